@@ -0,0 +1,37 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "benchmarks.h"
+
+// Замена глобальных operator new и delete для подсчета выделений памяти в
+// замерах. Счетчик общий для всех потоков
+namespace {
+std::atomic<size_t> allocationsCount{0};
+}  // namespace
+
+void* operator new(size_t size) {
+  allocationsCount.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace s21 {
+namespace benchmarks {
+
+size_t AllocationsCount() {
+  return allocationsCount.load(std::memory_order_relaxed);
+}
+
+}  //  namespace benchmarks
+}  //  namespace s21
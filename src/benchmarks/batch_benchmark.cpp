@@ -0,0 +1,113 @@
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../controller/controller.h"
+#include "benchmarks.h"
+
+namespace s21 {
+namespace benchmarks {
+
+namespace {
+template <typename T>
+std::vector<std::vector<T>> SplitIntoBatches(const std::vector<T>& items,
+                                             const size_t batchSize) {
+  std::vector<std::vector<T>> batches;
+  for (size_t i = 0; i < items.size(); i += batchSize)
+    batches.emplace_back(items.begin() + i,
+                         items.begin() + std::min(items.size(), i + batchSize));
+  return batches;
+}
+
+// Одиночные вызовы и пакеты по batchSize ключей через Controller, как их
+// выполняет Interface. Непустой logName включает журнал с общим fsync
+void RunStore(const std::string& name, const ContainerType type,
+              const int keysCount, const size_t batchSize,
+              const std::string& logName = "") {
+  std::vector<std::pair<Key, Value>> values;
+  std::vector<Key> keys;
+  for (int i = 0; i < keysCount; ++i) {
+    keys.push_back("key" + std::to_string(i));
+    values.push_back({keys.back(), {"Ivanov", "Ivan", 2000, "Moscow", i}});
+  }
+  const auto valueBatches = SplitIntoBatches(values, batchSize);
+  const auto keyBatches = SplitIntoBatches(keys, batchSize);
+  const auto ttl = std::chrono::hours(1);
+  auto open = [&](Controller& store) {
+    if (logName.empty()) return;
+    std::remove(logName.c_str());
+    store.EnableLog(logName, fsyncGroupCommit, std::chrono::milliseconds(0));
+  };
+  size_t found = 0;
+  {
+    Controller store(type);
+    open(store);
+    Measure(
+        name + " set with ttl",
+        [&]() {
+          for (const auto& [key, value] : values) store.set(key, value, ttl);
+        },
+        keysCount);
+    Measure(
+        name + " get",
+        [&]() {
+          for (const auto& key : keys) found += store.get(key).has_value();
+        },
+        keysCount);
+    Measure(
+        name + " del", [&]() { for (const auto& key : keys) store.del(key); },
+        keysCount);
+  }
+  {
+    Controller store(type);
+    open(store);
+    Measure(
+        name + " mset with ttl",
+        [&]() {
+          for (const auto& batch : valueBatches) store.mset(batch, ttl);
+        },
+        keysCount);
+    Measure(
+        name + " mget",
+        [&]() {
+          for (const auto& batch : keyBatches)
+            for (const auto& value : store.mget(batch))
+              found -= value.has_value();
+        },
+        keysCount);
+    Measure(
+        name + " mdel",
+        [&]() {
+          for (const auto& batch : keyBatches) store.mdel(batch);
+        },
+        keysCount);
+  }
+  if (found != 0) printf("unexpected keys count\n");
+  if (!logName.empty()) std::remove(logName.c_str());
+}
+}  // namespace
+
+void BatchBenchmark() {
+  const size_t batchSize = 100;
+  const std::string logName =
+      (std::filesystem::temp_directory_path() / "s21_benchmark_batch.aof")
+          .string();
+  printf("== Per-key calls vs batches of %zu keys ==\n", batchSize);
+  // В хеш-таблице 256 корзин, поэтому она проверяется на небольшом числе
+  // ключей
+  RunStore("hashtable", hashTable, 20000, batchSize);
+  RunStore("rbtree", rbtree, 200000, batchSize);
+  std::filesystem::remove_all("s21_lsm_tree");
+  RunStore("lsm", lsmTree, 200000, batchSize);
+  std::filesystem::remove_all("s21_lsm_tree");
+  std::filesystem::remove_all("s21_bitcask");
+  RunStore("bitcask", bitcask, 200000, batchSize);
+  std::filesystem::remove_all("s21_bitcask");
+  // Пакет сбрасывает журнал одним fsync вместо fsync на каждый ключ
+  printf("== Same with the operation log, group commit ==\n");
+  RunStore("rbtree + log", rbtree, 20000, batchSize, logName);
+}
+
+}  //  namespace benchmarks
+}  //  namespace s21
@@ -0,0 +1,43 @@
+// Замеры производительности компонентов хранилища
+#ifndef SRC_BENCHMARKS_BENCHMARKS_H_
+#define SRC_BENCHMARKS_BENCHMARKS_H_
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace s21 {
+namespace benchmarks {
+
+template <typename Func>
+double Measure(const std::string& name, Func func, long long operations = 0) {
+  auto start = std::chrono::steady_clock::now();
+  func();
+  std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+  if (operations > 0)
+    printf("%-48s %10.3f s %14.0f op/s\n", name.c_str(), time.count(),
+           operations / time.count());
+  else
+    printf("%-48s %10.3f s\n", name.c_str(), time.count());
+  return time.count();
+}
+
+void TtlBenchmark();
+void MultiStoreTtlBenchmark();
+void DataBenchmark();
+void LogBenchmark();
+void LsmBenchmark();
+void BitcaskBenchmark();
+void BloomBenchmark();
+void SortedTableBenchmark();
+void BatchBenchmark();
+void ZeroCopyBenchmark();
+void IncrBenchmark();
+
+// Число вызовов operator new с начала программы
+size_t AllocationsCount();
+
+}  //  namespace benchmarks
+}  //  namespace s21
+
+#endif  //  SRC_BENCHMARKS_BENCHMARKS_H_
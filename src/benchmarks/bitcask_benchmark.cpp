@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../model/bitcask/bitcask.h"
+#include "../model/hash_table/hash_table.h"
+#include "benchmarks.h"
+
+namespace s21 {
+namespace benchmarks {
+
+namespace {
+// Задержки операций func(i) для i из order
+template <typename Func>
+void PrintLatency(const std::string& name, const std::vector<int>& order,
+                  Func func) {
+  std::vector<double> latencies;
+  latencies.reserve(order.size());
+  auto total = std::chrono::steady_clock::now();
+  for (int i : order) {
+    auto start = std::chrono::steady_clock::now();
+    func(i);
+    std::chrono::duration<double, std::micro> time =
+        std::chrono::steady_clock::now() - start;
+    latencies.push_back(time.count());
+  }
+  std::chrono::duration<double> time = std::chrono::steady_clock::now() - total;
+  std::sort(latencies.begin(), latencies.end());
+  printf("%-32s %10.0f op/s  p50 %6.1f us  p99 %7.1f us\n", name.c_str(),
+         order.size() / time.count(), latencies[latencies.size() / 2],
+         latencies[latencies.size() * 99 / 100]);
+}
+
+void RunStore(const std::string& name, AbstractKeyValueStore& store,
+              std::vector<int>& order, std::mt19937& gen) {
+  std::shuffle(order.begin(), order.end(), gen);
+  PrintLatency(name + " set", order, [&](int i) {
+    store.set("key" + std::to_string(i), {"Ivanov", "Ivan", 2000, "Moscow", i});
+  });
+  std::shuffle(order.begin(), order.end(), gen);
+  PrintLatency(name + " get", order,
+               [&](int i) { store.get("key" + std::to_string(i)); });
+  PrintLatency(name + " get, missing keys", order,
+               [&](int i) { store.get("key" + std::to_string(i) + "_"); });
+}
+}  // namespace
+
+void BitcaskBenchmark() {
+  // В хеш-таблице 256 корзин, поэтому сравнение идет на небольшом числе ключей
+  const int compareCount = 20000;
+  const int keysCount = 300000;
+  std::mt19937 gen(21);
+  std::vector<int> order(compareCount);
+  for (int i = 0; i < compareCount; ++i) order[i] = i;
+  Bitcask::Options options;
+  options.directory =
+      (std::filesystem::temp_directory_path() / "s21_benchmark_bitcask")
+          .string();
+  options.segmentBytes = 8 << 20;
+  std::filesystem::remove_all(options.directory);
+  printf("== Bitcask vs hash table, %d keys ==\n", compareCount);
+  {
+    HashTable table;
+    RunStore("hash table", table, order, gen);
+  }
+  {
+    Bitcask bitcask(options);
+    RunStore("bitcask", bitcask, order, gen);
+  }
+  std::filesystem::remove_all(options.directory);
+
+  printf("== Bitcask, %d keys ==\n", keysCount);
+  order.resize(keysCount);
+  for (int i = 0; i < keysCount; ++i) order[i] = i;
+  {
+    Bitcask bitcask(options);
+    RunStore("bitcask", bitcask, order, gen);
+  }
+  // Открытие каталога: без подсказок сегменты читаются целиком
+  Measure(
+      "bitcask reopen, scan segments", [&]() { Bitcask bitcask(options); },
+      keysCount);
+  {
+    Bitcask bitcask(options);
+    bitcask.merge();
+  }
+  Measure(
+      "bitcask reopen after merge, hint files",
+      [&]() { Bitcask bitcask(options); }, keysCount);
+  std::filesystem::remove_all(options.directory);
+}
+
+}  //  namespace benchmarks
+}  //  namespace s21
@@ -0,0 +1,75 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../model/hash_table/hash_table.h"
+#include "../model/lsm_tree/lsm_tree.h"
+#include "benchmarks.h"
+
+namespace s21 {
+namespace benchmarks {
+
+namespace {
+// Доля missPercent запросов ищет отсутствующий ключ
+void Lookups(const std::string& name, AbstractKeyValueStore& store,
+             const int keysCount, const int lookupsCount,
+             const unsigned missPercent) {
+  std::mt19937 gen(21);
+  std::vector<std::string> keys(lookupsCount);
+  int expected = 0;
+  for (auto& key : keys) {
+    const int i = static_cast<int>(gen() % keysCount);
+    const bool miss = gen() % 100 < missPercent;
+    expected += !miss;
+    key = "key" + std::to_string(i) + (miss ? "_" : "");
+  }
+  int found = 0;
+  Measure(
+      name + ", " + std::to_string(missPercent) + "% misses",
+      [&]() {
+        for (const auto& key : keys) found += store.exists(key);
+      },
+      lookupsCount);
+  if (found != expected) printf("unexpected hits count\n");
+}
+
+std::string FilterName(const double rate) {
+  if (rate == 0) return "no filters";
+  char name[32];
+  snprintf(name, sizeof(name), "fp rate %g", rate);
+  return name;
+}
+}  // namespace
+
+void BloomBenchmark() {
+  const int tableKeys = 100000;
+  printf("== Hash table, %d keys ==\n", tableKeys);
+  for (const double rate : {0.0, 0.01, 0.001}) {
+    HashTable table(rate);
+    for (int i = 0; i < tableKeys; ++i)
+      table.set("key" + std::to_string(i),
+                {"Ivanov", "Ivan", 2000, "Moscow", i});
+    // Попадание обходит длинную цепочку корзины и стоит дороже промаха
+    Lookups(FilterName(rate), table, tableKeys, 200000, 100);
+    Lookups(FilterName(rate), table, tableKeys, 20000, 90);
+  }
+
+  const int lsmKeys = 300000;
+  printf("== LSM tree, %d keys ==\n", lsmKeys);
+  for (const double rate : {0.0, 0.01, 0.001}) {
+    LsmTree::Options options;
+    options.memtableBytes = 1 << 20;
+    options.runBytes = 2 << 20;
+    options.bloomFalsePositiveRate = rate;
+    LsmTree lsm(options);
+    for (int i = 0; i < lsmKeys; ++i)
+      lsm.set("key" + std::to_string(i),
+              {"Ivanov", "Ivan", 2000, "Moscow", i});
+    lsm.flush();
+    Lookups(FilterName(rate), lsm, lsmKeys, lsmKeys, 100);
+    Lookups(FilterName(rate), lsm, lsmKeys, lsmKeys, 90);
+  }
+}
+
+}  //  namespace benchmarks
+}  //  namespace s21
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "../model/data.h"
+#include "../model/delta_snapshot.h"
+#include "../model/hash_table/hash_table.h"
+#include "../model/mapped_file.h"
+#include "../model/self_balancing_binary_search_tree/self_balancing_binary_search_tree.h"
+#include "../model/snapshot.h"
+#include "benchmarks.h"
+
+namespace s21 {
+namespace benchmarks {
+
+namespace {
+// Размер дампа задается переменной окружения S21_BENCHMARK_DUMP_MB
+long long DumpSizeMb() {
+  const char* env = std::getenv("S21_BENCHMARK_DUMP_MB");
+  return env ? std::atoll(env) : 256;
+}
+
+long long WriteDump(const std::string& fileName, long long bytes) {
+  std::ofstream fout(fileName);
+  long long written = 0, lines = 0;
+  while (written < bytes) {
+    std::string line = "key" + std::to_string(lines) + " \"Ivanov\" \"Ivan " +
+                       std::to_string(lines % 100) + "\" " +
+                       std::to_string(1950 + lines % 70) +
+                       " \"Nizhny Novgorod\" " + std::to_string(lines % 1000) +
+                       "\n";
+    fout << line;
+    written += line.size();
+    ++lines;
+  }
+  return lines;
+}
+
+double FileSizeMb(const std::string& fileName) {
+  std::ifstream fin(fileName, std::ios::binary | std::ios::ate);
+  return static_cast<double>(fin.tellg()) / (1 << 20);
+}
+
+// Задержки SET новых ключей: пока exportDone не вернет true, но не меньше
+// minOperations
+void PrintSetLatency(const std::string& name,
+                     SelfBalancingBinarySearchTree& storage,
+                     const std::function<bool()>& exportDone,
+                     const size_t minOperations) {
+  static long long nextKey = 0;
+  Value value{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  std::vector<double> latencies;
+  while (latencies.size() < minOperations || !exportDone()) {
+    auto start = std::chrono::steady_clock::now();
+    storage.set("latency" + std::to_string(nextKey++), value);
+    std::chrono::duration<double, std::micro> time =
+        std::chrono::steady_clock::now() - start;
+    latencies.push_back(time.count());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  printf("%-48s p50 %8.1f us  p99 %8.1f us  max %10.1f us\n", name.c_str(),
+         latencies[latencies.size() / 2],
+         latencies[latencies.size() * 99 / 100], latencies.back());
+}
+}  // namespace
+
+void DataBenchmark() {
+  const std::string fileName = "/tmp/s21_benchmark_dump.txt";
+  const long long sizeMb = DumpSizeMb();
+  const long long lines = WriteDump(fileName, sizeMb << 20);
+  printf("== Text dump, %lld MB, %lld lines ==\n", sizeMb, lines);
+
+  size_t loaded = 0;
+  double time = Measure(
+      "Data::loadData", [&]() { loaded = Data::loadData(fileName).size(); },
+      lines);
+  printf("%-48s %10.1f MB/s\n", "  parse throughput", sizeMb / time);
+
+  SelfBalancingBinarySearchTree storage;
+  time = Measure(
+      "SelfBalancingBinarySearchTree::upload",
+      [&]() { storage.upload(fileName); }, lines);
+  printf("%-48s %10.1f MB/s\n", "  upload throughput", sizeMb / time);
+  {
+    // Цепочки 256 корзин растут с числом ключей, поэтому таблица загружает
+    // дамп поменьше
+    const std::string tableName = "/tmp/s21_benchmark_table_dump.txt";
+    const long long tableMb = std::max(1LL, sizeMb / 32);
+    const long long tableLines = WriteDump(tableName, tableMb << 20);
+    HashTable table;
+    time = Measure(
+        "HashTable::upload", [&]() { table.upload(tableName); }, tableLines);
+    printf("%-48s %10.1f MB/s\n", "  upload throughput", tableMb / time);
+    std::remove(tableName.c_str());
+  }
+  if (loaded != static_cast<size_t>(lines)) printf("unexpected line count\n");
+  std::remove(fileName.c_str());
+
+  // Перезапуск: выгрузка хранилища и загрузка в новое из текста и из снимка
+  printf("== Restart, %lld keys ==\n", lines);
+  const std::string textName = "/tmp/s21_benchmark_export.txt";
+  const std::string binaryName = "/tmp/s21_benchmark_export.snap";
+  Measure(
+      "export text", [&]() { storage.exportValues(textName, textFormat); },
+      lines);
+  Measure(
+      "export binary snapshot",
+      [&]() { storage.exportValues(binaryName, binaryFormat); }, lines);
+  Measure(
+      "parse text", [&]() { Data::loadData(textName); }, lines);
+  Measure(
+      "parse binary snapshot", [&]() { Data::loadData(binaryName); }, lines);
+  Measure(
+      "restart from text",
+      [&]() { SelfBalancingBinarySearchTree().upload(textName); }, lines);
+  Measure(
+      "restart from binary snapshot",
+      [&]() { SelfBalancingBinarySearchTree().upload(binaryName); }, lines);
+
+  // Сжатие блоков: размер файла и скорость загрузки относительно текста
+  printf("== Snapshot compression, %lld keys ==\n", lines);
+  const std::string rawName = "/tmp/s21_benchmark_export.raw";
+  Snapshot::save(rawName, Data::loadData(binaryName), false);
+  const double textMb = FileSizeMb(textName);
+  for (const auto& [name, file] :
+       {std::pair<const char*, std::string>{"text", textName},
+        {"uncompressed snapshot", rawName},
+        {"compressed snapshot", binaryName}}) {
+    const double fileMb = FileSizeMb(file);
+    MappedFile mapped(file);
+    time = Measure(
+        std::string("load ") + name,
+        [&]() {
+          if (Snapshot::IsSnapshot(mapped.View()))
+            Snapshot::load(mapped.View());
+          else
+            Data::loadData(file);
+        },
+        lines);
+    printf("%-48s %7.1f MB  x%.2f %10.1f MB/s\n",
+           "  file size, ratio to text, load as text", fileMb, textMb / fileMb,
+           textMb / time);
+  }
+  std::remove(rawName.c_str());
+
+  // Выгрузка в фоне блокирует хранилище только короткими отрезками обхода
+  printf("== SET latency, %lld keys ==\n", lines);
+  PrintSetLatency(
+      "idle", storage, []() { return true; }, 100000);
+  auto exported = storage.exportValuesInBackground(binaryName, binaryFormat);
+  PrintSetLatency(
+      "during background export", storage,
+      [&]() {
+        return exported.wait_for(std::chrono::seconds(0)) ==
+               std::future_status::ready;
+      },
+      1000);
+  std::remove(textName.c_str());
+  std::remove(binaryName.c_str());
+
+  // Дельта пишет только измененные записи
+  printf("== Checkpoint, 1%% of %lld keys changed ==\n", lines);
+  const std::string chainName = "/tmp/s21_benchmark_chain.snap";
+  Measure(
+      "full checkpoint", [&]() { storage.checkpoint(chainName); }, lines);
+  for (long long i = 0; i < lines; i += 100)
+    storage.update("key" + std::to_string(i), Value{"", "", 0, "", -1}, 0,
+                   pCoins);
+  Measure(
+      "delta checkpoint", [&]() { storage.checkpoint(chainName); }, lines);
+  Measure(
+      "restore base + delta",
+      [&]() { SelfBalancingBinarySearchTree().restoreCheckpoint(chainName); },
+      lines);
+  Measure(
+      "compact chain",
+      [&]() { DeltaSnapshot::compact(chainName); }, lines);
+  std::remove(chainName.c_str());
+}
+
+}  //  namespace benchmarks
+}  //  namespace s21
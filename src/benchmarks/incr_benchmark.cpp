@@ -0,0 +1,76 @@
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../controller/controller.h"
+#include "benchmarks.h"
+
+namespace s21 {
+namespace benchmarks {
+
+namespace {
+// Потоки прибавляют по единице к coins общих счетчиков. Возвращает число
+// потерянных прибавлений
+template <typename Increment>
+long long RunCounters(Controller& store, const std::string& name,
+                      const int countersCount, const int threadsCount,
+                      const int incrementsPerThread, Increment increment) {
+  for (int i = 0; i < countersCount; ++i)
+    store.update("counter" + std::to_string(i), {"", "", 0, "", 0}, 0, pCoins);
+  Measure(
+      name,
+      [&]() {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadsCount; ++t)
+          threads.emplace_back([&, t]() {
+            for (int i = 0; i < incrementsPerThread; ++i)
+              increment("counter" + std::to_string((i + t) % countersCount));
+          });
+        for (auto& thread : threads) thread.join();
+      },
+      static_cast<long long>(threadsCount) * incrementsPerThread);
+  long long total = 0;
+  for (int i = 0; i < countersCount; ++i)
+    total += store.get("counter" + std::to_string(i))->coins;
+  return static_cast<long long>(threadsCount) * incrementsPerThread - total;
+}
+
+void RunStore(const std::string& name, const ContainerType type) {
+  const int countersCount = 100;
+  const int threadsCount = 4;
+  const int incrementsPerThread = 100000;
+  Controller store(type);
+  for (int i = 0; i < countersCount; ++i)
+    store.set("counter" + std::to_string(i), {"Ivanov", "Ivan", 2000, "", 0});
+  // Чтение и изменение двумя вызовами: два захвата блокировки, а
+  // одновременные прибавления к одному счетчику теряются
+  const long long lost = RunCounters(
+      store, name + " get + update", countersCount, threadsCount,
+      incrementsPerThread, [&store](const Key& key) {
+        Value value = *store.get(key);
+        value.coins += 1;
+        store.update(key, value, 0, pCoins);
+      });
+  printf("%-48s %10lld\n", (name + " lost by get + update").c_str(), lost);
+  if (RunCounters(store, name + " incrBy", countersCount, threadsCount,
+                  incrementsPerThread, [&store](const Key& key) {
+                    int result = 0;
+                    store.incrBy(key, pCoins, 1, result);
+                  }) != 0)
+    printf("unexpected lost increments\n");
+}
+}  // namespace
+
+void IncrBenchmark() {
+  printf("== Counters: get + update vs incrBy, 4 threads ==\n");
+  RunStore("hashtable", hashTable);
+  RunStore("rbtree", rbtree);
+  std::filesystem::remove_all("s21_lsm_tree");
+  RunStore("lsm", lsmTree);
+  std::filesystem::remove_all("s21_lsm_tree");
+}
+
+}  //  namespace benchmarks
+}  //  namespace s21
@@ -0,0 +1,64 @@
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../model/self_balancing_binary_search_tree/self_balancing_binary_search_tree.h"
+#include "benchmarks.h"
+
+namespace s21 {
+namespace benchmarks {
+
+namespace {
+const std::string LogFile = "log_benchmark.aof";
+
+void RunWriters(SelfBalancingBinarySearchTree& store, const int threadsCount,
+                const int keysPerThread) {
+  Value value{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threadsCount; ++t)
+    workers.emplace_back([&, t]() {
+      for (int key = 0; key < keysPerThread; ++key)
+        store.set(std::to_string(t) + "_" + std::to_string(key), value);
+    });
+  for (auto& worker : workers) worker.join();
+}
+}  // namespace
+
+void LogBenchmark() {
+  const int threadsCount = 8;
+  const int keysPerThread = 2000;
+  printf("== SET from %d threads, %d keys each ==\n", threadsCount,
+         keysPerThread);
+  struct Mode {
+    std::string name;
+    bool enabled;
+    FsyncPolicy policy;
+  };
+  const std::vector<Mode> modes = {{"no log", false, fsyncInterval},
+                                   {"log, fsync every 1000 ms", true,
+                                    fsyncInterval},
+                                   {"log, group commit", true,
+                                    fsyncGroupCommit},
+                                   {"log, fsync always", true, fsyncAlways}};
+  for (const auto& mode : modes) {
+    unlink(LogFile.c_str());
+    SelfBalancingBinarySearchTree store;
+    if (mode.enabled) store.EnableLog(LogFile, mode.policy);
+    Measure(
+        mode.name, [&]() { RunWriters(store, threadsCount, keysPerThread); },
+        static_cast<long long>(threadsCount) * keysPerThread);
+  }
+  {
+    SelfBalancingBinarySearchTree store;
+    Measure("replay", [&]() { store.EnableLog(LogFile); },
+            static_cast<long long>(threadsCount) * keysPerThread);
+    Measure("rewrite", [&]() { store.RewriteLog(); },
+            static_cast<long long>(threadsCount) * keysPerThread);
+  }
+  unlink(LogFile.c_str());
+}
+
+}  //  namespace benchmarks
+}  //  namespace s21
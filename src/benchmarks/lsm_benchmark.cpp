@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../model/lsm_tree/lsm_tree.h"
+#include "benchmarks.h"
+
+namespace s21 {
+namespace benchmarks {
+
+void LsmBenchmark() {
+  const int keysCount = 300000;
+  // Таблица в памяти в сотни раз меньше данных, почти все чтения идут в файлы
+  LsmTree::Options options;
+  options.memtableBytes = 1 << 20;
+  options.runBytes = 2 << 20;
+  LsmTree lsm(options);
+  printf("== LSM tree, %d keys, memtable %zu KB ==\n", keysCount,
+         options.memtableBytes >> 10);
+  std::mt19937 gen(21);
+  std::vector<int> order(keysCount);
+  for (int i = 0; i < keysCount; ++i) order[i] = i;
+  std::shuffle(order.begin(), order.end(), gen);
+  Measure(
+      "set, random order",
+      [&]() {
+        for (int i : order)
+          lsm.set("key" + std::to_string(i),
+                  {"Ivanov", "Ivan", 2000, "Moscow", i});
+      },
+      keysCount);
+  Measure("flush and compact", [&]() { lsm.flush(); });
+  std::string levels;
+  for (size_t runs : lsm.runsPerLevel()) levels += " " + std::to_string(runs);
+  printf("%-48s%s\n", "  runs per level", levels.c_str());
+  std::shuffle(order.begin(), order.end(), gen);
+  int found = 0;
+  Measure(
+      "get, random order",
+      [&]() {
+        for (int i : order) found += lsm.get("key" + std::to_string(i)) ? 1 : 0;
+      },
+      keysCount);
+  Measure(
+      "get, missing keys",
+      [&]() {
+        for (int i : order)
+          found += lsm.exists("key" + std::to_string(i) + "_");
+      },
+      keysCount);
+  Measure(
+      "keys scan", [&]() { found -= static_cast<int>(lsm.keys().size()); },
+      keysCount);
+  if (found != 0) printf("unexpected keys count\n");
+}
+
+}  //  namespace benchmarks
+}  //  namespace s21
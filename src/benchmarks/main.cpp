@@ -0,0 +1,24 @@
+#include <cstring>
+
+#include "benchmarks.h"
+
+int main(int argc, char *argv[]) {
+  auto enabled = [&](const char *name) {
+    if (argc < 2) return true;
+    for (int i = 1; i < argc; ++i)
+      if (strcmp(argv[i], name) == 0) return true;
+    return false;
+  };
+  if (enabled("ttl")) s21::benchmarks::TtlBenchmark();
+  if (enabled("multistore")) s21::benchmarks::MultiStoreTtlBenchmark();
+  if (enabled("data")) s21::benchmarks::DataBenchmark();
+  if (enabled("log")) s21::benchmarks::LogBenchmark();
+  if (enabled("lsm")) s21::benchmarks::LsmBenchmark();
+  if (enabled("bitcask")) s21::benchmarks::BitcaskBenchmark();
+  if (enabled("bloom")) s21::benchmarks::BloomBenchmark();
+  if (enabled("table")) s21::benchmarks::SortedTableBenchmark();
+  if (enabled("batch")) s21::benchmarks::BatchBenchmark();
+  if (enabled("zerocopy")) s21::benchmarks::ZeroCopyBenchmark();
+  if (enabled("incr")) s21::benchmarks::IncrBenchmark();
+  return 0;
+}
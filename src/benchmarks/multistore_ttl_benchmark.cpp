@@ -0,0 +1,39 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../model/hash_table/hash_table.h"
+#include "benchmarks.h"
+
+namespace s21 {
+namespace benchmarks {
+
+void MultiStoreTtlBenchmark() {
+  const int keysPerStore = 20000;
+  const int maxStores = std::max(2u, std::thread::hardware_concurrency());
+  printf("== SET ... EX on independent stores, %d keys each ==\n",
+         keysPerStore);
+  for (int storesCount = 1; storesCount <= maxStores; storesCount *= 2) {
+    std::vector<std::unique_ptr<HashTable>> stores;
+    for (int i = 0; i < storesCount; ++i)
+      stores.push_back(std::make_unique<HashTable>());
+    Value value{"Ivanov", "Ivan", 2000, "Moscow", 10};
+    Measure(
+        std::to_string(storesCount) + " stores / threads",
+        [&]() {
+          std::vector<std::thread> workers;
+          for (int i = 0; i < storesCount; ++i)
+            workers.emplace_back([&, i]() {
+              for (int key = 0; key < keysPerStore; ++key)
+                stores[i]->set(std::to_string(key), value, 1 + key % 60);
+            });
+          for (auto& worker : workers) worker.join();
+        },
+        static_cast<long long>(keysPerStore) * storesCount);
+  }
+}
+
+}  //  namespace benchmarks
+}  //  namespace s21
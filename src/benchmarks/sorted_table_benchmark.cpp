@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../model/self_balancing_binary_search_tree/self_balancing_binary_search_tree.h"
+#include "../model/sorted_table/sorted_table.h"
+#include "benchmarks.h"
+
+namespace s21 {
+namespace benchmarks {
+
+void SortedTableBenchmark() {
+  const int keysCount = 300000;
+  const std::string dumpName = "/tmp/s21_benchmark_table.snap";
+  const std::string tableName = "/tmp/s21_benchmark_table.table";
+  std::vector<std::pair<Key, Value>> values;
+  values.reserve(keysCount);
+  for (int i = 0; i < keysCount; ++i)
+    values.push_back(
+        {"key" + std::to_string(i), {"Ivanov", "Ivan", 2000, "Moscow", i}});
+  {
+    SelfBalancingBinarySearchTree tree;
+    std::vector<std::pair<Key, Value>> copy = values;
+    tree.bulkInsert(copy);
+    tree.exportValues(dumpName, binaryFormat);
+  }
+  printf("== Read-only table vs rbtree, %d keys ==\n", keysCount);
+  Measure(
+      "table build", [&]() { SortedTable::Build(tableName, values); },
+      keysCount);
+
+  // Открытие: дерево строится из двоичной выгрузки, таблица читает индекс
+  std::unique_ptr<SelfBalancingBinarySearchTree> tree;
+  Measure(
+      "rbtree start: upload binary dump",
+      [&]() {
+        tree = std::make_unique<SelfBalancingBinarySearchTree>();
+        tree->upload(dumpName);
+      },
+      keysCount);
+  std::unique_ptr<SortedTable> table;
+  Measure(
+      "table start: map file, read fence index",
+      [&]() { table = std::make_unique<SortedTable>(tableName); }, keysCount);
+
+  std::mt19937 gen(21);
+  std::vector<std::string> keys(keysCount);
+  for (auto& key : keys) key = "key" + std::to_string(gen() % keysCount);
+  int found = 0;
+  Measure(
+      "rbtree get, random order",
+      [&]() {
+        for (const auto& key : keys) found += tree->get(key) ? 1 : 0;
+      },
+      keysCount);
+  Measure(
+      "table get, random order",
+      [&]() {
+        for (const auto& key : keys) found -= table->get(key) ? 1 : 0;
+      },
+      keysCount);
+  Measure(
+      "table exists, missing keys",
+      [&]() {
+        for (const auto& key : keys) found += table->exists(key + "_");
+      },
+      keysCount);
+  std::vector<std::string> sorted = table->keys();
+  const int rangesCount = 10000;
+  size_t rows = 0;
+  Measure(
+      "table range, 100 keys",
+      [&]() {
+        for (int i = 0; i < rangesCount; ++i) {
+          const size_t first = gen() % (sorted.size() - 100);
+          rows += table->range(sorted[first], sorted[first + 99]).size();
+        }
+      },
+      rangesCount);
+  if (found != 0 || rows != 100u * rangesCount)
+    printf("unexpected keys count\n");
+  std::remove(dumpName.c_str());
+  std::remove(tableName.c_str());
+}
+
+}  //  namespace benchmarks
+}  //  namespace s21
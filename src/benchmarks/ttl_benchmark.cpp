@@ -0,0 +1,45 @@
+#include <string>
+#include <thread>
+
+#include "../model/dispatchers/dispatcher_base.h"
+#include "../model/hash_table/hash_table.h"
+#include "benchmarks.h"
+
+namespace s21 {
+namespace benchmarks {
+
+void TtlBenchmark() {
+  const int keysCount = 5000000;
+  printf("== TTL dispatcher, %d keys ==\n", keysCount);
+  HashTable storage;
+  Dispatcher dispatcher;
+  dispatcher.Activate(&storage);
+
+  Measure(
+      "insert keys with TTL 1..3600 s",
+      [&]() {
+        Deadline now = Clock::now();
+        for (int i = 0; i < keysCount; ++i)
+          dispatcher.AddOrUpdateObservableValue(
+              std::to_string(i), now + std::chrono::seconds(2 + i % 3600));
+      },
+      keysCount);
+  Measure(
+      "1000 ticks without expired keys",
+      [&]() {
+        for (int i = 0; i < 1000; ++i) dispatcher.Update();
+      },
+      1000);
+  std::this_thread::sleep_for(std::chrono::seconds(3));
+  Measure("tick expiring ~2800 keys", [&]() { dispatcher.Update(); });
+  Measure(
+      "delete keys from observation",
+      [&]() {
+        for (int i = 0; i < keysCount; ++i)
+          dispatcher.DeleteKeyFromObserv(std::to_string(i));
+      },
+      keysCount);
+}
+
+}  //  namespace benchmarks
+}  //  namespace s21
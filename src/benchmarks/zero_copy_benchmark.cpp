@@ -0,0 +1,74 @@
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../model/hash_table/hash_table.h"
+#include "../model/lsm_tree/lsm_tree.h"
+#include "../model/self_balancing_binary_search_tree/self_balancing_binary_search_tree.h"
+#include "benchmarks.h"
+
+namespace s21 {
+namespace benchmarks {
+
+namespace {
+// Замер func по всем ключам с числом выделений памяти на операцию
+template <typename Func>
+void MeasureAllocations(const std::string& name,
+                        const std::vector<Key>& keys, Func func) {
+  const size_t before = AllocationsCount();
+  Measure(
+      name, [&]() { for (const auto& key : keys) func(key); }, keys.size());
+  printf("%-48s %10.2f\n", "  allocations per read",
+         1.0 * (AllocationsCount() - before) / keys.size());
+}
+
+void RunStore(const std::string& name, AbstractKeyValueStore& store,
+              const int keysCount) {
+  std::vector<Key> keys;
+  for (int i = 0; i < keysCount; ++i) {
+    keys.push_back("key" + std::to_string(i));
+    // Строки длиннее буфера малых строк, иначе копия не выделяет память
+    store.set(keys.back(), {"Konstantinopolsky", "Maximilian", 2000,
+                            "Saint Petersburg", i});
+  }
+  long long sum = 0;
+  MeasureAllocations(name + " get", keys, [&](const Key& key) {
+    std::optional<Value> value = store.get(key);
+    if (value) sum += value->coins + value->city.size();
+  });
+  MeasureAllocations(name + " visit", keys, [&](const Key& key) {
+    store.visit(key, [&sum](const Value& value) {
+      sum -= value.coins + value.city.size();
+    });
+  });
+  if (sum != 0) printf("unexpected values\n");
+}
+}  // namespace
+
+void ZeroCopyBenchmark() {
+  printf("== get copies vs visit ==\n");
+  {
+    // В хеш-таблице 256 корзин, поэтому ключей немного
+    HashTable hashTable;
+    RunStore("hashtable", hashTable, 20000);
+  }
+  {
+    SelfBalancingBinarySearchTree tree;
+    RunStore("rbtree", tree, 200000);
+  }
+  {
+    // Большая таблица в памяти держит все записи, маленькая сбрасывает
+    // почти все в файлы
+    LsmTree::Options options;
+    options.memtableBytes = 256 << 20;
+    LsmTree memtable(options);
+    RunStore("lsm, memtable", memtable, 200000);
+    options.memtableBytes = 64 << 10;
+    LsmTree runs(options);
+    RunStore("lsm, sorted runs", runs, 200000);
+  }
+}
+
+}  //  namespace benchmarks
+}  //  namespace s21
@@ -2,11 +2,19 @@
 
 namespace s21 {
 
-Controller::Controller(const ContainerType type) {
+Controller::Controller(const ContainerType type, const std::string& fileName) {
   if (type == hashTable) {
     storage_ = new HashTable();
   } else if (type == rbtree) {
     storage_ = new SelfBalancingBinarySearchTree();
+  } else if (type == lsmTree) {
+    LsmTree::Options options;
+    options.directory = "s21_lsm_tree";
+    storage_ = new LsmTree(options);
+  } else if (type == bitcask) {
+    storage_ = new Bitcask();
+  } else if (type == sortedTable) {
+    storage_ = table_ = new SortedTable(fileName);
   }
 };
 
@@ -16,34 +24,144 @@ Errors Controller::set(const std::string& key, const Value& value, int ttl) {
   return storage_->set(key, value, ttl);
 }
 
+Errors Controller::set(const std::string& key, const Value& value,
+                       std::chrono::milliseconds ttl) {
+  return storage_->set(key, value, ttl);
+}
+
+Errors Controller::set(Key&& key, Value&& value, int ttl) {
+  return storage_->set(std::move(key), std::move(value), ttl);
+}
+
+Errors Controller::set(Key&& key, Value&& value,
+                       std::chrono::milliseconds ttl) {
+  return storage_->set(std::move(key), std::move(value), ttl);
+}
+
 std::optional<Value> Controller::get(const std::string& key) {
   return storage_->get(key);
 }
 
+bool Controller::visit(const Key& key,
+                       const std::function<void(const Value&)>& visitor) {
+  return storage_->visit(key, visitor);
+}
+
+std::optional<VersionedValue> Controller::getVersioned(const Key& key) {
+  return storage_->getVersioned(key);
+}
+
+bool Controller::SupportsVersions() const {
+  return storage_->SupportsVersions();
+}
+
 bool Controller::exists(const std::string& key) {
   return storage_->exists(key);
 }
 
 Errors Controller::del(const std::string& key) { return storage_->del(key); }
 
+Errors Controller::delIfVersion(const Key& key, const uint64_t version) {
+  return storage_->delIfVersion(key, version);
+}
+
+std::vector<std::optional<Value>> Controller::mget(
+    const std::vector<Key>& keys) {
+  return storage_->mget(keys);
+}
+
+std::vector<Errors> Controller::mset(
+    const std::vector<std::pair<Key, Value>>& values,
+    std::chrono::milliseconds ttl) {
+  return storage_->mset(values, ttl);
+}
+
+std::vector<Errors> Controller::mdel(const std::vector<Key>& keys) {
+  return storage_->mdel(keys);
+}
+
 Errors Controller::update(const Key& key, const Value& value, const int ttl,
                           const int paramsMask) {
   return storage_->update(key, value, ttl, paramsMask);
 }
 
+Errors Controller::update(const Key& key, const Value& value,
+                          std::chrono::milliseconds ttl,
+                          const int paramsMask) {
+  return storage_->update(key, value, ttl, paramsMask);
+}
+
+Errors Controller::updateIfVersion(const Key& key, const Value& value,
+                                   const int ttl, const int paramsMask,
+                                   const uint64_t version) {
+  return storage_->updateIfVersion(key, value, ttl, paramsMask, version);
+}
+
+Errors Controller::updateIfVersion(const Key& key, const Value& value,
+                                   std::chrono::milliseconds ttl,
+                                   const int paramsMask,
+                                   const uint64_t version) {
+  return storage_->updateIfVersion(key, value, ttl, paramsMask, version);
+}
+
 Errors Controller::rename(const std::string& oldKey,
                           const std::string& newKey) {
   return storage_->rename(oldKey, newKey);
 }
 
+Errors Controller::incrBy(const Key& key, const int field, const int delta,
+                          int& result) {
+  return storage_->incrBy(key, field, delta, result);
+}
+
 int Controller::Ttl(const std::string& key) { return storage_->Ttl(key); }
 
+long long Controller::PTtl(const std::string& key) {
+  return storage_->PTtl(key);
+}
+
 int Controller::upload(const std::string& filename) {
   return storage_->upload(filename);
 }
 
-int Controller::exportValues(const std::string& filename) {
-  return storage_->exportValues(filename);
+size_t Controller::UploadErrorLine() { return storage_->UploadErrorLine(); }
+
+int Controller::exportValues(const std::string& filename,
+                             const FileFormat format) {
+  return storage_->exportValues(filename, format);
+}
+
+std::future<int> Controller::exportValuesInBackground(
+    const std::string& filename, const FileFormat format) {
+  return storage_->exportValuesInBackground(filename, format);
+}
+
+int Controller::EnableLog(const std::string& fileName,
+                          const FsyncPolicy policy,
+                          const std::chrono::milliseconds interval) {
+  return storage_->EnableLog(fileName, policy, interval);
+}
+
+int Controller::RewriteLog() { return storage_->RewriteLog(); }
+
+bool Controller::LogFailed() { return storage_->LogFailed(); }
+
+int Controller::checkpoint(const std::string& fileName) {
+  return storage_->checkpoint(fileName);
+}
+
+int Controller::restoreCheckpoint(const std::string& fileName) {
+  return storage_->restoreCheckpoint(fileName);
+}
+
+int Controller::compactCheckpoint(const std::string& fileName) {
+  return storage_->compactCheckpoint(fileName);
+}
+
+int Controller::buildTable(const std::string& fileName) {
+  return SortedTable::Build(fileName, [this](const EntryWriter& write) {
+    storage_->forEachEntryByKey(write);
+  });
 }
 
 const std::vector<std::string> Controller::keys() { return storage_->keys(); }
@@ -56,6 +174,45 @@ const std::vector<std::string> Controller::find(const Value& value,
 
 const std::vector<Value> Controller::showall() { return storage_->showall(); }
 
+const std::vector<AggregateRow> Controller::aggregate(
+    const AggregateQuery& query) {
+  return storage_->aggregate(query);
+}
+
+std::optional<std::vector<std::pair<Key, Value>>> Controller::range(
+    const Key& from, const Key& to) {
+  if (table_ == nullptr) return std::nullopt;
+  return table_->range(from, to);
+}
+
+std::vector<std::string> Controller::expiringWithin(
+    std::chrono::milliseconds window) {
+  return storage_->expiringWithin(window);
+}
+
+std::vector<size_t> Controller::expiryHistogram(
+    std::chrono::milliseconds bucket, const size_t bucketsCount) {
+  return storage_->expiryHistogram(bucket, bucketsCount);
+}
+
 int Controller::GetSize() { return storage_->GetSize(); }
 
+long long Controller::ApproxDistinct(const int field) {
+  return storage_->ApproxDistinct(field);
+}
+
+std::vector<HeavyHitter> Controller::TopK(const int field, const size_t k) {
+  return storage_->TopK(field, k);
+}
+
+std::shared_ptr<KeyspaceSubscription> Controller::Subscribe(
+    const size_t capacity) {
+  return storage_->Subscribe(capacity);
+}
+
+void Controller::Unsubscribe(
+    const std::shared_ptr<KeyspaceSubscription>& subscription) {
+  storage_->Unsubscribe(subscription);
+}
+
 }  //  namespace s21
@@ -1,11 +1,15 @@
 #ifndef SRC_MODEL_CONTROLLER_CONTROLLER_H_
 #define SRC_MODEL_CONTROLLER_CONTROLLER_H_
 
+#include <future>
 #include <memory>
 #include <optional>
 
+#include "../model/bitcask/bitcask.h"
 #include "../model/hash_table/hash_table.h"
+#include "../model/lsm_tree/lsm_tree.h"
 #include "../model/self_balancing_binary_search_tree/self_balancing_binary_search_tree.h"
+#include "../model/sorted_table/sorted_table.h"
 #include "../types.h"
 
 namespace s21 {
@@ -13,29 +17,84 @@ namespace s21 {
 class Controller {
  public:
   Controller() = delete;
-  Controller(const ContainerType type);
+  // fileName - файл таблицы для sortedTable, остальные хранилища его не
+  // используют
+  Controller(const ContainerType type, const std::string& fileName = "");
   ~Controller();
 
   Errors set(const std::string& key, const Value& value, int ttl = 0);
+  Errors set(const std::string& key, const Value& value,
+             std::chrono::milliseconds ttl);
+  Errors set(Key&& key, Value&& value, int ttl = 0);
+  Errors set(Key&& key, Value&& value, std::chrono::milliseconds ttl);
   std::optional<Value> get(const std::string& key);
+  bool visit(const Key& key,
+             const std::function<void(const Value&)>& visitor);
+  std::optional<VersionedValue> getVersioned(const Key& key);
+  bool SupportsVersions() const;
   bool exists(const std::string& key);
   Errors del(const std::string& key);
+  Errors delIfVersion(const Key& key, const uint64_t version);
+  std::vector<std::optional<Value>> mget(const std::vector<Key>& keys);
+  std::vector<Errors> mset(const std::vector<std::pair<Key, Value>>& values,
+                           std::chrono::milliseconds ttl);
+  std::vector<Errors> mdel(const std::vector<Key>& keys);
   Errors update(const Key& key, const Value& value, const int ttl,
                 const int paramsMask);
+  Errors update(const Key& key, const Value& value,
+                std::chrono::milliseconds ttl, const int paramsMask);
+  Errors updateIfVersion(const Key& key, const Value& value, const int ttl,
+                         const int paramsMask, const uint64_t version);
+  Errors updateIfVersion(const Key& key, const Value& value,
+                         std::chrono::milliseconds ttl, const int paramsMask,
+                         const uint64_t version);
   Errors rename(const std::string& oldKey, const std::string& newKey);
+  Errors incrBy(const Key& key, const int field, const int delta, int& result);
   int Ttl(const std::string& key);
+  long long PTtl(const std::string& key);
   int upload(const std::string& filename);
-  int exportValues(const std::string& filename);
+  size_t UploadErrorLine();
+  int exportValues(const std::string& filename,
+                   const FileFormat format = textFormat);
+  std::future<int> exportValuesInBackground(const std::string& filename,
+                                            const FileFormat format);
+  int EnableLog(const std::string& fileName, const FsyncPolicy policy,
+                const std::chrono::milliseconds interval);
+  int RewriteLog();
+  bool LogFailed();
+  int checkpoint(const std::string& fileName);
+  int restoreCheckpoint(const std::string& fileName);
+  int compactCheckpoint(const std::string& fileName);
+  // Записывает текущие записи хранилища в файл таблицы без времени жизни.
+  // Возвращает число записей или canNotOpenFile
+  int buildTable(const std::string& fileName);
+  // Изменения хранилища возвращают readOnlyStorage
+  bool isReadOnly() const { return table_ != nullptr; }
 
   const std::vector<std::string> keys();
   const std::vector<std::string> find(const Value& value, const int ttl,
                                       const int paramsMask);
   const std::vector<Value> showall();
+  const std::vector<AggregateRow> aggregate(const AggregateQuery& query);
+  // Записи с ключами от from до to по возрастанию ключа. nullopt, если
+  // хранилище не таблица
+  std::optional<std::vector<std::pair<Key, Value>>> range(const Key& from,
+                                                          const Key& to);
+  std::vector<std::string> expiringWithin(std::chrono::milliseconds window);
+  std::vector<size_t> expiryHistogram(std::chrono::milliseconds bucket,
+                                      const size_t bucketsCount);
 
   int GetSize();
+  long long ApproxDistinct(const int field);
+  std::vector<HeavyHitter> TopK(const int field, const size_t k);
+  std::shared_ptr<KeyspaceSubscription> Subscribe(
+      const size_t capacity = KeyspaceNotifier::DefaultCapacity);
+  void Unsubscribe(const std::shared_ptr<KeyspaceSubscription>& subscription);
 
  private:
   AbstractKeyValueStore* storage_;
+  // storage_, если хранилище - таблица, иначе nullptr
+  SortedTable* table_ = nullptr;
 };
 
 }  //  namespace s21
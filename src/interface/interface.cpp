@@ -5,28 +5,75 @@ Interface::Interface() { SetRegexMap(); }
 
 void Interface::SetRegexMap() {
   std::string key = (R"(\s\w+)");
-  std::string values = (R"(\s[\S]+\s[\S]+\s\d+\s[\S]+\s\d+)");
-  std::string values_dash =
-      (R"(\s[\S|-]+\s[\S|-]+\s[\S|-]+\s[\S|-]+\s[\S|-]+)");
-  std::string ex = (R"((\sEX\s\d+)?)");
+  // Год и монеты SET и MSET разбираются std::stoi до вызова хранилища
+  std::string values =
+      (R"(\s[\S]+\s[\S]+\s\d{1,9}\s[\S]+\s\d{1,9})");
+  // Год и монеты фильтра, UPDATE, UPDATEIF и FIND разбираются std::stoi,
+  // поэтому только числа или -
+  std::string filter =
+      (R"(\s\S+\s\S+\s(-|-?\d{1,9})\s\S+\s(-|-?\d{1,9}))");
+  std::string ex = (R"((\s(EX|PX)\s\d+)?)");
+  // find сравнивает время жизни в целых секундах
+  std::string exSeconds = (R"((\sEX\s\d{1,9})?)");
   std::string end = (R"(\s*?$)");
+  std::string version = (R"(\s\d{1,19})");
 
   regexMap["SET"] =
       std::regex(R"(^SET)" + key + values + ex + end, std::regex::icase);
   regexMap["GET"] = std::regex(R"(^GET)" + key + end, std::regex::icase);
+  regexMap["GETVER"] = std::regex(R"(^GETVER)" + key + end, std::regex::icase);
   regexMap["EXISTS"] = std::regex(R"(^EXISTS)" + key + end, std::regex::icase);
   regexMap["DEL"] = std::regex(R"(^DEL)" + key + end, std::regex::icase);
-  regexMap["UPDATE"] = std::regex(R"(^UPDATE)" + key + values_dash + ex + end,
+  regexMap["DELIF"] = std::regex(R"(^DELIF)" + key + version + end,
+                                 std::regex::icase);
+  regexMap["MGET"] = std::regex(R"(^MGET()" + key + ")+" + end,
+                                std::regex::icase);
+  regexMap["MSET"] =
+      std::regex(R"(^MSET()" + key + values + ")+" + ex + end,
+                 std::regex::icase);
+  regexMap["MDEL"] = std::regex(R"(^MDEL()" + key + ")+" + end,
+                                std::regex::icase);
+  regexMap["UPDATE"] = std::regex(R"(^UPDATE)" + key + filter + ex + end,
                                   std::regex::icase);
+  regexMap["UPDATEIF"] =
+      std::regex(R"(^UPDATEIF)" + key + version + filter + ex + end,
+                 std::regex::icase);
+  regexMap["INCRBY"] =
+      std::regex(R"(^INCRBY)" + key + R"(\s(year|coins)\s-?\d{1,9})" + end,
+                 std::regex::icase);
   regexMap["KEYS"] = std::regex(R"(^KEYS)" + end, std::regex::icase);
   regexMap["RENAME"] =
       std::regex(R"(^RENAME)" + key + key + end, std::regex::icase);
   regexMap["TTL"] = std::regex(R"(^TTL)" + key + end, std::regex::icase);
+  regexMap["PTTL"] = std::regex(R"(^PTTL)" + key + end, std::regex::icase);
   regexMap["FIND"] =
-      std::regex(R"(^FIND)" + values_dash + ex + end, std::regex::icase);
+      std::regex(R"(^FIND)" + filter + exSeconds + end,
+                 std::regex::icase);
   regexMap["SHOWALL"] = std::regex(R"(^SHOWALL)" + end, std::regex::icase);
   regexMap["UPLOAD"] = std::regex(R"(^UPLOAD\s.*$)", std::regex::icase);
   regexMap["EXPORT"] = std::regex(R"(^EXPORT\s.*)", std::regex::icase);
+  regexMap["AGGREGATE"] =
+      std::regex(R"(^AGGREGATE\s((SUM|MIN|MAX)\s(year|coins))"
+                 R"(|COUNT\s(year|coins|-)))"
+                 R"((\sBY\s(lastname|name|year|city|coins))?)"
+                 R"((\sWHERE)" +
+                     filter + ")?" + end,
+                 std::regex::icase);
+  regexMap["EXPIRING"] =
+      std::regex(R"(^EXPIRING\s\d{1,12}(\sBY\s\d{1,12})?)" + end,
+                 std::regex::icase);
+  regexMap["APPENDLOG"] = std::regex(
+      R"(^APPENDLOG\s\S+(\s(ALWAYS|GROUP|\d{1,6}))?)" + end, std::regex::icase);
+  regexMap["REWRITELOG"] =
+      std::regex(R"(^REWRITELOG)" + end, std::regex::icase);
+  regexMap["CHECKPOINT"] =
+      std::regex(R"(^CHECKPOINT\s\S+)" + end, std::regex::icase);
+  regexMap["RESTORE"] = std::regex(R"(^RESTORE\s\S+)" + end, std::regex::icase);
+  regexMap["COMPACT"] = std::regex(R"(^COMPACT\s\S+)" + end, std::regex::icase);
+  regexMap["RANGE"] =
+      std::regex(R"(^RANGE)" + key + key + end, std::regex::icase);
+  regexMap["BUILDTABLE"] =
+      std::regex(R"(^BUILDTABLE\s\S+)" + end, std::regex::icase);
   regexMap["HELP"] = std::regex(R"(^HELP)" + end, std::regex::icase);
   regexMap["RETURN"] = std::regex(R"(^RETURN)" + end, std::regex::icase);
 }
@@ -37,6 +84,9 @@ void Interface::ShowMainMenu() {
               << "Выберите тип хранилища:\n"
               << "\t1 - Хеш-таблица\n"
               << "\t2 - Самобалансирующееся бинарное дерево поиска\n"
+              << "\t3 - LSM-дерево на диске\n"
+              << "\t4 - Bitcask на диске\n"
+              << "\t5 - Отсортированная таблица из файла (только чтение)\n"
               << "\t0 - Выход\n";
 
     int input = -1;
@@ -47,15 +97,29 @@ void Interface::ShowMainMenu() {
       continue;
     }
 
+    // Прежнее хранилище закрывается до открытия нового: два экземпляра
+    // хранилища на диске не должны работать с одним каталогом
+    storage.reset();
     switch (input) {
       case 1:
-        storage = std::make_unique<Controller>(ContainerType::hashTable);
-        StorageStart();
+        OpenStorage(ContainerType::hashTable);
         break;
       case 2:
-        storage = std::make_unique<Controller>(ContainerType::rbtree);
-        StorageStart();
+        OpenStorage(ContainerType::rbtree);
         break;
+      case 3:
+        OpenStorage(ContainerType::lsmTree);
+        break;
+      case 4:
+        OpenStorage(ContainerType::bitcask);
+        break;
+      case 5: {
+        std::cout << "Введите путь к файлу таблицы:\n";
+        std::string fileName;
+        std::cin >> fileName;
+        OpenStorage(ContainerType::sortedTable, fileName);
+        break;
+      }
       case 0:
         std::cout << "bye-bye\n";
         return;
@@ -65,6 +129,19 @@ void Interface::ShowMainMenu() {
   }
 }
 
+void Interface::OpenStorage(const ContainerType type,
+                            const std::string& fileName) {
+  // Хранилища на диске бросают исключение, если их каталог или файл не
+  // открывается
+  try {
+    storage = std::make_unique<Controller>(type, fileName);
+  } catch (const std::runtime_error&) {
+    std::cout << "Ошибка: Невозможно открыть файл\n";
+    return;
+  }
+  StorageStart();
+}
+
 void Interface::ShowWrongInputAttention() {
   std::cout << "Некорректный ввод\n";
   std::cin.clear();
@@ -85,6 +162,8 @@ void Interface::StorageStart() {
             << "\tHELP - для вывода справочной информации о командах запросов\n"
             << "\tRETURN - для возврата в главное меню\n";
   while (true) {
+    ReportBackgroundExport(false);
+    ReportLogFailure();
     WaitingForInput();
     std::string str = "";
     std::getline(std::cin, str);
@@ -102,6 +181,10 @@ void Interface::StorageStart() {
     }
 
     Command commandNum = GetCommandNum(command.c_str());
+    if (storage->isReadOnly() && IsWriteCommand(commandNum)) {
+      std::cout << "ERROR: read-only storage\n";
+      continue;
+    }
     switch (commandNum) {
       case Command::SET:
         Set(args);
@@ -109,15 +192,36 @@ void Interface::StorageStart() {
       case Command::GET:
         Get(args);
         break;
+      case Command::GETVER:
+        GetVersioned(args);
+        break;
       case Command::EXISTS:
         Exists(args);
         break;
       case Command::DEL:
         Del(args);
         break;
+      case Command::DELIF:
+        DelIfVersion(args);
+        break;
+      case Command::MGET:
+        MGet(args);
+        break;
+      case Command::MSET:
+        MSet(args);
+        break;
+      case Command::MDEL:
+        MDel(args);
+        break;
       case Command::UPDATE:
         Update(args);
         break;
+      case Command::UPDATEIF:
+        UpdateIfVersion(args);
+        break;
+      case Command::INCRBY:
+        IncrBy(args);
+        break;
       case Command::KEYS:
         Keys();
         break;
@@ -127,6 +231,9 @@ void Interface::StorageStart() {
       case Command::TTL:
         Ttl(args);
         break;
+      case Command::PTTL:
+        PTtl(args);
+        break;
       case Command::FIND:
         Find(args);
         break;
@@ -139,10 +246,34 @@ void Interface::StorageStart() {
       case Command::EXPORT:
         Export(args);
         break;
+      case Command::AGGREGATE:
+        Aggregate(args);
+        break;
+      case Command::EXPIRING:
+        Expiring(args);
+        break;
+      case Command::APPENDLOG:
+        AppendLog(args);
+        break;
+      case Command::REWRITELOG:
+        RewriteLog();
+        break;
+      case Command::CHECKPOINT:
+      case Command::RESTORE:
+      case Command::COMPACT:
+        Checkpoint(args, commandNum);
+        break;
+      case Command::RANGE:
+        Range(args);
+        break;
+      case Command::BUILDTABLE:
+        BuildTable(args);
+        break;
       case Command::HELP:
         ShowHelpMenu();
         break;
       case Command::RETURN:
+        ReportBackgroundExport(true);
         return;
       default:
         ShowWrongInputAttention();
@@ -167,48 +298,100 @@ bool Interface::IsValidCommand(std::string str, std::string name) {
 Interface::Command Interface::GetCommandNum(const char* commandName) {
   if (strcasecmp(commandName, "SET") == 0) return Command::SET;
   if (strcasecmp(commandName, "GET") == 0) return Command::GET;
+  if (strcasecmp(commandName, "GETVER") == 0) return Command::GETVER;
   if (strcasecmp(commandName, "EXISTS") == 0) return Command::EXISTS;
   if (strcasecmp(commandName, "DEL") == 0) return Command::DEL;
+  if (strcasecmp(commandName, "DELIF") == 0) return Command::DELIF;
+  if (strcasecmp(commandName, "MGET") == 0) return Command::MGET;
+  if (strcasecmp(commandName, "MSET") == 0) return Command::MSET;
+  if (strcasecmp(commandName, "MDEL") == 0) return Command::MDEL;
   if (strcasecmp(commandName, "UPDATE") == 0) return Command::UPDATE;
+  if (strcasecmp(commandName, "UPDATEIF") == 0) return Command::UPDATEIF;
+  if (strcasecmp(commandName, "INCRBY") == 0) return Command::INCRBY;
   if (strcasecmp(commandName, "KEYS") == 0) return Command::KEYS;
   if (strcasecmp(commandName, "RENAME") == 0) return Command::RENAME;
   if (strcasecmp(commandName, "TTL") == 0) return Command::TTL;
+  if (strcasecmp(commandName, "PTTL") == 0) return Command::PTTL;
   if (strcasecmp(commandName, "FIND") == 0) return Command::FIND;
   if (strcasecmp(commandName, "SHOWALL") == 0) return Command::SHOWALL;
   if (strcasecmp(commandName, "UPLOAD") == 0) return Command::UPLOAD;
   if (strcasecmp(commandName, "EXPORT") == 0) return Command::EXPORT;
+  if (strcasecmp(commandName, "AGGREGATE") == 0) return Command::AGGREGATE;
+  if (strcasecmp(commandName, "EXPIRING") == 0) return Command::EXPIRING;
+  if (strcasecmp(commandName, "APPENDLOG") == 0) return Command::APPENDLOG;
+  if (strcasecmp(commandName, "REWRITELOG") == 0) return Command::REWRITELOG;
+  if (strcasecmp(commandName, "CHECKPOINT") == 0) return Command::CHECKPOINT;
+  if (strcasecmp(commandName, "RESTORE") == 0) return Command::RESTORE;
+  if (strcasecmp(commandName, "COMPACT") == 0) return Command::COMPACT;
+  if (strcasecmp(commandName, "RANGE") == 0) return Command::RANGE;
+  if (strcasecmp(commandName, "BUILDTABLE") == 0) return Command::BUILDTABLE;
   if (strcasecmp(commandName, "HELP") == 0) return Command::HELP;
   if (strcasecmp(commandName, "RETURN") == 0) return Command::RETURN;
   return Command::ERROR;
 }
 
+std::chrono::milliseconds Interface::GetTtlArg(
+    const std::vector<std::string>& commandArgs, size_t idx) {
+  if (commandArgs.size() <= idx + 1) return std::chrono::milliseconds(0);
+  // Слишком большое время жизни ограничивается LLONG_MAX миллисекунд,
+  // хранилище сводит его к самому дальнему представимому сроку
+  long long ttl = LLONG_MAX;
+  try {
+    ttl = std::stoll(commandArgs.at(idx + 1));
+  } catch (const std::out_of_range&) {
+  }
+  if (strcasecmp(commandArgs.at(idx).c_str(), "EX") == 0)
+    ttl = ttl > LLONG_MAX / 1000 ? LLONG_MAX : ttl * 1000;
+  return std::chrono::milliseconds(ttl);
+}
+
 void Interface::Set(const std::vector<std::string>& commandArgs) {
   Value values;
-  int ex = 0;
   Key key = commandArgs.at(1);
   values.lastname = commandArgs.at(2);
   values.name = commandArgs.at(3);
   values.year = std::stoi(commandArgs.at(4));
   values.city = commandArgs.at(5);
   values.coins = std::stoi(commandArgs.at(6));
-  if (commandArgs.size() > 8) ex = std::stoi(commandArgs.at(8));
 
-  if (storage->set(key, values, ex) == noErrors)
+  Errors res = storage->set(std::move(key), std::move(values),
+                            GetTtlArg(commandArgs, 7));
+  if (res == noErrors)
     std::cout << "OK\n";
-  else
+  else if (res == logWriteFailed)
+    std::cout << "ERROR: log write failed\n";
+  else if (res == keyAlreadyExists)
     std::cout << "ERROR: key already exists\n";
+  else
+    std::cout << "ERROR: write failed\n";
 }
 
 void Interface::Get(const std::vector<std::string>& commandArgs) {
   Key key = commandArgs.at(1);
 
-  auto findedValues = storage->get(key);
-  if (findedValues.has_value())
-    findedValues.value().Print();
+  // visitor вызывается под блокировкой хранилища, поэтому строка только
+  // форматируется в нем, а выводится после возврата из visit
+  std::ostringstream line;
+  if (storage->visit(key, [&line](const Value& value) { value.Print(line); }))
+    std::cout << line.str();
   else
     std::cout << "(null)\n";
 }
 
+void Interface::GetVersioned(const std::vector<std::string>& commandArgs) {
+  if (!storage->SupportsVersions()) {
+    std::cout << "ERROR: versions not supported by this storage\n";
+    return;
+  }
+  auto found = storage->getVersioned(commandArgs.at(1));
+  if (found) {
+    found->value.Print();
+    std::cout << "version " << found->version << "\n";
+  } else {
+    std::cout << "(null)\n";
+  }
+}
+
 void Interface::Exists(const std::vector<std::string>& commandArgs) {
   Key key = commandArgs.at(1);
   if (storage->exists(key))
@@ -220,15 +403,81 @@ void Interface::Exists(const std::vector<std::string>& commandArgs) {
 void Interface::Del(const std::vector<std::string>& commandArgs) {
   Key key = commandArgs.at(1);
 
-  if (storage->del(key) == noErrors)
+  Errors res = storage->del(key);
+  if (res == noErrors)
+    std::cout << "true\n";
+  else if (res == logWriteFailed)
+    std::cout << "ERROR: log write failed\n";
+  else
+    std::cout << "false\n";
+}
+
+void Interface::DelIfVersion(const std::vector<std::string>& commandArgs) {
+  Errors res =
+      storage->delIfVersion(commandArgs.at(1), std::stoull(commandArgs.at(2)));
+  if (res == noErrors)
     std::cout << "true\n";
+  else if (res == versionMismatch)
+    std::cout << "ERROR: version mismatch\n";
+  else if (res == versionsNotSupported)
+    std::cout << "ERROR: versions not supported by this storage\n";
+  else if (res == logWriteFailed)
+    std::cout << "ERROR: log write failed\n";
   else
     std::cout << "false\n";
 }
 
-void Interface::Update(const std::vector<std::string>& commandArgs) {
+void Interface::MGet(const std::vector<std::string>& commandArgs) {
+  std::vector<Key> keys(commandArgs.begin() + 1, commandArgs.end());
+  auto findedValues = storage->mget(keys);
+  for (size_t i = 0; i < findedValues.size(); i++) {
+    std::cout << i + 1 << ") ";
+    if (findedValues.at(i).has_value())
+      findedValues.at(i).value().Print();
+    else
+      std::cout << "(null)\n";
+  }
+}
+
+void Interface::MSet(const std::vector<std::string>& commandArgs) {
+  std::vector<std::pair<Key, Value>> values;
+  size_t i = 1;
+  for (; i + 5 < commandArgs.size(); i += 6) {
+    Value value;
+    value.lastname = commandArgs.at(i + 1);
+    value.name = commandArgs.at(i + 2);
+    value.year = std::stoi(commandArgs.at(i + 3));
+    value.city = commandArgs.at(i + 4);
+    value.coins = std::stoi(commandArgs.at(i + 5));
+    values.emplace_back(commandArgs.at(i), value);
+  }
+  auto results = storage->mset(values, GetTtlArg(commandArgs, i));
+  for (size_t j = 0; j < results.size(); j++) {
+    std::cout << j + 1 << ") ";
+    if (results.at(j) == noErrors)
+      std::cout << "OK\n";
+    else if (results.at(j) == logWriteFailed)
+      std::cout << "ERROR: log write failed\n";
+    else if (results.at(j) == keyAlreadyExists)
+      std::cout << "ERROR: key already exists\n";
+    else
+      std::cout << "ERROR: write failed\n";
+  }
+}
+
+void Interface::MDel(const std::vector<std::string>& commandArgs) {
+  std::vector<Key> keys(commandArgs.begin() + 1, commandArgs.end());
+  auto results = storage->mdel(keys);
+  const auto failed =
+      std::count(results.begin(), results.end(), logWriteFailed);
+  std::cout << std::count(results.begin(), results.end(), noErrors) + failed
+            << "\n";
+  if (failed > 0) std::cout << "ERROR: log write failed\n";
+}
+
+void Interface::Update(const std::vector<std::string>& commandArgs,
+                       const std::optional<uint64_t>& version) {
   Value values;
-  int ex = 0;
   Key key = commandArgs.at(1);
   values.lastname = commandArgs.at(2);
   values.name = commandArgs.at(3);
@@ -238,12 +487,43 @@ void Interface::Update(const std::vector<std::string>& commandArgs) {
   int mask = 0;
   for (size_t i = 2; i < 7; i++)
     if (commandArgs.at(i) != "-") mask |= (1 << (i - 2));
-  if (commandArgs.size() > 8) {
-    ex = std::stoi(commandArgs.at(8));
-    mask |= 5;
-  }
-  if (storage->update(key, values, ex, mask) == noErrors)
+  if (commandArgs.size() > 8) mask |= pTtl;
+  const auto ttl = GetTtlArg(commandArgs, 7);
+  Errors res = version
+                   ? storage->updateIfVersion(key, values, ttl, mask, *version)
+                   : storage->update(key, values, ttl, mask);
+  if (res == noErrors)
     std::cout << "OK\n";
+  else if (res == versionMismatch)
+    std::cout << "ERROR: version mismatch\n";
+  else if (res == versionsNotSupported)
+    std::cout << "ERROR: versions not supported by this storage\n";
+  else if (res == logWriteFailed)
+    std::cout << "ERROR: log write failed\n";
+  else
+    std::cout << "ERROR\n";
+}
+
+void Interface::UpdateIfVersion(const std::vector<std::string>& commandArgs) {
+  std::vector<std::string> args = commandArgs;
+  const uint64_t version = std::stoull(args.at(2));
+  args.erase(args.begin() + 2);
+  Update(args, version);
+}
+
+void Interface::IncrBy(const std::vector<std::string>& commandArgs) {
+  int result = 0;
+  Errors res = storage->incrBy(commandArgs.at(1),
+                               GetFieldParam(commandArgs.at(2)),
+                               std::stoi(commandArgs.at(3)), result);
+  if (res == noErrors)
+    std::cout << result << "\n";
+  else if (res == keyNotFound)
+    std::cout << "(null)\n";
+  else if (res == valueOutOfRange)
+    std::cout << "ERROR: value out of range\n";
+  else if (res == logWriteFailed)
+    std::cout << "ERROR: log write failed\n";
   else
     std::cout << "ERROR\n";
 }
@@ -261,8 +541,11 @@ void Interface::Rename(const std::vector<std::string>& commandArgs) {
   Key key1 = commandArgs.at(1);
   Key key2 = commandArgs.at(2);
 
-  if (storage->rename(key1, key2) == noErrors)
+  Errors res = storage->rename(key1, key2);
+  if (res == noErrors)
     std::cout << "true\n";
+  else if (res == logWriteFailed)
+    std::cout << "ERROR: log write failed\n";
   else
     std::cout << "false\n";
 }
@@ -291,6 +574,15 @@ void Interface::Ttl(const std::vector<std::string>& commandArgs) {
     std::cout << ttl << std::endl;
 }
 
+void Interface::PTtl(const std::vector<std::string>& commandArgs) {
+  Key key = commandArgs.at(1);
+  long long ttl = storage->PTtl(key);
+  if (ttl == keyNotFound)
+    std::cout << "(null)\n";
+  else
+    std::cout << ttl << std::endl;
+}
+
 void Interface::Find(const std::vector<std::string>& commandArgs) {
   Value values;
   int ex = 0;
@@ -304,7 +596,7 @@ void Interface::Find(const std::vector<std::string>& commandArgs) {
     if (commandArgs.at(i) != "-") mask |= (1 << (i - 1));
   if (commandArgs.size() > 7) {
     ex = std::stoi(commandArgs.at(7));
-    mask |= 5;
+    mask |= pTtl;
   }
 
   auto findedValues = storage->find(values, ex, mask);
@@ -320,6 +612,9 @@ void Interface::Upload(const std::vector<std::string>& commandArgs) {
   int rowCount = storage->upload(commandArgs.at(1));
   if (rowCount == canNotOpenFile)
     std::cout << "Ошибка: Невозможно открыть файл\n";
+  else if (rowCount == corruptedFile && storage->UploadErrorLine() != 0)
+    std::cout << "Ошибка: Файл поврежден, строка " << storage->UploadErrorLine()
+              << "\n";
   else if (rowCount == corruptedFile)
     std::cout << "Ошибка: Файл поврежден\n";
   else if (rowCount == unknownError)
@@ -329,13 +624,238 @@ void Interface::Upload(const std::vector<std::string>& commandArgs) {
 }
 
 void Interface::Export(const std::vector<std::string>& commandArgs) {
-  int rowCount = storage->exportValues(commandArgs.at(1));
+  FileFormat format = textFormat;
+  bool background = false;
+  for (size_t i = 2; i < commandArgs.size(); ++i) {
+    if (strcasecmp(commandArgs.at(i).c_str(), "BINARY") == 0)
+      format = binaryFormat;
+    if (strcasecmp(commandArgs.at(i).c_str(), "BACKGROUND") == 0)
+      background = true;
+  }
+  if (background) {
+    ReportBackgroundExport(true);
+    backgroundExport =
+        storage->exportValuesInBackground(commandArgs.at(1), format);
+    std::cout << "Выгрузка запущена\n";
+    return;
+  }
+  int rowCount = storage->exportValues(commandArgs.at(1), format);
   if (rowCount == canNotOpenFile)
     std::cout << "Ошибка: Невозможно открыть файл\n";
   else if (rowCount > 0)
     std::cout << "OK " << rowCount << "\n";
 }
 
+void Interface::ReportBackgroundExport(const bool wait) {
+  if (!backgroundExport.valid()) return;
+  if (!wait && backgroundExport.wait_for(std::chrono::seconds(0)) !=
+                   std::future_status::ready)
+    return;
+  int rowCount = backgroundExport.get();
+  if (rowCount == canNotOpenFile)
+    std::cout << "Фоновая выгрузка: Ошибка: Невозможно открыть файл\n";
+  else
+    std::cout << "Фоновая выгрузка: OK " << rowCount << "\n";
+}
+
+void Interface::AppendLog(const std::vector<std::string>& commandArgs) {
+  FsyncPolicy policy = fsyncInterval;
+  std::chrono::milliseconds interval(1000);
+  if (commandArgs.size() > 2) {
+    const std::string& mode = commandArgs.at(2);
+    if (strcasecmp(mode.c_str(), "ALWAYS") == 0)
+      policy = fsyncAlways;
+    else if (strcasecmp(mode.c_str(), "GROUP") == 0)
+      policy = fsyncGroupCommit;
+    else
+      interval = std::chrono::milliseconds(std::stoll(mode));
+  }
+  if (policy == fsyncInterval && interval.count() == 0) {
+    std::cout << "Ошибка: интервал должен быть больше 0\n";
+    return;
+  }
+  int rowCount = storage->EnableLog(commandArgs.at(1), policy, interval);
+  if (rowCount == canNotOpenFile)
+    std::cout << "Ошибка: Невозможно открыть файл\n";
+  else if (rowCount < 0)
+    std::cout << "Ошибка\n";
+  else
+    std::cout << "OK " << rowCount << "\n";
+}
+
+void Interface::ReportLogFailure() {
+  const bool failed = storage->LogFailed();
+  if (failed && !logFailureReported)
+    std::cout << "Ошибка: Запись в журнал не удалась, изменения не "
+                 "сохраняются до REWRITELOG\n";
+  logFailureReported = failed;
+}
+
+void Interface::RewriteLog() {
+  int rowCount = storage->RewriteLog();
+  if (rowCount == canNotOpenFile)
+    std::cout << "Ошибка: Журнал не включен\n";
+  else if (rowCount == logWriteFailed)
+    std::cout << "Ошибка: Запись в журнал не удалась\n";
+  else if (rowCount < 0)
+    std::cout << "Ошибка\n";
+  else
+    std::cout << "OK " << rowCount << "\n";
+}
+
+void Interface::Checkpoint(const std::vector<std::string>& commandArgs,
+                           Command command) {
+  int rowCount = 0;
+  if (command == Command::CHECKPOINT)
+    rowCount = storage->checkpoint(commandArgs.at(1));
+  else if (command == Command::RESTORE)
+    rowCount = storage->restoreCheckpoint(commandArgs.at(1));
+  else
+    rowCount = storage->compactCheckpoint(commandArgs.at(1));
+  if (rowCount == canNotOpenFile)
+    std::cout << "Ошибка: Невозможно открыть файл\n";
+  else if (rowCount == corruptedFile)
+    std::cout << "Ошибка: Файл поврежден\n";
+  else if (rowCount < 0)
+    std::cout << "Ошибка\n";
+  else
+    std::cout << "OK " << rowCount << "\n";
+}
+
+void Interface::Range(const std::vector<std::string>& commandArgs) {
+  auto rows = storage->range(commandArgs.at(1), commandArgs.at(2));
+  if (!rows) {
+    std::cout << "ERROR: RANGE is supported only by the sorted table\n";
+    return;
+  }
+  if (rows->empty()) {
+    std::cout << "(null)\n";
+    return;
+  }
+  for (size_t i = 0; i < rows->size(); i++) {
+    std::cout << i + 1 << ") " << rows->at(i).first << " ";
+    rows->at(i).second.Print();
+  }
+}
+
+void Interface::BuildTable(const std::vector<std::string>& commandArgs) {
+  int rowCount = storage->buildTable(commandArgs.at(1));
+  if (rowCount == canNotOpenFile)
+    std::cout << "Ошибка: Невозможно открыть файл\n";
+  else if (rowCount < 0)
+    std::cout << "Ошибка\n";
+  else
+    std::cout << "OK " << rowCount << "\n";
+}
+
+bool Interface::IsWriteCommand(Command command) {
+  switch (command) {
+    case Command::SET:
+    case Command::DEL:
+    case Command::DELIF:
+    case Command::MSET:
+    case Command::MDEL:
+    case Command::UPDATE:
+    case Command::UPDATEIF:
+    case Command::INCRBY:
+    case Command::RENAME:
+    case Command::UPLOAD:
+    case Command::APPENDLOG:
+    case Command::REWRITELOG:
+    case Command::RESTORE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+int Interface::GetFieldParam(std::string field) {
+  std::transform(field.begin(), field.end(), field.begin(), ::tolower);
+  if (field == "lastname") return pLastname;
+  if (field == "name") return pName;
+  if (field == "year") return pYear;
+  if (field == "city") return pCity;
+  if (field == "coins") return pCoins;
+  return 0;
+}
+
+void Interface::Aggregate(const std::vector<std::string>& commandArgs) {
+  AggregateQuery query{aggCount, 0, 0, Value(), 0, 0};
+  std::string function = commandArgs.at(1);
+  std::transform(function.begin(), function.end(), function.begin(),
+                 ::toupper);
+  if (function == "SUM") query.function = aggSum;
+  if (function == "MIN") query.function = aggMin;
+  if (function == "MAX") query.function = aggMax;
+  query.field = GetFieldParam(commandArgs.at(2));
+
+  size_t i = 3;
+  if (commandArgs.size() > i &&
+      strcasecmp(commandArgs.at(i).c_str(), "BY") == 0) {
+    query.groupBy = GetFieldParam(commandArgs.at(i + 1));
+    i += 2;
+  }
+  if (commandArgs.size() > i) {
+    ++i;
+    query.filter.lastname = commandArgs.at(i);
+    query.filter.name = commandArgs.at(i + 1);
+    query.filter.year =
+        commandArgs.at(i + 2) == "-" ? 0 : std::stoi(commandArgs.at(i + 2));
+    query.filter.city = commandArgs.at(i + 3);
+    query.filter.coins =
+        commandArgs.at(i + 4) == "-" ? 0 : std::stoi(commandArgs.at(i + 4));
+    for (size_t j = 0; j < 5; j++)
+      if (commandArgs.at(i + j) != "-") query.paramsMask |= (1 << j);
+  }
+
+  auto rows = storage->aggregate(query);
+  if (!rows.empty()) {
+    std::cout << std::left << std::setw(20) << "Group" << "| "
+              << std::setw(12) << "Result" << "| " << std::setw(8) << "Count"
+              << "|\n";
+    for (size_t j = 0; j < rows.size(); j++)
+      std::cout << std::setw(20) << rows.at(j).group << "  " << std::setw(12)
+                << rows.at(j).result << "  " << std::setw(8)
+                << rows.at(j).count << "\n";
+    std::cout << std::right;
+  } else
+    std::cout << "(null)\n";
+}
+
+void Interface::Expiring(const std::vector<std::string>& commandArgs) {
+  std::chrono::seconds window(std::stoll(commandArgs.at(1)));
+  if (commandArgs.size() > 3) {
+    std::chrono::seconds bucket(std::stoll(commandArgs.at(3)));
+    if (bucket.count() == 0) {
+      std::cout << "(null)\n";
+      return;
+    }
+    size_t bucketsCount =
+        (window.count() + bucket.count() - 1) / bucket.count();
+    if (bucketsCount > MaxHistogramBuckets) {
+      std::cout << "ERROR: too many buckets, maximum " << MaxHistogramBuckets
+                << "\n";
+      return;
+    }
+    auto counts = storage->expiryHistogram(bucket, bucketsCount);
+    std::cout << std::left << std::setw(20) << "Seconds" << "| "
+              << std::setw(8) << "Count" << "|\n";
+    for (size_t i = 0; i < counts.size(); i++)
+      std::cout << std::setw(20)
+                << std::to_string(i * bucket.count()) + "-" +
+                       std::to_string((i + 1) * bucket.count())
+                << "  " << std::setw(8) << counts.at(i) << "\n";
+    std::cout << std::right;
+    return;
+  }
+  auto findedKeys = storage->expiringWithin(window);
+  if (!findedKeys.empty())
+    for (size_t i = 0; i < findedKeys.size(); i++)
+      std::cout << i + 1 << ") " << findedKeys.at(i) << std::endl;
+  else
+    std::cout << "(null)\n";
+}
+
 void Interface::ShowHelpMenu() {
   std::cout << "Команды необходимо вводить в представленном формате:\n\n"
 
@@ -353,6 +873,7 @@ void Interface::ShowHelpMenu() {
             << "\tSET <ключ> <Фамилия> <Имя> <Год рождения> <Город> <Число "
                "текущих коинов> EX <время в \n"
             << "\tсекундах>(необязательное поле)\n"
+            << "\tВместо EX можно указать PX <время в миллисекундах>\n"
             << "\tКоманда используется для установки ключа и его значения.\n\n"
 
             << "\tGET <ключ>\n"
@@ -360,6 +881,13 @@ void Interface::ShowHelpMenu() {
                "ключом. Если такой записи нет, \n"
             << "\tто будет возвращён (null)\n\n"
 
+            << "\tGETVER <ключ>\n"
+            << "\tТо же, что GET, но дополнительно выводится версия записи. "
+               "Версия меняется при\n"
+            << "\tкаждом изменении записи. Хранилища на диске версий не "
+               "ведут, для них GETVER,\n"
+            << "\tDELIF и UPDATEIF выводят ошибку\n\n"
+
             << "\tEXISTS <ключ>\n"
             << "\tЭта команда проверяет, существует ли запись с данным ключом. "
                "Она возвращает true если \n"
@@ -370,6 +898,25 @@ void Interface::ShowHelpMenu() {
                "возвращает true, если запись\n"
             << "\tуспешно удалена, в противном случае - false\n\n"
 
+            << "\tDELIF <ключ> <версия>\n"
+            << "\tТо же, что DEL, но запись удаляется, только если ее версия "
+               "совпадает с заданной\n\n"
+
+            << "\tMGET <ключ> <ключ>...\n"
+            << "\tКоманда выводит значения нескольких ключей по порядку, "
+               "(null) для отсутствующих\n\n"
+
+            << "\tMSET <ключ> <Фамилия> <Имя> <Год рождения> <Город> <Число "
+               "текущих коинов> <ключ>...\n"
+            << "\tEX <время в секундах>(необязательное поле)\n"
+            << "\tКоманда задает несколько записей с общим временем жизни и "
+               "выводит результат для\n"
+            << "\tкаждого ключа\n\n"
+
+            << "\tMDEL <ключ> <ключ>...\n"
+            << "\tКоманда удаляет несколько ключей и выводит число удаленных "
+               "записей\n\n"
+
             << "\tUPDATE <ключ> <Фамилия> <Имя> <Год рождения> <Город> <Число "
                "текущих коинов>\n"
             << "\tКоманда обновляет значение по соответствующему ключу, если "
@@ -377,6 +924,16 @@ void Interface::ShowHelpMenu() {
             << "\tЕсли же какое-то поле менять не планируется, то на его месте "
                "ставится прочерк '-'\n\n"
 
+            << "\tUPDATEIF <ключ> <версия> <Фамилия> <Имя> <Год рождения> "
+               "<Город> <Число текущих коинов>\n"
+            << "\tТо же, что UPDATE, но запись обновляется, только если ее "
+               "версия совпадает с заданной\n\n"
+
+            << "\tINCRBY <ключ> <year|coins> <число>\n"
+            << "\tКоманда прибавляет число к полю записи, отрицательное число "
+               "вычитается. Выводит\n"
+            << "\tновое значение поля или (null), если записи нет\n\n"
+
             << "\tKEYS\n"
             << "\tВозвращает все ключи, которые есть в хранилище\n\n"
 
@@ -390,12 +947,18 @@ void Interface::ShowHelpMenu() {
             << "\tЕсли записи с заданным ключом не существует, то возвращается "
                "(null)\n\n"
 
+            << "\tPTTL <ключ>\n"
+            << "\tТо же, что TTL, но оставшееся время выводится в "
+               "миллисекундах\n\n"
+
             << "\tFIND <ключ> <Фамилия> <Имя> <Год рождения> <Город> <Число "
                "текущих коинов>\n"
             << "\tЭта команда используется для восстановления ключа (или "
                "ключей) по заданному значению.\n"
             << "\tЕсли же по каким-то полям не будет выполняться поиск, то на "
-               "их месте ставится прочерк -\n\n"
+               "их месте ставится прочерк -\n"
+            << "\tEX <время в секундах>(необязательное поле), PX для поиска "
+               "не поддерживается\n\n"
 
             << "\tSHOWALL\n"
             << "\tКоманда для получения всех записей, которые содержатся в "
@@ -407,8 +970,65 @@ void Interface::ShowHelpMenu() {
                "Файл содержит список \n"
             << "\tзагружаемых данных в формате\n\n"
 
-            << "\tEXPORT\n"
-            << "\tДанная команда используется для выгрузки данныхв файл\n\n";
+            << "\tEXPORT <файл> BINARY(необязательное поле) "
+               "BACKGROUND(необязательное поле)\n"
+            << "\tДанная команда используется для выгрузки данныхв файл\n"
+            << "\tС BINARY данные сохраняются в двоичном снимке, который "
+               "UPLOAD загружает быстрее\n"
+            << "\tС BACKGROUND выгрузка идет в фоне, результат выводится "
+               "после ее окончания\n\n"
+
+            << "\tAGGREGATE <SUM|COUNT|MIN|MAX> <year|coins|-> BY <поле>"
+               "(необязательное поле)\n"
+            << "\tWHERE <Фамилия> <Имя> <Год рождения> <Город> <Число текущих "
+               "коинов>(необязательное поле)\n"
+            << "\tКоманда вычисляет агрегат по полю записей внутри хранилища, "
+               "группируя их по \n"
+            << "\tуказанному полю. Фильтр WHERE задается так же, как в "
+               "FIND\n"
+            << "\tПоле '-' допускается только с COUNT\n\n"
+
+            << "\tEXPIRING <время в секундах> BY <время в секундах>"
+               "(необязательное поле)\n"
+            << "\tКоманда выводит ключи, время жизни которых истечет в "
+               "указанный срок, в порядке\n"
+            << "\tистечения. С BY выводится количество таких ключей в каждом "
+               "интервале заданной длины\n\n"
+
+            << "\tAPPENDLOG <файл> <ALWAYS|GROUP|интервал в мс>"
+               "(необязательное поле)\n"
+            << "\tКоманда восстанавливает записи из журнала операций и "
+               "дописывает в него все\n"
+            << "\tдальнейшие изменения. Журнал сбрасывается на диск после "
+               "каждой операции (ALWAYS),\n"
+            << "\tобщим fsync для одновременных операций (GROUP) или раз в "
+               "интервал от 1 до 999999 мс, по умолчанию 1000 мс\n\n"
+
+            << "\tREWRITELOG\n"
+            << "\tКоманда заменяет журнал операций текущим состоянием "
+               "хранилища\n\n"
+
+            << "\tCHECKPOINT <файл>\n"
+            << "\tКоманда сохраняет хранилище в цепочку снимков: первый раз "
+               "полный снимок, затем\n"
+            << "\tдельты только с измененными записями\n\n"
+
+            << "\tRESTORE <файл>\n"
+            << "\tКоманда загружает снимок вместе с его дельтами\n\n"
+
+            << "\tCOMPACT <файл>\n"
+            << "\tКоманда объединяет снимок и его дельты в один полный "
+               "снимок\n\n"
+
+            << "\tRANGE <ключ> <ключ>\n"
+            << "\tКоманда выводит записи с ключами в заданных границах по "
+               "возрастанию ключа.\n"
+            << "\tДоступна только для отсортированной таблицы\n\n"
+
+            << "\tBUILDTABLE <файл>\n"
+            << "\tКоманда записывает записи хранилища в файл отсортированной "
+               "таблицы без времени\n"
+            << "\tжизни. Таблицу можно открыть в главном меню\n\n";
 }
 
 }  // namespace s21
\ No newline at end of file
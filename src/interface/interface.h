@@ -1,10 +1,15 @@
 #pragma once
 
 #include <climits>
+#include <future>
+#include <iomanip>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <regex>
 #include <sstream>
+#include <stdexcept>
+#include <strings.h>
 
 #include "../controller/controller.h"
 
@@ -13,16 +18,33 @@ class Interface {
   enum Command {
     SET,
     GET,
+    GETVER,
     EXISTS,
     DEL,
+    DELIF,
+    MGET,
+    MSET,
+    MDEL,
     UPDATE,
+    UPDATEIF,
+    INCRBY,
     KEYS,
     RENAME,
     TTL,
+    PTTL,
     FIND,
     SHOWALL,
     UPLOAD,
     EXPORT,
+    AGGREGATE,
+    EXPIRING,
+    APPENDLOG,
+    REWRITELOG,
+    CHECKPOINT,
+    RESTORE,
+    COMPACT,
+    RANGE,
+    BUILDTABLE,
     HELP,
     RETURN,
     ERROR
@@ -36,6 +58,7 @@ class Interface {
   void WaitingForInput();
   void ShowWrongInputAttention();
   void ShowHelpMenu();
+  void OpenStorage(const ContainerType type, const std::string &fileName = "");
   void StorageStart();
   void SetRegexMap();
   std::vector<std::string> SplitBySpace(const std::string &);
@@ -43,18 +66,47 @@ class Interface {
   Command GetCommandNum(const char *);
   void Set(const std::vector<std::string> &);
   void Get(const std::vector<std::string> &);
+  void GetVersioned(const std::vector<std::string> &);
   void Exists(const std::vector<std::string> &);
   void Del(const std::vector<std::string> &);
-  void Update(const std::vector<std::string> &);
+  void DelIfVersion(const std::vector<std::string> &);
+  void MGet(const std::vector<std::string> &);
+  void MSet(const std::vector<std::string> &);
+  void MDel(const std::vector<std::string> &);
+  void Update(const std::vector<std::string> &,
+              const std::optional<uint64_t> &version = std::nullopt);
+  void UpdateIfVersion(const std::vector<std::string> &);
+  void IncrBy(const std::vector<std::string> &);
   void Keys();
   void Rename(const std::vector<std::string> &);
   void Ttl(const std::vector<std::string> &);
+  void PTtl(const std::vector<std::string> &);
+  std::chrono::milliseconds GetTtlArg(const std::vector<std::string> &,
+                                      size_t);
   void Find(const std::vector<std::string> &);
   void Showall();
   void Upload(const std::vector<std::string> &);
   void Export(const std::vector<std::string> &);
+  void ReportBackgroundExport(const bool wait);
+  // Сообщает об ошибке записи журнала один раз, пока она не устранена
+  void ReportLogFailure();
+  void Aggregate(const std::vector<std::string> &);
+  int GetFieldParam(std::string);
+  void Expiring(const std::vector<std::string> &);
+  void AppendLog(const std::vector<std::string> &);
+  void RewriteLog();
+  void Checkpoint(const std::vector<std::string> &, Command);
+  void Range(const std::vector<std::string> &);
+  void BuildTable(const std::vector<std::string> &);
+  // Команды, которые изменяют хранилище
+  static bool IsWriteCommand(Command);
+
+  // Ограничение EXPIRING ... BY, чтобы гистограмма не занимала всю память
+  static constexpr size_t MaxHistogramBuckets = 10000;
 
   std::unique_ptr<Controller> storage;
+  std::future<int> backgroundExport;
+  bool logFailureReported = false;
   std::map<std::string, std::regex> regexMap;
 };
 }  // namespace s21
\ No newline at end of file
@@ -0,0 +1,464 @@
+#include "abstract_key_value_store.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#include "../data.h"
+
+namespace s21 {
+
+Errors AbstractKeyValueStore::set(const std::string& key, const Value& value,
+                                  int ttl) {
+  return set(key, value, SecondsToTtl(ttl));
+}
+//----------------------------------------------------------------
+Errors AbstractKeyValueStore::set(Key&& key, Value&& value, int ttl) {
+  return set(std::move(key), std::move(value), SecondsToTtl(ttl));
+}
+//----------------------------------------------------------------
+Errors AbstractKeyValueStore::set(Key&& key, Value&& value,
+                                  std::chrono::milliseconds ttl) {
+  const Key& constKey = key;
+  const Value& constValue = value;
+  return set(constKey, constValue, ttl);
+}
+//----------------------------------------------------------------
+bool AbstractKeyValueStore::visit(
+    const Key& key, const std::function<void(const Value&)>& visitor) {
+  std::optional<Value> value = get(key);
+  if (!value) return false;
+  visitor(*value);
+  return true;
+}
+//----------------------------------------------------------------
+std::optional<VersionedValue> AbstractKeyValueStore::getVersioned(
+    const Key& key) {
+  std::optional<Value> value = get(key);
+  if (!value) return std::nullopt;
+  return VersionedValue{std::move(*value), 0};
+}
+//----------------------------------------------------------------
+bool AbstractKeyValueStore::SupportsVersions() const { return false; }
+//----------------------------------------------------------------
+Errors AbstractKeyValueStore::update(const Key& key, const Value& value,
+                                     const int ttl, const int paramsMask) {
+  return update(key, value, SecondsToTtl(ttl), paramsMask);
+}
+//----------------------------------------------------------------
+Errors AbstractKeyValueStore::updateIfVersion(const Key& key,
+                                              const Value& value,
+                                              const int ttl,
+                                              const int paramsMask,
+                                              const uint64_t version) {
+  return updateIfVersion(key, value, SecondsToTtl(ttl), paramsMask, version);
+}
+//----------------------------------------------------------------
+Errors AbstractKeyValueStore::updateIfVersion(const Key&, const Value&,
+                                              std::chrono::milliseconds,
+                                              const int, const uint64_t) {
+  return versionsNotSupported;
+}
+//----------------------------------------------------------------
+Errors AbstractKeyValueStore::delIfVersion(const Key&, const uint64_t) {
+  return versionsNotSupported;
+}
+//----------------------------------------------------------------
+int AbstractKeyValueStore::Ttl(const std::string& key) {
+  long long ttl = PTtl(key);
+  if (ttl < 0) return static_cast<int>(ttl);
+  return static_cast<int>(std::min<long long>(
+      (ttl + 999) / 1000, std::numeric_limits<int>::max()));
+}
+//----------------------------------------------------------------
+std::vector<std::optional<Value>> AbstractKeyValueStore::mget(
+    const std::vector<Key>& keys) {
+  std::vector<std::optional<Value>> res;
+  res.reserve(keys.size());
+  for (const auto& key : keys) res.push_back(get(key));
+  return res;
+}
+//----------------------------------------------------------------
+std::vector<Errors> AbstractKeyValueStore::mset(
+    const std::vector<std::pair<Key, Value>>& values, int ttl) {
+  return mset(values, SecondsToTtl(ttl));
+}
+//----------------------------------------------------------------
+std::vector<Errors> AbstractKeyValueStore::mset(
+    const std::vector<std::pair<Key, Value>>& values,
+    std::chrono::milliseconds ttl) {
+  std::vector<Errors> res;
+  res.reserve(values.size());
+  for (const auto& row : values) res.push_back(set(row.first, row.second, ttl));
+  return res;
+}
+//----------------------------------------------------------------
+std::vector<Errors> AbstractKeyValueStore::mdel(const std::vector<Key>& keys) {
+  std::vector<Errors> res;
+  res.reserve(keys.size());
+  for (const auto& key : keys) res.push_back(del(key));
+  return res;
+}
+//----------------------------------------------------------------
+size_t AbstractKeyValueStore::expireBatch(
+    const std::vector<std::string>& keys) {
+  const int sizeBefore = countItems.load();
+  for (const auto& key : keys) exists(key);
+  return static_cast<size_t>(std::max(sizeBefore - countItems.load(), 0));
+}
+//----------------------------------------------------------------
+std::vector<std::string> AbstractKeyValueStore::expiringWithin(
+    std::chrono::milliseconds window) {
+  std::vector<std::pair<long long, std::string>> found;
+  for (const auto& key : keys()) {
+    long long remaining = PTtl(key);
+    if (remaining > 0 && remaining <= window.count())
+      found.push_back({remaining, key});
+  }
+  std::sort(found.begin(), found.end());
+  std::vector<std::string> res;
+  for (auto& item : found) res.push_back(item.second);
+  return res;
+}
+//----------------------------------------------------------------
+std::vector<size_t> AbstractKeyValueStore::expiryHistogram(
+    std::chrono::milliseconds bucket, const size_t bucketsCount) {
+  std::vector<size_t> res(bucketsCount, 0);
+  if (bucket.count() <= 0) return res;
+  for (const auto& key : keys()) {
+    long long remaining = PTtl(key);
+    if (remaining < 0) continue;
+    size_t idx = static_cast<size_t>(remaining / bucket.count());
+    if (idx < bucketsCount) ++res[idx];
+  }
+  return res;
+}
+//----------------------------------------------------------------
+int AbstractKeyValueStore::upload(const std::string& filename) {
+  // Бинарный снимок без строк: номер прошлой загрузки не должен остаться
+  uploadErrorLine_ = 0;
+  try {
+    std::vector<Entry> entries = Data::loadEntries(filename);
+    return static_cast<int>(insertEntries(entries));
+  } catch (const CorruptedFileError& e) {
+    uploadErrorLine_ = e.Line();
+    return corruptedFile;
+  } catch (const std::exception& e) {
+    if (strstr(e.what(), "not open")) return canNotOpenFile;
+    if (strstr(e.what(), "Corrupted")) return corruptedFile;
+    return unknownError;
+  }
+}
+//----------------------------------------------------------------
+size_t AbstractKeyValueStore::bulkInsert(
+    std::vector<std::pair<Key, Value>>& values) {
+  const int sizeBefore = countItems.load();
+  for (const auto& row : values) set(row.first, row.second);
+  return static_cast<size_t>(std::max(countItems.load() - sizeBefore, 0));
+}
+//----------------------------------------------------------------
+int AbstractKeyValueStore::exportValues(const std::string& filename) {
+  return exportValues(filename, textFormat);
+}
+//----------------------------------------------------------------
+int AbstractKeyValueStore::exportValues(const std::string& filename,
+                                        const FileFormat format) {
+  return Data::saveData(
+      filename,
+      [this](const EntryWriter& write) { forEachEntry([]() {}, write); },
+      format);
+}
+//----------------------------------------------------------------
+std::future<int> AbstractKeyValueStore::exportValuesInBackground(
+    const std::string& filename, const FileFormat format) {
+  return std::async(std::launch::async, [this, filename, format]() {
+    return exportValues(filename, format);
+  });
+}
+//----------------------------------------------------------------
+std::vector<Entry> AbstractKeyValueStore::snapshotEntries(
+    const std::function<void()>& underLock) {
+  std::lock_guard<std::mutex> lock(snapshotMutex_);
+  return copyEntries(underLock);
+}
+//----------------------------------------------------------------
+void AbstractKeyValueStore::forEachEntry(
+    const std::function<void()>& underLock, const EntryWriter& write) {
+  for (const auto& entry : snapshotEntries(underLock))
+    write(entry.key, entry.value, entry.timeToDel);
+}
+//----------------------------------------------------------------
+void AbstractKeyValueStore::forEachEntryByKey(const EntryWriter& write) {
+  std::vector<Entry> entries = snapshotEntries();
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) { return a.key < b.key; });
+  for (const auto& entry : entries)
+    write(entry.key, entry.value, entry.timeToDel);
+}
+//----------------------------------------------------------------
+int AbstractKeyValueStore::EnableLog(const std::string& fileName,
+                                     const FsyncPolicy policy,
+                                     const std::chrono::milliseconds interval) {
+  DisableLog();
+  int replayed = AppendOnlyLog::Replay(
+      fileName, [this](const LogRecord& record) { ApplyLogRecord(record); });
+  if (replayed < 0) return replayed;
+  Errors res = log_.Open(fileName, policy, interval);
+  if (res != noErrors) return res;
+  // Операции до Open не попали в журнал, в том числе выполненные другими
+  // потоками во время воспроизведения. Перезапись сохраняет их вместе с
+  // записями журнала
+  int rewritten = RewriteLog();
+  if (rewritten < 0) return rewritten;
+  return replayed;
+}
+//----------------------------------------------------------------
+int AbstractKeyValueStore::RewriteLog() {
+  if (!log_.IsOpen()) return canNotOpenFile;
+  log_.BeginRewrite();
+  uint64_t cutLsn = 0;
+  return log_.FinishRewrite(
+      [&cutLsn, this](const EntryWriter& write) {
+        forEachEntry([&cutLsn, this]() { cutLsn = log_.LastLsn(); }, write);
+      },
+      cutLsn);
+}
+//----------------------------------------------------------------
+int AbstractKeyValueStore::checkpoint(const std::string& fileName) {
+  std::lock_guard<std::mutex> lock(checkpointMutex_);
+  if (checkpointName_ != fileName || !dirtyKeys_.Tracking())
+    return fullCheckpoint(fileName);
+  std::vector<Key> dirty = dirtyKeys_.Take();
+  std::vector<Entry> upserts;
+  std::vector<Key> deletes;
+  // Запись, измененная после Take, попадет и в следующую дельту, поэтому
+  // чтение значения и времени жизни без общей блокировки не теряет изменений
+  for (auto& key : dirty) {
+    const long long remaining = PTtl(key);
+    std::optional<Value> value =
+        remaining == keyNotFound ? std::nullopt : get(key);
+    if (!value) {
+      deletes.push_back(std::move(key));
+      continue;
+    }
+    const Deadline timeToDel =
+        remaining == hasNoTtl
+            ? NoDeadline
+            : SaturatingAdd(Clock::now(), std::chrono::milliseconds(remaining));
+    upserts.push_back({std::move(key), std::move(*value), timeToDel});
+  }
+  int res =
+      DeltaSnapshot::save(fileName, checkpointDeltas_ + 1, upserts, deletes);
+  if (res < 0) {
+    for (const auto& entry : upserts) dirtyKeys_.Mark(entry.key);
+    for (const auto& key : deletes) dirtyKeys_.Mark(key);
+    return res;
+  }
+  // Длинная цепочка заменяется полным снимком из хранилища, а не
+  // слиянием файлов цепочки в памяти
+  if (++checkpointDeltas_ >= MaxDeltasInChain) {
+    int saved = fullCheckpoint(fileName);
+    if (saved < 0) return saved;
+  }
+  return res;
+}
+//----------------------------------------------------------------
+int AbstractKeyValueStore::restoreCheckpoint(const std::string& fileName) {
+  std::lock_guard<std::mutex> lock(checkpointMutex_);
+  const bool wasEmpty = countItems.load() == 0;
+  std::vector<Entry> entries;
+  try {
+    entries = DeltaSnapshot::loadChain(fileName);
+  } catch (const std::exception& e) {
+    if (strstr(e.what(), "not open")) return canNotOpenFile;
+    return corruptedFile;
+  }
+  dirtyKeys_.Stop();
+  const uint64_t changesBefore = changesCount_.load();
+  const size_t inserted = insertEntries(entries);
+  if (wasEmpty) {
+    checkpointName_ = fileName;
+    checkpointDeltas_ = DeltaSnapshot::ChainLength(fileName);
+    // Каждая вставленная запись - одно изменение. Изменения других потоков
+    // во время вставки не отмечены, тогда отметки не включаются и следующий
+    // checkpoint пишет полный снимок
+    if (changesCount_.load() - changesBefore == inserted) dirtyKeys_.Start();
+  }
+  return static_cast<int>(inserted);
+}
+//----------------------------------------------------------------
+int AbstractKeyValueStore::compactCheckpoint(const std::string& fileName) {
+  std::lock_guard<std::mutex> lock(checkpointMutex_);
+  int res = DeltaSnapshot::compact(fileName);
+  if (res >= 0 && checkpointName_ == fileName) checkpointDeltas_ = 0;
+  return res;
+}
+//----------------------------------------------------------------
+int AbstractKeyValueStore::fullCheckpoint(const std::string& fileName) {
+  dirtyKeys_.Stop();
+  // Пока новый снимок не записан, старая цепочка остается целой. Ее дельты
+  // не применяются к новому снимку и удаляются после его записи. Тот же
+  // обход пересчитывает число уникальных значений полей
+  int res = DeltaSnapshot::saveBase(fileName, [this](const EntryWriter& write) {
+    forEachEntry(
+        [this]() {
+          dirtyKeys_.Start();
+          statistics_.StartRecount();
+        },
+        [this, &write](const Key& key, const Value& value,
+                       const Deadline timeToDel) {
+          statistics_.Recount(value);
+          write(key, value, timeToDel);
+        });
+  });
+  statistics_.FinishRecount(res >= 0);
+  if (res < 0) {
+    dirtyKeys_.Stop();
+    checkpointName_.clear();
+    return res;
+  }
+  DeltaSnapshot::removeDeltas(fileName);
+  checkpointName_ = fileName;
+  checkpointDeltas_ = 0;
+  return res;
+}
+//----------------------------------------------------------------
+size_t AbstractKeyValueStore::insertEntries(std::vector<Entry>& entries) {
+  std::vector<std::pair<Key, Value>> values;
+  std::vector<Entry> expiring;
+  values.reserve(entries.size());
+  for (auto& entry : entries) {
+    if (entry.timeToDel == NoDeadline)
+      values.emplace_back(std::move(entry.key), std::move(entry.value));
+    else if (!IsExpired(entry.timeToDel))
+      expiring.push_back(std::move(entry));
+  }
+  size_t inserted = bulkInsert(values);
+  for (auto& entry : expiring) {
+    if (set(std::move(entry.key), std::move(entry.value),
+            TtlOf(entry.timeToDel)) == noErrors)
+      ++inserted;
+  }
+  return inserted;
+}
+//----------------------------------------------------------------
+uint64_t AbstractKeyValueStore::RecordChange(const LogOperation operation,
+                                             const Key& key,
+                                             const Key& newKey) {
+  ++changesCount_;
+  if (dirtyKeys_.Tracking()) {
+    dirtyKeys_.Mark(key);
+    if (operation == logRename) dirtyKeys_.Mark(newKey);
+  }
+  if (!log_.IsOpen()) return 0;
+  return log_.Append({operation, key, newKey, Value{}, 0});
+}
+//----------------------------------------------------------------
+uint64_t AbstractKeyValueStore::RecordChange(const LogOperation operation,
+                                             const Key& key,
+                                             const Value& value,
+                                             const Deadline timeToDel) {
+  ++changesCount_;
+  if (dirtyKeys_.Tracking()) dirtyKeys_.Mark(key);
+  if (!log_.IsOpen()) return 0;
+  return log_.Append(
+      {operation, key, Key(), value, ToWallClock(timeToDel)});
+}
+//----------------------------------------------------------------
+Errors AbstractKeyValueStore::CommitChange(const uint64_t lsn) {
+  return log_.Commit(lsn) ? noErrors : logWriteFailed;
+}
+//----------------------------------------------------------------
+void AbstractKeyValueStore::CommitChanges(const uint64_t lsn,
+                                          std::vector<Errors>& res) {
+  if (CommitChange(lsn) == noErrors) return;
+  std::replace(res.begin(), res.end(), noErrors, logWriteFailed);
+}
+//----------------------------------------------------------------
+void AbstractKeyValueStore::ApplyLogRecord(const LogRecord& record) {
+  const auto ttl = RemainingTtl(record.expireAt);
+  const bool expired = record.expireAt != 0 && ttl.count() <= 0;
+  const auto newTtl = record.expireAt ? ttl : std::chrono::milliseconds(0);
+  switch (record.operation) {
+    case logSet:
+    case logUpdate:
+      if (expired) {
+        del(record.key);
+      } else if (set(record.key, record.value, newTtl) == keyAlreadyExists) {
+        update(record.key, record.value, newTtl,
+               pLastname | pName | pYear | pCity | pCoins | pTtl);
+      }
+      break;
+    case logDel:
+    case logExpire:
+      del(record.key);
+      break;
+    case logRename:
+      rename(record.key, record.newKey);
+      break;
+  }
+}
+//----------------------------------------------------------------
+size_t AbstractKeyValueStore::WorkersFor(const size_t items,
+                                         const size_t limit) const {
+  size_t count = workersCount_.load();
+  if (!count)
+    count = items < ParallelThreshold ? 1 : std::thread::hardware_concurrency();
+  return std::max<size_t>(1, std::min(count, limit));
+}
+//----------------------------------------------------------------
+void AbstractKeyValueStore::RunInParallel(
+    const size_t count, const std::function<void(size_t)>& task) {
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < count; ++i) workers.emplace_back(task, i);
+  if (count) task(0);
+  for (auto& worker : workers) worker.join();
+}
+//----------------------------------------------------------------
+long long AbstractKeyValueStore::RemainingMs(Deadline timeToDel) {
+  if (timeToDel == NoDeadline) return hasNoTtl;
+  auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+      timeToDel - Clock::now());
+  return remaining.count() > 0 ? remaining.count() : 0;
+}
+//----------------------------------------------------------------
+std::pair<Deadline, Deadline> AbstractKeyValueStore::TtlWindow(const int ttl) {
+  const Deadline now = Clock::now();
+  const long long seconds = ttl;
+  return {SaturatingAdd(now, std::chrono::seconds(seconds - 1)),
+          SaturatingAdd(now, std::chrono::seconds(seconds + 1))};
+}
+//----------------------------------------------------------------
+std::chrono::milliseconds AbstractKeyValueStore::TtlOf(Deadline timeToDel) {
+  long long remaining = RemainingMs(timeToDel);
+  return std::chrono::milliseconds(
+      remaining == hasNoTtl ? 0 : std::max(remaining, 1LL));
+}
+//----------------------------------------------------------------
+std::optional<int> AbstractKeyValueStore::IncrementedField(const Value& value,
+                                                           const int field,
+                                                           const int delta) {
+  if (field != pYear && field != pCoins) return std::nullopt;
+  const long long sum =
+      static_cast<long long>(field == pYear ? value.year : value.coins) + delta;
+  if (sum < std::numeric_limits<int>::min() ||
+      sum > std::numeric_limits<int>::max())
+    return std::nullopt;
+  return static_cast<int>(sum);
+}
+//----------------------------------------------------------------
+bool AbstractKeyValueStore::IsMatch(const Value& stored, Deadline timeToDel,
+                                    const Value& value, const int ttl,
+                                    const int paramsMask) {
+  return (!(paramsMask & pLastname) || stored.lastname == value.lastname) &&
+         (!(paramsMask & pName) || stored.name == value.name) &&
+         (!(paramsMask & pYear) || stored.year == value.year) &&
+         (!(paramsMask & pCity) || stored.city == value.city) &&
+         (!(paramsMask & pCoins) || stored.coins == value.coins) &&
+         (!(paramsMask & pTtl) ||
+          (timeToDel != NoDeadline &&
+           (RemainingMs(timeToDel) + 999) / 1000 == ttl));
+}
+
+}  // namespace s21
@@ -2,11 +2,21 @@
 #define SRC_MODEL_ABSTRACT_KEY_VALUE_STORE_ABSTRACT_KEY_VALUE_STORE_H_
 
 #include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "../../types.h"
+#include "../append_only_log.h"
+#include "../copy_on_write_view.h"
+#include "../delta_snapshot.h"
+#include "../events/keyspace_notifier.h"
+#include "../sketches/field_statistics.h"
 
 namespace s21 {
 
@@ -15,30 +25,248 @@ class AbstractKeyValueStore {
   AbstractKeyValueStore() = default;
   virtual ~AbstractKeyValueStore() = default;
 
+  Errors set(const std::string& key, const Value& value, int ttl = hasNoTtl);
   virtual Errors set(const std::string& key, const Value& value,
-                     int ttl = hasNoTtl) = 0;
+                     std::chrono::milliseconds ttl) = 0;
+  Errors set(Key&& key, Value&& value, int ttl = hasNoTtl);
+  // Хранилища в памяти перемещают строки key и value в запись вместо
+  // копирования
+  virtual Errors set(Key&& key, Value&& value, std::chrono::milliseconds ttl);
   virtual std::optional<Value> get(const Key& key) = 0;
+  // Вызывает visitor для значения key без копирования, если запись есть.
+  // Хранилища в памяти вызывают его под своей блокировкой, поэтому visitor
+  // не должен обращаться к хранилищу и не должен сохранять ссылку
+  virtual bool visit(const Key& key,
+                     const std::function<void(const Value&)>& visitor);
+  // Значение вместе с версией записи. Версия растет при каждом изменении
+  // записи и не повторяется, пока хранилище открыто. Хранилища на диске
+  // версий не ведут, SupportsVersions для них false, а версия всегда 0
+  virtual std::optional<VersionedValue> getVersioned(const Key& key);
+  // true, если хранилище ведет версии записей для getVersioned,
+  // updateIfVersion и delIfVersion
+  virtual bool SupportsVersions() const;
   virtual bool exists(const std::string& key) = 0;
   virtual Errors del(const std::string& key) = 0;
-  virtual Errors update(const Key& key, const Value& value, const int ttl,
+  Errors update(const Key& key, const Value& value, const int ttl,
+                const int paramsMask);
+  virtual Errors update(const Key& key, const Value& value,
+                        std::chrono::milliseconds ttl,
                         const int paramsMask) = 0;
   virtual Errors rename(const std::string& oldKey,
                         const std::string& newKey) = 0;
-  virtual int Ttl(const std::string& key) = 0;
-  virtual int upload(const std::string& filename) = 0;
-  virtual int exportValues(const std::string& filename) = 0;
+  // update и del, которые выполняются, только если версия записи равна
+  // version, иначе versionMismatch. Сравнение и изменение идут под одной
+  // блокировкой. Хранилища без версий возвращают versionsNotSupported
+  Errors updateIfVersion(const Key& key, const Value& value, const int ttl,
+                         const int paramsMask, const uint64_t version);
+  virtual Errors updateIfVersion(const Key& key, const Value& value,
+                                 std::chrono::milliseconds ttl,
+                                 const int paramsMask, const uint64_t version);
+  virtual Errors delIfVersion(const Key& key, const uint64_t version);
+  // Прибавляет delta к числовому полю field (pYear или pCoins) за один поиск
+  // под блокировкой хранилища и пишет новое значение в result. Время жизни
+  // записи не меняется. valueOutOfRange, если поле не числовое или результат
+  // не помещается в int
+  virtual Errors incrBy(const Key& key, const int field, const int delta,
+                        int& result) = 0;
+  int Ttl(const std::string& key);
+  virtual long long PTtl(const std::string& key) = 0;
+  // Пакетные get, set и del: i-й элемент ответа относится к i-му ключу и
+  // равен результату одиночной операции. Хранилища выполняют пакет за один
+  // захват блокировки
+  virtual std::vector<std::optional<Value>> mget(const std::vector<Key>& keys);
+  std::vector<Errors> mset(const std::vector<std::pair<Key, Value>>& values,
+                           int ttl = hasNoTtl);
+  virtual std::vector<Errors> mset(
+      const std::vector<std::pair<Key, Value>>& values,
+      std::chrono::milliseconds ttl);
+  virtual std::vector<Errors> mdel(const std::vector<Key>& keys);
+  // Удаляет истекшие записи из переданного списка ключей без уведомления
+  // TtlManager. Возвращает количество удаленных записей
+  virtual size_t expireBatch(const std::vector<std::string>& keys);
+  // Ключи, время жизни которых истечет в ближайшие window, по возрастанию
+  // оставшегося времени
+  virtual std::vector<std::string> expiringWithin(
+      std::chrono::milliseconds window);
+  // Количество ключей, время жизни которых истечет в каждом из bucketsCount
+  // последовательных интервалов длиной bucket
+  virtual std::vector<size_t> expiryHistogram(std::chrono::milliseconds bucket,
+                                              const size_t bucketsCount);
+  // Загружает записи из файла. Возвращает число добавленных записей или код
+  // ошибки, для corruptedFile номер строки доступен через UploadErrorLine
+  virtual int upload(const std::string& filename);
+  size_t UploadErrorLine() const { return uploadErrorLine_.load(); }
+  // Добавляет записи без времени жизни, существующие ключи пропускаются.
+  // Строки values могут быть перемещены. Возвращает число добавленных записей
+  virtual size_t bulkInsert(std::vector<std::pair<Key, Value>>& values);
+  int exportValues(const std::string& filename);
+  // Выгружает записи на момент вызова, не блокируя хранилище на время
+  // обхода и записи файла
+  virtual int exportValues(const std::string& filename,
+                           const FileFormat format);
+  std::future<int> exportValuesInBackground(const std::string& filename,
+                                            const FileFormat format);
+  // Живые записи на момент вызова. underLock вызывается под блокировкой
+  // хранилища в этот момент
+  std::vector<Entry> snapshotEntries(
+      const std::function<void()>& underLock = []() {});
+  // Вызывает write для живых записей на момент вызова, underLock - как у
+  // snapshotEntries. Хранилища в памяти копируют записи небольшими пачками и
+  // вызывают write без блокировки, хранилища на диске читают записи по мере
+  // обхода, поэтому так сохраняются данные больше памяти
+  virtual void forEachEntry(const std::function<void()>& underLock,
+                            const EntryWriter& write);
+  // То же по возрастанию ключей. Хранилища в памяти сортируют копию записей,
+  // хранилища на диске читают записи по порядку, не собирая их в память
+  virtual void forEachEntryByKey(const EntryWriter& write);
 
   virtual const std::vector<std::string> keys() = 0;
   virtual const std::vector<std::string> find(const Value& value, const int ttl,
                                               const int paramsMask) = 0;
   virtual const std::vector<Value> showall() = 0;
+  virtual const std::vector<AggregateRow> aggregate(
+      const AggregateQuery& query) = 0;
 
   int GetSize() { return countItems.load(); }
+  // Число потоков, которыми aggregate обходит хранилище, а загрузка
+  // вставляет записи. 0 - по числу ядер от ParallelThreshold записей и один
+  // поток для меньшего числа
+  void SetWorkersCount(const size_t count) { workersCount_ = count; }
+  long long ApproxDistinct(const int field) {
+    return statistics_.ApproxDistinct(field);
+  }
+  std::vector<HeavyHitter> TopK(const int field, const size_t k) {
+    return statistics_.TopK(field, k);
+  }
+  // Подписка на события set/update/del/rename/expire этого хранилища
+  std::shared_ptr<KeyspaceSubscription> Subscribe(
+      const size_t capacity = KeyspaceNotifier::DefaultCapacity) {
+    return notifier_.Subscribe(capacity);
+  }
+  void Unsubscribe(const std::shared_ptr<KeyspaceSubscription>& subscription) {
+    notifier_.Unsubscribe(subscription);
+  }
+  // Включает журнал операций: воспроизводит fileName и дописывает в него
+  // дальнейшие изменения. Журнал перезаписывается состоянием хранилища, так
+  // что в него попадают и изменения, сделанные до включения или во время
+  // воспроизведения. Возвращает число воспроизведенных записей или код
+  // ошибки
+  int EnableLog(const std::string& fileName,
+                const FsyncPolicy policy = fsyncInterval,
+                const std::chrono::milliseconds interval =
+                    std::chrono::seconds(1));
+  void DisableLog() { log_.Close(); }
+  bool LogEnabled() const { return log_.IsOpen(); }
+  // Запись в журнал не удалась, изменения не сохраняются до RewriteLog
+  bool LogFailed() { return log_.IsOpen() && log_.Failed(); }
+  // Заменяет журнал текущим состоянием хранилища, не блокируя его. Операции,
+  // выполненные во время перезаписи, не теряются. Возвращает число записей
+  // нового журнала или код ошибки
+  int RewriteLog();
+  // Сохраняет состояние в цепочку снимков fileName: первый раз и после
+  // MaxDeltasInChain дельт полный снимок, иначе дельту с записями,
+  // измененными после предыдущего снимка цепочки. Возвращает число
+  // сохраненных записей или код ошибки
+  int checkpoint(const std::string& fileName);
+  // Загружает цепочку снимков с оставшимся временем жизни записей, истекшие
+  // записи пропускаются. Если хранилище было пустым, следующий checkpoint в
+  // ту же цепочку запишет дельту
+  int restoreCheckpoint(const std::string& fileName);
+  // Заменяет цепочку снимков fileName одним полным снимком
+  int compactCheckpoint(const std::string& fileName);
 
  protected:
   std::atomic<int> countItems{0};
+  FieldStatistics statistics_;
+  KeyspaceNotifier notifier_;
+  std::atomic<size_t> uploadErrorLine_{0};
+  std::atomic<size_t> workersCount_{0};
+  std::atomic<uint64_t> lastVersion_{0};
+  AppendOnlyLog log_;
+  // Обход для snapshotEntries, одновременно идет только один
+  CopyOnWriteView snapshotView_;
+  std::mutex snapshotMutex_;
+  // Цепочка снимков, которую продолжает checkpoint
+  static constexpr size_t MaxDeltasInChain = 16;
+  DirtyKeys dirtyKeys_;
+  // Число вызовов RecordChange, по нему restoreCheckpoint узнает об
+  // изменениях других потоков во время вставки
+  std::atomic<uint64_t> changesCount_{0};
+  std::mutex checkpointMutex_;
+  std::string checkpointName_;
+  size_t checkpointDeltas_ = 0;
+
+  int fullCheckpoint(const std::string& fileName);
+  // Добавляет записи файла: без времени жизни через bulkInsert, с временем
+  // жизни через set с оставшимся временем. Истекшие записи пропускаются
+  size_t insertEntries(std::vector<Entry>& entries);
+
+  // Обходит хранилище через snapshotView_. underLock вызывается под
+  // блокировкой в момент snapshotView_.Begin
+  virtual std::vector<Entry> copyEntries(
+      const std::function<void()>& underLock) = 0;
+
+  // Вызывается под блокировкой хранилища рядом с notifier_.Publish: отмечает
+  // ключи для дельты и пишет операцию в журнал. Возвращает номер записи для
+  // log_.Commit или 0, если журнал выключен
+  uint64_t RecordChange(const LogOperation operation, const Key& key,
+                        const Key& newKey = Key());
+  uint64_t RecordChange(const LogOperation operation, const Key& key,
+                        const Value& value, const Deadline timeToDel);
+  // Ждет записи в журнал изменений до lsn после снятия блокировки
+  // хранилища. logWriteFailed, если запись не удалась
+  Errors CommitChange(const uint64_t lsn);
+  // То же для пакета: результаты примененных операций становятся
+  // logWriteFailed
+  void CommitChanges(const uint64_t lsn, std::vector<Errors>& res);
+  void ApplyLogRecord(const LogRecord& record);
+
+  // Версия для новой или измененной записи
+  uint64_t NextVersion() { return ++lastVersion_; }
+
+  // Число потоков для обхода items записей с учетом SetWorkersCount, но не
+  // больше limit
+  static constexpr size_t ParallelThreshold = 100000;
+  size_t WorkersFor(const size_t items, const size_t limit) const;
+  // Вызывает task для номеров от 0 до count - 1 в отдельных потоках, task(0)
+  // выполняется в вызывающем потоке. Возвращает управление после всех
+  static void RunInParallel(const size_t count,
+                            const std::function<void(size_t)>& task);
+
+  static std::chrono::milliseconds SecondsToTtl(const int ttl) {
+    return std::chrono::milliseconds(ttl > 0 ? ttl * 1000LL : 0);
+  }
+  static Deadline DeadlineAfter(std::chrono::milliseconds ttl) {
+    return ttl.count() > 0 ? SaturatingAdd(Clock::now(), ttl) : NoDeadline;
+  }
+  // Оставшееся время жизни в миллисекундах или hasNoTtl
+  static long long RemainingMs(Deadline timeToDel);
+  // Сроки, между которыми ищутся записи с временем жизни ttl секунд, с
+  // запасом в секунду: время жизни кандидатов пересчитывается под блокировкой
+  static std::pair<Deadline, Deadline> TtlWindow(const int ttl);
+  // Время жизни, с которым запись нужно перенести под другой ключ
+  static std::chrono::milliseconds TtlOf(Deadline timeToDel);
+  // Запись, время жизни которой истекло, считается отсутствующей
+  static bool IsExpired(Deadline timeToDel, Deadline now = Clock::now()) {
+    return timeToDel <= now;
+  }
+  // Запись с временем жизни, которое еще не истекло
+  static bool HasPendingTtl(Deadline timeToDel) {
+    return timeToDel != NoDeadline && timeToDel > Clock::now();
+  }
+
+  // Значение поля field после incrBy или nullopt для valueOutOfRange
+  static std::optional<int> IncrementedField(const Value& value,
+                                             const int field,
+                                             const int delta);
+  static void SetNumericField(Value& value, const int field, const int number) {
+    (field == pYear ? value.year : value.coins) = number;
+  }
+
+  static bool IsMatch(const Value& stored, Deadline timeToDel,
+                      const Value& value, const int ttl, const int paramsMask);
 };
 
 }  // namespace s21
 
-#endif  //  SRC_MODEL_ABSTRACT_KEY_VALUE_STORE_ABSTRACT_KEY_VALUE_STORE_H_
\ No newline at end of file
+#endif  //  SRC_MODEL_ABSTRACT_KEY_VALUE_STORE_ABSTRACT_KEY_VALUE_STORE_H_
@@ -0,0 +1,94 @@
+#include "aggregator.h"
+
+#include <algorithm>
+
+namespace s21 {
+
+Aggregator::Aggregator(const AggregateQuery& query)
+    : function_(query.function),
+      field_(query.field),
+      groupBy_(query.groupBy) {}
+//----------------------------------------------------------------
+void Aggregator::Add(const Value& value) {
+  long long fieldValue = FieldOf(value);
+  Partial& partial = groups_[GroupOf(value)];
+  if (!partial.count) {
+    partial.min = fieldValue;
+    partial.max = fieldValue;
+  } else {
+    partial.min = std::min(partial.min, fieldValue);
+    partial.max = std::max(partial.max, fieldValue);
+  }
+  partial.sum += fieldValue;
+  ++partial.count;
+}
+//----------------------------------------------------------------
+void Aggregator::Merge(const Aggregator& other) {
+  for (auto it = other.groups_.begin(); it != other.groups_.end(); ++it) {
+    auto found = groups_.find(it->first);
+    if (found == groups_.end()) {
+      groups_.insert(*it);
+      continue;
+    }
+    Partial& partial = found->second;
+    partial.min = std::min(partial.min, it->second.min);
+    partial.max = std::max(partial.max, it->second.max);
+    partial.sum += it->second.sum;
+    partial.count += it->second.count;
+  }
+}
+//----------------------------------------------------------------
+std::vector<AggregateRow> Aggregator::Result() const {
+  std::vector<AggregateRow> rows;
+  rows.reserve(groups_.size());
+  for (auto it = groups_.begin(); it != groups_.end(); ++it) {
+    AggregateRow row;
+    row.group = it->first;
+    row.count = it->second.count;
+    switch (function_) {
+      case aggSum:
+        row.result = it->second.sum;
+        break;
+      case aggCount:
+        row.result = it->second.count;
+        break;
+      case aggMin:
+        row.result = it->second.min;
+        break;
+      case aggMax:
+        row.result = it->second.max;
+        break;
+    }
+    rows.push_back(row);
+  }
+  std::sort(rows.begin(), rows.end(),
+            [](const AggregateRow& lhs, const AggregateRow& rhs) {
+              return lhs.group < rhs.group;
+            });
+  return rows;
+}
+//----------------------------------------------------------------
+std::string Aggregator::GroupOf(const Value& value) const {
+  switch (groupBy_) {
+    case pLastname:
+      return value.lastname;
+    case pName:
+      return value.name;
+    case pYear:
+      return std::to_string(value.year);
+    case pCity:
+      return value.city;
+    case pCoins:
+      return std::to_string(value.coins);
+    default:
+      return std::string();
+  }
+}
+//----------------------------------------------------------------
+long long Aggregator::FieldOf(const Value& value) const {
+  if (field_ == pYear) return value.year;
+  if (field_ == pCoins) return value.coins;
+  return 0;
+}
+
+}  //  namespace s21
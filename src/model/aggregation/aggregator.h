@@ -0,0 +1,41 @@
+// Потоковое вычисление агрегатов (SUM/COUNT/MIN/MAX) с группировкой по полю
+#ifndef SRC_MODEL_AGGREGATION_AGGREGATOR_H_
+#define SRC_MODEL_AGGREGATION_AGGREGATOR_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../types.h"
+
+namespace s21 {
+
+class Aggregator {
+ public:
+  explicit Aggregator(const AggregateQuery& query);
+
+  void Add(const Value& value);
+  // Добавляет группы other, посчитанные по другой части хранилища
+  void Merge(const Aggregator& other);
+  std::vector<AggregateRow> Result() const;
+
+ private:
+  struct Partial {
+    long long sum = 0;
+    long long min = 0;
+    long long max = 0;
+    int count = 0;
+  };
+
+  AggregateFunction function_;
+  int field_;
+  int groupBy_;
+  std::unordered_map<std::string, Partial> groups_;
+
+  std::string GroupOf(const Value& value) const;
+  long long FieldOf(const Value& value) const;
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_AGGREGATION_AGGREGATOR_H_
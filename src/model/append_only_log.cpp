@@ -0,0 +1,363 @@
+#include "append_only_log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "binary_io.h"
+#include "durable_file.h"
+#include "mapped_file.h"
+
+namespace s21 {
+
+namespace {
+// Запись журнала: размер данных (u32), CRC32 размера и данных (u32), данные.
+// CRC покрывает и размер, поэтому обнуленный или испорченный заголовок не
+// выглядит целой записью
+constexpr size_t RecordHeaderSize = 8;
+// Размер порции, которой снимок пишется в файл при перезаписи
+constexpr size_t RewriteChunkSize = 1 << 20;
+
+// Возвращает false, если данные не удалось записать целиком
+bool WriteAll(const int fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t written = write(fd, data.data(), data.size());
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return false;
+    data.remove_prefix(static_cast<size_t>(written));
+  }
+  return true;
+}
+
+std::string Frame(const std::string& payload) {
+  std::string res;
+  res.reserve(RecordHeaderSize + payload.size());
+  Put<uint32_t>(res, static_cast<uint32_t>(payload.size()));
+  Put<uint32_t>(res, Crc32(payload, Crc32(res)));
+  res.append(payload);
+  return res;
+}
+
+// Возвращает размер целой записи, которая начинается с pos, или 0
+size_t IntactFrame(std::string_view data, const size_t pos) {
+  const size_t left = data.size() - pos;
+  if (left < RecordHeaderSize) return 0;
+  BinaryReader header(data.substr(pos, RecordHeaderSize));
+  const uint32_t size = header.Get<uint32_t>();
+  const uint32_t crc = header.Get<uint32_t>();
+  if (left - RecordHeaderSize < size) return 0;
+  const uint32_t sizeCrc = Crc32(data.substr(pos, sizeof(uint32_t)));
+  std::string_view payload = data.substr(pos + RecordHeaderSize, size);
+  return Crc32(payload, sizeCrc) == crc ? RecordHeaderSize + size : 0;
+}
+}  // namespace
+
+AppendOnlyLog::AppendOnlyLog()
+    : fd_(-1),
+      policy_(fsyncInterval),
+      interval_(std::chrono::seconds(1)),
+      appendedLsn_(0),
+      syncedLsn_(0),
+      syncing_(false),
+      failed_(false),
+      rewriting_(false),
+      stopFlusher_(false) {}
+//----------------------------------------------------------------
+AppendOnlyLog::~AppendOnlyLog() { Close(); }
+//----------------------------------------------------------------
+int AppendOnlyLog::Replay(const std::string& fileName,
+                          const std::function<void(const LogRecord&)>& apply) {
+  if (access(fileName.c_str(), F_OK) != 0) return 0;
+  std::vector<LogRecord> records;
+  size_t validSize = 0;
+  size_t fileSize = 0;
+  try {
+    MappedFile file(fileName);
+    std::string_view data = file.View();
+    fileSize = data.size();
+    while (validSize < fileSize) {
+      const size_t frameSize = IntactFrame(data, validSize);
+      if (frameSize == 0) break;
+      records.push_back(Decode(
+          data.substr(validSize + RecordHeaderSize,
+                      frameSize - RecordHeaderSize)));
+      validSize += frameSize;
+    }
+    // Недописанной может быть только последняя запись. Если после
+    // поврежденной записи есть целая, записи за ней уже подтверждены и файл
+    // остается как есть
+    for (size_t pos = validSize + 1; pos < fileSize; ++pos)
+      if (IntactFrame(data, pos) != 0) return corruptedFile;
+  } catch (const std::exception& e) {
+    if (std::string(e.what()).find("not open") != std::string::npos)
+      return canNotOpenFile;
+    // Запись с верной CRC, которую не удалось разобрать, не является
+    // недописанным хвостом: файл остается как есть
+    return corruptedFile;
+  }
+  // Запись, которую не успели дописать до сбоя, отбрасывается до применения
+  // записей, чтобы при ошибке хранилище не изменилось
+  if (validSize < fileSize && truncate(fileName.c_str(), validSize) != 0)
+    return canNotOpenFile;
+  try {
+    for (const auto& record : records) apply(record);
+  } catch (const std::exception&) {
+    return corruptedFile;
+  }
+  return static_cast<int>(records.size());
+}
+//----------------------------------------------------------------
+Errors AppendOnlyLog::Open(const std::string& fileName,
+                           const FsyncPolicy policy,
+                           const std::chrono::milliseconds interval) {
+  Close();
+  // При нулевом интервале фоновый поток синхронизации крутился бы без сна
+  if (policy == fsyncInterval && interval.count() <= 0) return unknownError;
+  int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) return canNotOpenFile;
+  // Только что созданный журнал без сброса каталога может пропасть после
+  // сбоя вместе со всеми записями, подтвержденными через fdatasync
+  if (!SyncDirectory(DirectoryOf(fileName))) {
+    close(fd);
+    return canNotOpenFile;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  fileName_ = fileName;
+  policy_ = policy;
+  interval_ = interval;
+  // Номера записей продолжаются: операция, получившая номер до повторного
+  // открытия, может вызвать Commit уже после него
+  syncedLsn_ = appendedLsn_;
+  failed_ = false;
+  stopFlusher_ = false;
+  fd_ = fd;
+  if (policy_ == fsyncInterval)
+    flusher_ = std::thread(&AppendOnlyLog::FlusherLoop, this);
+  return noErrors;
+}
+//----------------------------------------------------------------
+void AppendOnlyLog::Close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopFlusher_ = true;
+    flusherWakeUp_.notify_all();
+  }
+  if (flusher_.joinable()) flusher_.join();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (fd_ < 0) return;
+  SyncUpTo(lock, appendedLsn_);
+  // Другой поток мог начать следующую запись после той, которой дождался
+  // SyncUpTo. Без ожидания он допишет старые записи в файл, получивший тот
+  // же дескриптор после повторного открытия
+  synced_.wait(lock, [this]() { return !syncing_; });
+  close(fd_);
+  fd_ = -1;
+  // После ошибки записи в буфере могут остаться записи, добавленные во время
+  // неудачной записи. Они не должны попасть в следующий открытый файл
+  buffer_.clear();
+  rewriting_ = false;
+  rewriteBuffer_.clear();
+}
+//----------------------------------------------------------------
+uint64_t AppendOnlyLog::Append(const LogRecord& record) {
+  std::string framed = Frame(Encode(record));
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fd_ < 0) return 0;
+  // После ошибки записи в файл попадет только следующая перезапись
+  if (!failed_) buffer_.append(framed);
+  const uint64_t lsn = ++appendedLsn_;
+  if (rewriting_) rewriteBuffer_.emplace_back(lsn, std::move(framed));
+  return lsn;
+}
+//----------------------------------------------------------------
+bool AppendOnlyLog::Commit(const uint64_t lsn) {
+  if (lsn == 0) return true;
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (policy_ == fsyncInterval) return !failed_;
+  return SyncUpTo(lock, lsn);
+}
+//----------------------------------------------------------------
+bool AppendOnlyLog::Failed() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return failed_;
+}
+//----------------------------------------------------------------
+uint64_t AppendOnlyLog::LastLsn() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return appendedLsn_;
+}
+//----------------------------------------------------------------
+bool AppendOnlyLog::SyncUpTo(std::unique_lock<std::mutex>& lock,
+                             const uint64_t lsn) {
+  // Пишет и синхронизирует один поток, остальные ждут его результата. Пока
+  // идет запись, новые записи копятся в buffer_ и уйдут следующим fsync,
+  // при fsyncAlways - каждая своим
+  while (syncedLsn_ < lsn && fd_ >= 0 && !failed_) {
+    if (syncing_) {
+      synced_.wait(lock);
+      continue;
+    }
+    // Все добавленные записи уже на диске. Так бывает, когда Commit
+    // вызывают с номером записи, сохраненной до повторного открытия
+    if (buffer_.empty()) {
+      syncedLsn_ = appendedLsn_;
+      break;
+    }
+    syncing_ = true;
+    std::string data;
+    uint64_t target = appendedLsn_;
+    if (policy_ == fsyncAlways) {
+      // Каждая запись пишется и сбрасывается на диск отдельно, поэтому
+      // одновременные операции не делят один fsync
+      const size_t size =
+          RecordHeaderSize + BinaryReader(buffer_).Get<uint32_t>();
+      data = buffer_.substr(0, size);
+      buffer_.erase(0, size);
+      target = syncedLsn_ + 1;
+    } else {
+      data.swap(buffer_);
+    }
+    const int fd = fd_;
+    lock.unlock();
+    const bool written = WriteAll(fd, data) && fdatasync(fd) == 0;
+    lock.lock();
+    // Недописанная запись обрывает журнал при воспроизведении, поэтому после
+    // ошибки записи ничего не считается сохраненным до перезаписи
+    if (written)
+      syncedLsn_ = target;
+    else
+      failed_ = true;
+    syncing_ = false;
+    synced_.notify_all();
+  }
+  return syncedLsn_ >= lsn;
+}
+//----------------------------------------------------------------
+void AppendOnlyLog::FlusherLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopFlusher_) {
+    flusherWakeUp_.wait_for(lock, interval_);
+    SyncUpTo(lock, appendedLsn_);
+  }
+}
+//----------------------------------------------------------------
+void AppendOnlyLog::BeginRewrite() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  rewriting_ = true;
+  rewriteBuffer_.clear();
+}
+//----------------------------------------------------------------
+int AppendOnlyLog::FinishRewrite(const EntrySource& entries,
+                                 const uint64_t& cutLsn) {
+  std::string fileName;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ < 0 || !rewriting_) return unknownError;
+    fileName = fileName_;
+  }
+  const std::string tmpName = fileName + ".rewrite";
+  int fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rewriting_ = false;
+    rewriteBuffer_.clear();
+    return canNotOpenFile;
+  }
+  // Снимок пишется без блокировки журнала, операции тем временем копятся в
+  // rewriteBuffer_
+  bool written = true;
+  int count = 0;
+  std::string chunk;
+  entries([&](const Key& key, const Value& value, const Deadline timeToDel) {
+    chunk.append(
+        Frame(Encode({logSet, key, Key(), value, ToWallClock(timeToDel)})));
+    ++count;
+    if (chunk.size() >= RewriteChunkSize) {
+      written = written && WriteAll(fd, chunk);
+      chunk.clear();
+    }
+  });
+  written = written && WriteAll(fd, chunk);
+  // Снимок сбрасывается на диск до блокировки журнала, под ней сбрасывается
+  // только хвост из rewriteBuffer_, и Append не ждет записи всего файла
+  written = written && fdatasync(fd) == 0;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  synced_.wait(lock, [this]() { return !syncing_; });
+  bool hasTail = false;
+  for (const auto& [lsn, framed] : rewriteBuffer_) {
+    if (lsn <= cutLsn) continue;
+    written = written && WriteAll(fd, framed);
+    hasTail = true;
+    ++count;
+  }
+  if (hasTail) written = written && fdatasync(fd) == 0;
+  // Недописанный файл не заменяет старый журнал
+  Errors res = noErrors;
+  if (!written)
+    res = logWriteFailed;
+  else if (fd_ < 0)
+    res = unknownError;
+  else if (rename(tmpName.c_str(), fileName.c_str()) != 0)
+    res = canNotOpenFile;
+  if (res != noErrors) {
+    close(fd);
+    unlink(tmpName.c_str());
+    rewriting_ = false;
+    rewriteBuffer_.clear();
+    return res;
+  }
+  // Под именем журнала уже новый файл, и писать дальше нужно в него. Пока
+  // переименование не сброшено на диск, после сбоя может вернуться старый
+  // журнал, поэтому при ошибке ничего не считается сохраненным до следующей
+  // перезаписи
+  const bool renamed = SyncDirectory(DirectoryOf(fileName));
+  close(fd_);
+  fd_ = fd;
+  // Все записи buffer_ уже попали в новый файл из rewriteBuffer_
+  buffer_.clear();
+  if (renamed) syncedLsn_ = appendedLsn_;
+  failed_ = !renamed;
+  rewriting_ = false;
+  rewriteBuffer_.clear();
+  synced_.notify_all();
+  return renamed ? count : logWriteFailed;
+}
+//----------------------------------------------------------------
+std::string AppendOnlyLog::Encode(const LogRecord& record) {
+  std::string res;
+  Put<uint8_t>(res, static_cast<uint8_t>(record.operation));
+  PutString(res, record.key);
+  PutString(res, record.newKey);
+  PutString(res, record.value.lastname);
+  PutString(res, record.value.name);
+  PutString(res, record.value.city);
+  Put<int32_t>(res, record.value.year);
+  Put<int32_t>(res, record.value.coins);
+  Put<int64_t>(res, record.expireAt);
+  return res;
+}
+//----------------------------------------------------------------
+LogRecord AppendOnlyLog::Decode(std::string_view payload) {
+  BinaryReader reader(payload);
+  LogRecord record;
+  const uint8_t operation = reader.Get<uint8_t>();
+  if (operation > logExpire)
+    throw std::runtime_error("Corrupted log: unknown operation");
+  record.operation = static_cast<LogOperation>(operation);
+  record.key = reader.GetString();
+  record.newKey = reader.GetString();
+  record.value.lastname = reader.GetString();
+  record.value.name = reader.GetString();
+  record.value.city = reader.GetString();
+  record.value.year = reader.Get<int32_t>();
+  record.value.coins = reader.Get<int32_t>();
+  record.expireAt = reader.Get<int64_t>();
+  return record;
+}
+
+}  //  namespace s21
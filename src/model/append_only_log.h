@@ -0,0 +1,107 @@
+// Журнал операций хранилища, который дописывается в конец файла
+#ifndef SRC_MODEL_APPEND_ONLY_LOG_H_
+#define SRC_MODEL_APPEND_ONLY_LOG_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../types.h"
+
+namespace s21 {
+
+enum LogOperation { logSet, logUpdate, logDel, logRename, logExpire };
+
+struct LogRecord {
+  LogOperation operation;
+  Key key;
+  // Новый ключ для logRename
+  Key newKey;
+  // Значение и время удаления после операции для logSet и logUpdate.
+  // Время удаления хранится в миллисекундах системных часов, 0 - без него
+  Value value;
+  int64_t expireAt;
+};
+
+class AppendOnlyLog {
+ public:
+  AppendOnlyLog();
+  ~AppendOnlyLog();
+
+  AppendOnlyLog(const AppendOnlyLog&) = delete;
+  AppendOnlyLog& operator=(const AppendOnlyLog&) = delete;
+
+  // Разбирает все записи файла и только потом вызывает apply для каждой.
+  // Поврежденная запись, после которой в файле нет ни одной целой,
+  // считается недописанной и отрезается. Возвращает число записей,
+  // canNotOpenFile или corruptedFile, если после поврежденной записи есть
+  // целая или запись с верной CRC не удалось разобрать. Тогда файл не
+  // изменяется и apply не вызывается. Отсутствующий файл считается пустым
+  static int Replay(const std::string& fileName,
+                    const std::function<void(const LogRecord&)>& apply);
+
+  Errors Open(const std::string& fileName, const FsyncPolicy policy,
+              const std::chrono::milliseconds interval);
+  void Close();
+  bool IsOpen() const { return fd_.load() >= 0; }
+
+  // Вызывается под блокировкой хранилища, чтобы порядок записей совпадал с
+  // порядком операций. Возвращает номер записи или 0, если журнал закрыт
+  uint64_t Append(const LogRecord& record);
+  // Вызывается после снятия блокировки хранилища, чтобы запись на диск не
+  // задерживала других. При fsyncAlways и fsyncGroupCommit ждет, пока запись
+  // не попадет на диск: при fsyncAlways отдельным fsync, при
+  // fsyncGroupCommit одним fsync для всех ожидающих. Возвращает false, если
+  // запись в файл не удалась
+  bool Commit(const uint64_t lsn);
+  // Запись в файл не удалась: новые записи не сохраняются, пока
+  // FinishRewrite не запишет журнал заново
+  bool Failed();
+  uint64_t LastLsn();
+
+  // Перезапись: записи после BeginRewrite накапливаются отдельно. entries
+  // обходит состояние хранилища после записи cutLsn, cutLsn читается после
+  // обхода. Возвращает число записей, logWriteFailed, если запись или
+  // fdatasync не удались, canNotOpenFile, если не удалось открыть или
+  // переименовать файл
+  void BeginRewrite();
+  int FinishRewrite(const EntrySource& entries, const uint64_t& cutLsn);
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable synced_;
+  std::atomic<int> fd_;
+  std::string fileName_;
+  FsyncPolicy policy_;
+  std::chrono::milliseconds interval_;
+
+  // Записи, еще не переданные в файл
+  std::string buffer_;
+  uint64_t appendedLsn_;
+  uint64_t syncedLsn_;
+  bool syncing_;
+  bool failed_;
+
+  bool rewriting_;
+  std::vector<std::pair<uint64_t, std::string>> rewriteBuffer_;
+
+  std::thread flusher_;
+  bool stopFlusher_;
+  std::condition_variable flusherWakeUp_;
+
+  static std::string Encode(const LogRecord& record);
+  static LogRecord Decode(std::string_view payload);
+  bool SyncUpTo(std::unique_lock<std::mutex>& lock, const uint64_t lsn);
+  void FlusherLoop();
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_APPEND_ONLY_LOG_H_
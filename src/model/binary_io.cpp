@@ -0,0 +1,27 @@
+#include "binary_io.h"
+
+#include <array>
+
+namespace s21 {
+
+namespace {
+std::array<uint32_t, 256> MakeCrcTable() {
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit)
+      crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+    table[i] = crc;
+  }
+  return table;
+}
+}  // namespace
+
+uint32_t Crc32(std::string_view data, const uint32_t previous) {
+  static const std::array<uint32_t, 256> table = MakeCrcTable();
+  uint32_t crc = previous ^ 0xFFFFFFFFu;
+  for (unsigned char c : data) crc = table[(crc ^ c) & 0xFF] ^ (crc >> 8);
+  return crc ^ 0xFFFFFFFFu;
+}
+
+}  //  namespace s21
@@ -0,0 +1,71 @@
+// Кодирование чисел и строк для двоичных файлов хранилища. Числа записываются
+// в порядке байтов little-endian, строки - длиной (u32) и байтами
+#ifndef SRC_MODEL_BINARY_IO_H_
+#define SRC_MODEL_BINARY_IO_H_
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace s21 {
+
+// previous - сумма предыдущей части данных, чтобы считать сумму по частям
+uint32_t Crc32(std::string_view data, const uint32_t previous = 0);
+
+// Байты собираются сдвигами, поэтому порядок в файле не зависит от
+// порядка байтов процессора
+template <typename T>
+void Put(std::string& out, const T value) {
+  static_assert(std::is_integral_v<T>, "Put encodes integers only");
+  auto bits = static_cast<std::make_unsigned_t<T>>(value);
+  char bytes[sizeof(T)];
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    bytes[i] = static_cast<char>(bits & 0xFF);
+    bits = static_cast<std::make_unsigned_t<T>>(bits >> 8);
+  }
+  out.append(bytes, sizeof(T));
+}
+
+inline void PutString(std::string& out, const std::string& str) {
+  Put<uint32_t>(out, static_cast<uint32_t>(str.size()));
+  out.append(str);
+}
+
+// Последовательное чтение из буфера с проверкой границ. При выходе за
+// границу бросает std::runtime_error с "Corrupted"
+class BinaryReader {
+ public:
+  explicit BinaryReader(std::string_view data) : data_(data), pos_(0) {}
+
+  template <typename T>
+  T Get() {
+    static_assert(std::is_integral_v<T>, "Get decodes integers only");
+    std::string_view bytes = Take(sizeof(T));
+    std::make_unsigned_t<T> bits = 0;
+    for (size_t i = sizeof(T); i > 0; --i)
+      bits = static_cast<std::make_unsigned_t<T>>(
+          (bits << 8) |
+          static_cast<unsigned char>(bytes[i - 1]));
+    return static_cast<T>(bits);
+  }
+  std::string GetString() { return std::string(Take(Get<uint32_t>())); }
+  std::string_view Take(const size_t size) {
+    if (data_.size() - pos_ < size)
+      throw std::runtime_error("Corrupted data: unexpected end");
+    std::string_view res = data_.substr(pos_, size);
+    pos_ += size;
+    return res;
+  }
+  bool AtEnd() const { return pos_ == data_.size(); }
+  size_t Position() const { return pos_; }
+
+ private:
+  std::string_view data_;
+  size_t pos_;
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_BINARY_IO_H_
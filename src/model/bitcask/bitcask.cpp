@@ -0,0 +1,924 @@
+#include "bitcask.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <tuple>
+
+#include "../aggregation/aggregator.h"
+#include "../dispatchers/ttl_manager.h"
+#include "../durable_file.h"
+
+namespace s21 {
+
+namespace {
+// Пауза перед повтором, если слияние не удалось
+constexpr std::chrono::seconds RetryDelay(1);
+// Число строк, которые загрузка вставляет за один захват блокировки. Меньше,
+// чем у хранилищ в памяти: каждая строка дописывается в файл сегмента
+constexpr size_t UploadBatchRows = 1024;
+}  // namespace
+
+Bitcask::Bitcask() : Bitcask(Options()) {}
+
+//----------------------------------------------------------------
+Bitcask::Bitcask(const Options& options)
+    : options_(options),
+      nextSegmentId_(0),
+      nextSeq_(1),
+      mergesRequested_(0),
+      mergesDone_(0),
+      stop_(false) {
+  load();
+  dispatcher_ = TtlManager::getInstance().addNewContainer(*this);
+  for (const auto& [key, location] : index_) {
+    if (location.timeToDel != NoDeadline) {
+      TtlManager::getInstance().addOrUpdateNode(*dispatcher_, key,
+                                                location.timeToDel);
+    }
+  }
+  worker_ = std::thread(&Bitcask::workerLoop, this);
+}
+
+//----------------------------------------------------------------
+Bitcask::~Bitcask() {
+  TtlManager::getInstance().deleteContainer(*this);
+  DisableLog();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+  worker_.join();
+  for (const auto& segment : unsynced_) segment->Sync();
+  active_->Sync();
+}
+
+//----------------------------------------------------------------
+Errors Bitcask::set(const std::string& key, const Value& value,
+                    std::chrono::milliseconds ttl) {
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Errors res = setLocked(key, value, timeToDel, lsn);
+    if (res != noErrors) return res;
+    // Срок в диспетчере меняется вместе с индексом, пока держится mutex_
+    if (timeToDel != NoDeadline)
+      TtlManager::getInstance().addOrUpdateNode(*dispatcher_, key, timeToDel);
+  }
+  return CommitChange(lsn);
+}
+
+//----------------------------------------------------------------
+std::optional<Value> Bitcask::get(const std::string& key) {
+  std::shared_ptr<Segment> segment;
+  Location location;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::optional<Location> found = findAlive(key);
+    if (!found) return std::nullopt;
+    location = *found;
+    segment = segments_.at(location.segment);
+  }
+  // Запись в сегменте не изменяется, поэтому читается без блокировки
+  try {
+    return segment->Read(location.offset, location.size).value;
+  } catch (const std::exception&) {
+    return std::nullopt;
+  }
+}
+
+//----------------------------------------------------------------
+bool Bitcask::exists(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return findAlive(key).has_value();
+}
+
+//----------------------------------------------------------------
+Errors Bitcask::del(const std::string& key) {
+  bool hasTtl = false;
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Errors res = delLocked(key, hasTtl, lsn);
+    if (res != noErrors) return res;
+    if (hasTtl) TtlManager::getInstance().deleteNode(*dispatcher_, key);
+  }
+  return CommitChange(lsn);
+}
+
+//----------------------------------------------------------------
+std::vector<std::optional<Value>> Bitcask::mget(const std::vector<Key>& keys) {
+  std::vector<std::optional<Value>> res(keys.size());
+  std::vector<std::pair<Location, size_t>> found;
+  std::map<uint32_t, std::shared_ptr<Segment>> segments;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      std::optional<Location> location = findAlive(keys[i]);
+      if (!location) continue;
+      found.push_back({*location, i});
+      segments.emplace(location->segment, segments_.at(location->segment));
+    }
+  }
+  // Записи читаются без блокировки в порядке их положения на диске
+  std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+    return std::tie(a.first.segment, a.first.offset) <
+           std::tie(b.first.segment, b.first.offset);
+  });
+  for (const auto& [location, idx] : found) {
+    try {
+      res[idx] = segments.at(location.segment)
+                     ->Read(location.offset, location.size)
+                     .value;
+    } catch (const std::exception&) {
+    }
+  }
+  return res;
+}
+
+//----------------------------------------------------------------
+std::vector<Errors> Bitcask::mset(
+    const std::vector<std::pair<Key, Value>>& values,
+    std::chrono::milliseconds ttl) {
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  std::vector<Errors> res;
+  res.reserve(values.size());
+  std::vector<Key> withTtl;
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [key, value] : values) {
+      res.push_back(setLocked(key, value, timeToDel, lsn));
+      if (res.back() == noErrors && timeToDel != NoDeadline)
+        withTtl.push_back(key);
+    }
+    TtlManager::getInstance().addOrUpdateNodes(*dispatcher_, withTtl,
+                                               timeToDel);
+  }
+  CommitChanges(lsn, res);
+  return res;
+}
+
+//----------------------------------------------------------------
+std::vector<Errors> Bitcask::mdel(const std::vector<Key>& keys) {
+  std::vector<Errors> res;
+  res.reserve(keys.size());
+  std::vector<Key> withTtl;
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& key : keys) {
+      bool hasTtl = false;
+      res.push_back(delLocked(key, hasTtl, lsn));
+      if (hasTtl) withTtl.push_back(key);
+    }
+    if (!withTtl.empty())
+      TtlManager::getInstance().deleteNodes(*dispatcher_, withTtl);
+  }
+  CommitChanges(lsn, res);
+  return res;
+}
+
+//----------------------------------------------------------------
+Errors Bitcask::update(const Key& key, const Value& value,
+                       std::chrono::milliseconds ttl, const int paramsMask) {
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::optional<Location> found = findAlive(key);
+    if (!found) return keyNotFound;
+    std::optional<Value> stored = readValue(*found);
+    if (!stored) return unknownError;
+    Value updated = *stored;
+    if (paramsMask & pLastname) updated.lastname = value.lastname;
+    if (paramsMask & pName) updated.name = value.name;
+    if (paramsMask & pYear) updated.year = value.year;
+    if (paramsMask & pCity) updated.city = value.city;
+    if (paramsMask & pCoins) updated.coins = value.coins;
+    const Deadline newTimeToDel =
+        paramsMask & pTtl ? timeToDel : found->timeToDel;
+    std::optional<Location> location = append(key, &updated, newTimeToDel);
+    if (!location) return unknownError;
+    forget(*found);
+    index_[key] = *location;
+    unaccount(key, stored);
+    statistics_.Insert(updated);
+    notifier_.Publish(evUpdate, key);
+    lsn = RecordChange(logUpdate, key, updated, newTimeToDel);
+    if (paramsMask & pTtl)
+      TtlManager::getInstance().addOrUpdateNode(*dispatcher_, key, timeToDel);
+  }
+  return CommitChange(lsn);
+}
+
+//----------------------------------------------------------------
+Errors Bitcask::rename(const std::string& oldKey, const std::string& newKey) {
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::optional<Location> found = findAlive(oldKey);
+    if (!found) return keyNotFound;
+    if (findAlive(newKey)) return keyAlreadyExists;
+    std::optional<Value> value = readValue(*found);
+    if (!value) return unknownError;
+    const Deadline timeToDel = found->timeToDel;
+    std::optional<Location> location = append(newKey, &*value, timeToDel);
+    if (!location || !append(oldKey, nullptr, NoDeadline)) {
+      if (location) {
+        forget(*location);
+        append(newKey, nullptr, NoDeadline);
+      }
+      return unknownError;
+    }
+    forget(*found);
+    index_.erase(oldKey);
+    index_.emplace(newKey, *location);
+    if (loading_.erase(oldKey)) statistics_.Insert(*value);
+    notifier_.Publish(evRename, oldKey, newKey);
+    lsn = RecordChange(logRename, oldKey, newKey);
+    if (timeToDel != NoDeadline) {
+      TtlManager::getInstance().deleteNode(*dispatcher_, oldKey);
+      TtlManager::getInstance().addOrUpdateNode(*dispatcher_, newKey,
+                                                timeToDel);
+    }
+  }
+  return CommitChange(lsn);
+}
+
+//----------------------------------------------------------------
+Errors Bitcask::incrBy(const Key& key, const int field, const int delta,
+                       int& result) {
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::optional<Location> found = findAlive(key);
+    if (!found) return keyNotFound;
+    std::optional<Value> stored = readValue(*found);
+    if (!stored) return unknownError;
+    std::optional<int> number = IncrementedField(*stored, field, delta);
+    if (!number) return valueOutOfRange;
+    Value updated = *stored;
+    SetNumericField(updated, field, *number);
+    std::optional<Location> location =
+        append(key, &updated, found->timeToDel);
+    if (!location) return unknownError;
+    forget(*found);
+    index_[key] = *location;
+    // Строковые поля не меняются: статистику достаточно дополнить, если
+    // фоновая загрузка еще не учла ключ
+    if (loading_.erase(key)) statistics_.Insert(updated);
+    notifier_.Publish(evUpdate, key);
+    lsn = RecordChange(logUpdate, key, updated, found->timeToDel);
+    result = *number;
+  }
+  return CommitChange(lsn);
+}
+
+//----------------------------------------------------------------
+long long Bitcask::PTtl(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::optional<Location> found = findAlive(key);
+  if (!found) return keyNotFound;
+  return RemainingMs(found->timeToDel);
+}
+
+//----------------------------------------------------------------
+size_t Bitcask::expireBatch(const std::vector<std::string>& keys) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int sizeBefore = countItems.load();
+  for (const auto& key : keys) findAlive(key);
+  return static_cast<size_t>(sizeBefore - countItems.load());
+}
+
+//----------------------------------------------------------------
+std::vector<std::string> Bitcask::expiringWithin(
+    std::chrono::milliseconds window) {
+  const Deadline now = Clock::now();
+  const Deadline until = SaturatingAdd(now, window);
+  auto candidates = dispatcher_->ExpiringBetween(now, until);
+  // Кандидаты диспетчера сверяются с индексом ключей
+  std::vector<std::string> res;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& key : candidates) {
+    std::optional<Location> found = findAlive(key);
+    if (found && found->timeToDel <= until) res.push_back(key);
+  }
+  return res;
+}
+
+//----------------------------------------------------------------
+std::vector<size_t> Bitcask::expiryHistogram(std::chrono::milliseconds bucket,
+                                             const size_t bucketsCount) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dispatcher_->CountByBuckets(
+      Clock::now(), bucket, bucketsCount,
+      [this](const Key& key, const Deadline deadline) {
+        std::optional<Location> found = findAlive(key);
+        return found && found->timeToDel == deadline;
+      });
+}
+
+//----------------------------------------------------------------
+size_t Bitcask::bulkInsert(std::vector<std::pair<Key, Value>>& values) {
+  uint64_t lsn = 0;
+  size_t inserted = 0;
+  bool failed = false;
+  // Блокировка отпускается после каждого пакета, чтобы загрузка не
+  // останавливала остальные запросы до своего окончания
+  for (size_t done = 0; done < values.size() && !failed;) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const size_t end = std::min(values.size(), done + UploadBatchRows);
+      for (; done < end; ++done) {
+        auto& row = values[done];
+        if (findAlive(row.first)) continue;
+        std::optional<Location> location =
+            append(row.first, &row.second, NoDeadline);
+        if (!location) {
+          failed = true;
+          break;
+        }
+        ++countItems;
+        ++inserted;
+        statistics_.Insert(row.second);
+        notifier_.Publish(evSet, row.first);
+        lsn = RecordChange(logSet, row.first, row.second, NoDeadline);
+        index_.emplace(std::move(row.first), *location);
+      }
+    }
+    std::this_thread::yield();
+  }
+  // Ошибку записи журнала показывает LogFailed
+  log_.Commit(lsn);
+  return inserted;
+}
+
+//----------------------------------------------------------------
+const std::vector<std::string> Bitcask::keys() {
+  std::vector<std::string> res;
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Deadline now = Clock::now();
+  for (const auto& [key, location] : index_)
+    if (!IsExpired(location.timeToDel, now)) res.push_back(key);
+  return res;
+}
+
+//----------------------------------------------------------------
+const std::vector<std::string> Bitcask::find(const Value& value, const int ttl,
+                                             const int paramsMask) {
+  View view;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (paramsMask & pTtl) {
+      const auto [from, to] = TtlWindow(ttl);
+      view.segments = segments_;
+      for (const auto& key : dispatcher_->ExpiringBetween(from, to)) {
+        std::optional<Location> found = findAlive(key);
+        if (found) view.entries.emplace_back(key, *found);
+      }
+    } else {
+      view = takeView(Clock::now());
+    }
+  }
+  std::vector<std::string> res;
+  forEach(view,
+          [&](const Key& key, const Value& stored, const Location& location) {
+            if (IsMatch(stored, location.timeToDel, value, ttl, paramsMask))
+              res.push_back(key);
+          });
+  return res;
+}
+
+//----------------------------------------------------------------
+const std::vector<Value> Bitcask::showall() {
+  View view;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    view = takeView(Clock::now());
+  }
+  std::vector<Value> res;
+  forEach(view, [&res](const Key&, const Value& value, const Location&) {
+    res.push_back(value);
+  });
+  return res;
+}
+
+//----------------------------------------------------------------
+const std::vector<AggregateRow> Bitcask::aggregate(
+    const AggregateQuery& query) {
+  // Агрегату нужны только значения: ключи не копируются, значения читаются
+  // с диска по одному
+  View view;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    view = takeView(Clock::now(), false);
+  }
+  Aggregator aggregator(query);
+  forEach(view,
+          [&](const Key&, const Value& value, const Location& location) {
+            if (IsMatch(value, location.timeToDel, query.filter, query.ttl,
+                        query.paramsMask))
+              aggregator.Add(value);
+          });
+  return aggregator.Result();
+}
+
+//----------------------------------------------------------------
+void Bitcask::merge() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (active_->Size() > 0) rollSegment();
+  const uint64_t request = ++mergesRequested_;
+  changed_.notify_all();
+  changed_.wait(lock, [&]() { return stop_ || mergesDone_ >= request; });
+}
+
+//----------------------------------------------------------------
+size_t Bitcask::segmentsCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return segments_.size();
+}
+
+//----------------------------------------------------------------
+void Bitcask::forEachEntry(const std::function<void()>& underLock,
+                           const EntryWriter& write) {
+  View view;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    underLock();
+    view = takeView(Clock::now());
+  }
+  forEach(view, [&write](const Key& key, const Value& value,
+                         const Location& location) {
+    write(key, value, location.timeToDel);
+  });
+}
+
+//----------------------------------------------------------------
+void Bitcask::forEachEntryByKey(const EntryWriter& write) {
+  View view;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    view = takeView(Clock::now());
+  }
+  forEach(
+      view,
+      [&write](const Key& key, const Value& value, const Location& location) {
+        write(key, value, location.timeToDel);
+      },
+      nullptr, true);
+}
+
+//----------------------------------------------------------------
+std::vector<Entry> Bitcask::copyEntries(
+    const std::function<void()>& underLock) {
+  std::vector<Entry> entries;
+  entries.reserve(countItems.load());
+  forEachEntry(underLock, [&entries](const Key& key, const Value& value,
+                                     const Deadline timeToDel) {
+    entries.push_back({key, value, timeToDel});
+  });
+  return entries;
+}
+
+//----------------------------------------------------------------
+void Bitcask::load() {
+  const std::string& directory = options_.directory;
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  if (error || !std::filesystem::is_directory(directory)) {
+    std::stringstream str;
+    str << "Directory " << directory << " not open\n";
+    throw std::runtime_error(str.str().c_str());
+  }
+  // Файлы сегментов, замененных слиянием до сбоя, удаляются до чтения
+  // каталога: иначе их записи вернули бы ключи, отметки об удалении которых
+  // слияние уже отбросило. Список удаляется только после их удаления
+  std::vector<uint32_t> replaced;
+  if (!Segment::ReadReplaced(directory, replaced)) {
+    std::stringstream str;
+    str << "Corrupted " << Segment::ReplacedName(directory) << "\n";
+    throw std::runtime_error(str.str().c_str());
+  }
+  for (const uint32_t id : replaced) {
+    std::remove(Segment::DataName(directory, id).c_str());
+    std::remove(Segment::HintName(directory, id).c_str());
+  }
+  if (!replaced.empty() && !SyncDirectory(directory)) {
+    std::stringstream str;
+    str << "Directory " << directory << " not open\n";
+    throw std::runtime_error(str.str().c_str());
+  }
+  std::remove(Segment::ReplacedName(directory).c_str());
+  std::remove((Segment::ReplacedName(directory) + ".tmp").c_str());
+  std::vector<uint32_t> ids;
+  for (const auto& file : std::filesystem::directory_iterator(directory)) {
+    const std::string stem = file.path().stem().string();
+    if (file.path().extension() != ".data" || stem.empty() ||
+        !std::all_of(stem.begin(), stem.end(), ::isdigit))
+      continue;
+    ids.push_back(static_cast<uint32_t>(std::stoul(stem)));
+  }
+  std::sort(ids.begin(), ids.end());
+
+  // Последняя версия каждого ключа по номеру записи
+  struct Latest {
+    uint64_t seq;
+    bool tombstone;
+    Location location;
+  };
+  std::unordered_map<Key, Latest> latest;
+  auto apply = [&](const Key& key, const uint64_t seq, const bool tombstone,
+                   const Location& location) {
+    auto found = latest.find(key);
+    if (found == latest.end()) {
+      latest.emplace(key, Latest{seq, tombstone, location});
+    } else if (found->second.seq < seq) {
+      found->second = Latest{seq, tombstone, location};
+    }
+    nextSeq_ = std::max(nextSeq_, seq + 1);
+  };
+  // Пустые сегменты остаются от каждого открытия каталога
+  std::vector<uint32_t> filled;
+  for (const uint32_t id : ids) {
+    const std::string dataName = Segment::DataName(directory, id);
+    if (std::filesystem::file_size(dataName, error) == 0 && !error)
+      std::remove(dataName.c_str());
+    else
+      filled.push_back(id);
+  }
+  for (const uint32_t id : filled) {
+    const std::string dataName = Segment::DataName(directory, id);
+    const std::string hintName = Segment::HintName(directory, id);
+    std::vector<BitcaskHint> hints;
+    if (Segment::ReadHints(hintName, hints)) {
+      for (const auto& hint : hints)
+        apply(hint.key, hint.seq, false,
+              {id, hint.size, hint.offset,
+               FromWallClock(hint.expireAt)});
+    } else {
+      // Недописанный хвост бывает у любого сегмента, в который писал append:
+      // не только у последнего, но и у сегмента, оставленного после ошибки
+      // записи или лежащего ниже выходов слияния. Выход слияния с файлом
+      // подсказок дописан целиком, и поврежденная запись в нем - ошибка
+      Segment::Scan(
+          dataName,
+          [&](const BitcaskRecord& record, const uint64_t offset,
+              std::string_view raw) {
+            apply(record.key, record.seq, record.tombstone,
+                  {id, static_cast<uint32_t>(raw.size()), offset,
+                   FromWallClock(record.expireAt)});
+          },
+          !std::filesystem::exists(hintName, error));
+    }
+    segments_[id] = std::make_shared<Segment>(directory, id);
+  }
+  const Deadline now = Clock::now();
+  index_.reserve(latest.size());
+  while (!latest.empty()) {
+    auto node = latest.extract(latest.begin());
+    const Latest& version = node.mapped();
+    if (version.tombstone || IsExpired(version.location.timeToDel, now))
+      continue;
+    segments_.at(version.location.segment)->liveBytes +=
+        version.location.size;
+    index_.emplace(std::move(node.key()), version.location);
+  }
+  countItems = static_cast<int>(index_.size());
+  for (const auto& row : index_) loading_.insert(row.first);
+  // Номера замененных сегментов не используются повторно
+  nextSegmentId_ = ids.empty() ? 0 : ids.back() + 1;
+  for (const uint32_t id : replaced)
+    nextSegmentId_ = std::max(nextSegmentId_, id + 1);
+  rollSegment();
+}
+
+//----------------------------------------------------------------
+std::optional<Bitcask::Location> Bitcask::findAlive(const Key& key) {
+  auto found = index_.find(key);
+  if (found == index_.end()) return std::nullopt;
+  if (IsExpired(found->second.timeToDel)) {
+    // Истекшая запись считается отсутствующей и удаляется при обращении.
+    // Отметка об удалении не нужна: при открытии каталога запись тоже
+    // окажется истекшей
+    std::optional<Value> old = readValue(found->second);
+    forget(found->second);
+    index_.erase(found);
+    --countItems;
+    unaccount(key, old);
+    notifier_.Publish(evExpire, key);
+    RecordChange(logExpire, key);
+    return std::nullopt;
+  }
+  return found->second;
+}
+
+//----------------------------------------------------------------
+Errors Bitcask::setLocked(const Key& key, const Value& value,
+                          const Deadline timeToDel, uint64_t& lsn) {
+  if (findAlive(key)) return keyAlreadyExists;
+  std::optional<Location> location = append(key, &value, timeToDel);
+  if (!location) return unknownError;
+  index_.emplace(key, *location);
+  ++countItems;
+  statistics_.Insert(value);
+  notifier_.Publish(evSet, key);
+  lsn = RecordChange(logSet, key, value, timeToDel);
+  return noErrors;
+}
+
+//----------------------------------------------------------------
+Errors Bitcask::delLocked(const Key& key, bool& hasTtl, uint64_t& lsn) {
+  std::optional<Location> found = findAlive(key);
+  if (!found) return keyNotFound;
+  std::optional<Value> old = readValue(*found);
+  if (!append(key, nullptr, NoDeadline)) return unknownError;
+  hasTtl = HasPendingTtl(found->timeToDel);
+  forget(*found);
+  index_.erase(key);
+  --countItems;
+  unaccount(key, old);
+  notifier_.Publish(evDel, key);
+  lsn = RecordChange(logDel, key);
+  return noErrors;
+}
+
+//----------------------------------------------------------------
+std::optional<Value> Bitcask::readValue(const Location& location) const {
+  try {
+    return segments_.at(location.segment)
+        ->Read(location.offset, location.size)
+        .value;
+  } catch (const std::exception&) {
+    return std::nullopt;
+  }
+}
+
+//----------------------------------------------------------------
+std::optional<Bitcask::Location> Bitcask::append(const Key& key,
+                                                 const Value* value,
+                                                 const Deadline timeToDel) {
+  BitcaskRecord record{nextSeq_++, value == nullptr,
+                       ToWallClock(timeToDel), key,
+                       value ? *value : Value{}};
+  const std::string raw = Segment::Encode(record);
+  try {
+    if (active_->Size() >= options_.segmentBytes) rollSegment();
+    const uint64_t offset = active_->Append(raw);
+    if (value) active_->liveBytes += raw.size();
+    return Location{active_->Id(), static_cast<uint32_t>(raw.size()), offset,
+                    timeToDel};
+  } catch (const std::exception&) {
+    // В сегмент с недописанной записью больше не пишем
+    try {
+      rollSegment();
+    } catch (const std::exception&) {
+    }
+    return std::nullopt;
+  }
+}
+
+//----------------------------------------------------------------
+void Bitcask::forget(const Location& location) {
+  auto segment = segments_.find(location.segment);
+  if (segment != segments_.end()) segment->second->liveBytes -= location.size;
+}
+
+//----------------------------------------------------------------
+void Bitcask::unaccount(const Key& key, const std::optional<Value>& old) {
+  if (!loading_.erase(key) && old) statistics_.Erase(*old);
+}
+
+//----------------------------------------------------------------
+void Bitcask::rollSegment() {
+  // fdatasync заполненного сегмента делает фоновый поток, чтобы запись не
+  // ждала диск под mutex_
+  if (active_) unsynced_.push_back(active_);
+  const uint32_t id = nextSegmentId_++;
+  // Подсказки удаленного сегмента с тем же номером не должны примениться
+  std::remove(Segment::HintName(options_.directory, id).c_str());
+  active_ = std::make_shared<Segment>(options_.directory, id);
+  segments_[id] = active_;
+  changed_.notify_all();
+}
+
+//----------------------------------------------------------------
+bool Bitcask::needsMerge() const {
+  uint64_t total = 0;
+  uint64_t live = 0;
+  for (const auto& [id, segment] : segments_) {
+    if (segment == active_) continue;
+    total += segment->Size();
+    live += segment->liveBytes;
+  }
+  return total >= options_.segmentBytes &&
+         static_cast<double>(total - live) >= total * options_.mergeRatio;
+}
+
+//----------------------------------------------------------------
+Bitcask::View Bitcask::takeView(const Deadline at,
+                                const bool withKeys) const {
+  View view;
+  view.segments = segments_;
+  view.entries.reserve(index_.size());
+  for (const auto& row : index_) {
+    if (IsExpired(row.second.timeToDel, at)) continue;
+    if (withKeys)
+      view.entries.push_back(row);
+    else
+      view.entries.emplace_back(Key(), row.second);
+  }
+  return view;
+}
+
+//----------------------------------------------------------------
+void Bitcask::forEach(const View& view,
+                      const std::function<void(const Key&, const Value&,
+                                               const Location&)>& func,
+                      const std::atomic<bool>* stop, const bool byKey) {
+  std::vector<const std::pair<Key, Location>*> order;
+  order.reserve(view.entries.size());
+  for (const auto& entry : view.entries) order.push_back(&entry);
+  std::sort(order.begin(), order.end(), [byKey](const auto* a, const auto* b) {
+    if (byKey) return a->first < b->first;
+    return std::make_pair(a->second.segment, a->second.offset) <
+           std::make_pair(b->second.segment, b->second.offset);
+  });
+  for (const auto* entry : order) {
+    if (stop && stop->load()) return;
+    const Location& location = entry->second;
+    try {
+      BitcaskRecord record = view.segments.at(location.segment)
+                                 ->Read(location.offset, location.size);
+      func(entry->first, record.value, location);
+    } catch (const std::exception&) {
+      // Поврежденная запись пропускается
+    }
+  }
+}
+
+//----------------------------------------------------------------
+void Bitcask::workerLoop() {
+  loadStatistics();
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    // Закрытый сегмент попадает во входы слияния только после сброса
+    if (!unsynced_.empty()) {
+      std::vector<std::shared_ptr<Segment>> closed;
+      closed.swap(unsynced_);
+      lock.unlock();
+      for (const auto& segment : closed) segment->Sync();
+      lock.lock();
+      continue;
+    }
+    const uint64_t requested = mergesRequested_;
+    if (requested == mergesDone_ && !needsMerge()) {
+      changed_.wait(lock);
+      continue;
+    }
+    std::vector<std::shared_ptr<Segment>> inputs;
+    for (const auto& [id, segment] : segments_)
+      if (segment != active_) inputs.push_back(segment);
+    lock.unlock();
+    bool failed = false;
+    try {
+      mergeSegments(inputs);
+    } catch (const std::exception&) {
+      failed = true;
+    }
+    lock.lock();
+    mergesDone_ = requested;
+    changed_.notify_all();
+    // Закрытые сегменты остаются как были, слияние повторится позже
+    if (failed) changed_.wait_for(lock, RetryDelay);
+  }
+}
+
+//----------------------------------------------------------------
+void Bitcask::loadStatistics() {
+  View view;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index_.empty()) return;
+    view = takeView(Clock::now());
+  }
+  // Записи, измененные за время чтения, уже учтены операциями
+  forEach(
+      view,
+      [this](const Key& key, const Value& value, const Location&) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (loading_.erase(key)) statistics_.Insert(value);
+      },
+      &stop_);
+  std::lock_guard<std::mutex> lock(mutex_);
+  loading_.clear();
+}
+
+//----------------------------------------------------------------
+void Bitcask::mergeSegments(
+    const std::vector<std::shared_ptr<Segment>>& inputs) {
+  struct Move {
+    Key key;
+    uint32_t fromSegment;
+    uint64_t fromOffset;
+    uint32_t toSegment;
+    uint64_t toOffset;
+  };
+  std::vector<Move> moves;
+  std::vector<std::shared_ptr<Segment>> outputs;
+  std::shared_ptr<Segment> output;
+  std::vector<BitcaskHint> hints;
+  auto finishOutput = [&]() {
+    if (!output) return;
+    output->Sync();
+    Segment::WriteHints(Segment::HintName(options_.directory, output->Id()),
+                        hints);
+    hints.clear();
+    outputs.push_back(std::move(output));
+    output.reset();
+  };
+  try {
+    for (const auto& input : inputs) {
+      // Недописанную запись закрытого сегмента оставляет ошибка append
+      const bool written = !std::filesystem::exists(
+          Segment::HintName(options_.directory, input->Id()));
+      Segment::Scan(
+          Segment::DataName(options_.directory, input->Id()),
+          [&](const BitcaskRecord& record, const uint64_t offset,
+              std::string_view raw) {
+            if (record.tombstone) return;
+            {
+              std::lock_guard<std::mutex> lock(mutex_);
+              auto found = index_.find(record.key);
+              if (found == index_.end() ||
+                  found->second.segment != input->Id() ||
+                  found->second.offset != offset)
+                return;
+            }
+            if (output && output->Size() >= options_.segmentBytes)
+              finishOutput();
+            if (!output) {
+              uint32_t id;
+              {
+                std::lock_guard<std::mutex> lock(mutex_);
+                id = nextSegmentId_++;
+              }
+              std::remove(Segment::HintName(options_.directory, id).c_str());
+              output = std::make_shared<Segment>(options_.directory, id);
+            }
+            const uint64_t toOffset = output->Append(raw);
+            hints.push_back({record.key, record.seq, toOffset,
+                             static_cast<uint32_t>(raw.size()),
+                             record.expireAt});
+            moves.push_back(
+                {record.key, input->Id(), offset, output->Id(), toOffset});
+          },
+          written);
+    }
+    finishOutput();
+    // Слияние отбрасывает отметки об удалении, поэтому файлы входных
+    // сегментов удаляются только после записи их номеров на диск
+    if (!inputs.empty()) {
+      // Номера сегментов, файлы которых уже удалены, из списка выпадают.
+      // Их удаление становится постоянным вместе с новым списком: запись
+      // списка сбрасывает каталог
+      std::vector<uint32_t> replaced;
+      for (const uint32_t id : replaced_) {
+        std::error_code error;
+        if (std::filesystem::exists(
+                Segment::DataName(options_.directory, id), error) ||
+            std::filesystem::exists(
+                Segment::HintName(options_.directory, id), error))
+          replaced.push_back(id);
+      }
+      for (const auto& input : inputs) replaced.push_back(input->Id());
+      Segment::WriteReplaced(options_.directory, replaced);
+      replaced_ = std::move(replaced);
+    }
+  } catch (...) {
+    if (output) outputs.push_back(output);
+    for (auto& segment : outputs) segment->MarkObsolete();
+    throw;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& segment : outputs) segments_[segment->Id()] = segment;
+  for (const auto& move : moves) {
+    auto found = index_.find(move.key);
+    if (found == index_.end() || found->second.segment != move.fromSegment ||
+        found->second.offset != move.fromOffset)
+      continue;
+    found->second.segment = move.toSegment;
+    found->second.offset = move.toOffset;
+    segments_.at(move.toSegment)->liveBytes += found->second.size;
+  }
+  for (const auto& segment : inputs) {
+    segments_.erase(segment->Id());
+    segment->MarkObsolete();
+  }
+}
+
+}  //  namespace s21
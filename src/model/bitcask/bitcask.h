@@ -0,0 +1,156 @@
+// Хранилище Bitcask на диске: записи дописываются в конец сегмента, в памяти
+// хранится только хеш-таблица от ключа к положению последней версии записи
+#ifndef SRC_MODEL_BITCASK_BITCASK_H_
+#define SRC_MODEL_BITCASK_BITCASK_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../abstract_key_value_store/abstract_key_value_store.h"
+#include "../dispatchers/dispatcher_base.h"
+#include "segment.h"
+
+namespace s21 {
+class Bitcask : public AbstractKeyValueStore {
+ public:
+  struct Options {
+    // Каталог создается, если его нет, и сохраняется после закрытия
+    std::string directory = "s21_bitcask";
+    // Размер, после которого активный сегмент закрывается
+    uint64_t segmentBytes = 64 << 20;
+    // Доля устаревших байт закрытых сегментов, после которой они сливаются
+    double mergeRatio = 0.5;
+  };
+
+  Bitcask();
+  // Бросает std::runtime_error с "not open", если каталог не открылся, или с
+  // "Corrupted", если поврежден файл REPLACED или сегмент. Недописанная
+  // последняя запись последнего сегмента отрезается
+  explicit Bitcask(const Options& options);
+  ~Bitcask() override;
+
+  using AbstractKeyValueStore::mset;
+  using AbstractKeyValueStore::set;
+  using AbstractKeyValueStore::update;
+
+  Errors set(const std::string& key, const Value& value,
+             std::chrono::milliseconds ttl) override;
+  std::optional<Value> get(const std::string& key) override;
+  bool exists(const std::string& key) override;
+  Errors del(const std::string& key) override;
+  Errors update(const Key& key, const Value& value,
+                std::chrono::milliseconds ttl, const int paramsMask) override;
+  Errors rename(const std::string& oldKey, const std::string& newKey) override;
+  Errors incrBy(const Key& key, const int field, const int delta,
+                int& result) override;
+  long long PTtl(const std::string& key) override;
+  std::vector<std::optional<Value>> mget(
+      const std::vector<Key>& keys) override;
+  std::vector<Errors> mset(const std::vector<std::pair<Key, Value>>& values,
+                           std::chrono::milliseconds ttl) override;
+  std::vector<Errors> mdel(const std::vector<Key>& keys) override;
+  size_t expireBatch(const std::vector<std::string>& keys) override;
+  std::vector<std::string> expiringWithin(
+      std::chrono::milliseconds window) override;
+  std::vector<size_t> expiryHistogram(std::chrono::milliseconds bucket,
+                                      const size_t bucketsCount) override;
+  size_t bulkInsert(std::vector<std::pair<Key, Value>>& values) override;
+  void forEachEntry(const std::function<void()>& underLock,
+                    const EntryWriter& write) override;
+  // Ключи и положения записей и так лежат в памяти, значения читаются с
+  // диска по одному в порядке ключей
+  void forEachEntryByKey(const EntryWriter& write) override;
+
+  const std::vector<std::string> keys() override;
+  const std::vector<std::string> find(const Value& value, const int ttl,
+                                      const int paramsMask) override;
+  const std::vector<Value> showall() override;
+  const std::vector<AggregateRow> aggregate(
+      const AggregateQuery& query) override;
+
+  // Закрывает активный сегмент и ждет слияния всех закрытых
+  void merge();
+  size_t segmentsCount();
+
+ protected:
+  std::vector<Entry> copyEntries(
+      const std::function<void()>& underLock) override;
+
+ private:
+  struct Location {
+    uint32_t segment;
+    uint32_t size;
+    uint64_t offset;
+    Deadline timeToDel;
+  };
+  // Положения записей для чтения без блокировки: записи в сегментах не
+  // изменяются, а сегменты живут, пока на них есть ссылки
+  struct View {
+    std::vector<std::pair<Key, Location>> entries;
+    std::map<uint32_t, std::shared_ptr<Segment>> segments;
+  };
+
+  Options options_;
+  std::mutex mutex_;
+  // Сообщает фоновому потоку о работе, а ждущим - об ее окончании
+  std::condition_variable changed_;
+  std::unordered_map<Key, Location> index_;
+  // Ключи, значения которых после открытия еще не попали в статистику
+  std::unordered_set<Key> loading_;
+  std::map<uint32_t, std::shared_ptr<Segment>> segments_;
+  std::shared_ptr<Segment> active_;
+  // Закрытые сегменты, которые фоновый поток еще не сбросил на диск
+  std::vector<std::shared_ptr<Segment>> unsynced_;
+  // Сегменты, замененные слияниями после открытия каталога, файлы которых
+  // могли остаться на диске. Изменяются только фоновым потоком
+  std::vector<uint32_t> replaced_;
+  uint32_t nextSegmentId_;
+  uint64_t nextSeq_;
+  uint64_t mergesRequested_;
+  uint64_t mergesDone_;
+  std::atomic<bool> stop_;
+  std::thread worker_;
+  std::shared_ptr<Dispatcher> dispatcher_;
+
+  void load();
+  // Требуют захваченного mutex_
+  // Истекшая запись удаляется при обращении
+  std::optional<Location> findAlive(const Key& key);
+  std::optional<Value> readValue(const Location& location) const;
+  // value == nullptr - отметка об удалении. nullopt, если запись не удалась
+  std::optional<Location> append(const Key& key, const Value* value,
+                                 const Deadline timeToDel);
+  void forget(const Location& location);
+  // Номер записи журнала пишется в lsn
+  Errors setLocked(const Key& key, const Value& value,
+                   const Deadline timeToDel, uint64_t& lsn);
+  Errors delLocked(const Key& key, bool& hasTtl, uint64_t& lsn);
+  // Убирает старое значение ключа из статистики
+  void unaccount(const Key& key, const std::optional<Value>& old);
+  void rollSegment();
+  bool needsMerge() const;
+  // withKeys == false оставляет ключи записей пустыми
+  View takeView(const Deadline at, const bool withKeys = true) const;
+
+  // Вызывает func для записей view в порядке их положения на диске или при
+  // byKey по возрастанию ключей, пока не выставлен stop
+  static void forEach(const View& view,
+                      const std::function<void(const Key&, const Value&,
+                                               const Location&)>& func,
+                      const std::atomic<bool>* stop = nullptr,
+                      const bool byKey = false);
+  void workerLoop();
+  // Статистика полей после открытия каталога заполняется в фоне
+  void loadStatistics();
+  void mergeSegments(const std::vector<std::shared_ptr<Segment>>& inputs);
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_BITCASK_BITCASK_H_
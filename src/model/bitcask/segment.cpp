@@ -0,0 +1,289 @@
+#include "segment.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include "../binary_io.h"
+#include "../durable_file.h"
+#include "../mapped_file.h"
+
+namespace s21 {
+
+namespace {
+constexpr uint8_t TombstoneFlag = 1;
+constexpr size_t RecordHeaderSize = 2 * sizeof(uint32_t);
+}  // namespace
+
+Segment::Segment(const std::string& directory, const uint32_t id)
+    : liveBytes(0),
+      directory_(directory),
+      fileName_(DataName(directory, id)),
+      id_(id),
+      fd_(open(fileName_.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644)),
+      size_(0),
+      obsolete_(false) {
+  struct stat st;
+  if (fd_ < 0 || fstat(fd_, &st) != 0) {
+    if (fd_ >= 0) close(fd_);
+    std::stringstream str;
+    str << "File " << fileName_ << " not open\n";
+    throw std::runtime_error(str.str().c_str());
+  }
+  size_ = static_cast<uint64_t>(st.st_size);
+}
+
+//----------------------------------------------------------------
+Segment::~Segment() {
+  close(fd_);
+  if (obsolete_) {
+    std::remove(fileName_.c_str());
+    std::remove(HintName(directory_, id_).c_str());
+  }
+}
+
+//----------------------------------------------------------------
+std::string Segment::DataName(const std::string& directory,
+                              const uint32_t id) {
+  return directory + "/" + std::to_string(id) + ".data";
+}
+
+//----------------------------------------------------------------
+std::string Segment::HintName(const std::string& directory,
+                              const uint32_t id) {
+  return directory + "/" + std::to_string(id) + ".hint";
+}
+
+//----------------------------------------------------------------
+uint64_t Segment::Append(std::string_view data) {
+  const uint64_t offset = size_.load();
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t res = write(fd_, data.data() + written, data.size() - written);
+    if (res < 0) {
+      // Недописанная запись в закрытом сегменте при открытии каталога
+      // выглядела бы как повреждение
+      if (ftruncate(fd_, static_cast<off_t>(offset)) != 0)
+        throw std::runtime_error("Can not truncate " + fileName_);
+      throw std::runtime_error("Can not write " + fileName_);
+    }
+    written += static_cast<size_t>(res);
+  }
+  size_ = offset + data.size();
+  return offset;
+}
+
+//----------------------------------------------------------------
+BitcaskRecord Segment::Read(const uint64_t offset,
+                            const uint32_t size) const {
+  std::string raw(size, '\0');
+  size_t done = 0;
+  while (done < raw.size()) {
+    ssize_t res = pread(fd_, raw.data() + done, raw.size() - done,
+                        static_cast<off_t>(offset + done));
+    if (res <= 0) throw std::runtime_error("Corrupted segment: short read");
+    done += static_cast<size_t>(res);
+  }
+  BinaryReader reader(raw);
+  const uint32_t payloadSize = reader.Get<uint32_t>();
+  const uint32_t crc = reader.Get<uint32_t>();
+  std::string_view payload = reader.Take(payloadSize);
+  if (Crc32(payload) != crc)
+    throw std::runtime_error("Corrupted segment: checksum mismatch");
+  return Decode(payload);
+}
+
+//----------------------------------------------------------------
+void Segment::Sync() { fdatasync(fd_); }
+
+//----------------------------------------------------------------
+std::string Segment::Encode(const BitcaskRecord& record) {
+  std::string payload;
+  Put<uint64_t>(payload, record.seq);
+  Put<uint8_t>(payload, record.tombstone ? TombstoneFlag : 0);
+  Put<int64_t>(payload, record.expireAt);
+  PutString(payload, record.key);
+  if (!record.tombstone) {
+    PutString(payload, record.value.lastname);
+    PutString(payload, record.value.name);
+    PutString(payload, record.value.city);
+    Put<int32_t>(payload, record.value.year);
+    Put<int32_t>(payload, record.value.coins);
+  }
+  std::string res;
+  res.reserve(RecordHeaderSize + payload.size());
+  Put<uint32_t>(res, static_cast<uint32_t>(payload.size()));
+  Put<uint32_t>(res, Crc32(payload));
+  res += payload;
+  return res;
+}
+
+//----------------------------------------------------------------
+uint64_t Segment::Scan(
+    const std::string& fileName,
+    const std::function<void(const BitcaskRecord& record,
+                             const uint64_t offset, std::string_view raw)>&
+        func,
+    const bool cutTornTail) {
+  uint64_t valid = 0;
+  size_t fileSize = 0;
+  {
+    MappedFile file(fileName);
+    std::string_view data = file.View();
+    fileSize = data.size();
+    while (valid < fileSize) {
+      const uint64_t left = fileSize - valid;
+      std::string_view raw;
+      bool intact = false;
+      if (left >= RecordHeaderSize) {
+        BinaryReader header(data.substr(valid, RecordHeaderSize));
+        const uint32_t payloadSize = header.Get<uint32_t>();
+        const uint32_t crc = header.Get<uint32_t>();
+        if (left - RecordHeaderSize >= payloadSize) {
+          raw = data.substr(valid, RecordHeaderSize + payloadSize);
+          intact = Crc32(raw.substr(RecordHeaderSize)) == crc;
+        }
+      }
+      // Недописанной может быть только последняя запись файла: короткая или
+      // с неверной контрольной суммой и доходящая до конца файла
+      if (!intact) {
+        const bool atEnd = raw.empty() || raw.size() == left;
+        if (!cutTornTail || !atEnd)
+          throw std::runtime_error("Corrupted " + fileName);
+        break;
+      }
+      // Запись с верной контрольной суммой дописана целиком, поэтому ошибка
+      // разбора - повреждение, а не недописанный хвост
+      BitcaskRecord record;
+      try {
+        record = Decode(raw.substr(RecordHeaderSize));
+      } catch (const std::exception&) {
+        throw std::runtime_error("Corrupted " + fileName);
+      }
+      func(record, valid, raw);
+      valid += raw.size();
+    }
+  }
+  if (valid < fileSize && truncate(fileName.c_str(), valid) != 0)
+    throw std::runtime_error("Can not truncate " + fileName);
+  return valid;
+}
+
+//----------------------------------------------------------------
+void Segment::WriteHints(const std::string& fileName,
+                         const std::vector<BitcaskHint>& hints) {
+  std::string data;
+  for (const auto& hint : hints) {
+    PutString(data, hint.key);
+    Put<uint64_t>(data, hint.seq);
+    Put<uint64_t>(data, hint.offset);
+    Put<uint32_t>(data, hint.size);
+    Put<int64_t>(data, hint.expireAt);
+  }
+  Put<uint32_t>(data, Crc32(data));
+  const std::string tmpName = fileName + ".tmp";
+  {
+    std::ofstream fout(tmpName, std::ios::binary | std::ios::trunc);
+    fout.write(data.data(), data.size());
+    if (!fout) {
+      std::remove(tmpName.c_str());
+      throw std::runtime_error("Can not write " + tmpName);
+    }
+  }
+  if (std::rename(tmpName.c_str(), fileName.c_str()) != 0) {
+    std::remove(tmpName.c_str());
+    throw std::runtime_error("Can not write " + fileName);
+  }
+}
+
+//----------------------------------------------------------------
+bool Segment::ReadHints(const std::string& fileName,
+                        std::vector<BitcaskHint>& hints) {
+  std::ifstream fin(fileName, std::ios::binary);
+  if (!fin.is_open()) return false;
+  const std::string data((std::istreambuf_iterator<char>(fin)),
+                         std::istreambuf_iterator<char>());
+  if (data.size() < sizeof(uint32_t)) return false;
+  std::string_view entries(data.data(), data.size() - sizeof(uint32_t));
+  BinaryReader footer(std::string_view(data).substr(entries.size()));
+  if (Crc32(entries) != footer.Get<uint32_t>()) return false;
+  try {
+    BinaryReader reader(entries);
+    while (!reader.AtEnd()) {
+      BitcaskHint hint;
+      hint.key = reader.GetString();
+      hint.seq = reader.Get<uint64_t>();
+      hint.offset = reader.Get<uint64_t>();
+      hint.size = reader.Get<uint32_t>();
+      hint.expireAt = reader.Get<int64_t>();
+      hints.push_back(std::move(hint));
+    }
+  } catch (const std::exception&) {
+    hints.clear();
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------
+std::string Segment::ReplacedName(const std::string& directory) {
+  return directory + "/REPLACED";
+}
+
+//----------------------------------------------------------------
+void Segment::WriteReplaced(const std::string& directory,
+                            const std::vector<uint32_t>& ids) {
+  std::string data;
+  for (const uint32_t id : ids) Put<uint32_t>(data, id);
+  Put<uint32_t>(data, Crc32(data));
+  const std::string fileName = ReplacedName(directory);
+  if (!ReplaceFileDurably(fileName, data))
+    throw std::runtime_error("Can not write " + fileName);
+}
+
+//----------------------------------------------------------------
+bool Segment::ReadReplaced(const std::string& directory,
+                           std::vector<uint32_t>& ids) {
+  std::ifstream fin(ReplacedName(directory), std::ios::binary);
+  if (!fin.is_open()) return true;
+  const std::string data((std::istreambuf_iterator<char>(fin)),
+                         std::istreambuf_iterator<char>());
+  if (data.size() < sizeof(uint32_t) ||
+      (data.size() - sizeof(uint32_t)) % sizeof(uint32_t) != 0)
+    return false;
+  std::string_view entries(data.data(), data.size() - sizeof(uint32_t));
+  BinaryReader footer(std::string_view(data).substr(entries.size()));
+  if (Crc32(entries) != footer.Get<uint32_t>()) return false;
+  BinaryReader reader(entries);
+  while (!reader.AtEnd()) ids.push_back(reader.Get<uint32_t>());
+  return true;
+}
+
+//----------------------------------------------------------------
+BitcaskRecord Segment::Decode(std::string_view payload) {
+  BinaryReader reader(payload);
+  BitcaskRecord record;
+  record.seq = reader.Get<uint64_t>();
+  record.tombstone = reader.Get<uint8_t>() & TombstoneFlag;
+  record.expireAt = reader.Get<int64_t>();
+  record.key = reader.GetString();
+  record.value = Value{};
+  if (!record.tombstone) {
+    record.value.lastname = reader.GetString();
+    record.value.name = reader.GetString();
+    record.value.city = reader.GetString();
+    record.value.year = reader.Get<int32_t>();
+    record.value.coins = reader.Get<int32_t>();
+  }
+  if (!reader.AtEnd())
+    throw std::runtime_error("Corrupted segment: record size mismatch");
+  return record;
+}
+
+}  //  namespace s21
@@ -0,0 +1,115 @@
+// Файл сегмента хранилища Bitcask. Записи только дописываются в конец:
+//   размер данных (u32), CRC32 данных (u32), данные
+//   данные:  номер записи (u64), флаги (u8), время удаления (i64,
+//            миллисекунды системных часов, 0 - без него), ключ, у живой
+//            записи дальше фамилия, имя, город, год и число коинов
+// Файл подсказок N.hint рядом с сегментом N.data перечисляет его записи без
+// значений, чтобы при запуске не читать сегмент целиком:
+//   записи:  ключ, номер записи (u64), смещение (u64), размер (u32), время
+//            удаления (i64)
+//   конец:   CRC32 всех записей (u32)
+// Файл REPLACED перечисляет сегменты, замененные слиянием, чьи файлы еще
+// могут оставаться в каталоге:
+//   записи:  номер сегмента (u32)
+//   конец:   CRC32 всех записей (u32)
+// Строки записываются длиной (u32) и байтами
+#ifndef SRC_MODEL_BITCASK_SEGMENT_H_
+#define SRC_MODEL_BITCASK_SEGMENT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../../types.h"
+
+namespace s21 {
+
+struct BitcaskRecord {
+  uint64_t seq;
+  bool tombstone;
+  int64_t expireAt;
+  Key key;
+  Value value;
+};
+
+struct BitcaskHint {
+  Key key;
+  uint64_t seq;
+  uint64_t offset;
+  uint32_t size;
+  int64_t expireAt;
+};
+
+class Segment {
+ public:
+  // Открывает файл на дописывание, создает его при необходимости. Бросает
+  // std::runtime_error с "not open", если файл не удалось открыть
+  Segment(const std::string& directory, const uint32_t id);
+  // Файл удаляется, если сегмент заменило слияние
+  ~Segment();
+
+  Segment(const Segment&) = delete;
+  Segment& operator=(const Segment&) = delete;
+
+  static std::string DataName(const std::string& directory, const uint32_t id);
+  static std::string HintName(const std::string& directory, const uint32_t id);
+
+  uint32_t Id() const { return id_; }
+  uint64_t Size() const { return size_.load(); }
+  // Вызывается под блокировкой хранилища. Возвращает смещение записи.
+  // Бросает std::runtime_error, если запись не удалась: недописанная запись
+  // отрезается, если это удается, и дописывать в сегмент больше нельзя
+  uint64_t Append(std::string_view data);
+  // Бросает std::runtime_error с "Corrupted", если запись повреждена
+  BitcaskRecord Read(const uint64_t offset, const uint32_t size) const;
+  void Sync();
+  void MarkObsolete() { obsolete_ = true; }
+
+  // Живые байты сегмента, изменяются под блокировкой хранилища
+  uint64_t liveBytes;
+
+  static std::string Encode(const BitcaskRecord& record);
+  // Вызывает func для каждой целой записи файла по порядку и возвращает
+  // длину целой части. При cutTornTail последняя запись файла, короткая или
+  // с неверной контрольной суммой, считается недописанной и отрезается.
+  // Иначе, как и для поврежденной записи не в конце файла, бросает
+  // std::runtime_error с "Corrupted" и не изменяет файл
+  static uint64_t Scan(
+      const std::string& fileName,
+      const std::function<void(const BitcaskRecord& record,
+                               const uint64_t offset,
+                               std::string_view raw)>& func,
+      const bool cutTornTail = false);
+  // Файл пишется во временный и переименовывается
+  static void WriteHints(const std::string& fileName,
+                         const std::vector<BitcaskHint>& hints);
+  // false, если файла нет или он поврежден
+  static bool ReadHints(const std::string& fileName,
+                        std::vector<BitcaskHint>& hints);
+  static std::string ReplacedName(const std::string& directory);
+  // Файл пишется во временный, сбрасывается на диск и переименовывается.
+  // После возврата на диске и файл, и созданные до него файлы каталога.
+  // Бросает std::runtime_error, если запись не удалась
+  static void WriteReplaced(const std::string& directory,
+                            const std::vector<uint32_t>& ids);
+  // Пустой список, если файла нет. false, если файл поврежден
+  static bool ReadReplaced(const std::string& directory,
+                           std::vector<uint32_t>& ids);
+
+ private:
+  std::string directory_;
+  std::string fileName_;
+  uint32_t id_;
+  int fd_;
+  std::atomic<uint64_t> size_;
+  std::atomic<bool> obsolete_;
+
+  static BitcaskRecord Decode(std::string_view payload);
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_BITCASK_SEGMENT_H_
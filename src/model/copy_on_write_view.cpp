@@ -0,0 +1,53 @@
+#include "copy_on_write_view.h"
+
+#include <functional>
+
+namespace s21 {
+
+void CopyOnWriteView::Begin() {
+  active_ = true;
+  at_ = Clock::now();
+  count_ = 0;
+  preserved_.assign(ShardsCount, {});
+}
+//----------------------------------------------------------------
+void CopyOnWriteView::Preserve(const Key& key, const Value* value,
+                               const Deadline timeToDel) {
+  if (!active_) return;
+  auto& shard = ShardOf(key);
+  if (shard.count(key)) return;
+  if (value)
+    shard.emplace(key, Entry{key, *value, timeToDel});
+  else
+    shard.emplace(key, std::nullopt);
+  ++count_;
+}
+//----------------------------------------------------------------
+bool CopyOnWriteView::Preserved(const Key& key) const {
+  if (count_ == 0) return false;
+  return preserved_[std::hash<Key>()(key) % ShardsCount].count(key);
+}
+//----------------------------------------------------------------
+CopyOnWriteView::PreservedEntries CopyOnWriteView::Finish() {
+  active_ = false;
+  count_ = 0;
+  PreservedEntries res;
+  res.swap(preserved_);
+  return res;
+}
+//----------------------------------------------------------------
+void CopyOnWriteView::ForEachAlive(const PreservedEntries& preserved,
+                                   const Deadline at,
+                                   const EntryWriter& write) {
+  for (const auto& shard : preserved)
+    for (const auto& item : shard)
+      if (item.second && item.second->timeToDel > at)
+        write(item.second->key, item.second->value, item.second->timeToDel);
+}
+//----------------------------------------------------------------
+std::unordered_map<Key, std::optional<Entry>>& CopyOnWriteView::ShardOf(
+    const Key& key) {
+  return preserved_[std::hash<Key>()(key) % ShardsCount];
+}
+
+}  //  namespace s21
@@ -0,0 +1,52 @@
+// Состояние хранилища на момент начала обхода. Обход блокирует хранилище
+// короткими отрезками, а изменения между ними не ждут его окончания: перед
+// изменением ключа, до которого обход еще не дошел, движок сохраняет прежнюю
+// запись. Такие ключи обход пропускает и берет из сохраненных записей.
+// Методы, кроме ForEachAlive, вызываются под блокировкой хранилища
+#ifndef SRC_MODEL_COPY_ON_WRITE_VIEW_H_
+#define SRC_MODEL_COPY_ON_WRITE_VIEW_H_
+
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "../types.h"
+
+namespace s21 {
+
+class CopyOnWriteView {
+ public:
+  // Сохраненные записи разбиты на части, чтобы рост таблицы под
+  // блокировкой хранилища перестраивал только одну небольшую часть
+  using PreservedEntries =
+      std::vector<std::unordered_map<Key, std::optional<Entry>>>;
+
+  bool Active() const { return active_; }
+  // Момент, на который снимается состояние
+  Deadline At() const { return at_; }
+
+  void Begin();
+  // Сохраняет запись ключа до первого изменения после Begin. value ==
+  // nullptr, если ключа не было
+  void Preserve(const Key& key, const Value* value, const Deadline timeToDel);
+  bool Preserved(const Key& key) const;
+  // Завершает обход и забирает сохраненные записи
+  PreservedEntries Finish();
+  // Вызывает write для сохраненных записей, живых на момент at
+  static void ForEachAlive(const PreservedEntries& preserved,
+                           const Deadline at, const EntryWriter& write);
+
+ private:
+  static constexpr size_t ShardsCount = 64;
+
+  bool active_ = false;
+  Deadline at_;
+  size_t count_ = 0;
+  PreservedEntries preserved_;
+
+  std::unordered_map<Key, std::optional<Entry>>& ShardOf(const Key& key);
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_COPY_ON_WRITE_VIEW_H_
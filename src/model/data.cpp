@@ -1,118 +1,215 @@
 #include "data.h"
 
+#include <algorithm>
+#include <charconv>
+#include <exception>
 #include <fstream>
-#include <iostream>
-#include <sstream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+#include "mapped_file.h"
+#include "snapshot.h"
 
 namespace s21 {
 
+namespace {
+// Файлы меньше этого размера на один поток разбираются без разделения
+constexpr size_t MinChunkSize = 1 << 20;
+}  // namespace
+
 std::vector<std::pair<Key, Value>> Data::loadData(const std::string& fileName) {
-  std::ifstream fin(fileName);
+  MappedFile file(fileName);
+  std::string_view text = file.View();
+  if (!Snapshot::IsSnapshot(text)) {
+    return parseText(text);
+  }
   std::vector<std::pair<Key, Value>> res;
-  if (!fin.is_open()) {
-    std::stringstream str;
-    str << "File " << fileName << " not open\n";
-    throw std::runtime_error(str.str().c_str());
+  std::vector<Entry> entries = Snapshot::load(text);
+  res.reserve(entries.size());
+  for (auto& entry : entries)
+    res.emplace_back(std::move(entry.key), std::move(entry.value));
+  return res;
+}
+
+std::vector<Entry> Data::loadEntries(const std::string& fileName) {
+  MappedFile file(fileName);
+  std::string_view text = file.View();
+  if (Snapshot::IsSnapshot(text)) {
+    return Snapshot::load(text);
   }
-  std::string currentStr;
-  std::pair<Key, Value> parsedStr;
-  while (!fin.eof()) {
-    std::getline(fin, currentStr);
-    if (!currentStr.size()) {
-      continue;
+  std::vector<Entry> res;
+  std::vector<std::pair<Key, Value>> values = parseText(text);
+  res.reserve(values.size());
+  for (auto& row : values)
+    res.push_back({std::move(row.first), std::move(row.second), NoDeadline});
+  return res;
+}
+
+std::vector<std::pair<Key, Value>> Data::parseText(std::string_view text) {
+  const size_t threadsCount = std::max<size_t>(
+      1, std::min<size_t>(std::thread::hardware_concurrency(),
+                          text.size() / MinChunkSize));
+  std::vector<std::string_view> chunks = splitIntoChunks(text, threadsCount);
+
+  // Фрагменты разбираются параллельно, ошибка запоминается для каждого
+  // фрагмента отдельно и сообщается по первому из них
+  std::vector<std::vector<std::pair<Key, Value>>> parsed(chunks.size());
+  std::vector<size_t> linesCount(chunks.size(), 0);
+  std::vector<std::exception_ptr> errors(chunks.size());
+  auto parse = [&](size_t i) {
+    try {
+      parseChunk(chunks[i], parsed[i], linesCount[i]);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < chunks.size(); ++i) workers.emplace_back(parse, i);
+  if (!chunks.empty()) parse(0);
+  for (auto& worker : workers) worker.join();
+
+  size_t linesBefore = 0;
+  size_t total = 0;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    if (errors[i]) {
+      try {
+        std::rethrow_exception(errors[i]);
+      } catch (const CorruptedFileError& e) {
+        throw CorruptedFileError(linesBefore + e.Line());
+      }
     }
-    parsedStr = parseOneStr(currentStr);
-    res.push_back(parsedStr);
+    linesBefore += linesCount[i];
+    total += parsed[i].size();
+  }
+  std::vector<std::pair<Key, Value>> res;
+  res.reserve(total);
+  for (auto& chunk : parsed)
+    std::move(chunk.begin(), chunk.end(), std::back_inserter(res));
+  return res;
+}
+
+std::vector<std::string_view> Data::splitIntoChunks(std::string_view text,
+                                                    size_t chunksCount) {
+  std::vector<std::string_view> res;
+  const size_t chunkSize = text.size() / chunksCount + 1;
+  while (!text.empty()) {
+    size_t end = text.size() <= chunkSize ? std::string_view::npos
+                                          : text.find('\n', chunkSize);
+    end = end == std::string_view::npos ? text.size() : end + 1;
+    res.push_back(text.substr(0, end));
+    text.remove_prefix(end);
   }
-  fin.close();
   return res;
 }
 
+void Data::parseChunk(std::string_view text,
+                      std::vector<std::pair<Key, Value>>& res,
+                      size_t& linesCount) {
+  linesCount = 0;
+  while (!text.empty()) {
+    size_t end = text.find('\n');
+    std::string_view currentStr = text.substr(0, end);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    ++linesCount;
+    if (currentStr.empty()) {
+      continue;
+    }
+    try {
+      res.push_back(parseOneStr(currentStr));
+    } catch (const std::runtime_error&) {
+      throw CorruptedFileError(linesCount);
+    }
+  }
+}
+
 int Data::saveData(const std::string& fileName,
-                   const std::vector<std::pair<Key, Value>>& values) {
+                   const std::vector<std::pair<Key, Value>>& values,
+                   const FileFormat format) {
+  return saveData(fileName, SourceOf(values), format);
+}
+
+int Data::saveData(const std::string& fileName, const EntrySource& source,
+                   const FileFormat format) {
+  if (format == binaryFormat) {
+    return Snapshot::save(fileName, source);
+  }
   std::ofstream fout(fileName);
   if (!fout.is_open()) {
     return canNotOpenFile;
   }
   int res = 0;
-  for (size_t i = 0; i < values.size(); ++i) {
-    fout << values[i].first << " \"" << values[i].second.lastname << "\" \""
-         << values[i].second.name << "\" " << values[i].second.year << " \""
-         << values[i].second.city << "\" " << values[i].second.coins << "\n";
+  source([&fout, &res](const Key& key, const Value& value, const Deadline) {
+    fout << key << " \"" << value.lastname << "\" \"" << value.name << "\" "
+         << value.year << " \"" << value.city << "\" " << value.coins << "\n";
     ++res;
-  }
+  });
   fout.close();
   return res;
 }
 
-std::pair<Key, Value> Data::parseOneStr(std::string& str) {
-  // std::cout << "parse " << str << "\n";
-  const int requiredCount = 6;
+std::pair<Key, Value> Data::parseOneStr(std::string_view str) {
   std::pair<Key, Value> res;
-  std::vector<std::string> elems = tokenizer(str, ' ');
-  if (elems.size() < requiredCount) {
-    throw std::runtime_error("Corrupted file 1");
-  }
-  // std::cout << "tokens\n";
-  // for (size_t i = 0; i < elems.size(); ++i) {
-  //     std::cout << elems[i] << "\n";
-  // }
-  // std::cout << "erase\n";
-  res.first = eraseOneWord(elems);
-  // std::cout <<
-  res.second.lastname = eraseOneWord(elems);
-  res.second.name = eraseOneWord(elems);
-  res.second.year = std::stoi(eraseOneWord(elems));
-  res.second.city = eraseOneWord(elems);
-  res.second.coins = std::stoi(eraseOneWord(elems));
-
+  size_t pos = 0;
+  res.first = unquote(nextField(str, pos));
+  res.second.lastname = unquote(nextField(str, pos));
+  res.second.name = unquote(nextField(str, pos));
+  res.second.year = parseInt(nextField(str, pos));
+  res.second.city = unquote(nextField(str, pos));
+  res.second.coins = parseInt(nextField(str, pos));
   return res;
 }
 
-std::vector<std::string> Data::tokenizer(std::string& str, char token) {
-  std::vector<std::string> elems;
-  std::string::size_type beg = 0;
-  for (std::string::size_type end = 0;
-       (end = str.find(token, end)) != std::string::npos; ++end) {
-    elems.push_back(str.substr(beg, end - beg));
-    beg = end + 1;
-    while (beg < str.size() && str[beg] == ' ') {
-      ++beg;
+// Поле - слово до пробела или, если оно начинается с кавычки, несколько слов
+// до слова с закрывающей кавычкой
+std::string_view Data::nextField(std::string_view str, size_t& pos) {
+  auto nextWord = [&](size_t& begin) {
+    while (pos < str.size() && str[pos] == ' ') {
+      ++pos;
     }
-    if (beg >= str.size()) {
-      std::runtime_error("Corrupted file 2");
+    begin = pos;
+    while (pos < str.size() && str[pos] != ' ') {
+      ++pos;
     }
-    end = beg - 1;
+    return str.substr(begin, pos - begin);
+  };
+  size_t begin = 0;
+  std::string_view word = nextWord(begin);
+  if (word.empty()) {
+    throw std::runtime_error("Corrupted file 1");
   }
-  if (str.substr(beg) != "") {
-    elems.push_back(str.substr(beg));
+  if (word.front() == '"' && (word.back() != '"' || word.size() == 1)) {
+    size_t wordBegin = 0;
+    do {
+      word = nextWord(wordBegin);
+      if (word.empty()) {
+        throw std::runtime_error("Corrupted file 4");
+      }
+    } while (word.find('"') == std::string_view::npos);
   }
-  return elems;
+  return str.substr(begin, pos - begin);
 }
 
-std::string Data::eraseOneWord(std::vector<std::string>& elems) {
-  if (!elems.size()) {
-    throw std::runtime_error("Corrupted file 3");
-  }
+// Удаляет кавычки, слова внутри кавычек разделяются одним пробелом
+std::string Data::unquote(std::string_view field) {
   std::string res;
-  res = elems.front();
-  elems.erase(elems.begin());
-  if (res.front() == '"' && (res.back() != '"' || res.size() == 1)) {
-    while (elems.size() &&
-           elems.front().find_first_of('"') == std::string::npos) {
-      res += " " + elems.front();
-      elems.erase(elems.begin());
-    }
-    if (elems.size()) {
-      res += " " + elems.front();
-      elems.erase(elems.begin());
-    } else {
-      throw std::runtime_error("Corrupted file 4");
+  res.reserve(field.size());
+  for (size_t i = 0; i < field.size(); ++i) {
+    if (field[i] == '"' ||
+        (i > 0 && field[i] == ' ' && field[i - 1] == ' ')) {
+      continue;
     }
+    res.push_back(field[i]);
   }
-  for (size_t i = res.find_first_of('"'); i != std::string::npos;
-       i = res.find_first_of('"')) {
-    res.erase(i, 1);
+  return res;
+}
+
+int Data::parseInt(std::string_view field) {
+  int res = 0;
+  auto [ptr, ec] = std::from_chars(field.data(), field.data() + field.size(),
+                                   res);
+  if (ec != std::errc() || ptr == field.data()) {
+    throw std::runtime_error("Corrupted file 5");
   }
   return res;
 }
@@ -1,25 +1,58 @@
 #ifndef SRC_MODEL_DATA_H_
 #define SRC_MODEL_DATA_H_
 
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "../types.h"
 
 namespace s21 {
+// Ошибка разбора файла с номером строки, в которой она найдена
+class CorruptedFileError : public std::runtime_error {
+ public:
+  explicit CorruptedFileError(const size_t line)
+      : std::runtime_error("Corrupted file: line " + std::to_string(line)),
+        line_(line) {}
+
+  size_t Line() const { return line_; }
+
+ private:
+  size_t line_;
+};
+
 class Data {
  public:
   Data() = default;
 
+  // Формат загружаемого файла определяется по его заголовку. Время удаления
+  // записей двоичного снимка отбрасывается
   static std::vector<std::pair<Key, Value>> loadData(
       const std::string& fileName);
+  // То же вместе с временем удаления, у записей текстового файла его нет
+  static std::vector<Entry> loadEntries(const std::string& fileName);
   static int saveData(const std::string& fileName,
-                      const std::vector<std::pair<Key, Value>>& values);
+                      const std::vector<std::pair<Key, Value>>& values,
+                      const FileFormat format = textFormat);
+  // Записи пишутся в файл по мере обхода source
+  static int saveData(const std::string& fileName, const EntrySource& source,
+                      const FileFormat format = textFormat);
 
  private:
-  static std::pair<Key, Value> parseOneStr(std::string& str);
-  static std::vector<std::string> tokenizer(std::string& str, char token);
-  static std::string eraseOneWord(std::vector<std::string>& elems);
+  static std::vector<std::pair<Key, Value>> parseText(std::string_view text);
+  // Разбирает строки фрагмента text. При ошибке бросает CorruptedFileError с
+  // номером строки внутри фрагмента, linesCount - число разобранных строк
+  static void parseChunk(std::string_view text,
+                         std::vector<std::pair<Key, Value>>& res,
+                         size_t& linesCount);
+  static std::vector<std::string_view> splitIntoChunks(std::string_view text,
+                                                       size_t chunksCount);
+  // Строки разбираются на месте, память выделяется только под итоговые поля
+  static std::pair<Key, Value> parseOneStr(std::string_view str);
+  static std::string_view nextField(std::string_view str, size_t& pos);
+  static std::string unquote(std::string_view field);
+  static int parseInt(std::string_view field);
 };
 
 }  //  namespace s21
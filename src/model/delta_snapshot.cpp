@@ -0,0 +1,289 @@
+#include "delta_snapshot.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+#include "binary_io.h"
+#include "data.h"
+#include "durable_file.h"
+#include "mapped_file.h"
+#include "snapshot.h"
+
+namespace s21 {
+
+namespace {
+constexpr char HeaderMagic[8] = {'S', '2', '1', 'D', 'E', 'L', 'T', '\0'};
+constexpr char FooterMagic[8] = {'S', '2', '1', 'D', 'E', 'N', 'D', '\0'};
+constexpr size_t HeaderSize = 20;
+// Заголовок полного снимка, в конце которого номер цепочки
+constexpr size_t BaseHeaderSize = 16;
+constexpr size_t FooterSize = 16;
+constexpr size_t RecordHeaderSize = 8;
+
+bool FileExists(const std::string& fileName) {
+  return access(fileName.c_str(), F_OK) == 0;
+}
+
+// Начало файла длиной до size байт
+std::string ReadPrefix(const std::string& fileName, const size_t size) {
+  std::ifstream fin(fileName, std::ios::binary);
+  std::string res(size, '\0');
+  fin.read(res.data(), size);
+  res.resize(static_cast<size_t>(std::max<std::streamsize>(fin.gcount(), 0)));
+  return res;
+}
+
+void PutRecord(std::string& out, const std::string& payload) {
+  Put<uint32_t>(out, static_cast<uint32_t>(payload.size()));
+  Put<uint32_t>(out, Crc32(payload));
+  out.append(payload);
+}
+}  // namespace
+
+std::string DeltaSnapshot::DeltaName(const std::string& fileName,
+                                     const size_t index) {
+  return fileName + ".delta" + std::to_string(index);
+}
+//----------------------------------------------------------------
+size_t DeltaSnapshot::ChainLength(const std::string& fileName) {
+  const uint32_t chainId = baseChainId(fileName).value_or(0);
+  size_t length = 0;
+  while (deltaChainId(DeltaName(fileName, length + 1)) == chainId) ++length;
+  return length;
+}
+//----------------------------------------------------------------
+std::optional<uint32_t> DeltaSnapshot::baseChainId(
+    const std::string& fileName) {
+  if (!FileExists(fileName)) return std::nullopt;
+  return Snapshot::ChainId(ReadPrefix(fileName, BaseHeaderSize));
+}
+//----------------------------------------------------------------
+std::optional<uint32_t> DeltaSnapshot::deltaChainId(
+    const std::string& fileName) {
+  const std::string header = ReadPrefix(fileName, HeaderSize);
+  if (header.size() < HeaderSize ||
+      std::memcmp(header.data(), HeaderMagic, sizeof(HeaderMagic)) != 0)
+    return std::nullopt;
+  // Версию проверяет apply, поэтому дельта цепочки с другой версией
+  // считается поврежденной, а не оставшейся от прошлой цепочки
+  BinaryReader reader(std::string_view(header).substr(sizeof(HeaderMagic)));
+  reader.Get<uint32_t>();
+  reader.Get<uint32_t>();
+  return reader.Get<uint32_t>();
+}
+//----------------------------------------------------------------
+uint32_t DeltaSnapshot::newChainId(const std::optional<uint32_t> previous) {
+  // 0 занят файлами без номера цепочки
+  std::random_device device;
+  uint32_t res = 0;
+  while (res == 0 || res == previous) res = device();
+  return res;
+}
+//----------------------------------------------------------------
+int DeltaSnapshot::save(const std::string& fileName, const size_t index,
+                        const std::vector<Entry>& upserts,
+                        const std::vector<Key>& deletes) {
+  const std::optional<uint32_t> chainId = baseChainId(fileName);
+  if (!chainId) return canNotOpenFile;
+  std::string data(HeaderMagic, sizeof(HeaderMagic));
+  Put<uint32_t>(data, Version);
+  Put<uint32_t>(data, static_cast<uint32_t>(index));
+  Put<uint32_t>(data, *chainId);
+  std::string payload;
+  for (const auto& [key, value, timeToDel] : upserts) {
+    payload.clear();
+    Put<uint8_t>(payload, deltaUpsert);
+    PutString(payload, key);
+    PutString(payload, value.lastname);
+    PutString(payload, value.name);
+    PutString(payload, value.city);
+    Put<int32_t>(payload, value.year);
+    Put<int32_t>(payload, value.coins);
+    Put<int64_t>(payload, ToWallClock(timeToDel));
+    PutRecord(data, payload);
+  }
+  for (const auto& key : deletes) {
+    payload.clear();
+    Put<uint8_t>(payload, deltaDelete);
+    PutString(payload, key);
+    PutRecord(data, payload);
+  }
+  data.append(FooterMagic, sizeof(FooterMagic));
+  Put<uint64_t>(data, upserts.size() + deletes.size());
+  // Контрольная точка считается сделанной, только когда дельта на диске
+  if (!ReplaceFileDurably(DeltaName(fileName, index), data))
+    return canNotOpenFile;
+  return static_cast<int>(upserts.size() + deletes.size());
+}
+//----------------------------------------------------------------
+void DeltaSnapshot::apply(
+    std::string_view data, const size_t index, const uint32_t chainId,
+    std::unordered_map<Key, std::optional<Entry>>& changes) {
+  if (data.size() < HeaderSize + FooterSize ||
+      std::memcmp(data.data(), HeaderMagic, sizeof(HeaderMagic)) != 0)
+    throw std::runtime_error("Corrupted delta: bad header");
+  BinaryReader header(data.substr(sizeof(HeaderMagic)));
+  if (header.Get<uint32_t>() != Version)
+    throw std::runtime_error("Corrupted delta: unsupported version");
+  if (header.Get<uint32_t>() != index)
+    throw std::runtime_error("Corrupted delta: wrong position in chain");
+  if (header.Get<uint32_t>() != chainId)
+    throw std::runtime_error("Corrupted delta: wrong chain");
+  std::string_view footer = data.substr(data.size() - FooterSize);
+  if (std::memcmp(footer.data(), FooterMagic, sizeof(FooterMagic)) != 0)
+    throw std::runtime_error("Corrupted delta: bad footer");
+  const uint64_t recordsTotal =
+      BinaryReader(footer.substr(sizeof(FooterMagic))).Get<uint64_t>();
+
+  BinaryReader records(
+      data.substr(HeaderSize, data.size() - HeaderSize - FooterSize));
+  uint64_t recordsCount = 0;
+  while (!records.AtEnd()) {
+    BinaryReader recordHeader(records.Take(RecordHeaderSize));
+    const uint32_t size = recordHeader.Get<uint32_t>();
+    const uint32_t crc = recordHeader.Get<uint32_t>();
+    std::string_view payload = records.Take(size);
+    if (Crc32(payload) != crc)
+      throw std::runtime_error("Corrupted delta: record checksum mismatch");
+    BinaryReader record(payload);
+    const uint8_t operation = record.Get<uint8_t>();
+    Key key = record.GetString();
+    if (operation == deltaDelete) {
+      changes[std::move(key)] = std::nullopt;
+    } else if (operation == deltaUpsert) {
+      Entry entry;
+      entry.key = key;
+      entry.value.lastname = record.GetString();
+      entry.value.name = record.GetString();
+      entry.value.city = record.GetString();
+      entry.value.year = record.Get<int32_t>();
+      entry.value.coins = record.Get<int32_t>();
+      entry.timeToDel = FromWallClock(record.Get<int64_t>());
+      changes[std::move(key)] = std::move(entry);
+    } else {
+      throw std::runtime_error("Corrupted delta: unknown operation");
+    }
+    ++recordsCount;
+  }
+  if (recordsCount != recordsTotal)
+    throw std::runtime_error("Corrupted delta: records count mismatch");
+}
+//----------------------------------------------------------------
+std::vector<Entry> DeltaSnapshot::loadChain(const std::string& fileName) {
+  std::vector<Entry> base = Data::loadEntries(fileName);
+  const size_t length = ChainLength(fileName);
+  if (length == 0) return base;
+  const uint32_t chainId = baseChainId(fileName).value_or(0);
+  // Дельты обычно намного меньше снимка, поэтому сначала собираются их
+  // изменения, а снимок проходится один раз
+  std::unordered_map<Key, std::optional<Entry>> changes;
+  for (size_t index = 1; index <= length; ++index) {
+    MappedFile file(DeltaName(fileName, index));
+    apply(file.View(), index, chainId, changes);
+  }
+  std::vector<Entry> res;
+  res.reserve(base.size());
+  for (auto& entry : base) {
+    auto change = changes.find(entry.key);
+    if (change == changes.end()) {
+      res.push_back(std::move(entry));
+    } else {
+      if (change->second) res.push_back(std::move(*change->second));
+      changes.erase(change);
+    }
+  }
+  for (auto& change : changes)
+    if (change.second) res.push_back(std::move(*change.second));
+  return res;
+}
+//----------------------------------------------------------------
+int DeltaSnapshot::compact(const std::string& fileName) {
+  std::vector<Entry> entries;
+  try {
+    entries = loadChain(fileName);
+  } catch (const std::exception& e) {
+    if (std::strstr(e.what(), "not open")) return canNotOpenFile;
+    return corruptedFile;
+  }
+  // Истекшие записи в новый снимок не переносятся
+  const Deadline now = Clock::now();
+  entries.erase(std::remove_if(entries.begin(), entries.end(),
+                               [now](const Entry& entry) {
+                                 return entry.timeToDel <= now;
+                               }),
+                entries.end());
+  int res = saveBase(fileName, SourceOf(entries));
+  if (res < 0) return res;
+  // Снимок уже содержит дельты, а оставшиеся после сбоя дельты относятся к
+  // прошлой цепочке и не применяются
+  removeDeltas(fileName);
+  return res;
+}
+//----------------------------------------------------------------
+void DeltaSnapshot::removeDeltas(const std::string& fileName) {
+  // Удаляются и дельты прошлых цепочек. Удаление с конца, чтобы после сбоя
+  // осталось начало цепочки
+  size_t length = 0;
+  while (FileExists(DeltaName(fileName, length + 1))) ++length;
+  for (size_t index = length; index > 0; --index)
+    std::remove(DeltaName(fileName, index).c_str());
+}
+//----------------------------------------------------------------
+int DeltaSnapshot::saveBase(const std::string& fileName,
+                            const std::vector<std::pair<Key, Value>>& values) {
+  return saveBase(fileName, SourceOf(values));
+}
+//----------------------------------------------------------------
+int DeltaSnapshot::saveBase(const std::string& fileName,
+                            const EntrySource& source) {
+  const std::string tmpName = fileName + ".tmp";
+  int res =
+      Snapshot::save(tmpName, source, true, newChainId(baseChainId(fileName)));
+  if (res < 0) {
+    std::remove(tmpName.c_str());
+    return res;
+  }
+  // Дельты удаляются сразу после записи снимка, поэтому он должен быть на
+  // диске под своим именем раньше, чем они пропадут
+  if (!SyncFile(tmpName) || !SyncDirectory(DirectoryOf(fileName)) ||
+      std::rename(tmpName.c_str(), fileName.c_str()) != 0) {
+    std::remove(tmpName.c_str());
+    return canNotOpenFile;
+  }
+  if (!SyncDirectory(DirectoryOf(fileName))) return canNotOpenFile;
+  return res;
+}
+//----------------------------------------------------------------
+void DirtyKeys::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  keys_.clear();
+  tracking_ = true;
+}
+//----------------------------------------------------------------
+void DirtyKeys::Stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tracking_ = false;
+  keys_.clear();
+}
+//----------------------------------------------------------------
+void DirtyKeys::Mark(const Key& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (tracking_) keys_.insert(key);
+}
+//----------------------------------------------------------------
+std::vector<Key> DirtyKeys::Take() {
+  std::unordered_set<Key> keys;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    keys.swap(keys_);
+  }
+  return std::vector<Key>(keys.begin(), keys.end());
+}
+
+}  //  namespace s21
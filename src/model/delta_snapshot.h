@@ -0,0 +1,96 @@
+// Цепочка снимков: полный двоичный снимок fileName и дельты fileName.delta1,
+// fileName.delta2... с записями, измененными после предыдущего снимка цепочки.
+// Дельта состоит из заголовка, записей и окончания:
+//   заголовок: "S21DELT" '\0', версия (u32), номер дельты (u32), номер
+//              цепочки (u32)
+//   запись:    размер данных (u32), CRC32 данных (u32), данные: операция (u8),
+//              ключ, для deltaUpsert фамилия, имя, город - длина (u32) и
+//              байты, год и число коинов - i32, время удаления - мс от эпохи
+//              (i64), 0 без времени жизни
+//   окончание: "S21DEND" '\0', число записей (u64)
+// Файлы цепочки пишутся во временный файл и переименовываются, поэтому
+// недописанная дельта в цепочку не попадает. Каждый полный снимок начинает
+// цепочку с новым номером, который записывается в его заголовок и в
+// заголовки его дельт. Дельты с другим номером остались от прошлой цепочки и
+// не применяются, поэтому старые дельты удаляются только после записи нового
+// снимка
+#ifndef SRC_MODEL_DELTA_SNAPSHOT_H_
+#define SRC_MODEL_DELTA_SNAPSHOT_H_
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../types.h"
+
+namespace s21 {
+
+class DeltaSnapshot {
+ public:
+  static constexpr uint32_t Version = 1;
+
+  static std::string DeltaName(const std::string& fileName,
+                               const size_t index);
+  // Число дельт цепочки текущего снимка, идущих подряд с первой
+  static size_t ChainLength(const std::string& fileName);
+  // Записывает дельту index цепочки текущего снимка fileName
+  static int save(const std::string& fileName, const size_t index,
+                  const std::vector<Entry>& upserts,
+                  const std::vector<Key>& deletes);
+  // Полный снимок цепочки с примененными по порядку дельтами вместе с
+  // временем удаления записей. Бросает std::runtime_error с "not open" или
+  // "Corrupted"
+  static std::vector<Entry> loadChain(const std::string& fileName);
+  // Заменяет цепочку одним полным снимком без истекших записей. Возвращает
+  // число его записей
+  static int compact(const std::string& fileName);
+  // Удаляет дельты цепочки, снимок остается
+  static void removeDeltas(const std::string& fileName);
+  // Записывает полный снимок с новым номером цепочки через временный файл.
+  // Дельты прошлой цепочки после этого не применяются. После успешного
+  // возврата снимок сброшен на диск вместе с каталогом, и дельты можно удалять
+  static int saveBase(const std::string& fileName,
+                      const std::vector<std::pair<Key, Value>>& values);
+  static int saveBase(const std::string& fileName, const EntrySource& source);
+
+ private:
+  enum Operation { deltaUpsert, deltaDelete };
+
+  // Номер цепочки снимка fileName, 0 для файла без номера. nullopt, если
+  // файла нет
+  static std::optional<uint32_t> baseChainId(const std::string& fileName);
+  // Номер цепочки из заголовка дельты или nullopt, если заголовок не прочитан
+  static std::optional<uint32_t> deltaChainId(const std::string& fileName);
+  static uint32_t newChainId(const std::optional<uint32_t> previous);
+  // Изменения дельты поверх changes: новая запись или nullopt для
+  // удаленного ключа
+  static void apply(std::string_view data, const size_t index,
+                    const uint32_t chainId,
+                    std::unordered_map<Key, std::optional<Entry>>& changes);
+};
+
+// Ключи, измененные после последнего снимка цепочки. Отметки ставятся
+// только между Start и Stop
+class DirtyKeys {
+ public:
+  bool Tracking() const { return tracking_.load(std::memory_order_relaxed); }
+  // Вызывается под блокировкой хранилища в момент снимка
+  void Start();
+  void Stop();
+  void Mark(const Key& key);
+  std::vector<Key> Take();
+
+ private:
+  std::atomic<bool> tracking_{false};
+  std::mutex mutex_;
+  std::unordered_set<Key> keys_;
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_DELTA_SNAPSHOT_H_
@@ -1,81 +1,171 @@
 #include "dispatcher_base.h"
 
-namespace s21 {
+#include <algorithm>
+#include <climits>
+#include <functional>
 
-namespace {
-std::mutex delKeyMutex_;
-std::mutex storageMutex_;
-}  // namespace
+namespace s21 {
 
-Dispatcher::Dispatcher() : storage_(nullptr) {}
+Dispatcher::Dispatcher() : nextShard_(0), storage_(nullptr) {}
 //----------------------------------------------------------------
 void Dispatcher::Activate(AbstractKeyValueStore* storage) {
+  std::lock_guard<std::mutex> lock(storageMutex_);
   storage_ = storage;
 }
-//-------------------c---------------------------------------------
+//----------------------------------------------------------------
+void Dispatcher::Deactivate() {
+  std::lock_guard<std::mutex> lock(storageMutex_);
+  storage_ = nullptr;
+}
+//----------------------------------------------------------------
 void Dispatcher::AddOrUpdateObservableValue(const std::string& value,
-                                            const int sec) {
-  {
-    std::lock_guard<std::mutex> lock(storageMutex_);
-    time_t currentTime = time(0);
-    time_t timeToDelete = currentTime + sec;
-    observableValues_.insert({value, timeToDelete});
+                                            const Deadline timeToDel) {
+  Shard& shard = ShardOf(value);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.Erase(value);
+  shard.observableValues.insert({value, timeToDel});
+  shard.deadlines.insert({timeToDel, value});
+}
+//----------------------------------------------------------------
+void Dispatcher::AddOrUpdateObservableValues(
+    const std::vector<std::string>& values, const Deadline timeToDel) {
+  auto groups = GroupByShard(values);
+  for (size_t i = 0; i < ShardsCount; ++i) {
+    if (groups[i].empty()) continue;
+    Shard& shard = shards_[i];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (const std::string* value : groups[i]) {
+      shard.Erase(*value);
+      shard.observableValues.insert({*value, timeToDel});
+      shard.deadlines.insert({timeToDel, *value});
+    }
   }
-  Update();
 }
 //----------------------------------------------------------------
-void Dispatcher::Update() {
+size_t Dispatcher::Update(const size_t maxCount) {
   std::vector<std::string> needDeleteValues;
-  {
-    std::lock_guard<std::mutex> lock(storageMutex_);
-    time_t currentTime = time(0);
-    for (auto it = observableValues_.begin(); it != observableValues_.end();
-         ++it) {
-      if (it->second <= currentTime) {
-        needDeleteValues.push_back(it->first);
-      }
+  Deadline currentTime = Clock::now();
+  // Обход начинается со следующего сегмента, чтобы при ограничении maxCount
+  // ни один сегмент не ждал дольше других
+  for (size_t i = 0; i < ShardsCount && needDeleteValues.size() < maxCount;
+       ++i) {
+    Shard& shard = shards_[(nextShard_ + i) % ShardsCount];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto it = shard.deadlines.begin();
+         it != shard.deadlines.end() && it->first <= currentTime &&
+         needDeleteValues.size() < maxCount;
+         it = shard.deadlines.erase(it)) {
+      needDeleteValues.push_back(it->second);
+      shard.observableValues.erase(it->second);
     }
   }
+  nextShard_ = (nextShard_ + 1) % ShardsCount;
   DeleteValues(needDeleteValues);
+  return needDeleteValues.size();
+}
+//----------------------------------------------------------------
+Deadline Dispatcher::NextDeadline() {
+  Deadline res = NoDeadline;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.deadlines.empty() && shard.deadlines.begin()->first < res)
+      res = shard.deadlines.begin()->first;
+  }
+  return res;
+}
+//----------------------------------------------------------------
+std::vector<std::string> Dispatcher::ExpiringBetween(const Deadline from,
+                                                     const Deadline to) {
+  std::vector<std::pair<Deadline, std::string>> found;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto it = shard.deadlines.lower_bound({from, std::string()});
+         it != shard.deadlines.end() && it->first <= to; ++it)
+      found.push_back(*it);
+  }
+  std::sort(found.begin(), found.end());
+  std::vector<std::string> res;
+  res.reserve(found.size());
+  for (auto& item : found) res.push_back(std::move(item.second));
+  return res;
+}
+//----------------------------------------------------------------
+std::vector<size_t> Dispatcher::CountByBuckets(
+    const Deadline from, const std::chrono::milliseconds bucket,
+    const size_t bucketsCount,
+    const std::function<bool(const std::string&, const Deadline)>&
+        isCurrent) {
+  std::vector<size_t> res(bucketsCount, 0);
+  if (bucket.count() <= 0 || bucketsCount == 0) return res;
+  // Конец диапазона ограничивается NoDeadline вместо переполнения
+  const long long maxBuckets = LLONG_MAX / bucket.count();
+  const Deadline to =
+      bucketsCount > static_cast<size_t>(maxBuckets)
+          ? NoDeadline
+          : SaturatingAdd(from, bucket * static_cast<long long>(bucketsCount));
+  std::vector<std::pair<Deadline, std::string>> found;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto it = shard.deadlines.lower_bound({from, std::string()});
+         it != shard.deadlines.end() && it->first < to; ++it)
+      found.push_back(*it);
+  }
+  for (const auto& [deadline, key] : found) {
+    if (!isCurrent(key, deadline)) continue;
+    const auto offset =
+        std::chrono::duration_cast<std::chrono::milliseconds>(deadline - from);
+    ++res[offset / bucket];
+  }
+  return res;
 }
 //----------------------------------------------------------------
 void Dispatcher::DeleteKeyFromObserv(const std::string& value) {
-  {
-    std::lock_guard<std::mutex> lock(delKeyMutex_);
-    if (deletingKey_ && *deletingKey_ == value) {
-      return;
-    }
+  Shard& shard = ShardOf(value);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.Erase(value);
+}
+//----------------------------------------------------------------
+void Dispatcher::DeleteKeysFromObserv(const std::vector<std::string>& values) {
+  auto groups = GroupByShard(values);
+  for (size_t i = 0; i < ShardsCount; ++i) {
+    if (groups[i].empty()) continue;
+    Shard& shard = shards_[i];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (const std::string* value : groups[i]) shard.Erase(*value);
   }
-  {
-    std::lock_guard<std::mutex> lock(storageMutex_);
-    for (auto it = observableValues_.begin(); it != observableValues_.end();
-         ++it) {
-      if (it->first == value) {
-        it = observableValues_.erase(it);
-        return;
-      }
-    }
+}
+//----------------------------------------------------------------
+void Dispatcher::Shard::Erase(const std::string& value) {
+  auto it = observableValues.find(value);
+  if (it != observableValues.end()) {
+    deadlines.erase({it->second, it->first});
+    observableValues.erase(it);
   }
 }
 //----------------------------------------------------------------
+Dispatcher::Shard& Dispatcher::ShardOf(const std::string& value) {
+  return shards_[ShardIndexOf(value)];
+}
+//----------------------------------------------------------------
+size_t Dispatcher::ShardIndexOf(const std::string& value) const {
+  return std::hash<std::string>()(value) % ShardsCount;
+}
+//----------------------------------------------------------------
+std::array<std::vector<const std::string*>, Dispatcher::ShardsCount>
+Dispatcher::GroupByShard(const std::vector<std::string>& values) const {
+  std::array<std::vector<const std::string*>, ShardsCount> groups;
+  for (const auto& value : values)
+    groups[ShardIndexOf(value)].push_back(&value);
+  return groups;
+}
+//----------------------------------------------------------------
 void Dispatcher::DeleteValues(
     const std::vector<std::string>& needDeleteValues) {
-  for (auto it = needDeleteValues.begin(); it != needDeleteValues.end(); it++) {
-    {
-      std::lock_guard<std::mutex> lock(delKeyMutex_);
-      deletingKey_ = std::make_shared<std::string>(*it);
-    }
-    {
-      std::lock_guard<std::mutex> lock(storageMutex_);
-      if (storage_->del(*it) == noErrors) {
-        observableValues_.erase(*it);
-      }
-    }
-    {
-      std::lock_guard<std::mutex> lock(delKeyMutex_);
-      deletingKey_.reset();
-    }
-  }
+  std::lock_guard<std::mutex> lock(storageMutex_);
+  if (!storage_ || needDeleteValues.empty()) return;
+  // Весь такт удаляется за один захват блокировки хранилища. Ключ, который
+  // успели задать заново, при этом не затрагивается
+  storage_->expireBatch(needDeleteValues);
 }
 
 }  //  namespace s21
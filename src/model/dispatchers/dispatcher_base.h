@@ -2,10 +2,13 @@
 #ifndef SRC_DISPATCHERS_DISPATCHER_BASE_H_
 #define SRC_DISPATCHERS_DISPATCHER_BASE_H_
 
-#include <ctime>
-#include <memory>
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <mutex>
+#include <set>
 #include <unordered_map>
+#include <vector>
 
 #include "../abstract_key_value_store/abstract_key_value_store.h"
 
@@ -17,17 +20,57 @@ class Dispatcher {
   ~Dispatcher() = default;
 
   void Activate(AbstractKeyValueStore* storage);
-  void AddOrUpdateObservableValue(const std::string& value, const int sec);
-  void Update();
+  void Deactivate();
+  void AddOrUpdateObservableValue(const std::string& value,
+                                  const Deadline timeToDel);
+  // Пакетные варианты берут мьютекс каждого сегмента один раз на все его
+  // ключи
+  void AddOrUpdateObservableValues(const std::vector<std::string>& values,
+                                   const Deadline timeToDel);
+  size_t Update(const size_t maxCount = SIZE_MAX);
   void DeleteKeyFromObserv(const std::string& value);
+  void DeleteKeysFromObserv(const std::vector<std::string>& values);
+  Deadline NextDeadline();
+  // Ключи со временем удаления в [from, to], упорядоченные по времени удаления
+  std::vector<std::string> ExpiringBetween(const Deadline from,
+                                           const Deadline to);
+  // Количество ключей в интервалах [from + i * bucket, from + (i + 1) * bucket).
+  // Ключ считается, только если isCurrent подтверждает, что у записи в
+  // хранилище именно такое время удаления. isCurrent вызывается без
+  // блокировок диспетчера
+  std::vector<size_t> CountByBuckets(
+      const Deadline from, const std::chrono::milliseconds bucket,
+      const size_t bucketsCount,
+      const std::function<bool(const std::string&, const Deadline)>&
+          isCurrent);
 
  private:
-  std::unordered_map<std::string, time_t> observableValues_;
+  static constexpr size_t ShardsCount = 16;
+
+  // Ключ -> время удаления и упорядоченный по времени удаления индекс:
+  // за один такт просматриваются только истекшие ключи. Ключи разнесены по
+  // сегментам со своими мьютексами, чтобы вставки не ждали друг друга
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<std::string, Deadline> observableValues;
+    std::set<std::pair<Deadline, std::string>> deadlines;
+
+    void Erase(const std::string& value);
+  };
+
+  std::array<Shard, ShardsCount> shards_;
+  size_t nextShard_;
+  // Защищает storage_ от удаления хранилища во время удаления ключей
+  std::mutex storageMutex_;
   AbstractKeyValueStore* storage_;
-  std::shared_ptr<std::string> deletingKey_;
 
+  Shard& ShardOf(const std::string& value);
+  size_t ShardIndexOf(const std::string& value) const;
+  // Ключи values, сгруппированные по сегментам
+  std::array<std::vector<const std::string*>, ShardsCount> GroupByShard(
+      const std::vector<std::string>& values) const;
   void DeleteValues(const std::vector<std::string>& needDeleteValues);
 };
 }  //  namespace s21
 
-#endif  //  SRC_DISPATCHERS_DISPATCHER_BASE_H_
\ No newline at end of file
+#endif  //  SRC_DISPATCHERS_DISPATCHER_BASE_H_
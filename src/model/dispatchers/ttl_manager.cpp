@@ -1,77 +1,150 @@
 #include "ttl_manager.h"
 
-#include <chrono>
+#include <algorithm>
+#include <vector>
 
 namespace s21 {
 
+namespace {
+// Активное удаление занимает не больше ExpireCycleBudget подряд, после чего
+// поток уступает ExpireCyclePause. Истекшие ключи, до которых очередь еще не
+// дошла, удаляются хранилищем при обращении к ним
+constexpr auto ExpireCycleBudget = std::chrono::milliseconds(25);
+constexpr auto ExpireCyclePause = std::chrono::milliseconds(75);
+constexpr size_t ExpireBatchSize = 256;
+constexpr Clock::rep NoWakeup = NoDeadline.time_since_epoch().count();
+}  // namespace
+
 TtlManager& TtlManager::getInstance() {
   static TtlManager inst;
-  inst.start();
   return inst;
 }
 
-void TtlManager::start() {
-  std::lock_guard<std::mutex> lock(mainThreadMutex_);
-  if (!mainThread_) {
-    mainThread_ = new std::thread(&TtlManager::doWork, std::ref(*this));
-  }
+void TtlManager::stop() {
+  std::lock_guard<std::mutex> lock(wakeMutex_);
+  stopFlag_ = true;
+  wakeCondition_.notify_all();
 }
 
-void TtlManager::stop() { stopFlag_ = true; }
-
-void TtlManager::addNewContainer(AbstractKeyValueStore& container) {
-  Dispatcher disp;
-  disp.Activate(&container);
-  std::pair<AbstractKeyValueStore*, Dispatcher> pair(&container, disp);
+std::shared_ptr<Dispatcher> TtlManager::addNewContainer(
+    AbstractKeyValueStore& container) {
+  auto disp = std::make_shared<Dispatcher>();
+  disp->Activate(&container);
   std::lock_guard<std::mutex> lock(dispatcherMutex_);
-  dispatchers_.insert((pair));
+  dispatchers_[&container] = disp;
+  return disp;
 }
 
 void TtlManager::deleteContainer(AbstractKeyValueStore& container) {
-  std::lock_guard<std::mutex> lock(dispatcherMutex_);
-  dispatchers_.erase(&container);
+  std::shared_ptr<Dispatcher> disp;
+  {
+    std::lock_guard<std::mutex> lock(dispatcherMutex_);
+    auto it = dispatchers_.find(&container);
+    if (it == dispatchers_.end()) return;
+    disp = it->second;
+    dispatchers_.erase(it);
+  }
+  disp->Deactivate();
 }
 
-void TtlManager::addOrUpdateNode(AbstractKeyValueStore& container,
-                                 const Key& key, int sec) {
-  if (sec > 0) {
-    std::lock_guard<std::mutex> lock(dispatcherMutex_);
-    dispatchers_[&container].AddOrUpdateObservableValue(key, sec);
+void TtlManager::addOrUpdateNode(Dispatcher& dispatcher, const Key& key,
+                                 const Deadline timeToDel) {
+  if (timeToDel != NoDeadline) {
+    dispatcher.AddOrUpdateObservableValue(key, timeToDel);
+    wakeUpBefore(timeToDel);
   } else {
-    deleteNode(container, key);
+    deleteNode(dispatcher, key);
   }
 }
 
-void TtlManager::deleteNode(AbstractKeyValueStore& container, const Key& key) {
-  std::lock_guard<std::mutex> lock(dispatcherMutex_);
-  dispatchers_[&container].DeleteKeyFromObserv(key);
+void TtlManager::deleteNode(Dispatcher& dispatcher, const Key& key) {
+  dispatcher.DeleteKeyFromObserv(key);
+}
+
+void TtlManager::addOrUpdateNodes(Dispatcher& dispatcher,
+                                  const std::vector<Key>& keys,
+                                  const Deadline timeToDel) {
+  if (keys.empty()) return;
+  if (timeToDel != NoDeadline) {
+    dispatcher.AddOrUpdateObservableValues(keys, timeToDel);
+    wakeUpBefore(timeToDel);
+  } else {
+    deleteNodes(dispatcher, keys);
+  }
+}
+
+void TtlManager::deleteNodes(Dispatcher& dispatcher,
+                             const std::vector<Key>& keys) {
+  dispatcher.DeleteKeysFromObserv(keys);
 }
 
-TtlManager::TtlManager() : stopFlag_(false), mainThread_(nullptr) {}
+TtlManager::TtlManager()
+    : stopFlag_(false),
+      mainThread_(nullptr),
+      nextWakeup_(NoWakeup),
+      pauseUntil_(0) {
+  mainThread_ = new std::thread(&TtlManager::doWork, std::ref(*this));
+}
 
 TtlManager::~TtlManager() {
   stop();
-  std::lock_guard<std::mutex> lock(mainThreadMutex_);
-  if (mainThread_) {
-    mainThread_->join();
-  }
+  mainThread_->join();
   delete mainThread_;
 }
 
 void TtlManager::doWork() {
   while (stopFlag_.load() == false) {
-    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::shared_ptr<Dispatcher>> dispatchers;
     {
       std::lock_guard<std::mutex> lock(dispatcherMutex_);
-      for (auto i = dispatchers_.begin(); i != dispatchers_.end(); ++i) {
-        i->second.Update();
+      dispatchers.reserve(dispatchers_.size());
+      for (auto i = dispatchers_.begin(); i != dispatchers_.end(); ++i)
+        dispatchers.push_back(i->second);
+    }
+    Deadline nextDeadline = NoDeadline;
+    const Deadline cycleEnd = Clock::now() + ExpireCycleBudget;
+    bool budgetExceeded = false;
+    for (auto i = dispatchers.begin(); i != dispatchers.end(); ++i) {
+      while ((*i)->Update(ExpireBatchSize) == ExpireBatchSize) {
+        if (Clock::now() >= cycleEnd) {
+          budgetExceeded = true;
+          break;
+        }
       }
+      nextDeadline = std::min(nextDeadline, (*i)->NextDeadline());
     }
-    auto finish = std::chrono::high_resolution_clock::now();
-    auto time = finish - start;
-    if (time < std::chrono::seconds{1}) {
-      std::this_thread::sleep_for(std::chrono::seconds{1} - time);
+    if (budgetExceeded) {
+      pauseUntil_ =
+          (Clock::now() + ExpireCyclePause).time_since_epoch().count();
     }
+
+    std::unique_lock<std::mutex> lock(wakeMutex_);
+    // Сроки, добавленные во время такта, уже снизили nextWakeup_
+    nextWakeup_ = std::max(
+        std::min(nextWakeup_.load(), nextDeadline.time_since_epoch().count()),
+        pauseUntil_.load());
+    const Clock::rep waitUntil = nextWakeup_.load();
+    auto needWakeUp = [this, waitUntil]() {
+      return stopFlag_.load() || nextWakeup_.load() < waitUntil;
+    };
+    if (waitUntil == NoWakeup) {
+      wakeCondition_.wait(lock, needWakeUp);
+    } else {
+      wakeCondition_.wait_until(
+          lock, Deadline(Clock::duration(waitUntil)), needWakeUp);
+    }
+    nextWakeup_ = NoWakeup;
+  }
+}
+
+void TtlManager::wakeUpBefore(const Deadline timeToDel) {
+  const Clock::rep wakeup =
+      std::max(timeToDel.time_since_epoch().count(), pauseUntil_.load());
+  if (wakeup >= nextWakeup_.load()) return;
+  std::lock_guard<std::mutex> lock(wakeMutex_);
+  if (wakeup < nextWakeup_.load()) {
+    nextWakeup_ = wakeup;
+    wakeCondition_.notify_one();
   }
 }
 
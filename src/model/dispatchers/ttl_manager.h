@@ -2,9 +2,12 @@
 #define SRC_DISPATCHERS_TTL_MANAGER_H_
 
 #include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "../../types.h"
 #include "../abstract_key_value_store/abstract_key_value_store.h"
@@ -22,25 +25,40 @@ class TtlManager {
 
   static TtlManager& getInstance();
   void stop();
-  void addNewContainer(AbstractKeyValueStore& container);
+  std::shared_ptr<Dispatcher> addNewContainer(
+      AbstractKeyValueStore& container);
   void deleteContainer(AbstractKeyValueStore& container);
-  void addOrUpdateNode(AbstractKeyValueStore& container, const Key& key,
-                       int sec);
-  void deleteNode(AbstractKeyValueStore& container, const Key& key);
+  void addOrUpdateNode(Dispatcher& dispatcher, const Key& key,
+                       const Deadline timeToDel);
+  void deleteNode(Dispatcher& dispatcher, const Key& key);
+  // Пакетные варианты для mset и mdel
+  void addOrUpdateNodes(Dispatcher& dispatcher, const std::vector<Key>& keys,
+                        const Deadline timeToDel);
+  void deleteNodes(Dispatcher& dispatcher, const std::vector<Key>& keys);
 
  private:
   std::atomic_bool stopFlag_;
+  // Защищает только список контейнеров, вставка ключей его не берет
   std::mutex dispatcherMutex_;
-  std::mutex mainThreadMutex_;
   std::thread* mainThread_;
-  std::unordered_map<AbstractKeyValueStore*, Dispatcher> dispatchers_;
+  std::unordered_map<AbstractKeyValueStore*, std::shared_ptr<Dispatcher>>
+      dispatchers_;
+  // Поток удаления спит до ближайшего времени удаления nextWakeup_ и
+  // пробуждается раньше, если зарегистрирован более ранний срок. Более
+  // поздние сроки проверяются без блокировки
+  std::mutex wakeMutex_;
+  std::condition_variable wakeCondition_;
+  std::atomic<Clock::rep> nextWakeup_;
+  // Конец паузы после такта, превысившего бюджет. Более ранние сроки не
+  // будят поток до него
+  std::atomic<Clock::rep> pauseUntil_;
 
   TtlManager();
   ~TtlManager();
-  void start();
   void doWork();
+  void wakeUpBefore(const Deadline timeToDel);
 };
 
 }  //  namespace s21
 
-#endif  //  SRC_DISPATCHERS_TTL_MANAGER_H_
\ No newline at end of file
+#endif  //  SRC_DISPATCHERS_TTL_MANAGER_H_
@@ -0,0 +1,58 @@
+#include "durable_file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+
+namespace s21 {
+
+bool SyncFile(const std::string& fileName) {
+  const int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  const bool synced = fsync(fd) == 0;
+  close(fd);
+  return synced;
+}
+
+bool SyncDirectory(const std::string& directory) {
+  const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) return false;
+  const bool synced = fsync(fd) == 0;
+  close(fd);
+  return synced;
+}
+
+std::string DirectoryOf(const std::string& fileName) {
+  const std::string directory =
+      std::filesystem::path(fileName).parent_path().string();
+  return directory.empty() ? "." : directory;
+}
+
+bool ReplaceFileDurably(const std::string& fileName, const std::string& data) {
+  const std::string tmpName = fileName + ".tmp";
+  const int fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool written = fd >= 0;
+  size_t done = 0;
+  while (written && done < data.size()) {
+    ssize_t res = write(fd, data.data() + done, data.size() - done);
+    if (res < 0 && errno == EINTR) continue;
+    written = res > 0;
+    if (written) done += static_cast<size_t>(res);
+  }
+  written = written && fsync(fd) == 0;
+  if (fd >= 0) close(fd);
+  // Первый сброс каталога сохраняет файлы, созданные до этого, второй -
+  // переименование
+  const std::string directory = DirectoryOf(fileName);
+  if (!written || !SyncDirectory(directory) ||
+      std::rename(tmpName.c_str(), fileName.c_str()) != 0) {
+    std::remove(tmpName.c_str());
+    return false;
+  }
+  return SyncDirectory(directory);
+}
+
+}  //  namespace s21
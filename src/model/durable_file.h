@@ -0,0 +1,23 @@
+// Сброс файлов на диск для файлов, которые должны пережить сбой: данные
+// попадают на диск до того, как файл становится виден под своим именем
+#ifndef SRC_MODEL_DURABLE_FILE_H_
+#define SRC_MODEL_DURABLE_FILE_H_
+
+#include <string>
+
+namespace s21 {
+
+// false, если файл не удалось открыть или сбросить на диск
+bool SyncFile(const std::string& fileName);
+// false, если каталог не удалось сбросить на диск
+bool SyncDirectory(const std::string& directory);
+// Каталог файла, "." для имени без каталога
+std::string DirectoryOf(const std::string& fileName);
+// Пишет data во временный файл fileName.tmp, сбрасывает его на диск и
+// переименовывает. После возврата true на диске и файл, и созданные до него
+// файлы каталога. При ошибке временный файл удаляется
+bool ReplaceFileDurably(const std::string& fileName, const std::string& data);
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_DURABLE_FILE_H_
@@ -0,0 +1,55 @@
+#include "keyspace_notifier.h"
+
+#include <algorithm>
+
+namespace s21 {
+
+KeyspaceSubscription::KeyspaceSubscription(const size_t capacity)
+    : events_(capacity), dropped_(0) {}
+//----------------------------------------------------------------
+bool KeyspaceSubscription::Poll(KeyspaceEvent& event) {
+  return events_.TryPop(event);
+}
+//----------------------------------------------------------------
+size_t KeyspaceSubscription::Dropped() const { return dropped_.load(); }
+//----------------------------------------------------------------
+void KeyspaceSubscription::Push(const KeyspaceEvent& event) {
+  if (!events_.TryPush(event))
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+}
+//----------------------------------------------------------------
+std::shared_ptr<KeyspaceSubscription> KeyspaceNotifier::Subscribe(
+    const size_t capacity) {
+  auto subscription = std::make_shared<KeyspaceSubscription>(capacity);
+  std::lock_guard<std::mutex> lock(subscribersMutex_);
+  auto subscribers = std::make_shared<Subscribers>(*subscribers_);
+  subscribers->push_back(subscription);
+  subscribersCount_.store(subscribers->size());
+  std::atomic_store(&subscribers_,
+                    std::shared_ptr<const Subscribers>(std::move(subscribers)));
+  return subscription;
+}
+//----------------------------------------------------------------
+void KeyspaceNotifier::Unsubscribe(
+    const std::shared_ptr<KeyspaceSubscription>& subscription) {
+  std::lock_guard<std::mutex> lock(subscribersMutex_);
+  auto subscribers = std::make_shared<Subscribers>(*subscribers_);
+  subscribers->erase(
+      std::remove(subscribers->begin(), subscribers->end(), subscription),
+      subscribers->end());
+  subscribersCount_.store(subscribers->size());
+  std::atomic_store(&subscribers_,
+                    std::shared_ptr<const Subscribers>(std::move(subscribers)));
+}
+//----------------------------------------------------------------
+void KeyspaceNotifier::Publish(const KeyspaceEventType type, const Key& key,
+                               const Key& newKey) {
+  // Без подписчиков событие даже не создается
+  if (subscribersCount_.load(std::memory_order_relaxed) == 0) return;
+  const KeyspaceEvent event{type, key, newKey};
+  const std::shared_ptr<const Subscribers> subscribers =
+      std::atomic_load(&subscribers_);
+  for (const auto& subscriber : *subscribers) subscriber->Push(event);
+}
+
+}  //  namespace s21
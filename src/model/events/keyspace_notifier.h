@@ -0,0 +1,65 @@
+// Поток событий об изменении ключей хранилища. Каждый подписчик получает
+// свою ограниченную очередь: хранилище не ждет медленного читателя, а
+// события, не поместившиеся в очередь, отбрасываются и подсчитываются
+#ifndef SRC_MODEL_EVENTS_KEYSPACE_NOTIFIER_H_
+#define SRC_MODEL_EVENTS_KEYSPACE_NOTIFIER_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../../types.h"
+#include "ring_buffer.h"
+
+namespace s21 {
+
+class KeyspaceSubscription {
+ public:
+  explicit KeyspaceSubscription(const size_t capacity);
+
+  // Забирает очередное событие, false если событий нет
+  bool Poll(KeyspaceEvent& event);
+  // Количество событий, отброшенных из-за переполнения очереди
+  size_t Dropped() const;
+
+ private:
+  friend class KeyspaceNotifier;
+
+  RingBuffer<KeyspaceEvent> events_;
+  std::atomic<size_t> dropped_;
+
+  // Единственный писатель очереди - KeyspaceNotifier::Publish своего
+  // хранилища, а его вызовы упорядочены блокировкой хранилища
+  void Push(const KeyspaceEvent& event);
+};
+
+class KeyspaceNotifier {
+ public:
+  static constexpr size_t DefaultCapacity = 1024;
+
+  KeyspaceNotifier() = default;
+
+  std::shared_ptr<KeyspaceSubscription> Subscribe(const size_t capacity);
+  void Unsubscribe(const std::shared_ptr<KeyspaceSubscription>& subscription);
+
+  // Вызывается только под блокировкой хранилища, поэтому у очередей
+  // подписчиков один писатель. Общих блокировок не берет: список подписчиков
+  // читается атомарно, Subscribe и Unsubscribe заменяют его копией
+  void Publish(const KeyspaceEventType type, const Key& key,
+               const Key& newKey = Key());
+
+ private:
+  typedef std::vector<std::shared_ptr<KeyspaceSubscription>> Subscribers;
+
+  // Упорядочивает Subscribe и Unsubscribe между собой
+  std::mutex subscribersMutex_;
+  // Читается и заменяется через std::atomic_load и std::atomic_store
+  std::shared_ptr<const Subscribers> subscribers_ =
+      std::make_shared<const Subscribers>();
+  std::atomic<size_t> subscribersCount_{0};
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_EVENTS_KEYSPACE_NOTIFIER_H_
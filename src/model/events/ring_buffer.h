@@ -0,0 +1,62 @@
+// Ограниченная очередь без блокировок для одного писателя и одного читателя.
+// Емкость округляется вверх до степени двойки
+#ifndef SRC_MODEL_EVENTS_RING_BUFFER_H_
+#define SRC_MODEL_EVENTS_RING_BUFFER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace s21 {
+
+template <typename T>
+class RingBuffer {
+ public:
+  explicit RingBuffer(const size_t capacity)
+      : buffer_(RoundUp(capacity)), mask_(buffer_.size() - 1) {}
+
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+
+  // Вызывается только писателем. false, если очередь заполнена
+  bool TryPush(T value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == buffer_.size())
+      return false;
+    buffer_[tail & mask_] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Вызывается только читателем. false, если очередь пуста
+  bool TryPop(T& value) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    value = std::move(buffer_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t Size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+  size_t Capacity() const { return buffer_.size(); }
+
+ private:
+  std::vector<T> buffer_;
+  const size_t mask_;
+  // Счетчики читателя и писателя лежат в разных строках кеша
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+
+  static size_t RoundUp(const size_t capacity) {
+    size_t res = 1;
+    while (res < capacity) res <<= 1;
+    return res;
+  }
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_EVENTS_RING_BUFFER_H_
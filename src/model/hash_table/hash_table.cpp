@@ -1,21 +1,40 @@
 #include "hash_table.h"
 
+#include <algorithm>
 #include <climits>
 #include <cstring>
+#include <thread>
 
-#include "../data.h"
+#include "../aggregation/aggregator.h"
 #include "../dispatchers/ttl_manager.h"
+#include "../sketches/field_statistics.h"
+#include "../worker_group.h"
 
 namespace s21 {
 
 namespace {
-constexpr size_t VectorSize = UCHAR_MAX;
+constexpr size_t VectorSize = UCHAR_MAX + 1;
+// Число записей, которые обход снимка проходит за один захват блокировки
+constexpr size_t SnapshotBatchSize = 4096;
+// Число строк, которые каждый поток загрузки вставляет за один захват
+// блокировки
+constexpr size_t UploadBatchRows = 16384;
+// Фильтр корзины перестраивается на удвоенное число ключей, но не меньше
+constexpr size_t MinFilterItems = 64;
 }
 
 using HashKey = HashTable::HashKey;
 
-HashTable::HashTable() : m_storage(VectorSize, nullptr) {
-  TtlManager::getInstance().addNewContainer(*this);
+HashTable::HashTable() : HashTable(DefaultBloomFalsePositiveRate) {}
+//----------------------------------------------------------------
+HashTable::HashTable(const double bloomFalsePositiveRate)
+    : m_storage(VectorSize, nullptr),
+      m_snapshotWalk(0),
+      m_falsePositiveRate(bloomFalsePositiveRate),
+      m_filters(VectorSize) {
+  for (auto& bucket : m_filters)
+    bucket.filter = BloomFilter(MinFilterItems, m_falsePositiveRate);
+  m_dispatcher = TtlManager::getInstance().addNewContainer(*this);
 }
 //----------------------------------------------------------------
 HashTable::~HashTable() { TtlManager::getInstance().deleteContainer(*this); }
@@ -27,134 +46,650 @@ HashKey HashTable::HashFunction(const Key& key) const {
 }
 //----------------------------------------------------------------
 const std::shared_ptr<HashTable::Item> HashTable::FindItem(const Key& key) {
-  std::lock_guard<std::mutex> lock(m_nodeMutex);
-  auto it = m_storage[HashFunction(key)];
-  while (it != nullptr && key != it->ItemKey) it = it->NextItem;
-  return it;
+  std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+  return FindAliveItem(key);
 }
 //----------------------------------------------------------------
-Errors HashTable::set(const std::string& key, const Value& value, int ttl) {
-  if (FindItem(key) != nullptr) return keyAlreadyExists;
-  std::lock_guard<std::mutex> lock(m_nodeMutex);
+std::shared_ptr<HashTable::Item> HashTable::FindAliveItem(
+    const Key& key, std::shared_ptr<Item>* prevItem) {
   const auto idx = HashFunction(key);
-  Item newItem(key, value,
-               ttl > 0 ? time(nullptr) + ttl : static_cast<time_t>(ttl));
+  std::shared_ptr<Item> prev = nullptr;
+  auto it = FindInBucket(idx, key, &prev);
+  if (it != nullptr && IsExpired(it->TimeToDel)) {
+    // Истекшая запись считается отсутствующей и удаляется при обращении
+    UnlinkItem(idx, prev, it);
+    notifier_.Publish(evExpire, key);
+    RecordChange(logExpire, key);
+    it = nullptr;
+  }
+  if (prevItem) *prevItem = prev;
+  return it;
+}
+//----------------------------------------------------------------
+std::shared_ptr<HashTable::Item> HashTable::FindInBucket(
+    const HashKey idx, const Key& key, std::shared_ptr<Item>* prevItem) const {
+  std::shared_ptr<Item> prev = nullptr;
+  const BloomFilter& filter = m_filters[idx].filter;
+  if (filter.Enabled() && !filter.MayContain(BloomFilter::HashOf(key))) {
+    if (prevItem) *prevItem = nullptr;
+    return nullptr;
+  }
+  auto it = m_storage[idx];
+  while (it != nullptr && key != it->ItemKey) {
+    prev = it;
+    it = it->NextItem;
+  }
+  if (prevItem) *prevItem = prev;
+  return it;
+}
+//----------------------------------------------------------------
+void HashTable::UnlinkItem(const HashKey idx, const std::shared_ptr<Item>& prev,
+                           const std::shared_ptr<Item>& item) {
+  PreserveForSnapshot(idx, item->ItemKey, item.get());
+  DetachFromBucket(idx, prev, item);
+  statistics_.Erase(item->ItemValue);
+  --countItems;
+}
+//----------------------------------------------------------------
+void HashTable::DetachFromBucket(const HashKey idx,
+                                 const std::shared_ptr<Item>& prev,
+                                 const std::shared_ptr<Item>& item) {
+  if (snapshotView_.Active()) {
+    // Обход продолжится с предыдущей записи цепочки. LastItem диапазона
+    // относится к корзине Cursor, другие корзины его не читают
+    SnapshotRange& range = RangeOf(idx);
+    if (idx == range.Cursor && item == range.LastItem) range.LastItem = prev;
+  }
+  if (prev == nullptr)
+    m_storage[idx] = item->NextItem;
+  else
+    prev->NextItem = item->NextItem;
+  BucketFilter& bucket = m_filters[idx];
+  --bucket.items;
+  if (++bucket.removed > std::max(bucket.items, MinFilterItems))
+    RebuildFilter(idx);
+}
+//----------------------------------------------------------------
+void HashTable::LinkItem(const std::shared_ptr<Item>& item) {
+  const auto idx = HashFunction(item->ItemKey);
+  PreserveForSnapshot(idx, item->ItemKey, nullptr);
+  AttachToBucket(idx, item);
+  statistics_.Insert(item->ItemValue);
+  ++countItems;
+}
+//----------------------------------------------------------------
+void HashTable::AttachToBucket(const HashKey idx,
+                               const std::shared_ptr<Item>& item) {
+  // rename переносит запись, пройденную обходом, в конец другой цепочки
+  item->SnapshotWalk = 0;
   auto it = m_storage[idx];
   if (it == nullptr) {
-    m_storage[idx] = std::make_shared<Item>(newItem);
+    m_storage[idx] = item;
   } else {
     while (it->NextItem != nullptr) it = it->NextItem;
-    it->NextItem = std::make_shared<Item>(newItem);
+    it->NextItem = item;
   }
-
-  if (ttl > 0) TtlManager::getInstance().addOrUpdateNode(*this, key, ttl);
-  ++countItems;
-  return noErrors;
+  BucketFilter& bucket = m_filters[idx];
+  if (++bucket.items + bucket.removed > bucket.filter.Capacity())
+    RebuildFilter(idx);
+  else
+    bucket.filter.Add(BloomFilter::HashOf(item->ItemKey));
+}
+//----------------------------------------------------------------
+void HashTable::RebuildFilter(const HashKey idx) {
+  BucketFilter& bucket = m_filters[idx];
+  bucket.filter = BloomFilter(std::max(2 * bucket.items, MinFilterItems),
+                              m_falsePositiveRate);
+  bucket.removed = 0;
+  if (!bucket.filter.Enabled()) return;
+  for (auto it = m_storage[idx]; it != nullptr; it = it->NextItem)
+    bucket.filter.Add(BloomFilter::HashOf(it->ItemKey));
+}
+//----------------------------------------------------------------
+void HashTable::PreserveForSnapshot(const HashKey idx, const Key& key,
+                                    const Item* item) {
+  if (!snapshotView_.Active()) return;
+  const SnapshotRange& range = RangeOf(idx);
+  if (idx < range.Cursor) return;
+  if (idx == range.Cursor && item && item->SnapshotWalk == m_snapshotWalk)
+    return;
+  if (item)
+    snapshotView_.Preserve(key, &item->ItemValue, item->TimeToDel);
+  else
+    snapshotView_.Preserve(key, nullptr, NoDeadline);
+}
+//----------------------------------------------------------------
+HashTable::SnapshotRange& HashTable::RangeOf(const HashKey idx) {
+  auto endsAfter = [](const HashKey i, const SnapshotRange& range) {
+    return i < range.End;
+  };
+  return *std::upper_bound(m_snapshotRanges.begin(), m_snapshotRanges.end(),
+                           idx, endsAfter);
+}
+//----------------------------------------------------------------
+std::pair<size_t, size_t> HashTable::BucketsOf(const size_t i,
+                                               const size_t count) const {
+  return {m_storage.size() * i / count, m_storage.size() * (i + 1) / count};
+}
+//----------------------------------------------------------------
+template <typename K, typename V>
+const HashTable::Item* HashTable::InsertUnderLock(K&& key, V&& value,
+                                                  const Deadline timeToDel,
+                                                  uint64_t& lsn) {
+  if (FindAliveItem(key) != nullptr) return nullptr;
+  auto item = std::make_shared<Item>(
+      std::forward<K>(key), std::forward<V>(value), timeToDel, NextVersion());
+  LinkItem(item);
+  notifier_.Publish(evSet, item->ItemKey);
+  lsn = RecordChange(logSet, item->ItemKey, item->ItemValue, timeToDel);
+  return item.get();
+}
+//----------------------------------------------------------------
+Errors HashTable::set(const std::string& key, const Value& value,
+                      std::chrono::milliseconds ttl) {
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+    if (!InsertUnderLock(key, value, timeToDel, lsn)) return keyAlreadyExists;
+    // Диспетчер обновляется под той же блокировкой, что и запись, поэтому
+    // видит изменения ключа в том же порядке
+    if (timeToDel != NoDeadline)
+      TtlManager::getInstance().addOrUpdateNode(*m_dispatcher, key, timeToDel);
+  }
+  return CommitChange(lsn);
+}
+//----------------------------------------------------------------
+Errors HashTable::set(Key&& key, Value&& value,
+                      std::chrono::milliseconds ttl) {
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+    const Item* item =
+        InsertUnderLock(std::move(key), std::move(value), timeToDel, lsn);
+    if (item == nullptr) return keyAlreadyExists;
+    // Ключ перемещен в запись
+    if (timeToDel != NoDeadline)
+      TtlManager::getInstance().addOrUpdateNode(*m_dispatcher, item->ItemKey,
+                                                timeToDel);
+  }
+  return CommitChange(lsn);
 }
 //----------------------------------------------------------------
 std::optional<Value> HashTable::get(const std::string& key) {
-  auto Item = FindItem(key);
+  std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+  auto Item = FindAliveItem(key);
   if (Item != nullptr)
     return Item->ItemValue;
   else
     return std::nullopt;
 }
 //----------------------------------------------------------------
+std::optional<VersionedValue> HashTable::getVersioned(const Key& key) {
+  std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+  auto item = FindAliveItem(key);
+  if (item == nullptr) return std::nullopt;
+  return VersionedValue{item->ItemValue, item->Version};
+}
+//----------------------------------------------------------------
+bool HashTable::visit(const Key& key,
+                      const std::function<void(const Value&)>& visitor) {
+  std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+  auto item = FindAliveItem(key);
+  if (item == nullptr) return false;
+  visitor(item->ItemValue);
+  return true;
+}
+//----------------------------------------------------------------
 bool HashTable::exists(const std::string& key) {
   return FindItem(key) != nullptr;
 }
 //----------------------------------------------------------------
 Errors HashTable::del(const std::string& key) {
-  if (FindItem(key) == nullptr) return keyNotFound;
   bool needDeleteFromTtlManager = false;
-  std::lock_guard<std::mutex> lock(m_nodeMutex);
-  auto idx = HashFunction(key);
-  auto it = m_storage[idx];
-  if (it->ItemKey == key) {
-    m_storage[idx] = it->NextItem;
-    needDeleteFromTtlManager = it->TimeToDel < 0;
-  } else {
-    while (it->NextItem->ItemKey != key) it = it->NextItem;
-    needDeleteFromTtlManager = it->NextItem->TimeToDel < 0;
-    it->NextItem = it->NextItem->NextItem;
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+    Errors res = EraseUnderLock(key, needDeleteFromTtlManager, lsn);
+    if (res != noErrors) return res;
+    if (needDeleteFromTtlManager)
+      TtlManager::getInstance().deleteNode(*m_dispatcher, key);
   }
-  --countItems;
-  if (needDeleteFromTtlManager)
-    TtlManager::getInstance().deleteNode(*this, key);
-  return noErrors;
+  return CommitChange(lsn);
 }
 //----------------------------------------------------------------
-Errors HashTable::update(const Key& key, const Value& value, const int ttl,
-                         const int paramsMask) {
-  auto it = FindItem(key);
-  if (it == nullptr) return keyNotFound;
-  std::lock_guard<std::mutex> lock(m_nodeMutex);
-  it->ItemValue.lastname =
-      paramsMask & pLastname ? value.lastname : it->ItemValue.lastname;
-  it->ItemValue.name = paramsMask & pName ? value.name : it->ItemValue.name;
-  it->ItemValue.year = paramsMask & pYear ? value.year : it->ItemValue.year;
-  it->ItemValue.city = paramsMask & pCity ? value.city : it->ItemValue.city;
-  it->ItemValue.coins = paramsMask & pCoins ? value.coins : it->ItemValue.coins;
-
-  if (paramsMask & pTtl) {
-    it->TimeToDel = ttl > 0 ? (time(nullptr) + ttl) : 0;
-    TtlManager::getInstance().addOrUpdateNode(*this, key, ttl);
+Errors HashTable::delIfVersion(const Key& key, const uint64_t version) {
+  bool needDeleteFromTtlManager = false;
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+    Errors res = EraseUnderLock(key, needDeleteFromTtlManager, lsn, version);
+    if (res != noErrors) return res;
+    if (needDeleteFromTtlManager)
+      TtlManager::getInstance().deleteNode(*m_dispatcher, key);
+  }
+  return CommitChange(lsn);
+}
+//----------------------------------------------------------------
+std::vector<std::optional<Value>> HashTable::mget(
+    const std::vector<Key>& keys) {
+  std::vector<std::optional<Value>> res;
+  res.reserve(keys.size());
+  std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+  for (const auto& key : keys) {
+    auto item = FindAliveItem(key);
+    if (item != nullptr)
+      res.push_back(item->ItemValue);
+    else
+      res.push_back(std::nullopt);
   }
+  return res;
+}
+//----------------------------------------------------------------
+std::vector<Errors> HashTable::mset(
+    const std::vector<std::pair<Key, Value>>& values,
+    std::chrono::milliseconds ttl) {
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  std::vector<Errors> res;
+  res.reserve(values.size());
+  std::vector<Key> withTtl;
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+    for (const auto& [key, value] : values) {
+      res.push_back(InsertUnderLock(key, value, timeToDel, lsn)
+                        ? noErrors
+                        : keyAlreadyExists);
+      if (res.back() == noErrors && timeToDel != NoDeadline)
+        withTtl.push_back(key);
+    }
+    TtlManager::getInstance().addOrUpdateNodes(*m_dispatcher, withTtl,
+                                               timeToDel);
+  }
+  // Журнал сбрасывается один раз на пакет: lsn последней записи покрывает
+  // все предыдущие
+  CommitChanges(lsn, res);
+  return res;
+}
+//----------------------------------------------------------------
+std::vector<Errors> HashTable::mdel(const std::vector<Key>& keys) {
+  std::vector<Errors> res;
+  res.reserve(keys.size());
+  std::vector<Key> withTtl;
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+    for (const auto& key : keys) {
+      bool hadTtl = false;
+      res.push_back(EraseUnderLock(key, hadTtl, lsn));
+      if (hadTtl) withTtl.push_back(key);
+    }
+    if (!withTtl.empty())
+      TtlManager::getInstance().deleteNodes(*m_dispatcher, withTtl);
+  }
+  CommitChanges(lsn, res);
+  return res;
+}
+//----------------------------------------------------------------
+Errors HashTable::EraseUnderLock(const Key& key, bool& hadTtl, uint64_t& lsn,
+                                 const std::optional<uint64_t>& version) {
+  std::shared_ptr<Item> prev = nullptr;
+  auto it = FindAliveItem(key, &prev);
+  if (it == nullptr) return keyNotFound;
+  if (version && it->Version != *version) return versionMismatch;
+  hadTtl = HasPendingTtl(it->TimeToDel);
+  UnlinkItem(HashFunction(key), prev, it);
+  notifier_.Publish(evDel, key);
+  lsn = RecordChange(logDel, key);
   return noErrors;
 }
 //----------------------------------------------------------------
+Errors HashTable::update(const Key& key, const Value& value,
+                         std::chrono::milliseconds ttl, const int paramsMask) {
+  return UpdateItem(key, value, ttl, paramsMask, std::nullopt);
+}
+//----------------------------------------------------------------
+Errors HashTable::updateIfVersion(const Key& key, const Value& value,
+                                  std::chrono::milliseconds ttl,
+                                  const int paramsMask,
+                                  const uint64_t version) {
+  return UpdateItem(key, value, ttl, paramsMask, version);
+}
+//----------------------------------------------------------------
+Errors HashTable::UpdateItem(const Key& key, const Value& value,
+                             std::chrono::milliseconds ttl,
+                             const int paramsMask,
+                             const std::optional<uint64_t>& version) {
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+    auto it = FindAliveItem(key);
+    if (it == nullptr) return keyNotFound;
+    if (version && it->Version != *version) return versionMismatch;
+    PreserveForSnapshot(HashFunction(key), key, it.get());
+    statistics_.Erase(it->ItemValue);
+    it->ItemValue.lastname =
+        paramsMask & pLastname ? value.lastname : it->ItemValue.lastname;
+    it->ItemValue.name = paramsMask & pName ? value.name : it->ItemValue.name;
+    it->ItemValue.year = paramsMask & pYear ? value.year : it->ItemValue.year;
+    it->ItemValue.city = paramsMask & pCity ? value.city : it->ItemValue.city;
+    it->ItemValue.coins =
+        paramsMask & pCoins ? value.coins : it->ItemValue.coins;
+    statistics_.Insert(it->ItemValue);
+    if (paramsMask & pTtl) it->TimeToDel = timeToDel;
+    it->Version = NextVersion();
+    notifier_.Publish(evUpdate, key);
+    lsn = RecordChange(logUpdate, key, it->ItemValue, it->TimeToDel);
+    if (paramsMask & pTtl)
+      TtlManager::getInstance().addOrUpdateNode(*m_dispatcher, key, timeToDel);
+  }
+  return CommitChange(lsn);
+}
+//----------------------------------------------------------------
 Errors HashTable::rename(const std::string& oldKey, const std::string& newKey) {
-  auto item = FindItem(oldKey);
-  if (item == nullptr) return keyNotFound;
-  Value value = item->ItemValue;
-  auto ttl = item->TimeToDel;
-  auto messageSet = set(newKey, value, ttl);
-  if (messageSet != noErrors) return messageSet;
-  return del(oldKey);
+  uint64_t lsn = 0;
+  {
+    // Запись переносится под новый ключ за одну блокировку, поэтому никто не
+    // увидит ее сразу под обоими ключами или ни под одним
+    std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+    if (FindAliveItem(oldKey) == nullptr) return keyNotFound;
+    if (FindAliveItem(newKey) != nullptr) return keyAlreadyExists;
+    std::shared_ptr<Item> prev = nullptr;
+    auto item = FindAliveItem(oldKey, &prev);
+    UnlinkItem(HashFunction(oldKey), prev, item);
+    const Deadline timeToDel = item->TimeToDel;
+    // Запись переносится в цепочку нового ключа без копирования значения
+    item->ItemKey = newKey;
+    item->Version = NextVersion();
+    item->NextItem = nullptr;
+    LinkItem(item);
+    notifier_.Publish(evRename, oldKey, newKey);
+    lsn = RecordChange(logRename, oldKey, newKey);
+    if (timeToDel != NoDeadline) {
+      TtlManager::getInstance().deleteNode(*m_dispatcher, oldKey);
+      TtlManager::getInstance().addOrUpdateNode(*m_dispatcher, newKey,
+                                                timeToDel);
+    }
+  }
+  return CommitChange(lsn);
+}
+//----------------------------------------------------------------
+Errors HashTable::incrBy(const Key& key, const int field, const int delta,
+                         int& result) {
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+    auto it = FindAliveItem(key);
+    if (it == nullptr) return keyNotFound;
+    std::optional<int> number = IncrementedField(it->ItemValue, field, delta);
+    if (!number) return valueOutOfRange;
+    PreserveForSnapshot(HashFunction(key), key, it.get());
+    // Статистика ведется только по строковым полям и не меняется
+    SetNumericField(it->ItemValue, field, *number);
+    it->Version = NextVersion();
+    notifier_.Publish(evUpdate, key);
+    lsn = RecordChange(logUpdate, key, it->ItemValue, it->TimeToDel);
+    result = *number;
+  }
+  return CommitChange(lsn);
 }
 //----------------------------------------------------------------
-int HashTable::Ttl(const std::string& key) {
-  auto item = FindItem(key);
+long long HashTable::PTtl(const std::string& key) {
+  std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+  auto item = FindAliveItem(key);
   if (item == nullptr) return keyNotFound;
-  std::lock_guard<std::mutex> lock(m_nodeMutex);
-  return item->TimeToDel > 0 ? (item->TimeToDel - time(nullptr))
-                             : static_cast<int>(hasNoTtl);
+  return RemainingMs(item->TimeToDel);
+}
+//----------------------------------------------------------------
+size_t HashTable::expireBatch(const std::vector<std::string>& keys) {
+  std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+  const int sizeBefore = countItems.load();
+  // Истекшие записи удаляет сам поиск, заданные заново ключи не затрагиваются
+  for (const auto& key : keys) FindAliveItem(key);
+  return static_cast<size_t>(sizeBefore - countItems.load());
 }
 //----------------------------------------------------------------
-int HashTable::upload(const std::string& filename) {
-  try {
-    std::vector<std::pair<Key, Value>> values(Data::loadData(filename));
-    auto sizeBeforeUpload = countItems.load();
-    for (size_t i = 0; i < values.size(); ++i)
-      set(values[i].first, values[i].second);
-    return countItems.load() - sizeBeforeUpload;
-  } catch (const std::exception& e) {
-    if (strstr(e.what(), "not open")) return canNotOpenFile;
-    if (strstr(e.what(), "Corrupted")) return corruptedFile;
-    return unknownError;
+std::vector<std::string> HashTable::expiringWithin(
+    std::chrono::milliseconds window) {
+  const Deadline now = Clock::now();
+  const Deadline until = SaturatingAdd(now, window);
+  auto candidates = m_dispatcher->ExpiringBetween(now, until);
+  // Кандидаты выбраны до захвата блокировки и к этому моменту могли быть
+  // удалены или заданы заново, поэтому проверяются по самим записям
+  std::vector<std::string> res;
+  std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+  for (const auto& key : candidates) {
+    auto it = FindAliveItem(key);
+    if (it != nullptr && it->TimeToDel <= until) res.push_back(key);
   }
+  return res;
 }
 //----------------------------------------------------------------
-int HashTable::exportValues(const std::string& filename) {
-  std::lock_guard<std::mutex> lock(m_nodeMutex);
-  std::vector<std::pair<Key, Value>> values;
-  for (size_t idx = 0; idx < m_storage.size(); ++idx) {
-    auto it = m_storage[idx];
-    while (it != nullptr) {
-      values.push_back(std::pair<Key, Value>(it->ItemKey, it->ItemValue));
-      it = it->NextItem;
+std::vector<size_t> HashTable::expiryHistogram(
+    std::chrono::milliseconds bucket, const size_t bucketsCount) {
+  std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+  return m_dispatcher->CountByBuckets(
+      Clock::now(), bucket, bucketsCount,
+      [this](const Key& key, const Deadline deadline) {
+        auto it = FindAliveItem(key);
+        return it != nullptr && it->TimeToDel == deadline;
+      });
+}
+//----------------------------------------------------------------
+size_t HashTable::bulkInsert(std::vector<std::pair<Key, Value>>& values) {
+  const size_t workersCount = WorkersFor(values.size(), m_storage.size());
+  // Каждый поток вставляет строки своих корзин, поэтому потоки не
+  // пересекаются по цепочкам и фильтрам. Корзины строк считаются заранее
+  std::vector<HashKey> bucketOf(values.size());
+  RunInParallel(workersCount, [this, workersCount, &values,
+                                &bucketOf](size_t i) {
+    for (size_t row = values.size() * i / workersCount;
+         row < values.size() * (i + 1) / workersCount; ++row)
+      bucketOf[row] = HashFunction(values[row].first);
+  });
+  // Ключи распределены по корзинам неравномерно, поэтому подряд идущие
+  // корзины делятся между потоками по числу строк, а не поровну. Строки
+  // потока раскладываются один раз и сохраняют порядок файла
+  std::vector<size_t> rowsInBucket(m_storage.size());
+  for (const HashKey idx : bucketOf) ++rowsInBucket[idx];
+  std::vector<size_t> workerOf(m_storage.size());
+  std::vector<size_t> rowsOfWorker(workersCount);
+  for (size_t idx = 0, worker = 0, passed = 0; idx < m_storage.size(); ++idx) {
+    while (worker + 1 < workersCount &&
+           passed >= values.size() * (worker + 1) / workersCount)
+      ++worker;
+    workerOf[idx] = worker;
+    rowsOfWorker[worker] += rowsInBucket[idx];
+    passed += rowsInBucket[idx];
+  }
+  // Статистика, события и записи журнала копятся у потока и переносятся в
+  // общие после пакета, чтобы потоки не захватывали общих блокировок
+  struct UploadPart {
+    std::vector<size_t> rows;
+    size_t next = 0;
+    std::vector<std::shared_ptr<Item>> expired;
+    std::vector<const Item*> inserted;
+    FieldStatistics statistics;
+  };
+  std::vector<UploadPart> parts(workersCount);
+  for (size_t i = 0; i < workersCount; ++i)
+    parts[i].rows.reserve(rowsOfWorker[i]);
+  for (size_t row = 0; row < values.size(); ++row)
+    parts[workerOf[bucketOf[row]]].rows.push_back(row);
+  auto insertRows = [this, &values, &bucketOf, &parts](size_t i) {
+    UploadPart& part = parts[i];
+    const size_t end = std::min(part.rows.size(), part.next + UploadBatchRows);
+    for (; part.next < end; ++part.next) {
+      const size_t row = part.rows[part.next];
+      const HashKey idx = bucketOf[row];
+      auto& [key, value] = values[row];
+      std::shared_ptr<Item> prev = nullptr;
+      auto found = FindInBucket(idx, key, &prev);
+      if (found != nullptr) {
+        if (!IsExpired(found->TimeToDel)) continue;
+        DetachFromBucket(idx, prev, found);
+        part.expired.push_back(found);
+      }
+      auto item = std::make_shared<Item>(std::move(key), std::move(value),
+                                         NoDeadline, NextVersion());
+      AttachToBucket(idx, item);
+      part.statistics.Insert(item->ItemValue);
+      part.inserted.push_back(item.get());
+    }
+  };
+  WorkerGroup workers(workersCount);
+
+  uint64_t lsn = 0;
+  size_t inserted = 0;
+  // Блокировка отпускается после каждого пакета, чтобы загрузка не
+  // останавливала остальные запросы до своего окончания
+  bool finished = false;
+  while (!finished) {
+    {
+      std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+      workers.Run(insertRows);
+      // События и журнал упорядочены с остальными изменениями блокировкой
+      // таблицы, поэтому переносятся под ней. Истекшая запись ключа удалена
+      // раньше, чем вставлена новая
+      finished = true;
+      for (auto& part : parts) {
+        for (const auto& item : part.expired) {
+          PreserveForSnapshot(HashFunction(item->ItemKey), item->ItemKey,
+                              item.get());
+          statistics_.Erase(item->ItemValue);
+          --countItems;
+          notifier_.Publish(evExpire, item->ItemKey);
+          RecordChange(logExpire, item->ItemKey);
+        }
+        for (const Item* item : part.inserted) {
+          PreserveForSnapshot(HashFunction(item->ItemKey), item->ItemKey,
+                              nullptr);
+          ++countItems;
+          notifier_.Publish(evSet, item->ItemKey);
+          lsn = RecordChange(logSet, item->ItemKey, item->ItemValue,
+                             NoDeadline);
+        }
+        inserted += part.inserted.size();
+        part.expired.clear();
+        part.inserted.clear();
+        finished = finished && part.next == part.rows.size();
+      }
+    }
+    std::this_thread::yield();
+  }
+  for (auto& part : parts) statistics_.Merge(part.statistics);
+  // Ошибку записи журнала показывает LogFailed
+  log_.Commit(lsn);
+  return inserted;
+}
+//----------------------------------------------------------------
+void HashTable::forEachEntry(const std::function<void()>& underLock,
+                             const EntryWriter& write) {
+  // Под блокировкой копируется одна пачка записей, write пишет ее после
+  // снятия блокировки
+  std::vector<Entry> batch;
+  batch.reserve(SnapshotBatchSize);
+  std::lock_guard<std::mutex> lock(snapshotMutex_);
+  WalkSnapshot(
+      underLock,
+      {[&batch](const Key& key, const Value& value, const Deadline timeToDel) {
+        batch.push_back({key, value, timeToDel});
+      }},
+      [&batch, &write]() {
+        for (const auto& entry : batch)
+          write(entry.key, entry.value, entry.timeToDel);
+        batch.clear();
+      });
+}
+//----------------------------------------------------------------
+std::vector<Entry> HashTable::copyEntries(
+    const std::function<void()>& underLock) {
+  std::vector<Entry> entries;
+  entries.reserve(countItems.load());
+  WalkSnapshot(underLock, {[&entries](const Key& key, const Value& value,
+                                      const Deadline timeToDel) {
+                 entries.push_back({key, value, timeToDel});
+               }});
+  return entries;
+}
+//----------------------------------------------------------------
+void HashTable::WalkSnapshot(const std::function<void()>& underLock,
+                             const std::vector<EntryWriter>& visits,
+                             const std::function<void()>& afterBatch) {
+  {
+    std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+    underLock();
+    snapshotView_.Begin();
+    m_snapshotRanges.clear();
+    for (size_t i = 0; i < visits.size(); ++i) {
+      const auto [begin, end] = BucketsOf(i, visits.size());
+      m_snapshotRanges.push_back({begin, end, nullptr});
     }
+    ++m_snapshotWalk;
+  }
+  const Deadline at = snapshotView_.At();
+  RunInParallel(visits.size(), [this, at, &visits, &afterBatch](size_t i) {
+    WalkRange(m_snapshotRanges[i], at, visits[i], afterBatch);
+  });
+  CopyOnWriteView::PreservedEntries preserved;
+  {
+    std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+    preserved = snapshotView_.Finish();
+  }
+  size_t count = 0;
+  CopyOnWriteView::ForEachAlive(
+      preserved, at,
+      [&visits, &afterBatch, &count](const Key& key, const Value& value,
+                                     const Deadline timeToDel) {
+        visits[0](key, value, timeToDel);
+        if (++count % SnapshotBatchSize == 0) afterBatch();
+      });
+  afterBatch();
+}
+//----------------------------------------------------------------
+void HashTable::WalkRange(SnapshotRange& range, const Deadline at,
+                          const EntryWriter& visit,
+                          const std::function<void()>& afterBatch) {
+  // Блокировка берется на SnapshotBatchSize записей, длинная цепочка
+  // проходится за несколько захватов. Записи, измененные до того, как до них
+  // дошел обход, берутся из snapshotView_. Потоки других диапазонов не
+  // трогают ни записи этого диапазона, ни range
+  while (range.Cursor < range.End) {
+    {
+      std::shared_lock<std::shared_mutex> lock(m_nodeMutex);
+      size_t count = 0;
+      while (range.Cursor < range.End && count < SnapshotBatchSize) {
+        auto it = range.LastItem ? range.LastItem->NextItem
+                                 : m_storage[range.Cursor];
+        for (; it != nullptr && count < SnapshotBatchSize;
+             it = it->NextItem, ++count) {
+          if (!IsExpired(it->TimeToDel, at) &&
+              !snapshotView_.Preserved(it->ItemKey))
+            visit(it->ItemKey, it->ItemValue, it->TimeToDel);
+          it->SnapshotWalk = m_snapshotWalk;
+          range.LastItem = it;
+        }
+        if (it != nullptr) break;
+        range.LastItem = nullptr;
+        ++range.Cursor;
+      }
+    }
+    afterBatch();
+    // Мьютекс не соблюдает очередь, ожидающие операции пропускаются вперед
+    std::this_thread::yield();
   }
-  return Data::saveData(filename, values);
 }
 //----------------------------------------------------------------
 const std::vector<std::string> HashTable::keys() {
-  std::lock_guard<std::mutex> lock(m_nodeMutex);
+  std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+  const Deadline now = Clock::now();
   std::vector<std::string> allKeys;
   for (size_t idx = 0; idx < m_storage.size(); ++idx) {
     auto it = m_storage[idx];
     while (it != nullptr) {
-      allKeys.push_back(it->ItemKey);
+      if (!IsExpired(it->TimeToDel, now)) allKeys.push_back(it->ItemKey);
       it = it->NextItem;
     }
   }
@@ -164,19 +699,28 @@ const std::vector<std::string> HashTable::keys() {
 const std::vector<std::string> HashTable::find(const Value& value,
                                                const int ttl,
                                                const int paramsMask) {
-  std::lock_guard<std::mutex> lock(m_nodeMutex);
   std::vector<std::string> neededKeys;
+  if (paramsMask & pTtl) {
+    // Кандидатов по времени жизни дает индекс диспетчера, остальные поля
+    // проверяются только у них
+    const auto [from, to] = TtlWindow(ttl);
+    auto candidates = m_dispatcher->ExpiringBetween(from, to);
+    std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+    for (const auto& key : candidates) {
+      auto it = FindAliveItem(key);
+      if (it != nullptr &&
+          IsMatch(it->ItemValue, it->TimeToDel, value, ttl, paramsMask))
+        neededKeys.push_back(key);
+    }
+    return neededKeys;
+  }
+  std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+  const Deadline now = Clock::now();
   for (size_t idx = 0; idx < m_storage.size(); ++idx) {
     auto it = m_storage[idx];
     while (it != nullptr) {
-      if ((!(paramsMask & pLastname) ||
-           it->ItemValue.lastname == value.lastname) &&
-          (!(paramsMask & pName) || it->ItemValue.name == value.name) &&
-          (!(paramsMask & pYear) || it->ItemValue.year == value.year) &&
-          (!(paramsMask & pCity) || it->ItemValue.city == value.city) &&
-          (!(paramsMask & pCoins) || it->ItemValue.coins == value.coins) &&
-          (!(paramsMask & pTtl) || it->TimeToDel == (time(nullptr) + ttl)))
-
+      if (!IsExpired(it->TimeToDel, now) &&
+          IsMatch(it->ItemValue, it->TimeToDel, value, ttl, paramsMask))
         neededKeys.push_back(it->ItemKey);
       it = it->NextItem;
     }
@@ -185,16 +729,58 @@ const std::vector<std::string> HashTable::find(const Value& value,
 }
 //----------------------------------------------------------------
 const std::vector<Value> HashTable::showall() {
-  std::lock_guard<std::mutex> lock(m_nodeMutex);
+  std::lock_guard<std::shared_mutex> lock(m_nodeMutex);
+  const Deadline now = Clock::now();
   std::vector<Value> allValues;
   for (size_t idx = 0; idx < m_storage.size(); ++idx) {
     auto it = m_storage[idx];
     while (it != nullptr) {
-      allValues.push_back(it->ItemValue);
+      if (!IsExpired(it->TimeToDel, now)) allValues.push_back(it->ItemValue);
       it = it->NextItem;
     }
   }
   return allValues;
 }
 
+//----------------------------------------------------------------
+const std::vector<AggregateRow> HashTable::aggregate(
+    const AggregateQuery& query) {
+  const size_t workersCount = WorkersFor(countItems.load(), m_storage.size());
+  std::vector<Aggregator> partials(workersCount, Aggregator(query));
+  // Каждый поток обходит свой диапазон корзин и считает свой Aggregator,
+  // значения передаются в него без копирования
+  std::unique_lock<std::mutex> snapshotLock(snapshotMutex_, std::try_to_lock);
+  if (snapshotLock.owns_lock()) {
+    // Обход идет через snapshotView_, поэтому запись, перенесенная rename или
+    // mset во время обхода, учитывается ровно один раз
+    std::vector<EntryWriter> visits;
+    for (size_t i = 0; i < workersCount; ++i)
+      visits.push_back([&partials, &query, i](const Key&, const Value& value,
+                                              const Deadline timeToDel) {
+        if (IsMatch(value, timeToDel, query.filter, query.ttl,
+                    query.paramsMask))
+          partials[i].Add(value);
+      });
+    WalkSnapshot([]() {}, visits);
+  } else {
+    // snapshotView_ занят выгрузкой или снимком. Чтобы не ждать их, таблица
+    // обходится под совместной блокировкой на все время запроса: изменения
+    // ждут его окончания, а выгрузка продолжается
+    std::shared_lock<std::shared_mutex> lock(m_nodeMutex);
+    const Deadline now = Clock::now();
+    RunInParallel(workersCount, [this, workersCount, now, &partials,
+                                 &query](size_t i) {
+      const auto [begin, end] = BucketsOf(i, workersCount);
+      for (size_t idx = begin; idx < end; ++idx)
+        for (auto it = m_storage[idx]; it != nullptr; it = it->NextItem)
+          if (!IsExpired(it->TimeToDel, now) &&
+              IsMatch(it->ItemValue, it->TimeToDel, query.filter, query.ttl,
+                      query.paramsMask))
+            partials[i].Add(it->ItemValue);
+    });
+  }
+  for (size_t i = 1; i < workersCount; ++i) partials[0].Merge(partials[i]);
+  return partials[0].Result();
+}
+
 }  //  namespace s21
@@ -3,9 +3,11 @@
 
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 
 #include "../abstract_key_value_store/abstract_key_value_store.h"
 #include "../dispatchers/dispatcher_base.h"
+#include "../sketches/bloom_filter.h"
 
 namespace s21 {
 class HashTable : public AbstractKeyValueStore {
@@ -13,46 +15,156 @@ class HashTable : public AbstractKeyValueStore {
   struct Item {
     Key ItemKey;
     Value ItemValue;
-    time_t TimeToDel;
+    Deadline TimeToDel;
+    uint64_t Version;
+    // Номер обхода snapshotView_, который уже прошел запись
+    uint64_t SnapshotWalk = 0;
     std::shared_ptr<Item> NextItem;
 
-    Item(Key key, Value value, time_t timeToDel)
-        : ItemKey(key),
-          ItemValue(value),
+    Item(Key key, Value value, Deadline timeToDel, uint64_t version)
+        : ItemKey(std::move(key)),
+          ItemValue(std::move(value)),
           TimeToDel(timeToDel),
+          Version(version),
           NextItem(nullptr) {}
   };
 
   typedef size_t HashKey;
 
+  static constexpr double DefaultBloomFalsePositiveRate = 0.01;
+
   HashTable();
+  // bloomFalsePositiveRate - доля ложных срабатываний фильтров Блума корзин,
+  // 0 - без фильтров
+  explicit HashTable(const double bloomFalsePositiveRate);
   ~HashTable() override;
 
+  using AbstractKeyValueStore::mset;
+  using AbstractKeyValueStore::set;
+  using AbstractKeyValueStore::update;
+  using AbstractKeyValueStore::updateIfVersion;
+
   Errors set(const std::string& key, const Value& value,
-             int ttl = hasNoTtl) override;
+             std::chrono::milliseconds ttl) override;
+  Errors set(Key&& key, Value&& value,
+             std::chrono::milliseconds ttl) override;
   std::optional<Value> get(const std::string& key) override;
+  bool visit(const Key& key,
+             const std::function<void(const Value&)>& visitor) override;
+  std::optional<VersionedValue> getVersioned(const Key& key) override;
+  bool SupportsVersions() const override { return true; }
   bool exists(const std::string& key) override;
   Errors del(const std::string& key) override;
-  Errors update(const Key& key, const Value& value, const int ttl,
-                const int paramsMask) override;
+  Errors delIfVersion(const Key& key, const uint64_t version) override;
+  Errors update(const Key& key, const Value& value,
+                std::chrono::milliseconds ttl, const int paramsMask) override;
+  Errors updateIfVersion(const Key& key, const Value& value,
+                         std::chrono::milliseconds ttl, const int paramsMask,
+                         const uint64_t version) override;
   Errors rename(const std::string& oldKey, const std::string& newKey) override;
-  int Ttl(const std::string& key) override;
-  int upload(const std::string& filename) override;
-  int exportValues(const std::string& filename) override;
+  Errors incrBy(const Key& key, const int field, const int delta,
+                int& result) override;
+  long long PTtl(const std::string& key) override;
+  std::vector<std::optional<Value>> mget(
+      const std::vector<Key>& keys) override;
+  std::vector<Errors> mset(const std::vector<std::pair<Key, Value>>& values,
+                           std::chrono::milliseconds ttl) override;
+  std::vector<Errors> mdel(const std::vector<Key>& keys) override;
+  size_t expireBatch(const std::vector<std::string>& keys) override;
+  std::vector<std::string> expiringWithin(
+      std::chrono::milliseconds window) override;
+  std::vector<size_t> expiryHistogram(std::chrono::milliseconds bucket,
+                                      const size_t bucketsCount) override;
+  size_t bulkInsert(std::vector<std::pair<Key, Value>>& values) override;
 
   const std::vector<std::string> keys() override;
   const std::vector<std::string> find(const Value& value, const int ttl,
                                       const int paramsMask) override;
   const std::vector<Value> showall() override;
+  const std::vector<AggregateRow> aggregate(
+      const AggregateQuery& query) override;
+  void forEachEntry(const std::function<void()>& underLock,
+                    const EntryWriter& write) override;
 
   int GetSize() { return countItems.load(); }
 
+ protected:
+  std::vector<Entry> copyEntries(
+      const std::function<void()>& underLock) override;
+
  private:
   std::vector<std::shared_ptr<Item>> m_storage;
-  std::mutex m_nodeMutex;
+  // Изменения и поиск захватывают m_nodeMutex монопольно, потому что поиск
+  // удаляет истекшие записи. Потоки обхода snapshotView_ и aggregate только
+  // читают таблицу и захватывают его совместно
+  std::shared_mutex m_nodeMutex;
+  std::shared_ptr<Dispatcher> m_dispatcher;
+  // Обход snapshotView_ делит корзины на диапазоны, каждый проходит свой
+  // поток. Корзины диапазона до Cursor обход уже прошел, в корзине Cursor -
+  // записи до LastItem включительно, отмеченные номером обхода m_snapshotWalk
+  struct SnapshotRange {
+    size_t Cursor;
+    size_t End;
+    std::shared_ptr<Item> LastItem;
+  };
+  std::vector<SnapshotRange> m_snapshotRanges;
+  uint64_t m_snapshotWalk;
+  // Фильтр Блума корзины отсекает поиск отсутствующего ключа без обхода
+  // цепочки. Удаленные ключи остаются в фильтре, пока его не перестроят
+  struct BucketFilter {
+    BloomFilter filter;
+    size_t items = 0;
+    size_t removed = 0;
+  };
+  double m_falsePositiveRate;
+  std::vector<BucketFilter> m_filters;
 
   HashKey HashFunction(const Key& key) const;
   const std::shared_ptr<Item> FindItem(const Key& key);
+  std::shared_ptr<Item> FindAliveItem(
+      const Key& key, std::shared_ptr<Item>* prevItem = nullptr);
+  void UnlinkItem(const HashKey idx, const std::shared_ptr<Item>& prev,
+                  const std::shared_ptr<Item>& item);
+  void LinkItem(const std::shared_ptr<Item>& item);
+  // Изменяют и читают только корзину idx, ее фильтр и позицию обхода в ней,
+  // поэтому потоки bulkInsert вызывают их одновременно для своих корзин.
+  // FindInBucket возвращает и истекшую запись
+  std::shared_ptr<Item> FindInBucket(const HashKey idx, const Key& key,
+                                     std::shared_ptr<Item>* prevItem) const;
+  void DetachFromBucket(const HashKey idx, const std::shared_ptr<Item>& prev,
+                        const std::shared_ptr<Item>& item);
+  void AttachToBucket(const HashKey idx, const std::shared_ptr<Item>& item);
+  // Требуют захваченного m_nodeMutex. Номер записи журнала пишется в lsn.
+  // Добавленная запись или nullptr, если ключ уже есть
+  template <typename K, typename V>
+  const Item* InsertUnderLock(K&& key, V&& value, const Deadline timeToDel,
+                              uint64_t& lsn);
+  // Непустой version - ожидаемая версия записи
+  Errors EraseUnderLock(const Key& key, bool& hadTtl, uint64_t& lsn,
+                        const std::optional<uint64_t>& version = std::nullopt);
+  Errors UpdateItem(const Key& key, const Value& value,
+                    std::chrono::milliseconds ttl, const int paramsMask,
+                    const std::optional<uint64_t>& version);
+  // Вызывает visits для живых записей на момент snapshotView_.Begin. Требует
+  // захваченного snapshotMutex_. Корзины делятся на visits.size()
+  // диапазонов, visits[i] вызывается для записей i-го диапазона из своего
+  // потока под совместно захваченным m_nodeMutex, а для записей, сохраненных
+  // в snapshotView_, - visits[0] после всех диапазонов. afterBatch
+  // вызывается без блокировки после каждых SnapshotBatchSize записей
+  // диапазона и в конце обхода, при нескольких диапазонах - одновременно
+  void WalkSnapshot(
+      const std::function<void()>& underLock,
+      const std::vector<EntryWriter>& visits,
+      const std::function<void()>& afterBatch = []() {});
+  void WalkRange(SnapshotRange& range, const Deadline at,
+                 const EntryWriter& visit,
+                 const std::function<void()>& afterBatch);
+  SnapshotRange& RangeOf(const HashKey idx);
+  // Корзины от begin до end, которые проходит i-й из count потоков
+  std::pair<size_t, size_t> BucketsOf(const size_t i, const size_t count) const;
+  void RebuildFilter(const HashKey idx);
+  void PreserveForSnapshot(const HashKey idx, const Key& key,
+                           const Item* item);
 };
 }  //  namespace s21
 
@@ -0,0 +1,1081 @@
+#include "lsm_tree.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <queue>
+#include <sstream>
+#include <unordered_set>
+
+#include "../aggregation/aggregator.h"
+#include "../dispatchers/ttl_manager.h"
+#include "../durable_file.h"
+
+namespace s21 {
+
+namespace {
+typedef std::function<bool(LsmRecord&)> RecordSource;
+
+// Во сколько раз уровень 0 может превысить levelZeroRuns, пока запись ждет
+// слияния
+constexpr size_t LevelZeroStallFactor = 3;
+// Пауза перед повтором, если файл не удалось записать
+constexpr std::chrono::seconds RetryDelay(1);
+// Число строк, которые загрузка вставляет за один захват блокировки. Меньше,
+// чем у хранилищ в памяти: проверка ключа может читать файлы уровней
+constexpr size_t UploadBatchRows = 1024;
+// MANIFEST: "S21LSMMF", номер следующего файла (u64), число записей в
+// файлах (u64), число уровней (u32), для каждого уровня число файлов (u32) и
+// их имена в порядке уровня, CRC32 всего предыдущего (u32)
+constexpr char ManifestName[] = "MANIFEST";
+constexpr char ManifestMagic[8] = {'S', '2', '1', 'L', 'S', 'M', 'M', 'F'};
+
+std::string TemporaryDirectory() {
+  static std::atomic<int> counter{0};
+  const std::string name = "s21_lsm_" + std::to_string(getpid()) + "_" +
+                           std::to_string(counter++);
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// Примерный объем записи в таблице в памяти вместе с узлом std::map
+size_t RecordBytes(const Key& key, const LsmValue& value) {
+  return key.size() + value.value.lastname.size() + value.value.name.size() +
+         value.value.city.size() + sizeof(LsmRecord) + 32;
+}
+
+RecordSource MemtableSource(const std::map<Key, LsmValue>& memtable) {
+  return [it = memtable.begin(), end = memtable.end()](
+             LsmRecord& record) mutable {
+    if (it == end) return false;
+    record = *it++;
+    return true;
+  };
+}
+
+// Файлы читаются по очереди, поэтому они не должны пересекаться по ключам
+RecordSource RunsSource(std::vector<std::shared_ptr<SortedRun>> runs) {
+  return [runs = std::move(runs), next = size_t(0),
+          cursor = std::optional<SortedRun::Cursor>()](
+             LsmRecord& record) mutable {
+    while (!cursor || !cursor->Next(record)) {
+      if (next == runs.size()) return false;
+      cursor.emplace(runs[next++]);
+    }
+    return true;
+  };
+}
+
+// Сливает источники, упорядоченные от новых к старым: для каждого ключа
+// вызывает out с самой новой версией, пока *stop не станет true
+void Merge(std::vector<RecordSource>& sources,
+           const std::function<void(LsmRecord&)>& out,
+           const std::atomic<bool>* stop = nullptr) {
+  std::vector<LsmRecord> heads(sources.size());
+  auto later = [&heads](const size_t a, const size_t b) {
+    if (heads[a].first != heads[b].first) {
+      return heads[b].first < heads[a].first;
+    }
+    return b < a;
+  };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(later)> queue(
+      later);
+  for (size_t i = 0; i < sources.size(); ++i)
+    if (sources[i](heads[i])) queue.push(i);
+  while (!queue.empty() && !(stop && stop->load())) {
+    const size_t newest = queue.top();
+    queue.pop();
+    while (!queue.empty() && heads[queue.top()].first == heads[newest].first) {
+      const size_t older = queue.top();
+      queue.pop();
+      if (sources[older](heads[older])) queue.push(older);
+    }
+    out(heads[newest]);
+    if (sources[newest](heads[newest])) queue.push(newest);
+  }
+}
+}  // namespace
+
+LsmTree::LsmTree() : LsmTree(Options()) {}
+
+//----------------------------------------------------------------
+LsmTree::LsmTree(const Options& options)
+    : options_(options),
+      directory_(options.directory.empty() ? TemporaryDirectory()
+                                           : options.directory),
+      ownsDirectory_(options.directory.empty()),
+      memtableBytes_(0),
+      levels_(1),
+      compactPointer_(1),
+      nextRunId_(0),
+      busy_(false),
+      failures_(0),
+      levelsItems_(0),
+      memtableItems_(0),
+      immutableItems_(0),
+      loadingStatistics_(false),
+      stop_(false) {
+  load();
+  countItems = static_cast<int>(levelsItems_);
+  dispatcher_ = TtlManager::getInstance().addNewContainer(*this);
+  // Открытие читает только MANIFEST и индексы файлов, значения для
+  // статистики и сроки записей читаются в фоне
+  bool hasRuns = false;
+  for (const auto& level : levels_) hasRuns = hasRuns || !level.empty();
+  if (hasRuns) {
+    loadingStatistics_ = true;
+    loader_ = std::thread(&LsmTree::loadStatistics, this, takeView());
+  }
+  worker_ = std::thread(&LsmTree::workerLoop, this);
+}
+
+//----------------------------------------------------------------
+LsmTree::~LsmTree() {
+  TtlManager::getInstance().deleteContainer(*this);
+  DisableLog();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+  if (loader_.joinable()) loader_.join();
+  worker_.join();
+  if (ownsDirectory_) {
+    for (auto& level : levels_)
+      for (auto& run : level) run->MarkObsolete();
+    levels_.clear();
+    std::error_code error;
+    std::filesystem::remove_all(directory_, error);
+  }
+}
+
+//----------------------------------------------------------------
+Errors LsmTree::set(const std::string& key, const Value& value,
+                    std::chrono::milliseconds ttl) {
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  uint64_t lsn = 0;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    waitForRoom(lock);
+    Errors res = setLocked(key, value, timeToDel, lsn);
+    if (res != noErrors) return res;
+    // Диспетчер меняется под mutex_, иначе после set/del/set с разных потоков
+    // в нем мог бы остаться срок не той записи, что лежит в дереве
+    if (timeToDel != NoDeadline)
+      TtlManager::getInstance().addOrUpdateNode(*dispatcher_, key, timeToDel);
+  }
+  return CommitChange(lsn);
+}
+
+//----------------------------------------------------------------
+std::optional<Value> LsmTree::get(const std::string& key) {
+  std::optional<LsmValue> found = readAlive(key);
+  if (!found) return std::nullopt;
+  return std::move(found->value);
+}
+
+//----------------------------------------------------------------
+bool LsmTree::visit(const Key& key,
+                    const std::function<void(const Value&)>& visitor) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Запись из таблицы в памяти передается без копирования, запись из
+    // файла все равно приходится читать в новый Value
+    auto it = memtable_.find(key);
+    if (it != memtable_.end() && !it->second.tombstone &&
+        !IsExpired(it->second.timeToDel)) {
+      visitor(it->second.value);
+      return true;
+    }
+  }
+  std::optional<LsmValue> found = readAlive(key);
+  if (!found) return false;
+  visitor(found->value);
+  return true;
+}
+
+//----------------------------------------------------------------
+bool LsmTree::exists(const std::string& key) {
+  return readAlive(key).has_value();
+}
+
+//----------------------------------------------------------------
+Errors LsmTree::del(const std::string& key) {
+  bool hasTtl = false;
+  uint64_t lsn = 0;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    waitForRoom(lock);
+    Errors res = delLocked(key, hasTtl, lsn);
+    if (res != noErrors) return res;
+    if (hasTtl) TtlManager::getInstance().deleteNode(*dispatcher_, key);
+  }
+  return CommitChange(lsn);
+}
+
+//----------------------------------------------------------------
+std::vector<std::optional<Value>> LsmTree::mget(const std::vector<Key>& keys) {
+  std::vector<std::optional<Value>> res(keys.size());
+  // Как в readAlive: под блокировкой проверяются таблицы в памяти и
+  // выбираются файлы, файлы читаются без нее
+  std::vector<std::pair<size_t, Level>> pending;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (!lookupMemory(keys[i])) {
+        pending.emplace_back(i, candidateRuns(keys[i]));
+        continue;
+      }
+      std::optional<LsmValue> found = findAlive(keys[i]);
+      if (found) res[i] = std::move(found->value);
+    }
+  }
+  std::vector<size_t> expired;
+  for (const auto& [i, runs] : pending) {
+    std::optional<LsmValue> found = lookupRuns(runs, keys[i]);
+    if (!found || found->tombstone) continue;
+    if (IsExpired(found->timeToDel))
+      expired.push_back(i);
+    else
+      res[i] = std::move(found->value);
+  }
+  if (expired.empty()) return res;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const size_t i : expired) {
+    std::optional<LsmValue> found = findAlive(keys[i]);
+    if (found) res[i] = std::move(found->value);
+  }
+  return res;
+}
+
+//----------------------------------------------------------------
+std::vector<Errors> LsmTree::mset(
+    const std::vector<std::pair<Key, Value>>& values,
+    std::chrono::milliseconds ttl) {
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  std::vector<Errors> res;
+  res.reserve(values.size());
+  uint64_t lsn = 0;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const auto& [key, value] : values) {
+      // Блокировка отпускается на время ожидания сброса таблицы, поэтому
+      // диспетчер обновляется сразу после каждой записи
+      waitForRoom(lock);
+      res.push_back(setLocked(key, value, timeToDel, lsn));
+      if (res.back() == noErrors && timeToDel != NoDeadline)
+        TtlManager::getInstance().addOrUpdateNode(*dispatcher_, key,
+                                                  timeToDel);
+    }
+  }
+  CommitChanges(lsn, res);
+  return res;
+}
+
+//----------------------------------------------------------------
+std::vector<Errors> LsmTree::mdel(const std::vector<Key>& keys) {
+  std::vector<Errors> res;
+  res.reserve(keys.size());
+  uint64_t lsn = 0;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const auto& key : keys) {
+      waitForRoom(lock);
+      bool hasTtl = false;
+      res.push_back(delLocked(key, hasTtl, lsn));
+      if (hasTtl) TtlManager::getInstance().deleteNode(*dispatcher_, key);
+    }
+  }
+  CommitChanges(lsn, res);
+  return res;
+}
+
+//----------------------------------------------------------------
+Errors LsmTree::update(const Key& key, const Value& value,
+                       std::chrono::milliseconds ttl, const int paramsMask) {
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  uint64_t lsn = 0;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    waitForRoom(lock);
+    std::optional<LsmValue> found = findAlive(key);
+    if (!found) return keyNotFound;
+    if (claimStatistics(key)) statistics_.Erase(found->value);
+    if (paramsMask & pLastname) found->value.lastname = value.lastname;
+    if (paramsMask & pName) found->value.name = value.name;
+    if (paramsMask & pYear) found->value.year = value.year;
+    if (paramsMask & pCity) found->value.city = value.city;
+    if (paramsMask & pCoins) found->value.coins = value.coins;
+    statistics_.Insert(found->value);
+    if (paramsMask & pTtl) found->timeToDel = timeToDel;
+    notifier_.Publish(evUpdate, key);
+    lsn = RecordChange(logUpdate, key, found->value, found->timeToDel);
+    put(key, std::move(*found));
+    if (paramsMask & pTtl)
+      TtlManager::getInstance().addOrUpdateNode(*dispatcher_, key, timeToDel);
+  }
+  return CommitChange(lsn);
+}
+
+//----------------------------------------------------------------
+Errors LsmTree::rename(const std::string& oldKey, const std::string& newKey) {
+  uint64_t lsn = 0;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    waitForRoom(lock);
+    std::optional<LsmValue> found = findAlive(oldKey);
+    if (!found) return keyNotFound;
+    if (findAlive(newKey)) return keyAlreadyExists;
+    const Deadline timeToDel = found->timeToDel;
+    // Запись уходит из-под ключа, до которого загрузка статистики еще не
+    // дошла, поэтому учитывается сразу
+    if (!claimStatistics(oldKey)) statistics_.Insert(found->value);
+    claimStatistics(newKey);
+    put(oldKey, LsmValue{true, Value{}, NoDeadline}, -1);
+    put(newKey, std::move(*found), 1);
+    notifier_.Publish(evRename, oldKey, newKey);
+    lsn = RecordChange(logRename, oldKey, newKey);
+    if (timeToDel != NoDeadline) {
+      TtlManager::getInstance().deleteNode(*dispatcher_, oldKey);
+      TtlManager::getInstance().addOrUpdateNode(*dispatcher_, newKey,
+                                                timeToDel);
+    }
+  }
+  return CommitChange(lsn);
+}
+
+//----------------------------------------------------------------
+Errors LsmTree::incrBy(const Key& key, const int field, const int delta,
+                       int& result) {
+  uint64_t lsn = 0;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    waitForRoom(lock);
+    std::optional<LsmValue> found = findAlive(key);
+    if (!found) return keyNotFound;
+    std::optional<int> number = IncrementedField(found->value, field, delta);
+    if (!number) return valueOutOfRange;
+    // Статистика ведется только по строковым полям и не меняется
+    SetNumericField(found->value, field, *number);
+    notifier_.Publish(evUpdate, key);
+    lsn = RecordChange(logUpdate, key, found->value, found->timeToDel);
+    put(key, std::move(*found));
+    result = *number;
+  }
+  return CommitChange(lsn);
+}
+
+//----------------------------------------------------------------
+long long LsmTree::PTtl(const std::string& key) {
+  std::optional<LsmValue> found = readAlive(key);
+  if (!found) return keyNotFound;
+  return RemainingMs(found->timeToDel);
+}
+
+//----------------------------------------------------------------
+size_t LsmTree::expireBatch(const std::vector<std::string>& keys) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int sizeBefore = countItems.load();
+  for (const auto& key : keys) findAlive(key);
+  return static_cast<size_t>(sizeBefore - countItems.load());
+}
+
+//----------------------------------------------------------------
+std::vector<std::string> LsmTree::expiringWithin(
+    std::chrono::milliseconds window) {
+  const Deadline now = Clock::now();
+  const Deadline until = SaturatingAdd(now, window);
+  auto candidates = dispatcher_->ExpiringBetween(now, until);
+  // Диспетчер может помнить удаленный ключ или прежнее время жизни,
+  // поэтому оно берется из найденной записи
+  std::vector<std::string> res;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& key : candidates) {
+    std::optional<LsmValue> found = findAlive(key);
+    if (found && found->timeToDel <= until) res.push_back(key);
+  }
+  return res;
+}
+
+//----------------------------------------------------------------
+std::vector<size_t> LsmTree::expiryHistogram(std::chrono::milliseconds bucket,
+                                             const size_t bucketsCount) {
+  // Как и в expiringWithin, считается только срок, совпадающий с записью
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dispatcher_->CountByBuckets(
+      Clock::now(), bucket, bucketsCount,
+      [this](const Key& key, const Deadline deadline) {
+        std::optional<LsmValue> found = findAlive(key);
+        return found && found->timeToDel == deadline;
+      });
+}
+
+//----------------------------------------------------------------
+size_t LsmTree::bulkInsert(std::vector<std::pair<Key, Value>>& values) {
+  uint64_t lsn = 0;
+  size_t inserted = 0;
+  // Блокировка отпускается после каждого пакета, чтобы загрузка не
+  // останавливала остальные запросы до своего окончания
+  for (size_t done = 0; done < values.size();) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      const size_t end = std::min(values.size(), done + UploadBatchRows);
+      for (; done < end; ++done) {
+        auto& row = values[done];
+        waitForRoom(lock);
+        if (findAlive(row.first)) continue;
+        ++inserted;
+        claimStatistics(row.first);
+        statistics_.Insert(row.second);
+        notifier_.Publish(evSet, row.first);
+        lsn = RecordChange(logSet, row.first, row.second, NoDeadline);
+        put(std::move(row.first),
+            LsmValue{false, std::move(row.second), NoDeadline}, 1);
+      }
+    }
+    std::this_thread::yield();
+  }
+  // Ошибку записи журнала показывает LogFailed
+  log_.Commit(lsn);
+  return inserted;
+}
+
+//----------------------------------------------------------------
+const std::vector<std::string> LsmTree::keys() {
+  View view;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    view = takeView();
+  }
+  std::vector<std::string> res;
+  scan(view, Clock::now(),
+       [&res](const Key& key, const Value&, const Deadline) {
+         res.push_back(key);
+       });
+  return res;
+}
+
+//----------------------------------------------------------------
+const std::vector<std::string> LsmTree::find(const Value& value, const int ttl,
+                                             const int paramsMask) {
+  std::vector<std::string> res;
+  if (paramsMask & pTtl) {
+    const auto [from, to] = TtlWindow(ttl);
+    auto candidates = dispatcher_->ExpiringBetween(from, to);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& key : candidates) {
+      std::optional<LsmValue> found = findAlive(key);
+      if (found &&
+          IsMatch(found->value, found->timeToDel, value, ttl, paramsMask))
+        res.push_back(key);
+    }
+    return res;
+  }
+  View view;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    view = takeView();
+  }
+  scan(view, Clock::now(),
+       [&](const Key& key, const Value& stored, const Deadline timeToDel) {
+         if (IsMatch(stored, timeToDel, value, ttl, paramsMask))
+           res.push_back(key);
+       });
+  return res;
+}
+
+//----------------------------------------------------------------
+const std::vector<Value> LsmTree::showall() {
+  View view;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    view = takeView();
+  }
+  std::vector<Value> res;
+  scan(view, Clock::now(),
+       [&res](const Key&, const Value& value, const Deadline) {
+         res.push_back(value);
+       });
+  return res;
+}
+
+//----------------------------------------------------------------
+const std::vector<AggregateRow> LsmTree::aggregate(
+    const AggregateQuery& query) {
+  View view;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    view = takeView();
+  }
+  Aggregator aggregator(query);
+  scan(view, Clock::now(),
+       [&](const Key&, const Value& value, const Deadline timeToDel) {
+         if (IsMatch(value, timeToDel, query.filter, query.ttl,
+                     query.paramsMask))
+           aggregator.Add(value);
+       });
+  return aggregator.Result();
+}
+
+//----------------------------------------------------------------
+bool LsmTree::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const uint64_t failures = failures_;
+  changed_.wait(lock, [&]() { return !immutable_ || failures_ != failures; });
+  if (failures_ != failures) return false;
+  if (!memtable_.empty()) rotateMemtable();
+  // Неудачный сброс или слияние фоновый поток повторяет, но ждать их
+  // успеха нельзя: при нехватке места на диске повторы не кончатся
+  changed_.wait(lock, [&]() {
+    return (!immutable_ && !busy_ && !pickCompaction()) ||
+           failures_ != failures;
+  });
+  return failures_ == failures;
+}
+
+//----------------------------------------------------------------
+std::vector<size_t> LsmTree::runsPerLevel() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<size_t> res;
+  for (const auto& level : levels_) res.push_back(level.size());
+  return res;
+}
+
+//----------------------------------------------------------------
+void LsmTree::forEachEntry(const std::function<void()>& underLock,
+                           const EntryWriter& write) {
+  View view;
+  Deadline at;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    underLock();
+    view = takeView();
+    at = Clock::now();
+  }
+  // Файлы представления неизменяемы, а в памяти остается только копия
+  // таблицы, поэтому обход не зависит от объема данных
+  scan(view, at, write);
+}
+
+//----------------------------------------------------------------
+std::vector<Entry> LsmTree::copyEntries(
+    const std::function<void()>& underLock) {
+  std::vector<Entry> entries;
+  entries.reserve(countItems.load());
+  forEachEntry(underLock, [&entries](const Key& key, const Value& value,
+                                     const Deadline timeToDel) {
+    entries.push_back({key, value, timeToDel});
+  });
+  return entries;
+}
+
+//----------------------------------------------------------------
+void LsmTree::load() {
+  std::error_code error;
+  std::filesystem::create_directories(directory_, error);
+  if (error || !std::filesystem::is_directory(directory_)) {
+    std::stringstream str;
+    str << "Directory " << directory_ << " not open\n";
+    throw std::runtime_error(str.str().c_str());
+  }
+  const std::string manifestName = directory_ + "/" + ManifestName;
+  std::unordered_set<std::string> listed;
+  if (std::filesystem::exists(manifestName, error)) {
+    MappedFile file(manifestName);
+    std::string_view data = file.View();
+    if (data.size() < sizeof(ManifestMagic) + sizeof(uint32_t) ||
+        std::memcmp(data.data(), ManifestMagic, sizeof(ManifestMagic)) != 0)
+      throw std::runtime_error("Corrupted manifest: bad header");
+    const size_t crcOffset = data.size() - sizeof(uint32_t);
+    if (Crc32(data.substr(0, crcOffset)) !=
+        BinaryReader(data.substr(crcOffset)).Get<uint32_t>())
+      throw std::runtime_error("Corrupted manifest: checksum mismatch");
+    BinaryReader reader(data.substr(sizeof(ManifestMagic),
+                                    crcOffset - sizeof(ManifestMagic)));
+    nextRunId_ = reader.Get<uint64_t>();
+    levelsItems_ = static_cast<int64_t>(reader.Get<uint64_t>());
+    levels_.resize(std::max<uint32_t>(reader.Get<uint32_t>(), 1));
+    for (auto& level : levels_) {
+      const uint32_t runsCount = reader.Get<uint32_t>();
+      for (uint32_t i = 0; i < runsCount; ++i) {
+        const std::string name = reader.GetString();
+        level.push_back(SortedRun::Open(directory_ + "/" + name,
+                                        options_.bloomFalsePositiveRate));
+        listed.insert(name);
+      }
+    }
+    if (!reader.AtEnd())
+      throw std::runtime_error("Corrupted manifest: size mismatch");
+  }
+  compactPointer_.assign(levels_.size(), Key());
+  // Файлы, которых нет в MANIFEST, остались от прерванного сброса или
+  // слияния
+  for (const auto& file : std::filesystem::directory_iterator(directory_)) {
+    const std::string name = file.path().filename().string();
+    if (file.path().extension() == ".run" && !listed.count(name))
+      std::filesystem::remove(file.path(), error);
+  }
+  std::filesystem::remove(manifestName + ".tmp", error);
+}
+
+//----------------------------------------------------------------
+void LsmTree::loadStatistics(const View& view) {
+  // Истекшие записи тоже учитываются, их удалит TtlManager или обращение к
+  // ним. Блокировка берется на одну запись
+  scan(
+      view, Deadline::min(),
+      [this](const Key& key, const Value& value, const Deadline timeToDel) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loadCursor_ = key;
+        std::optional<Deadline> deadline = timeToDel;
+        if (loadClaimed_.erase(key)) {
+          // Статистику ключа уже ведут операции, а срок берется из текущей
+          // записи: операция могла изменить запись, не меняя срока
+          std::optional<LsmValue> current = lookup(key);
+          deadline.reset();
+          if (current && !current->tombstone) deadline = current->timeToDel;
+        } else {
+          statistics_.Insert(value);
+        }
+        if (deadline && *deadline != NoDeadline)
+          TtlManager::getInstance().addOrUpdateNode(*dispatcher_, key,
+                                                    *deadline);
+      },
+      &stop_);
+  std::lock_guard<std::mutex> lock(mutex_);
+  loadingStatistics_ = false;
+  loadCursor_.reset();
+  loadClaimed_.clear();
+}
+
+//----------------------------------------------------------------
+bool LsmTree::claimStatistics(const Key& key) {
+  if (!loadingStatistics_ || (loadCursor_ && key <= *loadCursor_)) return true;
+  return !loadClaimed_.insert(key).second;
+}
+
+//----------------------------------------------------------------
+std::string LsmTree::manifestData(const std::vector<Level>& levels,
+                                  const int64_t items) const {
+  std::string data(ManifestMagic, sizeof(ManifestMagic));
+  Put<uint64_t>(data, nextRunId_.load());
+  Put<uint64_t>(data, static_cast<uint64_t>(items));
+  Put<uint32_t>(data, static_cast<uint32_t>(levels.size()));
+  for (const auto& level : levels) {
+    Put<uint32_t>(data, static_cast<uint32_t>(level.size()));
+    for (const auto& run : level)
+      PutString(data,
+                std::filesystem::path(run->FileName()).filename().string());
+  }
+  Put<uint32_t>(data, Crc32(data));
+  return data;
+}
+
+//----------------------------------------------------------------
+bool LsmTree::writeManifest(const std::string& data) const {
+  // MANIFEST заменяется переименованием после сброса на диск, поэтому после
+  // сбоя остается целым и ссылается только на сброшенные файлы уровней
+  return ReplaceFileDurably(directory_ + "/" + ManifestName, data);
+}
+
+//----------------------------------------------------------------
+std::optional<LsmValue> LsmTree::lookup(const Key& key) const {
+  std::optional<LsmValue> found = lookupMemory(key);
+  if (found) return found;
+  return lookupRuns(candidateRuns(key), key);
+}
+
+//----------------------------------------------------------------
+std::optional<LsmValue> LsmTree::lookupMemory(const Key& key) const {
+  auto found = memtable_.find(key);
+  if (found != memtable_.end()) return found->second;
+  if (immutable_) {
+    found = immutable_->find(key);
+    if (found != immutable_->end()) return found->second;
+  }
+  return std::nullopt;
+}
+
+//----------------------------------------------------------------
+LsmTree::Level LsmTree::candidateRuns(const Key& key) const {
+  // Фильтры и границы файлов хранятся в памяти, диск не читается
+  Level res;
+  const uint64_t hash = BloomFilter::HashOf(key);
+  for (const auto& run : levels_[0])
+    if (run->Overlaps(key, key) && run->MayContain(hash)) res.push_back(run);
+  for (size_t i = 1; i < levels_.size(); ++i) {
+    const Level& level = levels_[i];
+    auto run = std::upper_bound(
+        level.begin(), level.end(), key,
+        [](const Key& k, const std::shared_ptr<SortedRun>& r) {
+          return k < r->FirstKey();
+        });
+    if (run == level.begin()) continue;
+    const auto& candidate = *std::prev(run);
+    if (!(candidate->LastKey() < key) && candidate->MayContain(hash))
+      res.push_back(candidate);
+  }
+  return res;
+}
+
+//----------------------------------------------------------------
+std::optional<LsmValue> LsmTree::lookupRuns(const Level& runs,
+                                            const Key& key) {
+  try {
+    for (const auto& run : runs)
+      if (std::optional<LsmValue> value = run->Get(key)) return value;
+  } catch (const std::exception&) {
+    // Поврежденный блок считается пустым. Более старые версии ключа не
+    // ищутся: их могла перекрывать запись поврежденного блока
+  }
+  return std::nullopt;
+}
+
+//----------------------------------------------------------------
+std::optional<LsmValue> LsmTree::findAlive(const Key& key) {
+  std::optional<LsmValue> found = lookup(key);
+  if (!found || found->tombstone) return std::nullopt;
+  if (IsExpired(found->timeToDel)) {
+    // Истекшая запись считается отсутствующей и удаляется при обращении
+    put(key, LsmValue{true, Value{}, NoDeadline}, -1);
+    if (claimStatistics(key)) statistics_.Erase(found->value);
+    notifier_.Publish(evExpire, key);
+    RecordChange(logExpire, key);
+    return std::nullopt;
+  }
+  return found;
+}
+
+//----------------------------------------------------------------
+std::optional<LsmValue> LsmTree::readAlive(const Key& key) {
+  Level runs;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (lookupMemory(key)) return findAlive(key);
+    runs = candidateRuns(key);
+  }
+  // Файлы списка не удаляются, пока на них есть ссылки, поэтому слияние
+  // во время чтения ему не мешает
+  std::optional<LsmValue> found = lookupRuns(runs, key);
+  if (!found || found->tombstone) return std::nullopt;
+  if (!IsExpired(found->timeToDel)) return found;
+  // Пока файл читался, ключ могли изменить, поэтому удаление проверяет
+  // текущую запись
+  std::lock_guard<std::mutex> lock(mutex_);
+  return findAlive(key);
+}
+
+//----------------------------------------------------------------
+Errors LsmTree::setLocked(const Key& key, const Value& value,
+                          const Deadline timeToDel, uint64_t& lsn) {
+  if (findAlive(key)) return keyAlreadyExists;
+  put(key, LsmValue{false, value, timeToDel}, 1);
+  claimStatistics(key);
+  statistics_.Insert(value);
+  notifier_.Publish(evSet, key);
+  lsn = RecordChange(logSet, key, value, timeToDel);
+  return noErrors;
+}
+
+//----------------------------------------------------------------
+Errors LsmTree::delLocked(const Key& key, bool& hasTtl, uint64_t& lsn) {
+  std::optional<LsmValue> found = findAlive(key);
+  if (!found) return keyNotFound;
+  hasTtl = HasPendingTtl(found->timeToDel);
+  put(key, LsmValue{true, Value{}, NoDeadline}, -1);
+  if (claimStatistics(key)) statistics_.Erase(found->value);
+  notifier_.Publish(evDel, key);
+  lsn = RecordChange(logDel, key);
+  return noErrors;
+}
+
+//----------------------------------------------------------------
+void LsmTree::put(Key key, LsmValue value, const int itemsDelta) {
+  countItems += itemsDelta;
+  memtableItems_ += itemsDelta;
+  memtableBytes_ += RecordBytes(key, value);
+  memtable_.insert_or_assign(std::move(key), std::move(value));
+  // Отметки об удалении истекших записей пишутся и при чтении, и при
+  // удалении по времени, где waitForRoom не вызывается
+  if (memtableBytes_ >= options_.memtableBytes && !immutable_)
+    rotateMemtable();
+}
+
+//----------------------------------------------------------------
+void LsmTree::rotateMemtable() {
+  immutable_ = std::make_shared<const Memtable>(std::move(memtable_));
+  memtable_.clear();
+  memtableBytes_ = 0;
+  immutableItems_ = memtableItems_;
+  memtableItems_ = 0;
+  changed_.notify_all();
+}
+
+//----------------------------------------------------------------
+void LsmTree::waitForRoom(std::unique_lock<std::mutex>& lock) {
+  while (!stop_) {
+    if (levels_[0].size() < options_.levelZeroRuns * LevelZeroStallFactor) {
+      if (memtableBytes_ < options_.memtableBytes) return;
+      if (!immutable_) {
+        rotateMemtable();
+        return;
+      }
+    }
+    changed_.wait(lock);
+  }
+}
+
+//----------------------------------------------------------------
+LsmTree::View LsmTree::takeView() const {
+  return View{memtable_, immutable_, levels_};
+}
+
+//----------------------------------------------------------------
+std::optional<LsmTree::Compaction> LsmTree::pickCompaction() const {
+  if (levels_[0].size() >= options_.levelZeroRuns) {
+    Compaction compaction{0, levels_[0], {}, isBottom(1)};
+    Key first = levels_[0].front()->FirstKey();
+    Key last = levels_[0].front()->LastKey();
+    for (const auto& run : levels_[0]) {
+      first = std::min(first, run->FirstKey());
+      last = std::max(last, run->LastKey());
+    }
+    if (levels_.size() > 1) {
+      for (const auto& run : levels_[1])
+        if (run->Overlaps(first, last)) compaction.overlapping.push_back(run);
+    }
+    return compaction;
+  }
+  for (size_t i = 1; i < levels_.size(); ++i) {
+    uint64_t bytes = 0;
+    for (const auto& run : levels_[i]) bytes += run->FileSize();
+    if (bytes <= maxLevelBytes(i)) continue;
+    // Файлы уровня сливаются по кругу, чтобы ключи обновлялись равномерно
+    auto next = std::find_if(levels_[i].begin(), levels_[i].end(),
+                             [&](const std::shared_ptr<SortedRun>& run) {
+                               return compactPointer_[i] < run->FirstKey();
+                             });
+    if (next == levels_[i].end()) next = levels_[i].begin();
+    Compaction compaction{i, {*next}, {}, isBottom(i + 1)};
+    if (i + 1 < levels_.size()) {
+      for (const auto& run : levels_[i + 1])
+        if (run->Overlaps((*next)->FirstKey(), (*next)->LastKey()))
+          compaction.overlapping.push_back(run);
+    }
+    return compaction;
+  }
+  return std::nullopt;
+}
+
+//----------------------------------------------------------------
+bool LsmTree::isBottom(const size_t level) const {
+  for (size_t i = level + 1; i < levels_.size(); ++i)
+    if (!levels_[i].empty()) return false;
+  return true;
+}
+
+//----------------------------------------------------------------
+uint64_t LsmTree::maxLevelBytes(const size_t level) const {
+  uint64_t res = options_.runBytes;
+  for (size_t i = 0; i < level; ++i) res *= options_.levelRatio;
+  return res;
+}
+
+//----------------------------------------------------------------
+void LsmTree::scan(const View& view, const Deadline at,
+                   const std::function<void(const Key&, const Value&,
+                                            const Deadline)>& func,
+                   const std::atomic<bool>* stop) {
+  std::vector<RecordSource> sources;
+  sources.push_back(MemtableSource(view.memtable));
+  if (view.immutable) sources.push_back(MemtableSource(*view.immutable));
+  for (const auto& run : view.levels[0]) sources.push_back(RunsSource({run}));
+  for (size_t i = 1; i < view.levels.size(); ++i)
+    sources.push_back(RunsSource(view.levels[i]));
+  // Исключения func передаются дальше, а на поврежденном блоке обход
+  // останавливается
+  bool damaged = false;
+  for (auto& source : sources)
+    source = [source = std::move(source), &damaged](LsmRecord& record) {
+      try {
+        return source(record);
+      } catch (const std::exception&) {
+        damaged = true;
+        throw;
+      }
+    };
+  try {
+    Merge(
+        sources,
+        [&](LsmRecord& record) {
+          if (!record.second.tombstone &&
+              !IsExpired(record.second.timeToDel, at))
+            func(record.first, record.second.value, record.second.timeToDel);
+        },
+        stop);
+  } catch (const std::exception&) {
+    if (!damaged) throw;
+  }
+}
+
+//----------------------------------------------------------------
+void LsmTree::workerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // При закрытии сохраняемого каталога таблица в памяти сбрасывается на
+    // диск, новые слияния не начинаются
+    if (stop_ && (ownsDirectory_ || (!immutable_ && memtable_.empty())))
+      break;
+    if (stop_ && !immutable_) rotateMemtable();
+    std::vector<RecordSource> sources;
+    bool dropTombstones = false;
+    std::shared_ptr<const Memtable> flushed = immutable_;
+    std::optional<Compaction> compaction;
+    if (flushed) {
+      sources.push_back(MemtableSource(*flushed));
+      dropTombstones = levels_[0].empty() && isBottom(0);
+    } else if (!stop_ && (compaction = pickCompaction())) {
+      for (const auto& run : compaction->inputs)
+        sources.push_back(RunsSource({run}));
+      sources.push_back(RunsSource(compaction->overlapping));
+      dropTombstones = compaction->dropTombstones;
+    } else {
+      changed_.wait(lock);
+      continue;
+    }
+    busy_ = true;
+    lock.unlock();
+    Level outputs;
+    bool failed = false;
+    try {
+      outputs = writeRuns(sources, dropTombstones);
+    } catch (const std::exception&) {
+      failed = true;
+    }
+    lock.lock();
+    std::vector<Level> levels;
+    bool manifestWritten = false;
+    if (!failed) {
+      // Уровни меняет только этот поток, поэтому новые уровни собираются под
+      // блокировкой, а MANIFEST для них пишется и сбрасывается на диск без
+      // нее
+      levels = levels_;
+      if (flushed)
+        levels[0].insert(levels[0].begin(), outputs.begin(), outputs.end());
+      else
+        levels = merged(std::move(levels), *compaction, outputs);
+      // Слияние не меняет числа записей, сброс добавляет изменение таблицы
+      const std::string manifest = manifestData(
+          levels, levelsItems_ + (flushed ? immutableItems_ : 0));
+      lock.unlock();
+      manifestWritten = writeManifest(manifest);
+      lock.lock();
+      // Файл, которого нет в MANIFEST, удаляется при открытии, поэтому
+      // таблица в памяти остается до записи MANIFEST
+      if (flushed && !manifestWritten) {
+        for (auto& run : outputs) run->MarkObsolete();
+        failed = true;
+      }
+    }
+    busy_ = false;
+    if (failed) {
+      ++failures_;
+      changed_.notify_all();
+      // Данные остаются в памяти и в прежних файлах, запись повторится.
+      // При закрытии изменения остаются только в журнале операций
+      if (stop_) break;
+      changed_.wait_for(lock, RetryDelay);
+      continue;
+    }
+    if (flushed) {
+      levels_ = std::move(levels);
+      levelsItems_ += immutableItems_;
+      immutableItems_ = 0;
+      immutable_.reset();
+      // Таблица могла переполниться, пока предыдущая сбрасывалась
+      if (memtableBytes_ >= options_.memtableBytes) rotateMemtable();
+    } else {
+      install(*compaction, std::move(levels), manifestWritten);
+    }
+    changed_.notify_all();
+  }
+}
+
+//----------------------------------------------------------------
+LsmTree::Level LsmTree::writeRuns(std::vector<RecordSource>& sources,
+                                  const bool dropTombstones) {
+  Level outputs;
+  std::optional<SortedRun::Builder> builder;
+  std::string runName;
+  try {
+    Merge(sources, [&](LsmRecord& record) {
+      if (dropTombstones && record.second.tombstone) return;
+      if (!builder)
+        builder.emplace(runName = newRunName(),
+                        options_.bloomFalsePositiveRate);
+      builder->Add(record.first, record.second);
+      if (builder->Size() >= options_.runBytes) {
+        outputs.push_back(builder->Finish());
+        builder.reset();
+      }
+    });
+    if (builder) {
+      std::shared_ptr<SortedRun> run = builder->Finish();
+      builder.reset();
+      if (run) outputs.push_back(std::move(run));
+    }
+  } catch (...) {
+    if (builder) {
+      builder.reset();
+      std::remove(runName.c_str());
+    }
+    for (auto& run : outputs) run->MarkObsolete();
+    throw;
+  }
+  return outputs;
+}
+
+//----------------------------------------------------------------
+std::vector<LsmTree::Level> LsmTree::merged(std::vector<Level> levels,
+                                            const Compaction& compaction,
+                                            const Level& outputs) {
+  auto remove = [](Level& level, const Level& runs) {
+    for (const auto& run : runs)
+      level.erase(std::find(level.begin(), level.end(), run));
+  };
+  const size_t target = compaction.level + 1;
+  if (levels.size() <= target) levels.resize(target + 1);
+  remove(levels[compaction.level], compaction.inputs);
+  remove(levels[target], compaction.overlapping);
+  Level& level = levels[target];
+  level.insert(level.end(), outputs.begin(), outputs.end());
+  std::sort(level.begin(), level.end(),
+            [](const std::shared_ptr<SortedRun>& a,
+               const std::shared_ptr<SortedRun>& b) {
+              return a->FirstKey() < b->FirstKey();
+            });
+  return levels;
+}
+
+//----------------------------------------------------------------
+void LsmTree::install(const Compaction& compaction, std::vector<Level> levels,
+                      const bool manifestWritten) {
+  levels_ = std::move(levels);
+  compactPointer_.resize(levels_.size());
+  if (compaction.level > 0)
+    compactPointer_[compaction.level] = compaction.inputs.back()->LastKey();
+  // Прежний MANIFEST ссылается на замененные файлы. Если новый не
+  // записался, они остаются на диске и удаляются при следующем открытии
+  if (!manifestWritten) return;
+  for (const auto& run : compaction.inputs) run->MarkObsolete();
+  for (const auto& run : compaction.overlapping) run->MarkObsolete();
+}
+
+//----------------------------------------------------------------
+std::string LsmTree::newRunName() {
+  return directory_ + "/" + std::to_string(nextRunId_++) + ".run";
+}
+
+}  //  namespace s21
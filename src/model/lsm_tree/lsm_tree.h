@@ -0,0 +1,225 @@
+// Хранилище на LSM-дереве для данных, которые не помещаются в память.
+// Список файлов по уровням хранится в файле MANIFEST каталога
+#ifndef SRC_MODEL_LSM_TREE_LSM_TREE_H_
+#define SRC_MODEL_LSM_TREE_LSM_TREE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include "../abstract_key_value_store/abstract_key_value_store.h"
+#include "../dispatchers/dispatcher_base.h"
+#include "sorted_run.h"
+
+namespace s21 {
+class LsmTree : public AbstractKeyValueStore {
+ public:
+  struct Options {
+    // Каталог создается, если его нет, и сохраняется после закрытия.
+    // Пустая строка - новый каталог во временном каталоге системы, который
+    // удаляется при закрытии
+    std::string directory;
+    // Размер таблицы в памяти, после которого она сбрасывается на диск
+    size_t memtableBytes = 4 << 20;
+    // Размер файлов, на которые слияние делит уровень
+    size_t runBytes = 8 << 20;
+    size_t levelZeroRuns = 4;
+    // Уровень i вмещает runBytes * levelRatio^i байт
+    size_t levelRatio = 10;
+    // Доля ложных срабатываний фильтров Блума файлов, 0 - без фильтров
+    double bloomFalsePositiveRate = 0.01;
+  };
+
+  LsmTree();
+  // Бросает std::runtime_error с "not open", если каталог или файл уровня
+  // не открылся, и с "Corrupted", если MANIFEST или индекс файла уровня
+  // поврежден. Блоки файлов проверяются при чтении: ключ из поврежденного
+  // блока считается отсутствующим, а обход на таком блоке останавливается
+  explicit LsmTree(const Options& options);
+  ~LsmTree() override;
+
+  using AbstractKeyValueStore::mset;
+  using AbstractKeyValueStore::set;
+  using AbstractKeyValueStore::update;
+
+  Errors set(const std::string& key, const Value& value,
+             std::chrono::milliseconds ttl) override;
+  std::optional<Value> get(const std::string& key) override;
+  bool visit(const Key& key,
+             const std::function<void(const Value&)>& visitor) override;
+  bool exists(const std::string& key) override;
+  Errors del(const std::string& key) override;
+  Errors update(const Key& key, const Value& value,
+                std::chrono::milliseconds ttl, const int paramsMask) override;
+  Errors rename(const std::string& oldKey, const std::string& newKey) override;
+  Errors incrBy(const Key& key, const int field, const int delta,
+                int& result) override;
+  long long PTtl(const std::string& key) override;
+  std::vector<std::optional<Value>> mget(
+      const std::vector<Key>& keys) override;
+  std::vector<Errors> mset(const std::vector<std::pair<Key, Value>>& values,
+                           std::chrono::milliseconds ttl) override;
+  std::vector<Errors> mdel(const std::vector<Key>& keys) override;
+  size_t expireBatch(const std::vector<std::string>& keys) override;
+  std::vector<std::string> expiringWithin(
+      std::chrono::milliseconds window) override;
+  std::vector<size_t> expiryHistogram(std::chrono::milliseconds bucket,
+                                      const size_t bucketsCount) override;
+  size_t bulkInsert(std::vector<std::pair<Key, Value>>& values) override;
+  void forEachEntry(const std::function<void()>& underLock,
+                    const EntryWriter& write) override;
+  // Обход слиянием уровней уже идет по возрастанию ключей
+  void forEachEntryByKey(const EntryWriter& write) override {
+    forEachEntry([]() {}, write);
+  }
+
+  const std::vector<std::string> keys() override;
+  const std::vector<std::string> find(const Value& value, const int ttl,
+                                      const int paramsMask) override;
+  const std::vector<Value> showall() override;
+  const std::vector<AggregateRow> aggregate(
+      const AggregateQuery& query) override;
+
+  // Сбрасывает таблицу в памяти на диск и ждет окончания слияний. false,
+  // если сброс или слияние не удались, фоновый поток повторит их позже
+  bool flush();
+  // Число файлов на каждом уровне
+  std::vector<size_t> runsPerLevel();
+
+ protected:
+  std::vector<Entry> copyEntries(
+      const std::function<void()>& underLock) override;
+
+ private:
+  typedef std::map<Key, LsmValue> Memtable;
+  typedef std::vector<std::shared_ptr<SortedRun>> Level;
+  // Возвращает следующую запись по возрастанию ключей, false в конце
+  typedef std::function<bool(LsmRecord&)> RecordSource;
+  // Состояние для обхода без блокировки: файлы неизменяемы, таблица в
+  // памяти скопирована
+  struct View {
+    Memtable memtable;
+    std::shared_ptr<const Memtable> immutable;
+    std::vector<Level> levels;
+  };
+  // Файлы inputs уровня level сливаются с файлами overlapping уровня
+  // level + 1
+  struct Compaction {
+    size_t level;
+    Level inputs;
+    Level overlapping;
+    bool dropTombstones;
+  };
+
+  Options options_;
+  std::string directory_;
+  bool ownsDirectory_;
+  std::mutex mutex_;
+  // Сообщает фоновому потоку о работе, а ждущим - об ее окончании
+  std::condition_variable changed_;
+  Memtable memtable_;
+  size_t memtableBytes_;
+  // Таблица, которую сбрасывает фоновый поток
+  std::shared_ptr<const Memtable> immutable_;
+  // Уровень 0 упорядочен от новых файлов к старым, остальные - по ключам
+  std::vector<Level> levels_;
+  // Последний ключ, слитый из уровня, следующее слияние начнется после него
+  std::vector<Key> compactPointer_;
+  std::atomic<uint64_t> nextRunId_;
+  bool busy_;
+  // Число неудачных сбросов и слияний, по нему flush узнает об ошибке
+  uint64_t failures_;
+  // Число записей в файлах уровней и изменение этого числа таблицами в
+  // памяти. Истекшие, но не удаленные записи тоже считаются
+  int64_t levelsItems_;
+  int64_t memtableItems_;
+  int64_t immutableItems_;
+  // Статистика по файлам, открытым в конструкторе, считается фоновым
+  // потоком по возрастанию ключей. Ключи до loadCursor_ он уже учел,
+  // остальные ключи из loadClaimed_ учитывают операции, и он их пропускает
+  bool loadingStatistics_;
+  std::optional<Key> loadCursor_;
+  std::unordered_set<Key> loadClaimed_;
+  std::atomic<bool> stop_;
+  std::thread worker_;
+  std::thread loader_;
+  std::shared_ptr<Dispatcher> dispatcher_;
+
+  // Открывает файлы уровней из MANIFEST и удаляет файлы, которых в нем нет
+  void load();
+  // Учитывает в статистике записи файлов view и регистрирует их время
+  // удаления
+  void loadStatistics(const View& view);
+  // Требует захваченного mutex_. false, если значение key из файлов,
+  // открытых в конструкторе, еще не учтено в статистике. Тогда загрузка
+  // статистики пропустит key, и дальше его учитывают операции
+  bool claimStatistics(const Key& key);
+  // Содержимое MANIFEST для уровней levels с items записями
+  std::string manifestData(const std::vector<Level>& levels,
+                           const int64_t items) const;
+  // Заменяет MANIFEST без блокировки, поэтому вызывается только фоновым
+  // потоком. false, если запись не удалась
+  bool writeManifest(const std::string& data) const;
+  // Требуют захваченного mutex_. Ключ из поврежденного блока считается
+  // отсутствующим
+  std::optional<LsmValue> lookup(const Key& key) const;
+  // Версия key из таблиц в памяти
+  std::optional<LsmValue> lookupMemory(const Key& key) const;
+  // Файлы уровней, которые могут содержать key, от новых к старым
+  Level candidateRuns(const Key& key) const;
+  // Ищет key в runs по порядку. Файлы неизменяемы, поэтому блокировка не
+  // нужна. Ключ из поврежденного блока считается отсутствующим
+  static std::optional<LsmValue> lookupRuns(const Level& runs, const Key& key);
+  // Истекшая запись удаляется при обращении
+  std::optional<LsmValue> findAlive(const Key& key);
+  // findAlive для чтения: под mutex_ проверяются только таблицы в памяти и
+  // выбираются файлы, а сами файлы читаются без блокировки. Истекшая запись
+  // из файла удаляется под mutex_ после чтения
+  std::optional<LsmValue> readAlive(const Key& key);
+  // Переполненная таблица передается фоновому потоку, если он свободен.
+  // itemsDelta - изменение числа записей
+  void put(Key key, LsmValue value, const int itemsDelta = 0);
+  // Делает таблицу в памяти неизменяемой и будит фоновый поток
+  void rotateMemtable();
+  // Номер записи журнала пишется в lsn
+  Errors setLocked(const Key& key, const Value& value,
+                   const Deadline timeToDel, uint64_t& lsn);
+  Errors delLocked(const Key& key, bool& hasTtl, uint64_t& lsn);
+  // Ждет, пока таблица в памяти не освободится, и не дает уровню 0 расти
+  // быстрее слияний
+  void waitForRoom(std::unique_lock<std::mutex>& lock);
+  View takeView() const;
+  std::optional<Compaction> pickCompaction() const;
+  bool isBottom(const size_t level) const;
+  uint64_t maxLevelBytes(const size_t level) const;
+
+  // Вызывает func для живых на момент at записей по возрастанию ключей.
+  // Обход прерывается, когда *stop становится true или встречается
+  // поврежденный блок
+  static void scan(const View& view, const Deadline at,
+                   const std::function<void(const Key&, const Value&,
+                                            const Deadline)>& func,
+                   const std::atomic<bool>* stop = nullptr);
+  void workerLoop();
+  // Сливает источники, упорядоченные от новых к старым, в файлы не больше
+  // runBytes. Бросает std::runtime_error, если файл не удалось записать
+  Level writeRuns(std::vector<RecordSource>& sources,
+                  const bool dropTombstones);
+  // Уровни levels, в которых файлы слияния заменены на outputs
+  static std::vector<Level> merged(std::vector<Level> levels,
+                                   const Compaction& compaction,
+                                   const Level& outputs);
+  // Требует захваченного mutex_. Файлы, которые заменило слияние, удаляются
+  // только если MANIFEST без них записан
+  void install(const Compaction& compaction, std::vector<Level> levels,
+               const bool manifestWritten);
+  std::string newRunName();
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_LSM_TREE_LSM_TREE_H_
@@ -0,0 +1,245 @@
+#include "sorted_run.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include "../durable_file.h"
+
+namespace s21 {
+
+namespace {
+constexpr uint8_t TombstoneFlag = 1;
+// Записи передаются в файл порциями такого размера
+constexpr size_t WriteBufferSize = 64 << 10;
+constexpr size_t FooterSize = 3 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+}  // namespace
+
+SortedRun::Builder::Builder(const std::string& fileName,
+                            const double falsePositiveRate)
+    : fileName_(fileName),
+      fout_(fileName, std::ios::binary | std::ios::trunc),
+      size_(0),
+      falsePositiveRate_(falsePositiveRate) {
+  if (!fout_.is_open()) {
+    std::stringstream str;
+    str << "File " << fileName << " not open\n";
+    throw std::runtime_error(str.str().c_str());
+  }
+}
+
+//----------------------------------------------------------------
+void SortedRun::Builder::Add(const Key& key, const LsmValue& value) {
+  if (block_.size() >= BlockSize) finishBlock();
+  if (block_.empty()) index_.push_back({key, size_, 0});
+  const size_t before = block_.size();
+  Encode(block_, key, value);
+  size_ += block_.size() - before;
+  lastKey_ = key;
+  hashes_.push_back(BloomFilter::HashOf(key));
+}
+
+//----------------------------------------------------------------
+void SortedRun::Builder::finishBlock() {
+  index_.back().crc = Crc32(block_);
+  buffer_.append(block_);
+  block_.clear();
+  if (buffer_.size() >= WriteBufferSize) {
+    fout_.write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+  }
+}
+
+//----------------------------------------------------------------
+std::shared_ptr<SortedRun> SortedRun::Builder::Finish() {
+  if (index_.empty()) {
+    fout_.close();
+    std::remove(fileName_.c_str());
+    return nullptr;
+  }
+  finishBlock();
+  std::string index;
+  for (const Block& block : index_) {
+    PutString(index, block.firstKey);
+    Put<uint64_t>(index, block.offset);
+    Put<uint32_t>(index, block.crc);
+  }
+  PutString(index, lastKey_);
+  for (const uint64_t hash : hashes_) Put<uint64_t>(index, hash);
+  buffer_.append(index);
+  Put<uint64_t>(buffer_, size_);
+  Put<uint64_t>(buffer_, index_.size());
+  Put<uint64_t>(buffer_, hashes_.size());
+  Put<uint32_t>(buffer_, Crc32(index));
+  Put<uint32_t>(buffer_, Magic);
+  fout_.write(buffer_.data(), buffer_.size());
+  buffer_.clear();
+  fout_.close();
+  // Файл попадает в MANIFEST только после сброса на диск
+  if (!fout_ || !SyncFile(fileName_)) {
+    std::remove(fileName_.c_str());
+    throw std::runtime_error("Can not write " + fileName_);
+  }
+  index_.clear();
+  hashes_.clear();
+  return std::make_shared<SortedRun>(fileName_, falsePositiveRate_);
+}
+
+//----------------------------------------------------------------
+SortedRun::Cursor::Cursor(std::shared_ptr<const SortedRun> run)
+    : run_(std::move(run)), nextBlock_(0), reader_(std::string_view()) {}
+
+//----------------------------------------------------------------
+bool SortedRun::Cursor::Next(LsmRecord& record) {
+  while (reader_.AtEnd()) {
+    if (nextBlock_ == run_->index_.size()) return false;
+    reader_ = BinaryReader(run_->block(nextBlock_++));
+  }
+  record.first = reader_.GetString();
+  Decode(reader_, &record.second);
+  return true;
+}
+
+//----------------------------------------------------------------
+SortedRun::SortedRun(const std::string& fileName,
+                     const double falsePositiveRate)
+    : fileName_(fileName),
+      file_(fileName, false),
+      blocksEnd_(0),
+      obsolete_(false) {
+  loadIndex(falsePositiveRate);
+}
+
+//----------------------------------------------------------------
+std::shared_ptr<SortedRun> SortedRun::Open(const std::string& fileName,
+                                           const double falsePositiveRate) {
+  return std::make_shared<SortedRun>(fileName, falsePositiveRate);
+}
+
+//----------------------------------------------------------------
+SortedRun::~SortedRun() {
+  if (obsolete_) std::remove(fileName_.c_str());
+}
+
+//----------------------------------------------------------------
+std::optional<LsmValue> SortedRun::Get(const Key& key) const {
+  auto found = std::upper_bound(
+      index_.begin(), index_.end(), key,
+      [](const Key& k, const Block& b) { return k < b.firstKey; });
+  if (found == index_.begin()) return std::nullopt;
+  BinaryReader reader(block(std::prev(found) - index_.begin()));
+  while (!reader.AtEnd()) {
+    std::string_view stored = reader.Take(reader.Get<uint32_t>());
+    if (stored < key) {
+      Decode(reader, nullptr);
+    } else if (stored == key) {
+      LsmValue value;
+      Decode(reader, &value);
+      return value;
+    } else {
+      break;
+    }
+  }
+  return std::nullopt;
+}
+
+//----------------------------------------------------------------
+void SortedRun::loadIndex(const double falsePositiveRate) {
+  std::string_view data = file_.View();
+  if (data.size() < FooterSize)
+    throw std::runtime_error("Corrupted run " + fileName_ + ": file too short");
+  BinaryReader footer(data.substr(data.size() - FooterSize));
+  const uint64_t indexOffset = footer.Get<uint64_t>();
+  const uint64_t blocksCount = footer.Get<uint64_t>();
+  const uint64_t keysCount = footer.Get<uint64_t>();
+  const uint32_t crc = footer.Get<uint32_t>();
+  if (footer.Get<uint32_t>() != Magic)
+    throw std::runtime_error("Corrupted run " + fileName_ + ": bad magic");
+  if (indexOffset > data.size() - FooterSize)
+    throw std::runtime_error("Corrupted run " + fileName_ +
+                             ": bad index offset");
+  std::string_view index =
+      data.substr(indexOffset, data.size() - FooterSize - indexOffset);
+  if (Crc32(index) != crc)
+    throw std::runtime_error("Corrupted run " + fileName_ +
+                             ": index checksum mismatch");
+  // Каждый блок и хеш занимают в индексе не меньше 8 байт, поэтому
+  // поврежденное число не приведет к огромному резервированию
+  if (blocksCount == 0 || blocksCount > index.size() / sizeof(uint64_t) ||
+      keysCount > index.size() / sizeof(uint64_t))
+    throw std::runtime_error("Corrupted run " + fileName_ +
+                             ": index size mismatch");
+  BinaryReader reader(index);
+  index_.reserve(blocksCount);
+  for (uint64_t i = 0; i < blocksCount; ++i) {
+    Block block;
+    block.firstKey = reader.GetString();
+    block.offset = reader.Get<uint64_t>();
+    block.crc = reader.Get<uint32_t>();
+    if (block.offset >= indexOffset ||
+        (index_.empty() ? block.offset != 0
+                        : block.offset <= index_.back().offset))
+      throw std::runtime_error("Corrupted run " + fileName_ +
+                               ": bad index entry");
+    index_.push_back(std::move(block));
+  }
+  lastKey_ = reader.GetString();
+  BloomFilter filter(keysCount, falsePositiveRate);
+  for (uint64_t i = 0; i < keysCount; ++i) filter.Add(reader.Get<uint64_t>());
+  if (!reader.AtEnd())
+    throw std::runtime_error("Corrupted run " + fileName_ +
+                             ": index size mismatch");
+  filter_ = std::move(filter);
+  blocksEnd_ = indexOffset;
+}
+
+//----------------------------------------------------------------
+std::string_view SortedRun::block(const size_t i) const {
+  const uint64_t begin = index_[i].offset;
+  const uint64_t end =
+      i + 1 == index_.size() ? blocksEnd_ : index_[i + 1].offset;
+  std::string_view data = file_.View().substr(begin, end - begin);
+  if (Crc32(data) != index_[i].crc)
+    throw std::runtime_error("Corrupted run " + fileName_ +
+                             ": block checksum mismatch");
+  return data;
+}
+
+//----------------------------------------------------------------
+void SortedRun::Encode(std::string& out, const Key& key,
+                       const LsmValue& value) {
+  PutString(out, key);
+  Put<uint8_t>(out, value.tombstone ? TombstoneFlag : 0);
+  Put<int64_t>(out, ToWallClock(value.timeToDel));
+  if (value.tombstone) return;
+  PutString(out, value.value.lastname);
+  PutString(out, value.value.name);
+  PutString(out, value.value.city);
+  Put<int32_t>(out, value.value.year);
+  Put<int32_t>(out, value.value.coins);
+}
+
+//----------------------------------------------------------------
+void SortedRun::Decode(BinaryReader& reader, LsmValue* value) {
+  const bool tombstone = reader.Get<uint8_t>() & TombstoneFlag;
+  const int64_t expireAt = reader.Get<int64_t>();
+  if (!value) {
+    if (tombstone) return;
+    for (int i = 0; i < 3; ++i) reader.Take(reader.Get<uint32_t>());
+    reader.Take(2 * sizeof(int32_t));
+    return;
+  }
+  value->tombstone = tombstone;
+  value->timeToDel = FromWallClock(expireAt);
+  value->value = Value{};
+  if (tombstone) return;
+  value->value.lastname = reader.GetString();
+  value->value.name = reader.GetString();
+  value->value.city = reader.GetString();
+  value->value.year = reader.Get<int32_t>();
+  value->value.coins = reader.Get<int32_t>();
+}
+
+}  //  namespace s21
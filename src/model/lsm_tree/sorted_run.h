@@ -0,0 +1,151 @@
+// Неизменяемый отсортированный файл LSM-дерева. Файл удаляется, когда его
+// заменило слияние, иначе переживает перезапуск и открывается через Open.
+// Формат файла:
+//   блоки:  записи по возрастанию ключей - ключ, флаги (u8), время удаления
+//           (i64, миллисекунды системных часов, 0 - без него), у живой
+//           записи дальше фамилия, имя, город, год (i32) и число коинов (i32).
+//           Блок закрывается после записи, на которой он достиг BlockSize
+//           байт
+//   индекс: первый ключ, смещение (u64) и CRC32 (u32) каждого блока, затем
+//           последний ключ файла и хеши всех ключей (u64) для фильтра Блума
+//   конец:  смещение индекса (u64), число блоков (u64), число ключей (u64),
+//           CRC32 индекса (u32), "S21R" (u32)
+// Строки записываются длиной (u32) и байтами. Открытие читает только
+// индекс, поиск ключа читает и проверяет один блок, а фильтр Блума в памяти
+// отсекает поиск отсутствующих ключей без чтения блоков
+#ifndef SRC_MODEL_LSM_TREE_SORTED_RUN_H_
+#define SRC_MODEL_LSM_TREE_SORTED_RUN_H_
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "../../types.h"
+#include "../binary_io.h"
+#include "../mapped_file.h"
+#include "../sketches/bloom_filter.h"
+
+namespace s21 {
+
+// Версия записи. tombstone - отметка об удалении, перекрывающая более старые
+// версии ключа
+struct LsmValue {
+  bool tombstone;
+  Value value;
+  Deadline timeToDel;
+};
+typedef std::pair<Key, LsmValue> LsmRecord;
+
+class SortedRun {
+ public:
+  static constexpr uint32_t Magic = 0x52313253;  // "S21R"
+  static constexpr size_t BlockSize = 4096;
+
+  // Первый ключ, смещение и контрольная сумма блока
+  struct Block {
+    Key firstKey;
+    uint64_t offset;
+    uint32_t crc;
+  };
+
+  class Builder {
+   public:
+    // Бросает std::runtime_error с "not open", если файл не удалось создать.
+    // falsePositiveRate - доля ложных срабатываний фильтра Блума
+    Builder(const std::string& fileName, const double falsePositiveRate);
+
+    // Ключи передаются по возрастанию
+    void Add(const Key& key, const LsmValue& value);
+    bool Empty() const { return index_.empty(); }
+    uint64_t Size() const { return size_; }
+    // Дописывает файл, сбрасывает его на диск и открывает для чтения. Бросает
+    // std::runtime_error, если файл не удалось записать
+    std::shared_ptr<SortedRun> Finish();
+
+   private:
+    std::string fileName_;
+    std::ofstream fout_;
+    std::string buffer_;
+    // Записи незакрытого блока
+    std::string block_;
+    uint64_t size_;
+    std::vector<Block> index_;
+    Key lastKey_;
+    double falsePositiveRate_;
+    // Хеши ключей пишутся в индекс в конце файла
+    std::vector<uint64_t> hashes_;
+
+    // Дописывает block_ в buffer_ и запоминает его контрольную сумму
+    void finishBlock();
+  };
+
+  // Последовательное чтение всех записей файла
+  class Cursor {
+   public:
+    explicit Cursor(std::shared_ptr<const SortedRun> run);
+    // false, если записи закончились. Бросает std::runtime_error с
+    // "Corrupted", если блок поврежден
+    bool Next(LsmRecord& record);
+
+   private:
+    std::shared_ptr<const SortedRun> run_;
+    size_t nextBlock_;
+    BinaryReader reader_;
+  };
+
+  // Читает индекс и фильтр из конца файла. Бросает std::runtime_error с
+  // "not open" или "Corrupted"
+  SortedRun(const std::string& fileName, const double falsePositiveRate);
+  // Открывает файл, записанный Builder
+  static std::shared_ptr<SortedRun> Open(const std::string& fileName,
+                                         const double falsePositiveRate);
+  // Файл удаляется, если его заменило слияние
+  ~SortedRun();
+
+  SortedRun(const SortedRun&) = delete;
+  SortedRun& operator=(const SortedRun&) = delete;
+
+  // false, если ключа в файле точно нет. hash - BloomFilter::HashOf(key)
+  bool MayContain(const uint64_t hash) const {
+    return filter_.MayContain(hash);
+  }
+  // Версия ключа, в том числе отметка об удалении. Бросает
+  // std::runtime_error с "Corrupted", если блок ключа поврежден
+  std::optional<LsmValue> Get(const Key& key) const;
+  const Key& FirstKey() const { return index_.front().firstKey; }
+  const Key& LastKey() const { return lastKey_; }
+  bool Overlaps(const Key& first, const Key& last) const {
+    return !(LastKey() < first || last < FirstKey());
+  }
+  uint64_t FileSize() const { return file_.View().size(); }
+  const std::string& FileName() const { return fileName_; }
+  void MarkObsolete() { obsolete_ = true; }
+
+ private:
+  std::string fileName_;
+  MappedFile file_;
+  std::vector<Block> index_;
+  // Блоки лежат в file_ до индекса
+  uint64_t blocksEnd_;
+  Key lastKey_;
+  BloomFilter filter_;
+  std::atomic<bool> obsolete_;
+
+  void loadIndex(const double falsePositiveRate);
+  // Байты блока с проверкой контрольной суммы
+  std::string_view block(const size_t i) const;
+
+  static void Encode(std::string& out, const Key& key, const LsmValue& value);
+  // Читает запись после ключа, при value == nullptr пропускает ее
+  static void Decode(BinaryReader& reader, LsmValue* value);
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_LSM_TREE_SORTED_RUN_H_
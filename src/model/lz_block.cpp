@@ -0,0 +1,125 @@
+#include "lz_block.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace s21 {
+
+namespace {
+constexpr size_t HashBits = 14;
+
+uint32_t Read32(const char* ptr) {
+  uint32_t value;
+  std::memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+size_t Hash(const uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - HashBits);
+}
+
+void PutLength(std::string& out, size_t length) {
+  while (length >= 255) {
+    out.push_back(static_cast<char>(255));
+    length -= 255;
+  }
+  out.push_back(static_cast<char>(length));
+}
+
+void PutSequence(std::string& out, std::string_view literals,
+                 const size_t matchLength, const size_t offset) {
+  const size_t matchCode = matchLength ? matchLength - LzBlock::MinMatch : 0;
+  const uint8_t token =
+      static_cast<uint8_t>((std::min<size_t>(literals.size(), 15) << 4) |
+                           std::min<size_t>(matchCode, 15));
+  out.push_back(static_cast<char>(token));
+  if (literals.size() >= 15) PutLength(out, literals.size() - 15);
+  out.append(literals);
+  if (matchLength == 0) return;
+  out.push_back(static_cast<char>(offset & 0xFF));
+  out.push_back(static_cast<char>(offset >> 8));
+  if (matchCode >= 15) PutLength(out, matchCode - 15);
+}
+
+size_t GetLength(std::string_view data, size_t& pos, size_t length) {
+  if (length != 15) return length;
+  uint8_t byte = 255;
+  while (byte == 255) {
+    if (pos >= data.size())
+      throw std::runtime_error("Corrupted data: truncated length");
+    byte = static_cast<uint8_t>(data[pos++]);
+    length += byte;
+  }
+  return length;
+}
+}  // namespace
+
+std::string LzBlock::Compress(std::string_view data) {
+  std::string res;
+  res.reserve(data.size() / 2 + 16);
+  // Позиция последнего вхождения каждых четырех байт по их хешу
+  std::vector<uint32_t> table(size_t(1) << HashBits, UINT32_MAX);
+  size_t anchor = 0;
+  size_t pos = 0;
+  while (pos + MinMatch <= data.size()) {
+    const uint32_t sequence = Read32(data.data() + pos);
+    uint32_t& slot = table[Hash(sequence)];
+    const size_t candidate = slot;
+    slot = static_cast<uint32_t>(pos);
+    if (candidate == UINT32_MAX || pos - candidate > MaxOffset ||
+        Read32(data.data() + candidate) != sequence) {
+      ++pos;
+      continue;
+    }
+    size_t length = MinMatch;
+    while (pos + length < data.size() &&
+           data[candidate + length] == data[pos + length])
+      ++length;
+    PutSequence(res, data.substr(anchor, pos - anchor), length,
+                pos - candidate);
+    pos += length;
+    anchor = pos;
+  }
+  PutSequence(res, data.substr(anchor), 0, 0);
+  return res;
+}
+//----------------------------------------------------------------
+std::string LzBlock::Decompress(std::string_view data, const size_t rawSize) {
+  std::string res;
+  // Байт сжатых данных распаковывается не больше чем в 255 байт, поэтому
+  // неверный rawSize не приводит к огромному выделению памяти
+  res.reserve(std::min(rawSize, data.size() * 255));
+  size_t pos = 0;
+  while (pos < data.size()) {
+    const uint8_t token = static_cast<uint8_t>(data[pos++]);
+    const size_t literals = GetLength(data, pos, token >> 4);
+    if (data.size() - pos < literals || rawSize - res.size() < literals)
+      throw std::runtime_error("Corrupted data: literals out of bounds");
+    res.append(data.substr(pos, literals));
+    pos += literals;
+    if (pos == data.size()) break;
+    if (data.size() - pos < 2)
+      throw std::runtime_error("Corrupted data: truncated offset");
+    const size_t offset = static_cast<uint8_t>(data[pos]) |
+                          (static_cast<uint8_t>(data[pos + 1]) << 8);
+    pos += 2;
+    const size_t length = GetLength(data, pos, token & 0x0F) + MinMatch;
+    if (offset == 0 || offset > res.size() || rawSize - res.size() < length)
+      throw std::runtime_error("Corrupted data: match out of bounds");
+    const size_t from = res.size() - offset;
+    if (offset >= length) {
+      res.append(res, from, length);
+    } else {
+      // Повтор перекрывает сам себя и копируется побайтно
+      for (size_t i = 0; i < length; ++i) res.push_back(res[from + i]);
+    }
+  }
+  if (res.size() != rawSize)
+    throw std::runtime_error("Corrupted data: size mismatch");
+  return res;
+}
+
+}  //  namespace s21
@@ -0,0 +1,30 @@
+// Сжатие блоков алгоритмом семейства LZ77. Сжатые данные - последовательности
+// из литералов и ссылки на повтор в уже распакованных данных:
+//   токен (u8): старшие 4 бита - число литералов, младшие - длина повтора
+//               минус MinMatch, значение 15 продолжается байтами до первого
+//               байта меньше 255
+//   литералы
+//   смещение повтора (u16), отсутствует в последней последовательности
+#ifndef SRC_MODEL_LZ_BLOCK_H_
+#define SRC_MODEL_LZ_BLOCK_H_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace s21 {
+
+class LzBlock {
+ public:
+  static constexpr size_t MinMatch = 4;
+  static constexpr size_t MaxOffset = 65535;
+
+  static std::string Compress(std::string_view data);
+  // Бросает std::runtime_error с "Corrupted", если data не распаковывается
+  // ровно в rawSize байт
+  static std::string Decompress(std::string_view data, const size_t rawSize);
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_LZ_BLOCK_H_
@@ -0,0 +1,42 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <stdexcept>
+
+namespace s21 {
+
+MappedFile::MappedFile(const std::string& fileName, const bool sequential)
+    : data_(nullptr), size_(0) {
+  int fd = open(fileName.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    if (fd >= 0) close(fd);
+    std::stringstream str;
+    str << "File " << fileName << " not open\n";
+    throw std::runtime_error(str.str().c_str());
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ > 0) {
+    void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      close(fd);
+      std::stringstream str;
+      str << "File " << fileName << " not open\n";
+      throw std::runtime_error(str.str().c_str());
+    }
+    madvise(addr, size_, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+    data_ = static_cast<const char*>(addr);
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) munmap(const_cast<char*>(data_), size_);
+}
+
+}  //  namespace s21
@@ -0,0 +1,29 @@
+// Файл, отображенный в память только для чтения
+#ifndef SRC_MODEL_MAPPED_FILE_H_
+#define SRC_MODEL_MAPPED_FILE_H_
+
+#include <string>
+#include <string_view>
+
+namespace s21 {
+class MappedFile {
+ public:
+  // Бросает std::runtime_error с "not open", если файл не удалось открыть.
+  // sequential - файл читается один раз от начала до конца, иначе вразброс
+  explicit MappedFile(const std::string& fileName,
+                      const bool sequential = true);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view View() const { return std::string_view(data_, size_); }
+
+ private:
+  const char* data_;
+  size_t size_;
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_MAPPED_FILE_H_
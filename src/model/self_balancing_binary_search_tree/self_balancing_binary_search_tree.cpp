@@ -1,16 +1,25 @@
 #include "self_balancing_binary_search_tree.h"
 
+#include <algorithm>
 #include <cstring>
+#include <limits>
 #include <queue>
+#include <thread>
 
-#include "../data.h"
+#include "../aggregation/aggregator.h"
 #include "../dispatchers/ttl_manager.h"
 
 namespace s21 {
 
+namespace {
+constexpr size_t SnapshotBatchSize = 4096;
+// Число строк, которые загрузка вставляет за один захват блокировки
+constexpr size_t UploadBatchRows = 16384;
+}
+
 SelfBalancingBinarySearchTree::SelfBalancingBinarySearchTree() {
   root = nullptr;
-  TtlManager::getInstance().addNewContainer(*this);
+  dispatcher = TtlManager::getInstance().addNewContainer(*this);
 }
 
 SelfBalancingBinarySearchTree::~SelfBalancingBinarySearchTree() {
@@ -19,35 +28,47 @@ SelfBalancingBinarySearchTree::~SelfBalancingBinarySearchTree() {
 }
 
 Errors SelfBalancingBinarySearchTree::set(const std::string &key,
-                                          const Value &value, int ttl) {
-  Node *node = new Node;
+                                          const Value &value,
+                                          std::chrono::milliseconds ttl) {
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  uint64_t lsn = 0;
   {
-    std::lock_guard<std::mutex> lock(nodeMutex);
-    node->key = key;
-    node->val = value;
-    node->timeToDel =
-        ttl > 0 ? (time(nullptr) + ttl) : static_cast<int>(hasNoTtl);
-    node->color = red;
-    node->leftChild = nullptr;
-    node->rightChild = nullptr;
-    node->parent = nullptr;
-    if (!findPlaceForNewNode(node)) {
-      delete node;
+    std::lock_guard<std::shared_mutex> lock(nodeMutex);
+    if (!setUnderLock(key, value, timeToDel, lsn)) {
       return keyAlreadyExists;
     }
-    insertCase1(node);
-    ++countItems;
+    // Под блокировкой дерева диспетчер получает изменения ключа в том же
+    // порядке, что и дерево
+    if (timeToDel != NoDeadline) {
+      TtlManager::getInstance().addOrUpdateNode(*dispatcher, key, timeToDel);
+    }
   }
-  if (ttl > 0) {
-    TtlManager::getInstance().addOrUpdateNode(*this, key, ttl);
+  return CommitChange(lsn);
+}
+
+Errors SelfBalancingBinarySearchTree::set(Key &&key, Value &&value,
+                                          std::chrono::milliseconds ttl) {
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::shared_mutex> lock(nodeMutex);
+    Node *n = setUnderLock(std::move(key), std::move(value), timeToDel, lsn);
+    if (!n) {
+      return keyAlreadyExists;
+    }
+    // Ключ перемещен в узел
+    if (timeToDel != NoDeadline) {
+      TtlManager::getInstance().addOrUpdateNode(*dispatcher, n->key,
+                                                timeToDel);
+    }
   }
-  return noErrors;
+  return CommitChange(lsn);
 }
 
 std::optional<Value> SelfBalancingBinarySearchTree::get(
     const std::string &key) {
-  std::lock_guard<std::mutex> lock(nodeMutex);
-  Node *n = findNode(key);
+  std::lock_guard<std::shared_mutex> lock(nodeMutex);
+  Node *n = findAliveNode(key);
   if (n) {
     return n->val;
   } else {
@@ -55,95 +76,194 @@ std::optional<Value> SelfBalancingBinarySearchTree::get(
   }
 }
 
+std::optional<VersionedValue> SelfBalancingBinarySearchTree::getVersioned(
+    const Key &key) {
+  std::lock_guard<std::shared_mutex> lock(nodeMutex);
+  Node *n = findAliveNode(key);
+  if (!n) {
+    return std::nullopt;
+  }
+  return VersionedValue{n->val, n->version};
+}
+
+bool SelfBalancingBinarySearchTree::visit(
+    const Key &key, const std::function<void(const Value &)> &visitor) {
+  std::lock_guard<std::shared_mutex> lock(nodeMutex);
+  Node *n = findAliveNode(key);
+  if (!n) {
+    return false;
+  }
+  visitor(n->val);
+  return true;
+}
+
 bool SelfBalancingBinarySearchTree::exists(const std::string &key) {
-  std::lock_guard<std::mutex> lock(nodeMutex);
-  if (findNode(key) != nullptr) {
+  std::lock_guard<std::shared_mutex> lock(nodeMutex);
+  if (findAliveNode(key) != nullptr) {
     return true;
   }
   return false;
 }
 
 Errors SelfBalancingBinarySearchTree::del(const std::string &key) {
-  Node *n = nullptr;
   bool hasTtl = false;
+  uint64_t lsn = 0;
   {
-    std::lock_guard<std::mutex> lock(nodeMutex);
-    n = findNode(key);
-    if (!n) {
-      return keyNotFound;
+    std::lock_guard<std::shared_mutex> lock(nodeMutex);
+    Errors res = delUnderLock(key, hasTtl, lsn);
+    if (res != noErrors) {
+      return res;
     }
-    if (n->timeToDel > time(nullptr)) {
-      hasTtl = true;
+    if (hasTtl) {
+      TtlManager::getInstance().deleteNode(*dispatcher, key);
     }
   }
-  if (hasTtl) {
-    TtlManager::getInstance().deleteNode(*this, key);
-  }
-  std::lock_guard<std::mutex> lock(nodeMutex);
-  Node *replacedNode = nullptr;
-  if (n->leftChild && n->rightChild) {
-    replacedNode = n->leftChild;
-    while (replacedNode->rightChild) {
-      replacedNode = replacedNode->rightChild;
+  return CommitChange(lsn);
+}
+
+Errors SelfBalancingBinarySearchTree::delIfVersion(const Key &key,
+                                                   const uint64_t version) {
+  bool hasTtl = false;
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::shared_mutex> lock(nodeMutex);
+    Errors res = delUnderLock(key, hasTtl, lsn, version);
+    if (res != noErrors) {
+      return res;
+    }
+    if (hasTtl) {
+      TtlManager::getInstance().deleteNode(*dispatcher, key);
     }
   }
-  Node *child = n->leftChild ? n->leftChild : n->rightChild;
+  return CommitChange(lsn);
+}
 
-  if (replacedNode) {
-    child = replacedNode->leftChild ? replacedNode->leftChild
-                                    : replacedNode->rightChild;
-    if (child) {
-      child->parent = replacedNode->parent;
+std::vector<std::optional<Value>> SelfBalancingBinarySearchTree::mget(
+    const std::vector<Key> &keys) {
+  std::vector<std::optional<Value>> res;
+  res.reserve(keys.size());
+  std::lock_guard<std::shared_mutex> lock(nodeMutex);
+  for (const auto &key : keys) {
+    Node *n = findAliveNode(key);
+    if (n) {
+      res.push_back(n->val);
+    } else {
+      res.push_back(std::nullopt);
     }
-    if (replacedNode->color == black) {
-      if (child && child->color == red) {
-        child->color = black;
-      } else {
-        deleteCase1(replacedNode);
+  }
+  return res;
+}
+
+std::vector<Errors> SelfBalancingBinarySearchTree::mset(
+    const std::vector<std::pair<Key, Value>> &values,
+    std::chrono::milliseconds ttl) {
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  std::vector<Errors> res;
+  res.reserve(values.size());
+  std::vector<Key> withTtl;
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::shared_mutex> lock(nodeMutex);
+    for (const auto &[key, value] : values) {
+      res.push_back(setUnderLock(key, value, timeToDel, lsn)
+                        ? noErrors
+                        : keyAlreadyExists);
+      if (res.back() == noErrors && timeToDel != NoDeadline) {
+        withTtl.push_back(key);
       }
     }
-    n->key = replacedNode->key;
-    n->val = replacedNode->val;
-    n = replacedNode;
-  } else {
-    if (child) {
-      child->parent = n->parent;
-    }
-    if (n->color == black) {
-      if (child && child->color == red) {
-        child->color = black;
-        if (n == root) {
-          root = child;
-        }
-      } else {
-        deleteCase1(n);
+    TtlManager::getInstance().addOrUpdateNodes(*dispatcher, withTtl,
+                                               timeToDel);
+  }
+  CommitChanges(lsn, res);
+  return res;
+}
+
+std::vector<Errors> SelfBalancingBinarySearchTree::mdel(
+    const std::vector<Key> &keys) {
+  std::vector<Errors> res;
+  res.reserve(keys.size());
+  std::vector<Key> withTtl;
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::shared_mutex> lock(nodeMutex);
+    for (const auto &key : keys) {
+      bool hasTtl = false;
+      res.push_back(delUnderLock(key, hasTtl, lsn));
+      if (hasTtl) {
+        withTtl.push_back(key);
       }
     }
+    if (!withTtl.empty()) {
+      TtlManager::getInstance().deleteNodes(*dispatcher, withTtl);
+    }
   }
+  CommitChanges(lsn, res);
+  return res;
+}
 
-  if (n->parent && n == n->parent->leftChild) {
-    n->parent->leftChild = child;
-  } else if (n->parent && n == n->parent->rightChild) {
-    n->parent->rightChild = child;
-  } else if (n->parent) {
-    return unknownError;
+SelfBalancingBinarySearchTree::Node *
+SelfBalancingBinarySearchTree::setUnderLock(Key key, Value value,
+                                            const Deadline timeToDel,
+                                            uint64_t &lsn) {
+  Node *n = insertNode(std::move(key), std::move(value), timeToDel);
+  if (!n) {
+    return nullptr;
   }
-  delete n;
-  --countItems;
+  notifier_.Publish(evSet, n->key);
+  lsn = RecordChange(logSet, n->key, n->val, timeToDel);
+  return n;
+}
+
+Errors SelfBalancingBinarySearchTree::delUnderLock(
+    const Key &key, bool &hasTtl, uint64_t &lsn,
+    const std::optional<uint64_t> &version) {
+  Node *n = findAliveNode(key);
+  if (!n) {
+    return keyNotFound;
+  }
+  if (version && n->version != *version) {
+    return versionMismatch;
+  }
+  hasTtl = HasPendingTtl(n->timeToDel);
+  Errors res = eraseNode(n);
+  if (res != noErrors) {
+    return res;
+  }
+  notifier_.Publish(evDel, key);
+  lsn = RecordChange(logDel, key);
   return noErrors;
 }
 
 Errors SelfBalancingBinarySearchTree::update(const Key &key, const Value &value,
-                                             const int ttl,
+                                             std::chrono::milliseconds ttl,
                                              const int paramsMask) {
+  return updateNode(key, value, ttl, paramsMask, std::nullopt);
+}
+
+Errors SelfBalancingBinarySearchTree::updateIfVersion(
+    const Key &key, const Value &value, std::chrono::milliseconds ttl,
+    const int paramsMask, const uint64_t version) {
+  return updateNode(key, value, ttl, paramsMask, version);
+}
+
+Errors SelfBalancingBinarySearchTree::updateNode(
+    const Key &key, const Value &value, std::chrono::milliseconds ttl,
+    const int paramsMask, const std::optional<uint64_t> &version) {
   Node *n = nullptr;
-  bool needUpdateDispatcher = false;
+  const Deadline timeToDel = DeadlineAfter(ttl);
+  uint64_t lsn = 0;
   {
-    std::lock_guard<std::mutex> lock(nodeMutex);
-    n = findNode(key);
+    std::lock_guard<std::shared_mutex> lock(nodeMutex);
+    n = findAliveNode(key);
     if (!n) {
       return keyNotFound;
     }
+    if (version && n->version != *version) {
+      return versionMismatch;
+    }
+    preserveForSnapshot(key, n);
+    statistics_.Erase(n->val);
     if (paramsMask & pLastname) {
       n->val.lastname = value.lastname;
     }
@@ -159,102 +279,320 @@ Errors SelfBalancingBinarySearchTree::update(const Key &key, const Value &value,
     if (paramsMask & pCoins) {
       n->val.coins = value.coins;
     }
+    statistics_.Insert(n->val);
     if (paramsMask & pTtl) {
-      n->timeToDel = ttl > 0 ? (time(nullptr) + ttl) : 0;
-      needUpdateDispatcher = true;
+      n->timeToDel = timeToDel;
+    }
+    n->version = NextVersion();
+    notifier_.Publish(evUpdate, key);
+    lsn = RecordChange(logUpdate, key, n->val, n->timeToDel);
+    if (paramsMask & pTtl) {
+      TtlManager::getInstance().addOrUpdateNode(*dispatcher, key, timeToDel);
     }
   }
-  if (needUpdateDispatcher) {
-    TtlManager::getInstance().addOrUpdateNode(*this, key, ttl);
-  }
-  return noErrors;
+  return CommitChange(lsn);
 }
 
 Errors SelfBalancingBinarySearchTree::rename(const std::string &oldKey,
                                              const std::string &newKey) {
-  Node *n = nullptr;
+  uint64_t lsn = 0;
   {
-    std::lock_guard<std::mutex> lock(nodeMutex);
-    n = findNode(oldKey);
+    std::lock_guard<std::shared_mutex> lock(nodeMutex);
+    Node *n = findAliveNode(oldKey);
     if (!n) {
       return keyNotFound;
     }
+    if (findAliveNode(newKey)) {
+      return keyAlreadyExists;
+    }
+    // findAliveNode(newKey) мог удалить истекший узел и перестроить дерево
+    // Узел переносится на место нового ключа без копирования значения
+    n = detachNode(findNode(oldKey));
+    if (!n) {
+      return unknownError;
+    }
+    const Deadline timeToDel = n->timeToDel;
+    n->key = newKey;
+    n->version = NextVersion();
+    attachNode(n);
+    notifier_.Publish(evRename, oldKey, newKey);
+    lsn = RecordChange(logRename, oldKey, newKey);
+    if (timeToDel != NoDeadline) {
+      TtlManager::getInstance().deleteNode(*dispatcher, oldKey);
+      TtlManager::getInstance().addOrUpdateNode(*dispatcher, newKey,
+                                                timeToDel);
+    }
   }
-  Errors res = set(newKey, n->val, n->timeToDel);
-  if (res != noErrors) {
-    return res;
+  return CommitChange(lsn);
+}
+
+Errors SelfBalancingBinarySearchTree::incrBy(const Key &key, const int field,
+                                             const int delta, int &result) {
+  uint64_t lsn = 0;
+  {
+    std::lock_guard<std::shared_mutex> lock(nodeMutex);
+    Node *n = findAliveNode(key);
+    if (!n) {
+      return keyNotFound;
+    }
+    std::optional<int> number = IncrementedField(n->val, field, delta);
+    if (!number) {
+      return valueOutOfRange;
+    }
+    preserveForSnapshot(key, n);
+    // Статистика ведется только по строковым полям и не меняется
+    SetNumericField(n->val, field, *number);
+    n->version = NextVersion();
+    notifier_.Publish(evUpdate, key);
+    lsn = RecordChange(logUpdate, key, n->val, n->timeToDel);
+    result = *number;
   }
-  return del(n->key);
+  return CommitChange(lsn);
 }
 
-int SelfBalancingBinarySearchTree::Ttl(const std::string &key) {
-  std::lock_guard<std::mutex> lock(nodeMutex);
-  Node *n = findNode(key);
+long long SelfBalancingBinarySearchTree::PTtl(const std::string &key) {
+  std::lock_guard<std::shared_mutex> lock(nodeMutex);
+  Node *n = findAliveNode(key);
   if (!n) {
     return keyNotFound;
   }
-  return n->timeToDel > 0 ? (n->timeToDel - time(nullptr))
-                          : static_cast<int>(hasNoTtl);
+  return RemainingMs(n->timeToDel);
 }
 
 const std::vector<std::string> SelfBalancingBinarySearchTree::keys() {
   std::vector<std::string> res;
-  std::lock_guard<std::mutex> lock(nodeMutex);
+  std::lock_guard<std::shared_mutex> lock(nodeMutex);
+  const Deadline now = Clock::now();
   Node *it = findMin(root);
   while (it) {
-    res.push_back(it->key);
+    if (!IsExpired(it->timeToDel, now)) {
+      res.push_back(it->key);
+    }
     it = nextElem(it);
   }
   return res;
 }
 
-int SelfBalancingBinarySearchTree::upload(const std::string &filename) {
-  std::vector<std::pair<Key, Value>> values;
-  try {
-    values = Data::loadData(filename);
-  } catch (const std::exception &e) {
-    if (strstr(e.what(), "not open")) {
-      return canNotOpenFile;
+size_t SelfBalancingBinarySearchTree::expireBatch(
+    const std::vector<std::string> &keys) {
+  std::lock_guard<std::shared_mutex> lock(nodeMutex);
+  const int sizeBefore = countItems.load();
+  for (const auto &key : keys) {
+    findAliveNode(key);
+  }
+  return static_cast<size_t>(sizeBefore - countItems.load());
+}
+
+std::vector<std::string> SelfBalancingBinarySearchTree::expiringWithin(
+    std::chrono::milliseconds window) {
+  const Deadline now = Clock::now();
+  const Deadline until = SaturatingAdd(now, window);
+  auto candidates = dispatcher->ExpiringBetween(now, until);
+  // Между выборкой кандидатов и захватом nodeMutex ключ мог быть удален
+  std::vector<std::string> res;
+  std::lock_guard<std::shared_mutex> lock(nodeMutex);
+  for (const auto &key : candidates) {
+    Node *n = findAliveNode(key);
+    if (n && n->timeToDel <= until) {
+      res.push_back(key);
+    }
+  }
+  return res;
+}
+
+std::vector<size_t> SelfBalancingBinarySearchTree::expiryHistogram(
+    std::chrono::milliseconds bucket, const size_t bucketsCount) {
+  std::lock_guard<std::shared_mutex> lock(nodeMutex);
+  return dispatcher->CountByBuckets(
+      Clock::now(), bucket, bucketsCount,
+      [this](const Key &key, const Deadline deadline) {
+        Node *n = findAliveNode(key);
+        return n && n->timeToDel == deadline;
+      });
+}
+
+size_t SelfBalancingBinarySearchTree::bulkInsert(
+    std::vector<std::pair<Key, Value>> &values) {
+  uint64_t lsn = 0;
+  size_t inserted = 0;
+  // Блокировка отпускается после каждого пакета, чтобы загрузка не
+  // останавливала остальные запросы до своего окончания
+  for (size_t done = 0; done < values.size();) {
+    {
+      std::lock_guard<std::shared_mutex> lock(nodeMutex);
+      const size_t end = std::min(values.size(), done + UploadBatchRows);
+      for (; done < end; ++done) {
+        auto &row = values[done];
+        Node *n = insertNode(std::move(row.first), std::move(row.second),
+                             NoDeadline);
+        if (n) {
+          ++inserted;
+          notifier_.Publish(evSet, n->key);
+          lsn = RecordChange(logSet, n->key, n->val, NoDeadline);
+        }
+      }
     }
-    if (strstr(e.what(), "Corrupted")) {
-      return corruptedFile;
+    std::this_thread::yield();
+  }
+  // Ошибку записи журнала показывает LogFailed
+  log_.Commit(lsn);
+  return inserted;
+}
+
+void SelfBalancingBinarySearchTree::forEachEntry(
+    const std::function<void()> &underLock, const EntryWriter &write) {
+  // Под блокировкой копируется одна пачка узлов, write пишет ее после снятия
+  // блокировки
+  std::vector<Entry> batch;
+  batch.reserve(SnapshotBatchSize);
+  std::lock_guard<std::mutex> lock(snapshotMutex_);
+  walkSnapshot(
+      underLock,
+      {[&batch](const Key &key, const Value &value, const Deadline timeToDel) {
+        batch.push_back({key, value, timeToDel});
+      }},
+      [&batch, &write]() {
+        for (const auto &entry : batch) {
+          write(entry.key, entry.value, entry.timeToDel);
+        }
+        batch.clear();
+      });
+}
+
+std::vector<Entry> SelfBalancingBinarySearchTree::copyEntries(
+    const std::function<void()> &underLock) {
+  std::vector<Entry> entries;
+  entries.reserve(countItems.load());
+  walkSnapshot(underLock, {[&entries](const Key &key, const Value &value,
+                                      const Deadline timeToDel) {
+                 entries.push_back({key, value, timeToDel});
+               }});
+  return entries;
+}
+
+void SelfBalancingBinarySearchTree::walkSnapshot(
+    const std::function<void()> &underLock,
+    const std::vector<EntryWriter> &visits,
+    const std::function<void()> &afterBatch) {
+  {
+    std::lock_guard<std::shared_mutex> lock(nodeMutex);
+    underLock();
+    snapshotView_.Begin();
+    snapshotRanges = splitRanges(visits.size());
+  }
+  const Deadline at = snapshotView_.At();
+  RunInParallel(snapshotRanges.size(),
+                [this, at, &visits, &afterBatch](size_t i) {
+                  walkRange(i, at, visits[i], afterBatch);
+                });
+  CopyOnWriteView::PreservedEntries preserved;
+  {
+    std::lock_guard<std::shared_mutex> lock(nodeMutex);
+    preserved = snapshotView_.Finish();
+  }
+  size_t count = 0;
+  CopyOnWriteView::ForEachAlive(
+      preserved, at,
+      [&visits, &afterBatch, &count](const Key &key, const Value &value,
+                                     const Deadline timeToDel) {
+        visits[0](key, value, timeToDel);
+        if (++count % SnapshotBatchSize == 0) {
+          afterBatch();
+        }
+      });
+  afterBatch();
+}
+
+void SelfBalancingBinarySearchTree::walkRange(
+    const size_t i, const Deadline at, const EntryWriter &visit,
+    const std::function<void()> &afterBatch) {
+  // Блокировка берется на SnapshotBatchSize узлов по порядку ключей, записи,
+  // измененные до того, как до них дошел обход, берутся из snapshotView_.
+  // Потоки других диапазонов меняют только свой cursor
+  KeyRange &range = snapshotRanges[i];
+  bool finished = false;
+  while (!finished) {
+    {
+      std::shared_lock<std::shared_mutex> lock(nodeMutex);
+      Node *it = range.cursor ? upperBound(*range.cursor)
+                              : rangeBegin(snapshotRanges, i);
+      for (size_t count = 0; !pastRange(range, it) && count < SnapshotBatchSize;
+           ++count) {
+        if (!IsExpired(it->timeToDel, at) &&
+            !snapshotView_.Preserved(it->key)) {
+          visit(it->key, it->val, it->timeToDel);
+        }
+        range.cursor = it->key;
+        it = nextElem(it);
+      }
+      finished = pastRange(range, it);
     }
-    return unknownError;
+    afterBatch();
+    // Мьютекс не соблюдает очередь, ожидающие операции пропускаются вперед
+    std::this_thread::yield();
   }
-  for (size_t i = 0; i < values.size(); ++i) {
-    set(values[i].first, values[i].second);
+}
+
+std::vector<SelfBalancingBinarySearchTree::KeyRange>
+SelfBalancingBinarySearchTree::splitRanges(const size_t count) const {
+  // Узлы первых depth уровней делят дерево на 2^depth частей, 2^depth <= count
+  int depth = 0;
+  while ((size_t(2) << depth) <= count) {
+    ++depth;
   }
-  return values.size();
+  std::vector<KeyRange> ranges;
+  collectRangeEnds(root, depth, ranges);
+  ranges.push_back({std::nullopt, std::nullopt});
+  return ranges;
 }
 
-int SelfBalancingBinarySearchTree::exportValues(const std::string &filename) {
-  std::lock_guard<std::mutex> lock(nodeMutex);
-  Node *it = findMin(root);
-  std::vector<std::pair<Key, Value>> values;
-  if (it) {
-    do {
-      values.push_back(std::pair<Key, Value>(it->key, it->val));
-      it = nextElem(it);
-    } while (it);
+void SelfBalancingBinarySearchTree::collectRangeEnds(
+    Node *n, const int depth, std::vector<KeyRange> &ranges) const {
+  if (!n || depth == 0) {
+    return;
   }
-  return Data::saveData(filename, values);
+  collectRangeEnds(n->leftChild, depth - 1, ranges);
+  ranges.push_back({n->key, std::nullopt});
+  collectRangeEnds(n->rightChild, depth - 1, ranges);
+}
+
+SelfBalancingBinarySearchTree::KeyRange &
+SelfBalancingBinarySearchTree::rangeOf(const std::string &key) {
+  return *std::partition_point(snapshotRanges.begin(), snapshotRanges.end(),
+                               [&key](const KeyRange &range) {
+                                 return range.last && *range.last < key;
+                               });
+}
+
+SelfBalancingBinarySearchTree::Node *SelfBalancingBinarySearchTree::rangeBegin(
+    const std::vector<KeyRange> &ranges, const size_t i) const {
+  return i == 0 ? findMin(root) : upperBound(*ranges[i - 1].last);
 }
 
 const std::vector<std::string> SelfBalancingBinarySearchTree::find(
     const Value &value, const int ttl, const int paramsMask) {
   std::vector<std::string> res;
-  std::lock_guard<std::mutex> lock(nodeMutex);
+  if (paramsMask & pTtl) {
+    const auto [from, to] = TtlWindow(ttl);
+    auto candidates = dispatcher->ExpiringBetween(from, to);
+    std::lock_guard<std::shared_mutex> lock(nodeMutex);
+    for (const auto &key : candidates) {
+      Node *n = findAliveNode(key);
+      if (n && IsMatch(n->val, n->timeToDel, value, ttl, paramsMask)) {
+        res.push_back(key);
+      }
+    }
+    return res;
+  }
+  std::lock_guard<std::shared_mutex> lock(nodeMutex);
   if (!root) {
     return res;
   }
+  const Deadline now = Clock::now();
   Node *it = findMin(root);
   while (it) {
-    if ((!(paramsMask & pLastname) || it->val.lastname == value.lastname) &&
-        (!(paramsMask & pName) || it->val.name == value.name) &&
-        (!(paramsMask & pYear) || it->val.year == value.year) &&
-        (!(paramsMask & pCity) || it->val.city == value.city) &&
-        (!(paramsMask & pCoins) || it->val.coins == value.coins) &&
-        (!(paramsMask & pTtl) || it->timeToDel == (time(nullptr) + ttl))) {
+    if (!IsExpired(it->timeToDel, now) &&
+        IsMatch(it->val, it->timeToDel, value, ttl, paramsMask)) {
       res.push_back(it->key);
     }
     it = nextElem(it);
@@ -264,27 +602,185 @@ const std::vector<std::string> SelfBalancingBinarySearchTree::find(
 
 const std::vector<Value> SelfBalancingBinarySearchTree::showall() {
   std::vector<Value> res;
-  std::lock_guard<std::mutex> lock(nodeMutex);
+  std::lock_guard<std::shared_mutex> lock(nodeMutex);
   if (!root) {
     return res;
   }
+  const Deadline now = Clock::now();
   Node *it = findMin(root);
   while (it) {
-    res.push_back(it->val);
+    if (!IsExpired(it->timeToDel, now)) {
+      res.push_back(it->val);
+    }
     it = nextElem(it);
   }
   return res;
 }
 
+const std::vector<AggregateRow> SelfBalancingBinarySearchTree::aggregate(
+    const AggregateQuery &query) {
+  const size_t workersCount =
+      WorkersFor(countItems.load(), std::numeric_limits<size_t>::max());
+  std::vector<Aggregator> partials(workersCount, Aggregator(query));
+  // Каждый поток обходит свой диапазон ключей и считает свой Aggregator
+  std::unique_lock<std::mutex> snapshotLock(snapshotMutex_, std::try_to_lock);
+  if (snapshotLock.owns_lock()) {
+    // Обход идет через snapshotView_, поэтому запись, перенесенная rename или
+    // mset во время обхода, учитывается ровно один раз
+    std::vector<EntryWriter> visits;
+    for (size_t i = 0; i < workersCount; ++i) {
+      visits.push_back([&partials, &query, i](const Key &, const Value &value,
+                                              const Deadline timeToDel) {
+        if (IsMatch(value, timeToDel, query.filter, query.ttl,
+                    query.paramsMask)) {
+          partials[i].Add(value);
+        }
+      });
+    }
+    walkSnapshot([]() {}, visits);
+  } else {
+    // snapshotView_ занят выгрузкой или снимком. Чтобы не ждать их, дерево
+    // обходится под совместной блокировкой на все время запроса: изменения
+    // ждут его окончания, а выгрузка продолжается
+    std::shared_lock<std::shared_mutex> lock(nodeMutex);
+    const Deadline now = Clock::now();
+    const std::vector<KeyRange> ranges = splitRanges(workersCount);
+    RunInParallel(ranges.size(), [this, now, &ranges, &partials,
+                                  &query](size_t i) {
+      for (Node *it = rangeBegin(ranges, i); !pastRange(ranges[i], it);
+           it = nextElem(it)) {
+        if (!IsExpired(it->timeToDel, now) &&
+            IsMatch(it->val, it->timeToDel, query.filter, query.ttl,
+                    query.paramsMask)) {
+          partials[i].Add(it->val);
+        }
+      }
+    });
+  }
+  for (size_t i = 1; i < workersCount; ++i) {
+    partials[0].Merge(partials[i]);
+  }
+  return partials[0].Result();
+}
+
 void SelfBalancingBinarySearchTree::clearTree() {
-  Key curRoot;
-  while (countItems.load()) {
-    {
-      std::lock_guard<std::mutex> lock(nodeMutex);
-      curRoot = root->key;
+  // Узлы освобождаются без del: очистка не удаляет записи, поэтому не
+  // публикует события и не меняет статистику, журнал и снимок
+  std::lock_guard<std::shared_mutex> lock(nodeMutex);
+  std::vector<Node *> nodes;
+  if (root) {
+    nodes.push_back(root);
+  }
+  while (!nodes.empty()) {
+    Node *n = nodes.back();
+    nodes.pop_back();
+    if (n->leftChild) {
+      nodes.push_back(n->leftChild);
+    }
+    if (n->rightChild) {
+      nodes.push_back(n->rightChild);
+    }
+    delete n;
+  }
+  root = nullptr;
+  countItems = 0;
+}
+
+Errors SelfBalancingBinarySearchTree::eraseNode(Node *n) {
+  n = detachNode(n);
+  if (!n) {
+    return unknownError;
+  }
+  delete n;
+  return noErrors;
+}
+
+SelfBalancingBinarySearchTree::Node *SelfBalancingBinarySearchTree::detachNode(
+    Node *n) {
+  preserveForSnapshot(n->key, n);
+  statistics_.Erase(n->val);
+  Node *replacedNode = nullptr;
+  if (n->leftChild && n->rightChild) {
+    replacedNode = n->leftChild;
+    while (replacedNode->rightChild) {
+      replacedNode = replacedNode->rightChild;
+    }
+  }
+  Node *child = n->leftChild ? n->leftChild : n->rightChild;
+
+  if (replacedNode) {
+    child = replacedNode->leftChild ? replacedNode->leftChild
+                                    : replacedNode->rightChild;
+    if (child) {
+      child->parent = replacedNode->parent;
+    }
+    if (replacedNode->color == black) {
+      if (child && child->color == red) {
+        child->color = black;
+      } else {
+        deleteCase1(replacedNode);
+      }
+    }
+    std::swap(n->key, replacedNode->key);
+    std::swap(n->val, replacedNode->val);
+    std::swap(n->timeToDel, replacedNode->timeToDel);
+    std::swap(n->version, replacedNode->version);
+    n = replacedNode;
+  } else {
+    if (child) {
+      child->parent = n->parent;
+    }
+    if (n->color == black) {
+      if (child && child->color == red) {
+        child->color = black;
+        if (n == root) {
+          root = child;
+        }
+      } else {
+        deleteCase1(n);
+      }
     }
-    del(curRoot);
   }
+
+  if (n->parent && n == n->parent->leftChild) {
+    n->parent->leftChild = child;
+  } else if (n->parent && n == n->parent->rightChild) {
+    n->parent->rightChild = child;
+  } else if (n->parent) {
+    return nullptr;
+  }
+  --countItems;
+  return n;
+}
+
+SelfBalancingBinarySearchTree::Node *SelfBalancingBinarySearchTree::insertNode(
+    Key key, Value value, const Deadline timeToDel) {
+  findAliveNode(key);
+  Node *node = new Node;
+  node->key = std::move(key);
+  node->val = std::move(value);
+  node->timeToDel = timeToDel;
+  node->version = NextVersion();
+  if (!attachNode(node)) {
+    delete node;
+    return nullptr;
+  }
+  return node;
+}
+
+bool SelfBalancingBinarySearchTree::attachNode(Node *node) {
+  node->color = red;
+  node->leftChild = nullptr;
+  node->rightChild = nullptr;
+  node->parent = nullptr;
+  if (!findPlaceForNewNode(node)) {
+    return false;
+  }
+  preserveForSnapshot(node->key, nullptr);
+  insertCase1(node);
+  statistics_.Insert(node->val);
+  ++countItems;
+  return true;
 }
 
 bool SelfBalancingBinarySearchTree::findPlaceForNewNode(Node *newNode) {
@@ -450,6 +946,50 @@ void SelfBalancingBinarySearchTree::insertCase5(Node *n) {
   }
 }
 
+SelfBalancingBinarySearchTree::Node *
+SelfBalancingBinarySearchTree::findAliveNode(const std::string &key) {
+  Node *n = findNode(key);
+  if (n && IsExpired(n->timeToDel)) {
+    // Истекшая запись считается отсутствующей и удаляется при обращении
+    eraseNode(n);
+    notifier_.Publish(evExpire, key);
+    RecordChange(logExpire, key);
+    n = nullptr;
+  }
+  return n;
+}
+
+SelfBalancingBinarySearchTree::Node *SelfBalancingBinarySearchTree::upperBound(
+    const std::string &key) const {
+  Node *res = nullptr;
+  Node *cur = root;
+  while (cur) {
+    if (cur->key > key) {
+      res = cur;
+      cur = cur->leftChild;
+    } else {
+      cur = cur->rightChild;
+    }
+  }
+  return res;
+}
+
+void SelfBalancingBinarySearchTree::preserveForSnapshot(const std::string &key,
+                                                        const Node *n) {
+  if (!snapshotView_.Active()) {
+    return;
+  }
+  const KeyRange &range = rangeOf(key);
+  if (range.cursor && key <= *range.cursor) {
+    return;
+  }
+  if (n) {
+    snapshotView_.Preserve(key, &n->val, n->timeToDel);
+  } else {
+    snapshotView_.Preserve(key, nullptr, NoDeadline);
+  }
+}
+
 SelfBalancingBinarySearchTree::Node *SelfBalancingBinarySearchTree::findNode(
     const std::string &key) const {
   Node *cur = root;
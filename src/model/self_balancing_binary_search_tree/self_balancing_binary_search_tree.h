@@ -1,7 +1,9 @@
 #ifndef SRC_MODEL_SELF_BALANCING_BINARY_SEARCH_THREE_SELF_BALANCING_BINARY_SEARCH_THREE_H_
 #define SRC_MODEL_SELF_BALANCING_BINARY_SEARCH_THREE_SELF_BALANCING_BINARY_SEARCH_THREE_H_
 
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
 
 #include "../abstract_key_value_store/abstract_key_value_store.h"
 #include "../dispatchers/dispatcher_base.h"
@@ -13,7 +15,8 @@ class SelfBalancingBinarySearchTree : public AbstractKeyValueStore {
   struct Node {
     Key key;
     Value val;
-    time_t timeToDel;
+    Deadline timeToDel;
+    uint64_t version;
     Node* parent;
     Node* leftChild;
     Node* rightChild;
@@ -26,29 +29,92 @@ class SelfBalancingBinarySearchTree : public AbstractKeyValueStore {
   SelfBalancingBinarySearchTree();
   ~SelfBalancingBinarySearchTree();
 
+  using AbstractKeyValueStore::mset;
+  using AbstractKeyValueStore::set;
+  using AbstractKeyValueStore::update;
+  using AbstractKeyValueStore::updateIfVersion;
+
   Errors set(const std::string& key, const Value& value,
-             int ttl = hasNoTtl) override;
+             std::chrono::milliseconds ttl) override;
+  Errors set(Key&& key, Value&& value,
+             std::chrono::milliseconds ttl) override;
   std::optional<Value> get(const std::string& key) override;
+  bool visit(const Key& key,
+             const std::function<void(const Value&)>& visitor) override;
+  std::optional<VersionedValue> getVersioned(const Key& key) override;
+  bool SupportsVersions() const override { return true; }
   bool exists(const std::string& key) override;
   Errors del(const std::string& key) override;
-  Errors update(const Key& key, const Value& value, const int ttl,
-                const int paramsMask) override;
+  Errors delIfVersion(const Key& key, const uint64_t version) override;
+  Errors update(const Key& key, const Value& value,
+                std::chrono::milliseconds ttl, const int paramsMask) override;
+  Errors updateIfVersion(const Key& key, const Value& value,
+                         std::chrono::milliseconds ttl, const int paramsMask,
+                         const uint64_t version) override;
   Errors rename(const std::string& oldKey, const std::string& newKey) override;
-  int Ttl(const std::string& key) override;
+  Errors incrBy(const Key& key, const int field, const int delta,
+                int& result) override;
+  long long PTtl(const std::string& key) override;
+  std::vector<std::optional<Value>> mget(
+      const std::vector<Key>& keys) override;
+  std::vector<Errors> mset(const std::vector<std::pair<Key, Value>>& values,
+                           std::chrono::milliseconds ttl) override;
+  std::vector<Errors> mdel(const std::vector<Key>& keys) override;
+  size_t expireBatch(const std::vector<std::string>& keys) override;
+  std::vector<std::string> expiringWithin(
+      std::chrono::milliseconds window) override;
+  std::vector<size_t> expiryHistogram(std::chrono::milliseconds bucket,
+                                      const size_t bucketsCount) override;
 
-  int upload(const std::string& filename) override;
-  int exportValues(const std::string& filename) override;
+  size_t bulkInsert(std::vector<std::pair<Key, Value>>& values) override;
 
   const std::vector<std::string> keys() override;
   const std::vector<std::string> find(const Value& value, const int ttl,
                                       const int paramsMask) override;
   const std::vector<Value> showall() override;
+  const std::vector<AggregateRow> aggregate(
+      const AggregateQuery& query) override;
+  void forEachEntry(const std::function<void()>& underLock,
+                    const EntryWriter& write) override;
+
+ protected:
+  std::vector<Entry> copyEntries(
+      const std::function<void()>& underLock) override;
 
  private:
+  // Диапазон ключей после last предыдущего диапазона до last включительно,
+  // last == nullopt - до конца дерева. Ключи диапазона до cursor включительно
+  // обход snapshotView_ уже прошел
+  struct KeyRange {
+    std::optional<Key> last;
+    std::optional<Key> cursor;
+  };
+
   Node* root;
-  std::mutex nodeMutex;
+  // Изменения и поиск захватывают nodeMutex монопольно, потому что поиск
+  // удаляет истекшие узлы. Потоки обхода snapshotView_ и aggregate только
+  // читают дерево и захватывают его совместно
+  std::shared_mutex nodeMutex;
+  std::shared_ptr<Dispatcher> dispatcher;
+  // Диапазоны, на которые делится обход snapshotView_, каждый проходит свой
+  // поток
+  std::vector<KeyRange> snapshotRanges;
 
   void clearTree();
+  // Требует захваченного nodeMutex. nullptr, если ключ уже существует
+  Node* insertNode(Key key, Value value, const Deadline timeToDel);
+  // Узел вставляется в дерево заново, с сохранением key и val
+  bool attachNode(Node* node);
+  // Требуют захваченного nodeMutex. Номер записи журнала пишется в lsn.
+  // setUnderLock возвращает новый узел или nullptr, если ключ уже есть
+  Node* setUnderLock(Key key, Value value, const Deadline timeToDel,
+                     uint64_t& lsn);
+  // Непустой version - ожидаемая версия записи
+  Errors delUnderLock(const Key& key, bool& hasTtl, uint64_t& lsn,
+                      const std::optional<uint64_t>& version = std::nullopt);
+  Errors updateNode(const Key& key, const Value& value,
+                    std::chrono::milliseconds ttl, const int paramsMask,
+                    const std::optional<uint64_t>& version);
   bool findPlaceForNewNode(Node* newNode);
   Node* grandParent(const Node& n);
   Node* uncle(const Node& n);
@@ -61,6 +127,38 @@ class SelfBalancingBinarySearchTree : public AbstractKeyValueStore {
   void insertCase4(Node* n);
   void insertCase5(Node* n);
   Node* findNode(const std::string& key) const;
+  Node* findAliveNode(const std::string& key);
+  // Первый узел с ключом больше key
+  Node* upperBound(const std::string& key) const;
+  void preserveForSnapshot(const std::string& key, const Node* n);
+  // Вызывает visits для живых записей на момент snapshotView_.Begin. Требует
+  // захваченного snapshotMutex_. Ключи делятся не больше чем на visits.size()
+  // диапазонов, visits[i] вызывается для узлов i-го диапазона из своего
+  // потока под совместно захваченным nodeMutex, а для записей, сохраненных в
+  // snapshotView_, - visits[0] после всех диапазонов. afterBatch вызывается
+  // без блокировки после каждых SnapshotBatchSize записей диапазона и в конце
+  // обхода, при нескольких диапазонах - одновременно
+  void walkSnapshot(
+      const std::function<void()>& underLock,
+      const std::vector<EntryWriter>& visits,
+      const std::function<void()>& afterBatch = []() {});
+  void walkRange(const size_t i, const Deadline at, const EntryWriter& visit,
+                 const std::function<void()>& afterBatch);
+  // Требует захваченного nodeMutex. Не больше count диапазонов, границы
+  // которых - ключи верхних уровней дерева, поэтому диапазоны примерно равны
+  std::vector<KeyRange> splitRanges(const size_t count) const;
+  void collectRangeEnds(Node* n, const int depth,
+                        std::vector<KeyRange>& ranges) const;
+  KeyRange& rangeOf(const std::string& key);
+  // Первый узел диапазона ranges[i] и проверка, что узел за его концом
+  Node* rangeBegin(const std::vector<KeyRange>& ranges, const size_t i) const;
+  static bool pastRange(const KeyRange& range, const Node* n) {
+    return !n || (range.last && n->key > *range.last);
+  }
+  Errors eraseNode(Node* n);
+  // Узел исключается из дерева, но не удаляется. Возвращает узел, который
+  // хранит запись n, или nullptr при нарушении структуры дерева
+  Node* detachNode(Node* n);
 
   Errors deleteCase1(Node* n);
   Errors deleteCase2(Node* n);
@@ -0,0 +1,67 @@
+#include "bloom_filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace s21 {
+
+namespace {
+constexpr size_t BlockBits = 512;
+
+// Номер следующего бита в блоке: старшие биты шагов мультипликативного
+// генератора, начатого с хеша
+size_t NextBit(uint64_t& state) {
+  state = state * 0x9e3779b97f4a7c15ULL + 0x632be59bd9b4e019ULL;
+  return static_cast<size_t>(state >> 55);
+}
+}  // namespace
+
+BloomFilter::BloomFilter(size_t expectedItems, double falsePositiveRate)
+    : capacity_(expectedItems), blocksCount_(0), hashesCount_(0) {
+  if (!(falsePositiveRate > 0 && falsePositiveRate < 1)) return;
+  // Оптимум обычного фильтра: ln(1/p) / ln(2)^2 бит и ln(2) * бит хешей на
+  // ключ. Блочному фильтру для той же доли нужно на десятую часть бит больше
+  const double ln2 = std::log(2.0);
+  const double bitsPerKey = -std::log(falsePositiveRate) / (ln2 * ln2) * 1.1;
+  hashesCount_ = std::clamp(static_cast<int>(std::lround(bitsPerKey * ln2)),
+                            1, 16);
+  const double bits = std::max<double>(expectedItems, 1) * bitsPerKey;
+  blocksCount_ = static_cast<size_t>(std::ceil(bits / BlockBits));
+  blocks_.assign(blocksCount_ * BlockWords, 0);
+}
+//----------------------------------------------------------------
+uint64_t BloomFilter::HashOf(std::string_view key) {
+  uint64_t hash = std::hash<std::string_view>()(key);
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+//----------------------------------------------------------------
+void BloomFilter::Add(uint64_t hash) {
+  if (blocks_.empty()) return;
+  // Старшая половина хеша выбирает блок
+  uint64_t* block = &blocks_[((hash >> 32) * blocksCount_ >> 32) * BlockWords];
+  uint64_t h = hash;
+  for (int i = 0; i < hashesCount_; ++i) {
+    const size_t bit = NextBit(h);
+    block[bit / 64] |= uint64_t(1) << (bit % 64);
+  }
+}
+//----------------------------------------------------------------
+bool BloomFilter::MayContain(uint64_t hash) const {
+  if (blocks_.empty()) return true;
+  const uint64_t* block =
+      &blocks_[((hash >> 32) * blocksCount_ >> 32) * BlockWords];
+  uint64_t h = hash;
+  for (int i = 0; i < hashesCount_; ++i) {
+    const size_t bit = NextBit(h);
+    if (!(block[bit / 64] & (uint64_t(1) << (bit % 64)))) return false;
+  }
+  return true;
+}
+
+}  //  namespace s21
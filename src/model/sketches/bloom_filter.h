@@ -0,0 +1,41 @@
+// Блочный фильтр Блума: все биты ключа лежат в одном блоке размером со
+// строку кеша, поэтому проверка читает одну строку памяти. Отвечает "точно
+// нет" или "возможно есть"
+#ifndef SRC_MODEL_SKETCHES_BLOOM_FILTER_H_
+#define SRC_MODEL_SKETCHES_BLOOM_FILTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace s21 {
+
+class BloomFilter {
+ public:
+  // Фильтр на expectedItems ключей с долей ложных срабатываний
+  // falsePositiveRate. Доля вне (0, 1) отключает фильтр: MayContain всегда
+  // возвращает true
+  explicit BloomFilter(size_t expectedItems = 0,
+                       double falsePositiveRate = 0.01);
+
+  // Перемешанный std::hash строки, им же хеширует значения FieldStatistics
+  static uint64_t HashOf(std::string_view key);
+
+  void Add(uint64_t hash);
+  bool MayContain(uint64_t hash) const;
+  bool Enabled() const { return !blocks_.empty(); }
+  size_t Capacity() const { return capacity_; }
+
+ private:
+  static constexpr size_t BlockWords = 8;
+
+  size_t capacity_;
+  size_t blocksCount_;
+  int hashesCount_;
+  std::vector<uint64_t> blocks_;
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_SKETCHES_BLOOM_FILTER_H_
@@ -0,0 +1,40 @@
+#include "count_min_sketch.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace s21 {
+
+CountMinSketch::CountMinSketch(size_t width, size_t depth)
+    : width_(width), depth_(depth), counters_(width * depth, 0) {}
+//----------------------------------------------------------------
+long long CountMinSketch::Add(uint64_t hash, long long delta) {
+  long long estimate = LLONG_MAX;
+  for (size_t row = 0; row < depth_; ++row) {
+    long long& counter = counters_[Cell(hash, row)];
+    counter += delta;
+    estimate = std::min(estimate, counter);
+  }
+  return estimate;
+}
+//----------------------------------------------------------------
+void CountMinSketch::Merge(const CountMinSketch& other) {
+  for (size_t i = 0; i < counters_.size(); ++i)
+    counters_[i] += other.counters_[i];
+}
+//----------------------------------------------------------------
+long long CountMinSketch::Estimate(uint64_t hash) const {
+  long long estimate = LLONG_MAX;
+  for (size_t row = 0; row < depth_; ++row)
+    estimate = std::min(estimate, counters_[Cell(hash, row)]);
+  return estimate;
+}
+//----------------------------------------------------------------
+size_t CountMinSketch::Cell(uint64_t hash, size_t row) const {
+  // Двойное хеширование: строки различаются шагом второй половины хеша
+  const uint32_t h1 = static_cast<uint32_t>(hash);
+  const uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+  return row * width_ + (h1 + row * h2) % width_;
+}
+
+}  //  namespace s21
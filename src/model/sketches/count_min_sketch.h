@@ -0,0 +1,30 @@
+// Оценка частот значений (Count-Min) с поддержкой уменьшения счетчиков
+#ifndef SRC_MODEL_SKETCHES_COUNT_MIN_SKETCH_H_
+#define SRC_MODEL_SKETCHES_COUNT_MIN_SKETCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace s21 {
+
+class CountMinSketch {
+ public:
+  explicit CountMinSketch(size_t width = 2048, size_t depth = 4);
+
+  long long Add(uint64_t hash, long long delta);
+  // Прибавляет счетчики other тех же размеров
+  void Merge(const CountMinSketch& other);
+  long long Estimate(uint64_t hash) const;
+
+ private:
+  size_t width_;
+  size_t depth_;
+  std::vector<long long> counters_;
+
+  size_t Cell(uint64_t hash, size_t row) const;
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_SKETCHES_COUNT_MIN_SKETCH_H_
@@ -0,0 +1,148 @@
+#include "field_statistics.h"
+
+#include <algorithm>
+
+#include "bloom_filter.h"
+
+namespace s21 {
+
+void FieldStatistics::FieldSketch::Add(const std::string& fieldValue,
+                                       long long delta) {
+  const uint64_t hash = BloomFilter::HashOf(fieldValue);
+  if (delta > 0) {
+    distinct.Add(hash);
+    if (recounted) recounted->Add(hash);
+  }
+  long long estimate = frequency.Add(hash, delta);
+
+  auto found = candidates.find(fieldValue);
+  if (found != candidates.end()) {
+    if (estimate > 0)
+      found->second = estimate;
+    else
+      candidates.erase(found);
+    return;
+  }
+  if (delta <= 0) return;
+  if (candidates.size() < CandidatesCount) {
+    candidates.emplace(fieldValue, estimate);
+    return;
+  }
+  auto minIt = std::min_element(
+      candidates.begin(), candidates.end(),
+      [](const auto& lhs, const auto& rhs) { return lhs.second < rhs.second; });
+  if (minIt->second < estimate) {
+    candidates.erase(minIt);
+    candidates.emplace(fieldValue, estimate);
+  }
+}
+//----------------------------------------------------------------
+void FieldStatistics::FieldSketch::Merge(const FieldSketch& other) {
+  distinct.Merge(other.distinct);
+  if (recounted) recounted->Merge(other.distinct);
+  frequency.Merge(other.frequency);
+  // Кандидаты обеих частей переоцениваются по общим счетчикам, остаются
+  // CandidatesCount самых частых
+  for (auto it = other.candidates.begin(); it != other.candidates.end(); ++it)
+    candidates.emplace(it->first, 0);
+  std::vector<std::pair<std::string, long long>> merged;
+  merged.reserve(candidates.size());
+  for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+    long long estimate = frequency.Estimate(BloomFilter::HashOf(it->first));
+    if (estimate > 0) merged.emplace_back(it->first, estimate);
+  }
+  if (merged.size() > CandidatesCount) {
+    std::nth_element(merged.begin(), merged.begin() + CandidatesCount,
+                     merged.end(), [](const auto& lhs, const auto& rhs) {
+                       return lhs.second > rhs.second;
+                     });
+    merged.resize(CandidatesCount);
+  }
+  candidates = std::unordered_map<std::string, long long>(merged.begin(),
+                                                           merged.end());
+}
+//----------------------------------------------------------------
+void FieldStatistics::Insert(const Value& value) {
+  std::lock_guard<std::mutex> lock(statisticsMutex_);
+  lastname_.Add(value.lastname, 1);
+  name_.Add(value.name, 1);
+  city_.Add(value.city, 1);
+}
+//----------------------------------------------------------------
+void FieldStatistics::Erase(const Value& value) {
+  std::lock_guard<std::mutex> lock(statisticsMutex_);
+  lastname_.Add(value.lastname, -1);
+  name_.Add(value.name, -1);
+  city_.Add(value.city, -1);
+}
+//----------------------------------------------------------------
+void FieldStatistics::Merge(FieldStatistics& other) {
+  std::scoped_lock lock(statisticsMutex_, other.statisticsMutex_);
+  lastname_.Merge(other.lastname_);
+  name_.Merge(other.name_);
+  city_.Merge(other.city_);
+}
+//----------------------------------------------------------------
+void FieldStatistics::StartRecount() {
+  std::lock_guard<std::mutex> lock(statisticsMutex_);
+  for (FieldSketch* sketch : {&lastname_, &name_, &city_})
+    sketch->recounted.emplace();
+}
+//----------------------------------------------------------------
+void FieldStatistics::Recount(const Value& value) {
+  std::lock_guard<std::mutex> lock(statisticsMutex_);
+  if (!city_.recounted) return;
+  lastname_.recounted->Add(BloomFilter::HashOf(value.lastname));
+  name_.recounted->Add(BloomFilter::HashOf(value.name));
+  city_.recounted->Add(BloomFilter::HashOf(value.city));
+}
+//----------------------------------------------------------------
+void FieldStatistics::FinishRecount(const bool completed) {
+  std::lock_guard<std::mutex> lock(statisticsMutex_);
+  for (FieldSketch* sketch : {&lastname_, &name_, &city_}) {
+    if (completed && sketch->recounted)
+      sketch->distinct = std::move(*sketch->recounted);
+    sketch->recounted.reset();
+  }
+}
+//----------------------------------------------------------------
+long long FieldStatistics::ApproxDistinct(const int field) {
+  std::lock_guard<std::mutex> lock(statisticsMutex_);
+  FieldSketch* sketch = SketchOf(field);
+  return sketch ? sketch->distinct.Estimate() : 0;
+}
+//----------------------------------------------------------------
+std::vector<HeavyHitter> FieldStatistics::TopK(const int field,
+                                               const size_t k) {
+  std::lock_guard<std::mutex> lock(statisticsMutex_);
+  std::vector<HeavyHitter> res;
+  FieldSketch* sketch = SketchOf(field);
+  if (!sketch) return res;
+  for (auto it = sketch->candidates.begin(); it != sketch->candidates.end();
+       ++it)
+    res.push_back(HeavyHitter{
+        it->first,
+        sketch->frequency.Estimate(BloomFilter::HashOf(it->first))});
+  std::sort(res.begin(), res.end(),
+            [](const HeavyHitter& lhs, const HeavyHitter& rhs) {
+              return lhs.count > rhs.count ||
+                     (lhs.count == rhs.count && lhs.value < rhs.value);
+            });
+  if (res.size() > k) res.resize(k);
+  return res;
+}
+//----------------------------------------------------------------
+FieldStatistics::FieldSketch* FieldStatistics::SketchOf(const int field) {
+  switch (field) {
+    case pLastname:
+      return &lastname_;
+    case pName:
+      return &name_;
+    case pCity:
+      return &city_;
+    default:
+      return nullptr;
+  }
+}
+
+}  //  namespace s21
@@ -0,0 +1,65 @@
+// Приближенная статистика по строковым полям записей: число уникальных
+// значений и наиболее частые значения. Обновляется при изменении хранилища.
+// HyperLogLog не умеет убирать значения, поэтому после удалений и изменений
+// число уникальных значений завышено, пока полный снимок хранилища не
+// пересчитает его через StartRecount, Recount и FinishRecount
+#ifndef SRC_MODEL_SKETCHES_FIELD_STATISTICS_H_
+#define SRC_MODEL_SKETCHES_FIELD_STATISTICS_H_
+
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../types.h"
+#include "count_min_sketch.h"
+#include "hyper_log_log.h"
+
+namespace s21 {
+
+class FieldStatistics {
+ public:
+  FieldStatistics() = default;
+
+  void Insert(const Value& value);
+  void Erase(const Value& value);
+  // Добавляет статистику other, собранную отдельно, например потоком загрузки
+  void Merge(FieldStatistics& other);
+
+  // Пересчет числа уникальных значений обходом хранилища. StartRecount
+  // вызывается под блокировкой хранилища в начале обхода: значения, которые
+  // добавляются во время обхода, попадают и в пересчет. FinishRecount с
+  // completed == false отбрасывает пересчет после неудачного обхода
+  void StartRecount();
+  void Recount(const Value& value);
+  void FinishRecount(const bool completed);
+
+  long long ApproxDistinct(const int field);
+  std::vector<HeavyHitter> TopK(const int field, const size_t k);
+
+ private:
+  // Число кандидатов в частые значения, которое хранится для каждого поля
+  static constexpr size_t CandidatesCount = 64;
+
+  struct FieldSketch {
+    HyperLogLog distinct;
+    std::optional<HyperLogLog> recounted;
+    CountMinSketch frequency;
+    std::unordered_map<std::string, long long> candidates;
+
+    void Add(const std::string& fieldValue, long long delta);
+    void Merge(const FieldSketch& other);
+  };
+
+  std::mutex statisticsMutex_;
+  FieldSketch lastname_;
+  FieldSketch name_;
+  FieldSketch city_;
+
+  FieldSketch* SketchOf(const int field);
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_SKETCHES_FIELD_STATISTICS_H_
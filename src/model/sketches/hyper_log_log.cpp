@@ -0,0 +1,38 @@
+#include "hyper_log_log.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace s21 {
+
+HyperLogLog::HyperLogLog(int precision)
+    : precision_(precision), registers_(size_t(1) << precision, 0) {}
+//----------------------------------------------------------------
+void HyperLogLog::Add(uint64_t hash) {
+  const size_t idx = hash >> (64 - precision_);
+  const uint64_t rest =
+      (hash << precision_) | (uint64_t(1) << (precision_ - 1));
+  const uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+  registers_[idx] = std::max(registers_[idx], rank);
+}
+//----------------------------------------------------------------
+void HyperLogLog::Merge(const HyperLogLog& other) {
+  for (size_t i = 0; i < registers_.size(); ++i)
+    registers_[i] = std::max(registers_[i], other.registers_[i]);
+}
+//----------------------------------------------------------------
+long long HyperLogLog::Estimate() const {
+  const double m = static_cast<double>(registers_.size());
+  double sum = 0;
+  int zeros = 0;
+  for (auto it = registers_.begin(); it != registers_.end(); ++it) {
+    sum += std::ldexp(1.0, -*it);
+    if (*it == 0) ++zeros;
+  }
+  const double alpha = 0.7213 / (1.0 + 1.079 / m);
+  double estimate = alpha * m * m / sum;
+  if (estimate <= 2.5 * m && zeros) estimate = m * std::log(m / zeros);
+  return std::llround(estimate);
+}
+
+}  //  namespace s21
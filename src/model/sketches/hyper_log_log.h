@@ -0,0 +1,26 @@
+// Оценка числа уникальных значений (HyperLogLog)
+#ifndef SRC_MODEL_SKETCHES_HYPER_LOG_LOG_H_
+#define SRC_MODEL_SKETCHES_HYPER_LOG_LOG_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace s21 {
+
+class HyperLogLog {
+ public:
+  explicit HyperLogLog(int precision = 14);
+
+  void Add(uint64_t hash);
+  // Добавляет значения other той же точности
+  void Merge(const HyperLogLog& other);
+  long long Estimate() const;
+
+ private:
+  int precision_;
+  std::vector<uint8_t> registers_;
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_SKETCHES_HYPER_LOG_LOG_H_
@@ -0,0 +1,214 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+#include "binary_io.h"
+#include "lz_block.h"
+
+namespace s21 {
+
+namespace {
+constexpr char HeaderMagic[8] = {'S', '2', '1', 'S', 'N', 'A', 'P', '\0'};
+constexpr char FooterMagic[8] = {'S', '2', '1', 'S', 'N', 'E', 'N', 'D'};
+constexpr size_t HeaderSize = 16;
+constexpr size_t IndexEntrySize = 12;
+constexpr size_t FooterSize = 32;
+// Блок закрывается, когда данные записей превышают этот размер
+constexpr size_t BlockPayloadSize = 64 << 10;
+}  // namespace
+
+bool Snapshot::IsSnapshot(std::string_view data) {
+  return data.size() >= sizeof(HeaderMagic) &&
+         std::memcmp(data.data(), HeaderMagic, sizeof(HeaderMagic)) == 0;
+}
+
+uint32_t Snapshot::ChainId(std::string_view data) {
+  if (data.size() < HeaderSize || !IsSnapshot(data)) return 0;
+  return BinaryReader(data.substr(sizeof(HeaderMagic) + 4, 4)).Get<uint32_t>();
+}
+
+int Snapshot::save(const std::string& fileName,
+                   const std::vector<std::pair<Key, Value>>& values,
+                   const bool compress, const uint32_t chainId) {
+  return save(fileName, SourceOf(values), compress, chainId);
+}
+
+int Snapshot::save(const std::string& fileName, const EntrySource& source,
+                   const bool compress, const uint32_t chainId) {
+  std::ofstream fout(fileName, std::ios::binary | std::ios::trunc);
+  if (!fout.is_open()) {
+    return canNotOpenFile;
+  }
+  std::string header(HeaderMagic, sizeof(HeaderMagic));
+  Put<uint32_t>(header, Version);
+  Put<uint32_t>(header, chainId);
+  fout.write(header.data(), header.size());
+
+  std::vector<BlockInfo> blocks;
+  uint64_t offset = HeaderSize;
+  std::string payload;
+  uint32_t recordsCount = 0;
+  uint64_t recordsTotal = 0;
+  auto flushBlock = [&]() {
+    if (recordsCount == 0) return;
+    std::string compressed;
+    if (compress) compressed = LzBlock::Compress(payload);
+    const std::string& stored =
+        compress && compressed.size() < payload.size() ? compressed : payload;
+    std::string sizes;
+    Put<uint32_t>(sizes, recordsCount);
+    Put<uint32_t>(sizes, static_cast<uint32_t>(stored.size()));
+    Put<uint32_t>(sizes, static_cast<uint32_t>(payload.size()));
+    std::string blockHeader = sizes.substr(0, 2 * sizeof(uint32_t));
+    Put<uint32_t>(blockHeader, Crc32(stored, Crc32(sizes)));
+    blockHeader.append(sizes.substr(2 * sizeof(uint32_t)));
+    fout.write(blockHeader.data(), blockHeader.size());
+    fout.write(stored.data(), stored.size());
+    blocks.push_back({offset, recordsCount});
+    offset += blockHeader.size() + stored.size();
+    payload.clear();
+    recordsCount = 0;
+  };
+  source([&](const Key& key, const Value& value, const Deadline timeToDel) {
+    PutString(payload, key);
+    PutString(payload, value.lastname);
+    PutString(payload, value.name);
+    PutString(payload, value.city);
+    Put<int32_t>(payload, value.year);
+    Put<int32_t>(payload, value.coins);
+    Put<int64_t>(payload, ToWallClock(timeToDel));
+    ++recordsCount;
+    ++recordsTotal;
+    if (payload.size() >= BlockPayloadSize) flushBlock();
+  });
+  flushBlock();
+
+  std::string index;
+  for (const auto& block : blocks) {
+    Put<uint64_t>(index, block.offset);
+    Put<uint32_t>(index, block.recordsCount);
+  }
+  std::string footer;
+  Put<uint64_t>(footer, offset);
+  Put<uint32_t>(footer, static_cast<uint32_t>(blocks.size()));
+  Put<uint32_t>(footer, Crc32(index));
+  Put<uint64_t>(footer, recordsTotal);
+  footer.append(FooterMagic, sizeof(FooterMagic));
+  fout.write(index.data(), index.size());
+  fout.write(footer.data(), footer.size());
+  fout.close();
+  if (!fout) {
+    return canNotOpenFile;
+  }
+  return static_cast<int>(recordsTotal);
+}
+
+std::vector<Entry> Snapshot::load(std::string_view data) {
+  if (data.size() < HeaderSize + FooterSize || !IsSnapshot(data))
+    throw std::runtime_error("Corrupted snapshot: bad header");
+  BinaryReader header(data.substr(sizeof(HeaderMagic), 4));
+  if (header.Get<uint32_t>() != Version)
+    throw std::runtime_error("Corrupted snapshot: unsupported version");
+
+  std::string_view footerData = data.substr(data.size() - FooterSize);
+  if (std::memcmp(footerData.data() + FooterSize - sizeof(FooterMagic),
+                  FooterMagic, sizeof(FooterMagic)) != 0)
+    throw std::runtime_error("Corrupted snapshot: bad footer");
+  BinaryReader footer(footerData);
+  const uint64_t indexOffset = footer.Get<uint64_t>();
+  const uint32_t blocksCount = footer.Get<uint32_t>();
+  const uint32_t indexCrc = footer.Get<uint32_t>();
+  const uint64_t recordsTotal = footer.Get<uint64_t>();
+  if (indexOffset < HeaderSize ||
+      indexOffset + uint64_t(blocksCount) * IndexEntrySize !=
+          data.size() - FooterSize)
+    throw std::runtime_error("Corrupted snapshot: bad index");
+  std::string_view indexData =
+      data.substr(indexOffset, blocksCount * IndexEntrySize);
+  if (Crc32(indexData) != indexCrc)
+    throw std::runtime_error("Corrupted snapshot: index checksum mismatch");
+
+  BinaryReader index(indexData);
+  std::vector<BlockInfo> blocks(blocksCount);
+  uint64_t recordsCount = 0;
+  for (auto& block : blocks) {
+    block.offset = index.Get<uint64_t>();
+    block.recordsCount = index.Get<uint32_t>();
+    if (block.offset < HeaderSize || block.offset >= indexOffset)
+      throw std::runtime_error("Corrupted snapshot: bad index");
+    recordsCount += block.recordsCount;
+  }
+  if (recordsCount != recordsTotal)
+    throw std::runtime_error("Corrupted snapshot: records count mismatch");
+
+  // Блоки независимы, поэтому распаковываются и разбираются параллельно
+  const size_t threadsCount = std::max<size_t>(
+      1, std::min<size_t>(std::thread::hardware_concurrency(), blocks.size()));
+  std::vector<std::vector<Entry>> parsed(threadsCount);
+  std::vector<std::exception_ptr> errors(threadsCount);
+  auto parse = [&](size_t part) {
+    try {
+      for (size_t i = part * blocks.size() / threadsCount;
+           i < (part + 1) * blocks.size() / threadsCount; ++i)
+        loadBlock(data.substr(0, indexOffset), blocks[i], parsed[part]);
+    } catch (...) {
+      errors[part] = std::current_exception();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t part = 1; part < threadsCount; ++part)
+    workers.emplace_back(parse, part);
+  parse(0);
+  for (auto& worker : workers) worker.join();
+  for (auto& error : errors)
+    if (error) std::rethrow_exception(error);
+
+  std::vector<Entry> res;
+  res.reserve(recordsTotal);
+  for (auto& part : parsed)
+    std::move(part.begin(), part.end(), std::back_inserter(res));
+  return res;
+}
+
+void Snapshot::loadBlock(std::string_view data, const BlockInfo& block,
+                         std::vector<Entry>& res) {
+  BinaryReader blockHeader(data.substr(block.offset));
+  const uint32_t recordsCount = blockHeader.Get<uint32_t>();
+  const uint32_t storedSize = blockHeader.Get<uint32_t>();
+  const uint32_t crc = blockHeader.Get<uint32_t>();
+  const uint32_t rawSize = blockHeader.Get<uint32_t>();
+  std::string_view stored = blockHeader.Take(storedSize);
+  // Размер до сжатия тоже под суммой: по нему выделяется память и
+  // выбирается, распаковывать ли блок
+  std::string sizes;
+  Put<uint32_t>(sizes, recordsCount);
+  Put<uint32_t>(sizes, storedSize);
+  Put<uint32_t>(sizes, rawSize);
+  if (recordsCount != block.recordsCount || Crc32(stored, Crc32(sizes)) != crc)
+    throw std::runtime_error("Corrupted snapshot: block checksum mismatch");
+  std::string decompressed;
+  if (rawSize != storedSize)
+    decompressed = LzBlock::Decompress(stored, rawSize);
+  BinaryReader reader(rawSize != storedSize ? decompressed : stored);
+  for (uint32_t i = 0; i < recordsCount; ++i) {
+    Entry record;
+    record.key = reader.GetString();
+    record.value.lastname = reader.GetString();
+    record.value.name = reader.GetString();
+    record.value.city = reader.GetString();
+    record.value.year = reader.Get<int32_t>();
+    record.value.coins = reader.Get<int32_t>();
+    record.timeToDel = FromWallClock(reader.Get<int64_t>());
+    res.push_back(std::move(record));
+  }
+  if (!reader.AtEnd())
+    throw std::runtime_error("Corrupted snapshot: block size mismatch");
+}
+
+}  //  namespace s21
@@ -0,0 +1,54 @@
+// Двоичный снимок хранилища. Файл состоит из заголовка, блоков записей с
+// контрольными суммами и индекса блоков в конце файла:
+//   заголовок: "S21SNAP" '\0', версия (u32), номер цепочки снимков (u32,
+//              0 для снимка вне цепочки)
+//   блок:      число записей (u32), размер данных (u32), CRC32 (u32) трех
+//              чисел блока и данных, размер записей до сжатия (u32), данные
+//   записи:    ключ, фамилия, имя, город - длина (u32) и байты, год и число
+//              коинов - i32, время удаления - мс от эпохи (i64), 0 без
+//              времени жизни. Сжаты LzBlock, если это уменьшает блок, иначе
+//              размеры до и после сжатия совпадают
+//   индекс:    для каждого блока смещение (u64) и число записей (u32)
+//   окончание: смещение индекса (u64), число блоков (u32), CRC32 индекса
+//              (u32), число записей (u64), "S21SNEND"
+// Числа записываются в порядке байтов little-endian
+#ifndef SRC_MODEL_SNAPSHOT_H_
+#define SRC_MODEL_SNAPSHOT_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../types.h"
+
+namespace s21 {
+class Snapshot {
+ public:
+  static constexpr uint32_t Version = 1;
+
+  static bool IsSnapshot(std::string_view data);
+  // Номер цепочки DeltaSnapshot из заголовка снимка
+  static uint32_t ChainId(std::string_view data);
+  // Бросает std::runtime_error с "Corrupted", если снимок поврежден
+  static std::vector<Entry> load(std::string_view data);
+  static int save(const std::string& fileName,
+                  const std::vector<std::pair<Key, Value>>& values,
+                  const bool compress = true, const uint32_t chainId = 0);
+  // Записи пишутся блоками по мере обхода source вместе с временем удаления
+  static int save(const std::string& fileName, const EntrySource& source,
+                  const bool compress = true, const uint32_t chainId = 0);
+
+ private:
+  struct BlockInfo {
+    uint64_t offset;
+    uint32_t recordsCount;
+  };
+
+  static void loadBlock(std::string_view data, const BlockInfo& block,
+                        std::vector<Entry>& res);
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_SNAPSHOT_H_
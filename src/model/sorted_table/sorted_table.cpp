@@ -0,0 +1,388 @@
+#include "sorted_table.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+
+#include "../aggregation/aggregator.h"
+#include "../durable_file.h"
+
+namespace s21 {
+
+namespace {
+constexpr size_t HeaderSize = 2 * sizeof(uint32_t) + sizeof(uint64_t);
+constexpr size_t FooterSize = 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+}  // namespace
+
+int SortedTable::Build(const std::string& fileName,
+                       std::vector<std::pair<Key, Value>> values) {
+  std::stable_sort(
+      values.begin(), values.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+  values.erase(std::unique(values.begin(), values.end(),
+                           [](const auto& a, const auto& b) {
+                             return a.first == b.first;
+                           }),
+               values.end());
+  return Build(fileName, SourceOf(values));
+}
+
+//----------------------------------------------------------------
+int SortedTable::Build(const std::string& fileName,
+                       const EntrySource& source) {
+  // Открытая таблица читает файл через отображение, поэтому новый файл
+  // пишется рядом и заменяет старый переименованием
+  const std::string tmpName = fileName + ".tmp";
+  std::ofstream fout(tmpName, std::ios::binary | std::ios::trunc);
+  if (!fout.is_open()) return canNotOpenFile;
+  // Число записей известно только после обхода, поэтому заголовок
+  // переписывается в конце
+  fout.write(std::string(HeaderSize, '\0').data(), HeaderSize);
+
+  std::string record;
+  std::string fences;
+  uint64_t fencesCount = 0;
+  uint64_t count = 0;
+  uint64_t offset = HeaderSize;
+  Key lastKey;
+  bool ordered = true;
+  source([&](const Key& key, const Value& value, const Deadline) {
+    if (!ordered) return;
+    if (count > 0 && !(lastKey < key)) {
+      ordered = false;
+      return;
+    }
+    if (count % FenceInterval == 0) {
+      PutString(fences, key);
+      Put<uint64_t>(fences, offset);
+      ++fencesCount;
+    }
+    record.clear();
+    PutString(record, key);
+    PutString(record, value.lastname);
+    PutString(record, value.name);
+    PutString(record, value.city);
+    Put<int32_t>(record, value.year);
+    Put<int32_t>(record, value.coins);
+    fout.write(record.data(), record.size());
+    offset += record.size();
+    ++count;
+    lastKey = key;
+  });
+
+  std::string header;
+  Put<uint32_t>(header, Magic);
+  Put<uint32_t>(header, Version);
+  Put<uint64_t>(header, count);
+  std::string footer;
+  Put<uint64_t>(footer, offset);
+  Put<uint64_t>(footer, fencesCount);
+  Put<uint32_t>(footer, Crc32(header + fences));
+  Put<uint32_t>(footer, Magic);
+  fout.write(fences.data(), fences.size());
+  fout.write(footer.data(), footer.size());
+  fout.seekp(0);
+  fout.write(header.data(), header.size());
+  fout.close();
+  // Число записей возвращается как int, поэтому таблица, в которой их
+  // больше, не заменяет прежнюю
+  if (!ordered || !fout ||
+      count > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+    std::remove(tmpName.c_str());
+    return ordered && !fout ? canNotOpenFile : unknownError;
+  }
+  // Таблица может заменять открытый файл, поэтому после сбоя под его именем
+  // должен остаться целый файл, старый или новый
+  if (!SyncFile(tmpName) || !SyncDirectory(DirectoryOf(fileName)) ||
+      std::rename(tmpName.c_str(), fileName.c_str()) != 0) {
+    std::remove(tmpName.c_str());
+    return canNotOpenFile;
+  }
+  if (!SyncDirectory(DirectoryOf(fileName))) return canNotOpenFile;
+  return static_cast<int>(count);
+}
+
+//----------------------------------------------------------------
+SortedTable::SortedTable(const std::string& fileName)
+    : file_(fileName, false), recordsBegin_(0), recordsEnd_(0), stop_(false) {
+  loadIndex();
+  statisticsLoader_ = std::thread(&SortedTable::loadStatistics, this);
+}
+
+//----------------------------------------------------------------
+SortedTable::~SortedTable() {
+  stop_ = true;
+  statisticsLoader_.join();
+}
+
+//----------------------------------------------------------------
+Errors SortedTable::set(const std::string&, const Value&,
+                        std::chrono::milliseconds) {
+  return readOnlyStorage;
+}
+
+//----------------------------------------------------------------
+std::optional<Value> SortedTable::get(const std::string& key) {
+  BinaryReader reader = blockOf(key);
+  try {
+    for (size_t i = 0; i < FenceInterval && !reader.AtEnd(); ++i) {
+      std::string_view found = ReadKey(reader);
+      if (found == key) return ReadValue(reader);
+      if (found > key) break;
+      SkipValue(reader);
+    }
+  } catch (const std::exception&) {
+    // Поврежденный блок считается пустым
+  }
+  return std::nullopt;
+}
+
+//----------------------------------------------------------------
+bool SortedTable::exists(const std::string& key) {
+  BinaryReader reader = blockOf(key);
+  try {
+    for (size_t i = 0; i < FenceInterval && !reader.AtEnd(); ++i) {
+      std::string_view found = ReadKey(reader);
+      if (found >= key) return found == key;
+      SkipValue(reader);
+    }
+  } catch (const std::exception&) {
+  }
+  return false;
+}
+
+//----------------------------------------------------------------
+Errors SortedTable::del(const std::string&) { return readOnlyStorage; }
+
+//----------------------------------------------------------------
+Errors SortedTable::update(const Key&, const Value&, std::chrono::milliseconds,
+                           const int) {
+  return readOnlyStorage;
+}
+
+//----------------------------------------------------------------
+Errors SortedTable::rename(const std::string&, const std::string&) {
+  return readOnlyStorage;
+}
+
+//----------------------------------------------------------------
+Errors SortedTable::incrBy(const Key&, const int, const int, int&) {
+  return readOnlyStorage;
+}
+
+//----------------------------------------------------------------
+long long SortedTable::PTtl(const std::string& key) {
+  return exists(key) ? hasNoTtl : keyNotFound;
+}
+
+//----------------------------------------------------------------
+size_t SortedTable::expireBatch(const std::vector<std::string>&) { return 0; }
+
+//----------------------------------------------------------------
+std::vector<std::string> SortedTable::expiringWithin(
+    std::chrono::milliseconds) {
+  return {};
+}
+
+//----------------------------------------------------------------
+std::vector<size_t> SortedTable::expiryHistogram(std::chrono::milliseconds,
+                                                 const size_t bucketsCount) {
+  return std::vector<size_t>(bucketsCount, 0);
+}
+
+//----------------------------------------------------------------
+size_t SortedTable::bulkInsert(std::vector<std::pair<Key, Value>>&) {
+  return 0;
+}
+
+//----------------------------------------------------------------
+const std::vector<std::string> SortedTable::keys() {
+  std::vector<std::string> res;
+  res.reserve(countItems.load());
+  forEach(
+      [&res](std::string_view key, const Value&) { res.emplace_back(key); });
+  return res;
+}
+
+//----------------------------------------------------------------
+const std::vector<std::string> SortedTable::find(const Value& value,
+                                                 const int ttl,
+                                                 const int paramsMask) {
+  std::vector<std::string> res;
+  forEach([&](std::string_view key, const Value& stored) {
+    if (IsMatch(stored, NoDeadline, value, ttl, paramsMask))
+      res.emplace_back(key);
+  });
+  return res;
+}
+
+//----------------------------------------------------------------
+const std::vector<Value> SortedTable::showall() {
+  std::vector<Value> res;
+  res.reserve(countItems.load());
+  forEach([&res](std::string_view, const Value& value) {
+    res.push_back(value);
+  });
+  return res;
+}
+
+//----------------------------------------------------------------
+const std::vector<AggregateRow> SortedTable::aggregate(
+    const AggregateQuery& query) {
+  Aggregator aggregator(query);
+  forEach([&](std::string_view, const Value& value) {
+    if (IsMatch(value, NoDeadline, query.filter, query.ttl, query.paramsMask))
+      aggregator.Add(value);
+  });
+  return aggregator.Result();
+}
+
+//----------------------------------------------------------------
+std::vector<std::pair<Key, Value>> SortedTable::range(const Key& from,
+                                                      const Key& to) {
+  std::vector<std::pair<Key, Value>> res;
+  if (to < from) return res;
+  BinaryReader reader = blockOf(from);
+  try {
+    while (!reader.AtEnd()) {
+      std::string_view key = ReadKey(reader);
+      if (key > to) break;
+      if (key < from) {
+        SkipValue(reader);
+        continue;
+      }
+      res.emplace_back(Key(key), ReadValue(reader));
+    }
+  } catch (const std::exception&) {
+  }
+  return res;
+}
+
+//----------------------------------------------------------------
+void SortedTable::forEachEntry(const std::function<void()>& underLock,
+                               const EntryWriter& write) {
+  // Файл не изменяется, поэтому любой момент обхода согласован
+  underLock();
+  forEach([&write](std::string_view key, const Value& value) {
+    write(Key(key), value, NoDeadline);
+  });
+}
+
+//----------------------------------------------------------------
+std::vector<Entry> SortedTable::copyEntries(
+    const std::function<void()>& underLock) {
+  std::vector<Entry> entries;
+  entries.reserve(countItems.load());
+  forEachEntry(underLock, [&entries](const Key& key, const Value& value,
+                                     const Deadline timeToDel) {
+    entries.push_back({key, value, timeToDel});
+  });
+  return entries;
+}
+
+//----------------------------------------------------------------
+void SortedTable::loadIndex() {
+  std::string_view data = file_.View();
+  if (data.size() < HeaderSize + FooterSize)
+    throw std::runtime_error("Corrupted table: file too short");
+  BinaryReader header(data.substr(0, HeaderSize));
+  BinaryReader footer(data.substr(data.size() - FooterSize));
+  const uint32_t magic = header.Get<uint32_t>();
+  const uint32_t version = header.Get<uint32_t>();
+  const uint64_t recordsCount = header.Get<uint64_t>();
+  const uint64_t fencesOffset = footer.Get<uint64_t>();
+  const uint64_t fencesCount = footer.Get<uint64_t>();
+  const uint32_t crc = footer.Get<uint32_t>();
+  if (magic != Magic || footer.Get<uint32_t>() != Magic ||
+      version != Version)
+    throw std::runtime_error("Corrupted table: bad magic or version");
+  if (fencesOffset < HeaderSize || fencesOffset > data.size() - FooterSize)
+    throw std::runtime_error("Corrupted table: bad index offset");
+  std::string_view fences =
+      data.substr(fencesOffset, data.size() - FooterSize - fencesOffset);
+  if (Crc32(std::string(data.substr(0, HeaderSize)) + std::string(fences)) !=
+      crc)
+    throw std::runtime_error("Corrupted table: index checksum mismatch");
+
+  if (fencesCount != (recordsCount + FenceInterval - 1) / FenceInterval)
+    throw std::runtime_error("Corrupted table: index size mismatch");
+  BinaryReader reader(fences);
+  fences_.reserve(fencesCount);
+  for (uint64_t i = 0; i < fencesCount; ++i) {
+    Fence fence;
+    fence.key = reader.Take(reader.Get<uint32_t>());
+    fence.offset = reader.Get<uint64_t>();
+    if (fence.offset < HeaderSize || fence.offset >= fencesOffset ||
+        (!fences_.empty() && fence.offset <= fences_.back().offset))
+      throw std::runtime_error("Corrupted table: bad index entry");
+    fences_.push_back(fence);
+  }
+  if (!reader.AtEnd())
+    throw std::runtime_error("Corrupted table: index size mismatch");
+  recordsBegin_ = HeaderSize;
+  recordsEnd_ = fencesOffset;
+  countItems = static_cast<int>(recordsCount);
+}
+
+//----------------------------------------------------------------
+BinaryReader SortedTable::blockOf(std::string_view key) const {
+  auto fence = std::upper_bound(
+      fences_.begin(), fences_.end(), key,
+      [](std::string_view k, const Fence& f) { return k < f.key; });
+  const uint64_t begin =
+      fence == fences_.begin() ? recordsBegin_ : std::prev(fence)->offset;
+  return BinaryReader(file_.View().substr(begin, recordsEnd_ - begin));
+}
+
+//----------------------------------------------------------------
+std::string_view SortedTable::ReadKey(BinaryReader& reader) {
+  return reader.Take(reader.Get<uint32_t>());
+}
+
+//----------------------------------------------------------------
+Value SortedTable::ReadValue(BinaryReader& reader) {
+  Value value;
+  value.lastname = reader.GetString();
+  value.name = reader.GetString();
+  value.city = reader.GetString();
+  value.year = reader.Get<int32_t>();
+  value.coins = reader.Get<int32_t>();
+  return value;
+}
+
+//----------------------------------------------------------------
+void SortedTable::SkipValue(BinaryReader& reader) {
+  for (int i = 0; i < 3; ++i) reader.Take(reader.Get<uint32_t>());
+  reader.Take(2 * sizeof(int32_t));
+}
+
+//----------------------------------------------------------------
+void SortedTable::forEach(
+    const std::function<void(std::string_view, const Value&)>& func) const {
+  BinaryReader reader(file_.View().substr(recordsBegin_,
+                                          recordsEnd_ - recordsBegin_));
+  try {
+    while (!reader.AtEnd()) {
+      std::string_view key = ReadKey(reader);
+      func(key, ReadValue(reader));
+    }
+  } catch (const std::exception&) {
+    // Обход останавливается на поврежденной записи
+  }
+}
+
+//----------------------------------------------------------------
+void SortedTable::loadStatistics() {
+  BinaryReader reader(file_.View().substr(recordsBegin_,
+                                          recordsEnd_ - recordsBegin_));
+  try {
+    while (!reader.AtEnd() && !stop_) {
+      ReadKey(reader);
+      statistics_.Insert(ReadValue(reader));
+    }
+  } catch (const std::exception&) {
+  }
+}
+
+}  //  namespace s21
@@ -0,0 +1,121 @@
+// Хранилище только для чтения поверх отсортированного файла. Файл
+// отображается в память и читается прямо из кеша страниц, при открытии
+// читается только разреженный индекс в конце файла, поэтому открытие не
+// зависит от числа записей. Формат файла:
+//   заголовок: "S21T" (u32), версия (u32), число записей (u64)
+//   записи:    по возрастанию ключа без повторов - ключ, фамилия, имя, город,
+//              год (i32), число коинов (i32)
+//   индекс:    ключ и смещение от начала файла (u64) каждой FenceInterval-й
+//              записи
+//   конец:     смещение индекса (u64), число ключей индекса (u64), CRC32
+//              заголовка и индекса (u32), "S21T" (u32)
+// Строки записываются длиной (u32) и байтами. Время жизни не хранится.
+// Записи не проверяются при открытии: чтение поврежденного блока ведет себя
+// как отсутствие записей в нем
+#ifndef SRC_MODEL_SORTED_TABLE_SORTED_TABLE_H_
+#define SRC_MODEL_SORTED_TABLE_SORTED_TABLE_H_
+
+#include <atomic>
+#include <string_view>
+#include <thread>
+
+#include "../abstract_key_value_store/abstract_key_value_store.h"
+#include "../binary_io.h"
+#include "../mapped_file.h"
+
+namespace s21 {
+class SortedTable : public AbstractKeyValueStore {
+ public:
+  static constexpr uint32_t Magic = 0x54313253;  // "S21T"
+  static constexpr uint32_t Version = 1;
+  static constexpr size_t FenceInterval = 16;
+
+  // Записывает values в файл таблицы, из записей с одинаковым ключом
+  // остается первая. Файл сбрасывается на диск до замены прежнего.
+  // Возвращает число записей, canNotOpenFile или unknownError, если записей
+  // больше INT_MAX
+  static int Build(const std::string& fileName,
+                   std::vector<std::pair<Key, Value>> values);
+  // То же для записей, которые source выдает по возрастанию ключа без
+  // повторов. Записи пишутся в файл по мере обхода, в памяти остается только
+  // индекс. unknownError, если порядок нарушен
+  static int Build(const std::string& fileName, const EntrySource& source);
+
+  // Бросает std::runtime_error с "not open", если файл не удалось открыть,
+  // и с "Corrupted", если это не файл таблицы или индекс поврежден
+  explicit SortedTable(const std::string& fileName);
+  ~SortedTable() override;
+
+  using AbstractKeyValueStore::set;
+  using AbstractKeyValueStore::update;
+
+  // Изменения возвращают readOnlyStorage
+  Errors set(const std::string& key, const Value& value,
+             std::chrono::milliseconds ttl) override;
+  std::optional<Value> get(const std::string& key) override;
+  bool exists(const std::string& key) override;
+  Errors del(const std::string& key) override;
+  Errors update(const Key& key, const Value& value,
+                std::chrono::milliseconds ttl, const int paramsMask) override;
+  Errors rename(const std::string& oldKey, const std::string& newKey) override;
+  Errors incrBy(const Key& key, const int field, const int delta,
+                int& result) override;
+  long long PTtl(const std::string& key) override;
+  size_t expireBatch(const std::vector<std::string>& keys) override;
+  std::vector<std::string> expiringWithin(
+      std::chrono::milliseconds window) override;
+  std::vector<size_t> expiryHistogram(std::chrono::milliseconds bucket,
+                                      const size_t bucketsCount) override;
+  size_t bulkInsert(std::vector<std::pair<Key, Value>>& values) override;
+  void forEachEntry(const std::function<void()>& underLock,
+                    const EntryWriter& write) override;
+  void forEachEntryByKey(const EntryWriter& write) override {
+    forEachEntry([]() {}, write);
+  }
+
+  const std::vector<std::string> keys() override;
+  const std::vector<std::string> find(const Value& value, const int ttl,
+                                      const int paramsMask) override;
+  const std::vector<Value> showall() override;
+  const std::vector<AggregateRow> aggregate(
+      const AggregateQuery& query) override;
+
+  // Записи с ключами от from до to включительно по возрастанию ключа
+  std::vector<std::pair<Key, Value>> range(const Key& from, const Key& to);
+
+ protected:
+  std::vector<Entry> copyEntries(
+      const std::function<void()>& underLock) override;
+
+ private:
+  struct Fence {
+    std::string_view key;
+    uint64_t offset;
+  };
+
+  MappedFile file_;
+  // Ключи индекса указывают в отображенный файл
+  std::vector<Fence> fences_;
+  // Записи лежат в file_ между recordsBegin_ и recordsEnd_
+  uint64_t recordsBegin_;
+  uint64_t recordsEnd_;
+  std::atomic<bool> stop_;
+  std::thread statisticsLoader_;
+
+  void loadIndex();
+  // Читатель записей с начала блока, в котором может лежать key
+  BinaryReader blockOf(std::string_view key) const;
+  // Ключ следующей записи без копирования
+  static std::string_view ReadKey(BinaryReader& reader);
+  static Value ReadValue(BinaryReader& reader);
+  static void SkipValue(BinaryReader& reader);
+  // Вызывает func для каждой записи по порядку до первой поврежденной
+  void forEach(
+      const std::function<void(std::string_view, const Value&)>& func) const;
+  // Статистика полей заполняется в фоне, чтобы не читать файл при открытии
+  void loadStatistics();
+};
+
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_SORTED_TABLE_SORTED_TABLE_H_
@@ -0,0 +1,48 @@
+#include "worker_group.h"
+
+namespace s21 {
+
+WorkerGroup::WorkerGroup(const size_t count)
+    : task_(nullptr), round_(0), running_(0), stop_(false) {
+  for (size_t i = 1; i < count; ++i)
+    threads_.emplace_back(&WorkerGroup::Loop, this, i);
+}
+//----------------------------------------------------------------
+WorkerGroup::~WorkerGroup() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  started_.notify_all();
+  for (auto& thread : threads_) thread.join();
+}
+//----------------------------------------------------------------
+void WorkerGroup::Run(const std::function<void(size_t)>& task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    running_ = threads_.size();
+    ++round_;
+  }
+  started_.notify_all();
+  task(0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_.wait(lock, [this]() { return running_ == 0; });
+  task_ = nullptr;
+}
+//----------------------------------------------------------------
+void WorkerGroup::Loop(const size_t i) {
+  uint64_t done = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    started_.wait(lock, [this, done]() { return stop_ || round_ != done; });
+    if (stop_) return;
+    done = round_;
+    const std::function<void(size_t)>& task = *task_;
+    lock.unlock();
+    task(i);
+    lock.lock();
+    if (--running_ == 0) finished_.notify_one();
+  }
+}
+}  //  namespace s21
@@ -0,0 +1,43 @@
+// Потоки, которые выполняют задачу по очереди несколько раз подряд. В
+// отличие от RunInParallel потоки создаются один раз, поэтому пакетная
+// обработка не платит за создание и ожидание потоков на каждом пакете
+#ifndef SRC_MODEL_WORKER_GROUP_H_
+#define SRC_MODEL_WORKER_GROUP_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace s21 {
+
+class WorkerGroup {
+ public:
+  // count - число исполнителей вместе с вызывающим потоком
+  explicit WorkerGroup(const size_t count);
+  ~WorkerGroup();
+  WorkerGroup(const WorkerGroup&) = delete;
+  WorkerGroup& operator=(const WorkerGroup&) = delete;
+
+  // Вызывает task для номеров от 0 до count - 1, task(0) выполняется в
+  // вызывающем потоке. Возвращает управление после всех
+  void Run(const std::function<void(size_t)>& task);
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable started_;
+  std::condition_variable finished_;
+  const std::function<void(size_t)>* task_;
+  // Номер текущего запуска, по его смене потоки берут задачу
+  uint64_t round_;
+  size_t running_;
+  bool stop_;
+  std::vector<std::thread> threads_;
+
+  void Loop(const size_t i);
+};
+}  //  namespace s21
+
+#endif  //  SRC_MODEL_WORKER_GROUP_H_
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "../model/hash_table/hash_table.h"
+#include "../model/self_balancing_binary_search_tree/self_balancing_binary_search_tree.h"
+#include "../types.h"
+
+// Замена глобальных operator new и delete для подсчета выделений памяти.
+// Счетчик общий для всех тестов и потоков, поэтому проверяется разница
+// между двумя точками одного теста
+namespace {
+std::atomic<size_t> allocationsCount{0};
+
+size_t AllocationsCount() {
+  return allocationsCount.load(std::memory_order_relaxed);
+}
+
+// Строки длиннее буфера малой строки, чтобы каждая копия выделяла память
+std::string LongKey(int i) {
+  return "allocation_test_key_" + std::to_string(100 + i);
+}
+
+s21::Value LongValue(int i) {
+  return {"Konstantinopolsky", "Maximilian-Alexander", 1990,
+          "Petropavlovsk-Kamchatsky", i};
+}
+
+template <typename Store>
+void CheckMovedSetSavesCopies() {
+  Store store;
+  store.set(LongKey(0), LongValue(0));
+  const s21::Key key = LongKey(1);
+  const s21::Value value = LongValue(1);
+  size_t before = AllocationsCount();
+  ASSERT_EQ(store.set(key, value), s21::noErrors);
+  const size_t copied = AllocationsCount() - before;
+
+  s21::Key movedKey = LongKey(2);
+  s21::Value movedValue = LongValue(2);
+  before = AllocationsCount();
+  ASSERT_EQ(store.set(std::move(movedKey), std::move(movedValue)),
+            s21::noErrors);
+  const size_t moved = AllocationsCount() - before;
+  // Ключ и три строки значения не копируются
+  EXPECT_EQ(copied - moved, 4u);
+  EXPECT_EQ(store.get(LongKey(2))->coins, 2);
+}
+}  // namespace
+
+void* operator new(size_t size) {
+  allocationsCount.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+
+TEST(allocations, hashtable_moved_set_test) {
+  CheckMovedSetSavesCopies<s21::HashTable>();
+}
+
+TEST(allocations, rbtree_moved_set_test) {
+  CheckMovedSetSavesCopies<s21::SelfBalancingBinarySearchTree>();
+}
+
+TEST(allocations, moved_set_existing_key_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  tree.set(LongKey(0), LongValue(0));
+  EXPECT_EQ(tree.set(LongKey(0), LongValue(1)), s21::keyAlreadyExists);
+  EXPECT_EQ(tree.get(LongKey(0))->coins, 0);
+  s21::HashTable table;
+  table.set(LongKey(0), LongValue(0));
+  s21::Key key = LongKey(0);
+  s21::Value value = LongValue(1);
+  EXPECT_EQ(table.set(std::move(key), std::move(value)),
+            s21::keyAlreadyExists);
+  EXPECT_EQ(table.get(LongKey(0))->coins, 0);
+}
+
+TEST(allocations, hashtable_rename_test) {
+  s21::HashTable table;
+  for (int i = 0; i < 10; ++i) table.set(LongKey(i), LongValue(i));
+  const s21::Key newKey = LongKey(50);
+  const size_t before = AllocationsCount();
+  ASSERT_EQ(table.rename(LongKey(3), newKey), s21::noErrors);
+  // Выделяется только строка нового ключа в записи
+  EXPECT_LE(AllocationsCount() - before, 1u);
+  EXPECT_EQ(table.get(newKey)->coins, 3);
+  EXPECT_FALSE(table.exists(LongKey(3)));
+}
+
+TEST(allocations, rbtree_rename_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  for (int i = 0; i < 31; ++i) tree.set(LongKey(i), LongValue(i));
+  const s21::Key newKey = LongKey(50);
+  const size_t before = AllocationsCount();
+  ASSERT_EQ(tree.rename(LongKey(15), newKey), s21::noErrors);
+  EXPECT_LE(AllocationsCount() - before, 1u);
+  EXPECT_EQ(tree.get(newKey)->coins, 15);
+  EXPECT_FALSE(tree.exists(LongKey(15)));
+  EXPECT_EQ(tree.keys().size(), 31u);
+}
+
+TEST(allocations, rbtree_del_inner_node_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  for (int i = 0; i < 31; ++i) tree.set(LongKey(i), LongValue(i));
+  // В дереве из 31 ключа у узлов ближе к корню по два потомка
+  for (int i : {15, 7, 23, 3}) {
+    const s21::Key key = LongKey(i);
+    const size_t before = AllocationsCount();
+    ASSERT_EQ(tree.del(key), s21::noErrors);
+    EXPECT_EQ(AllocationsCount() - before, 0u);
+  }
+  EXPECT_EQ(tree.keys().size(), 27u);
+  EXPECT_EQ(tree.get(LongKey(14))->coins, 14);
+}
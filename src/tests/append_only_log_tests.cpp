@@ -0,0 +1,503 @@
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <csignal>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../model/append_only_log.h"
+#include "../model/binary_io.h"
+#include "../model/hash_table/hash_table.h"
+#include "../model/self_balancing_binary_search_tree/self_balancing_binary_search_tree.h"
+#include "../types.h"
+
+namespace {
+const std::string LogFile = "examples/test.aof";
+// Размер и CRC32 перед данными каждой записи журнала
+constexpr size_t RecordHeaderSize = 8;
+
+std::string ReadFile(const std::string& fileName) {
+  std::ifstream fin(fileName, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(fin),
+                     std::istreambuf_iterator<char>());
+}
+}  // namespace
+
+TEST(append_only_log, replay_test) {
+  unlink(LogFile.c_str());
+  {
+    s21::HashTable hashtable;
+    ASSERT_EQ(hashtable.EnableLog(LogFile, s21::fsyncAlways), 0);
+    hashtable.set("a", {"Ivanov", "Ivan", 2000, "Moscow", 10});
+    hashtable.set("b", {"Petrov", "Petr", 1990, "Kazan", 20}, 100);
+    hashtable.set("c", {"Sidorov", "Sidr", 1980, "Omsk", 30});
+    hashtable.update("a", {"-", "-", 0, "-", 55}, 0, s21::pCoins);
+    hashtable.rename("c", "d");
+    hashtable.del("b");
+  }
+  s21::SelfBalancingBinarySearchTree rbtree;
+  ASSERT_EQ(rbtree.EnableLog(LogFile, s21::fsyncAlways), 6);
+  ASSERT_EQ(rbtree.GetSize(), 2);
+  ASSERT_EQ(rbtree.get("a").value().coins, 55);
+  ASSERT_EQ(rbtree.get("a").value().city, "Moscow");
+  ASSERT_EQ(rbtree.get("d").value().lastname, "Sidorov");
+  ASSERT_FALSE(rbtree.exists("b"));
+  ASSERT_FALSE(rbtree.exists("c"));
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, replay_ttl_test) {
+  unlink(LogFile.c_str());
+  {
+    s21::SelfBalancingBinarySearchTree rbtree;
+    rbtree.EnableLog(LogFile, s21::fsyncInterval,
+                     std::chrono::milliseconds(10));
+    rbtree.set("short", {"a", "b", 1, "c", 2}, std::chrono::milliseconds(50));
+    rbtree.set("long", {"a", "b", 1, "c", 2}, 100);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.EnableLog(LogFile), 2);
+  ASSERT_FALSE(hashtable.exists("short"));
+  ASSERT_GT(hashtable.PTtl("long"), 99000);
+  ASSERT_LE(hashtable.PTtl("long"), 100000);
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, torn_tail_test) {
+  unlink(LogFile.c_str());
+  {
+    s21::HashTable hashtable;
+    hashtable.EnableLog(LogFile, s21::fsyncAlways);
+    hashtable.set("a", {"a", "b", 1, "c", 2});
+    hashtable.set("b", {"a", "b", 1, "c", 2});
+  }
+  const std::string data = ReadFile(LogFile);
+  ASSERT_EQ(truncate(LogFile.c_str(), data.size() - 3), 0);
+  {
+    s21::HashTable hashtable;
+    ASSERT_EQ(hashtable.EnableLog(LogFile, s21::fsyncAlways), 1);
+    ASSERT_TRUE(hashtable.exists("a"));
+    ASSERT_FALSE(hashtable.exists("b"));
+    // Новые записи дописываются после отрезанного хвоста
+    hashtable.set("c", {"a", "b", 1, "c", 2});
+  }
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.EnableLog(LogFile), 2);
+  ASSERT_TRUE(hashtable.exists("c"));
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, undecodable_record_test) {
+  unlink(LogFile.c_str());
+  {
+    s21::HashTable hashtable;
+    hashtable.EnableLog(LogFile, s21::fsyncAlways);
+    hashtable.set("a", {"a", "b", 1, "c", 2});
+  }
+  // Запись с верной CRC и неизвестной операцией между целыми записями
+  std::string data = ReadFile(LogFile);
+  const std::string valid = data;
+  const std::string payload(1, static_cast<char>(0xFF));
+  std::string size;
+  s21::Put<uint32_t>(size, static_cast<uint32_t>(payload.size()));
+  data.append(size);
+  s21::Put<uint32_t>(data, s21::Crc32(payload, s21::Crc32(size)));
+  data.append(payload);
+  data.append(valid);
+  {
+    std::ofstream fout(LogFile, std::ios::binary | std::ios::trunc);
+    fout << data;
+  }
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.EnableLog(LogFile), s21::corruptedFile);
+  // Записи разбираются до применения, поэтому первая не применяется
+  ASSERT_EQ(hashtable.GetSize(), 0);
+  ASSERT_EQ(ReadFile(LogFile), data);
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, corrupted_record_test) {
+  unlink(LogFile.c_str());
+  {
+    s21::HashTable hashtable;
+    hashtable.EnableLog(LogFile, s21::fsyncAlways);
+    hashtable.set("a", {"a", "b", 1, "c", 2});
+    hashtable.set("b", {"a", "b", 1, "c", 2});
+  }
+  // Неверная CRC у первой записи, за которой идет подтвержденная вторая
+  std::string data = ReadFile(LogFile);
+  data[RecordHeaderSize] = static_cast<char>(data[RecordHeaderSize] ^ 0xFF);
+  {
+    std::ofstream fout(LogFile, std::ios::binary | std::ios::trunc);
+    fout << data;
+  }
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.EnableLog(LogFile), s21::corruptedFile);
+  ASSERT_EQ(ReadFile(LogFile), data);
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, corrupted_size_test) {
+  unlink(LogFile.c_str());
+  {
+    s21::HashTable hashtable;
+    hashtable.EnableLog(LogFile, s21::fsyncAlways);
+    hashtable.set("a", {"a", "b", 1, "c", 2});
+    hashtable.set("b", {"a", "b", 1, "c", 2});
+  }
+  // Размер первой записи выходит за конец файла, но за ней идет целая
+  // запись, поэтому это не недописанный хвост
+  std::string data = ReadFile(LogFile);
+  data[3] = static_cast<char>(0x7F);
+  {
+    std::ofstream fout(LogFile, std::ios::binary | std::ios::trunc);
+    fout << data;
+  }
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.EnableLog(LogFile), s21::corruptedFile);
+  ASSERT_EQ(hashtable.GetSize(), 0);
+  ASSERT_EQ(ReadFile(LogFile), data);
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, zeroed_record_test) {
+  unlink(LogFile.c_str());
+  {
+    s21::HashTable hashtable;
+    hashtable.EnableLog(LogFile, s21::fsyncAlways);
+    hashtable.set("a", {"a", "b", 1, "c", 2});
+  }
+  // Обнуленный заголовок не считается целой пустой записью
+  std::string data = ReadFile(LogFile);
+  const std::string valid = data;
+  data.insert(0, RecordHeaderSize, '\0');
+  data.append(valid);
+  {
+    std::ofstream fout(LogFile, std::ios::binary | std::ios::trunc);
+    fout << data;
+  }
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.EnableLog(LogFile), s21::corruptedFile);
+  ASSERT_EQ(ReadFile(LogFile), data);
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, corrupted_last_record_test) {
+  unlink(LogFile.c_str());
+  {
+    s21::HashTable hashtable;
+    hashtable.EnableLog(LogFile, s21::fsyncAlways);
+    hashtable.set("a", {"a", "b", 1, "c", 2});
+    hashtable.set("b", {"a", "b", 1, "c", 2});
+  }
+  // Последняя запись целой длины с неверной CRC отрезается
+  std::string data = ReadFile(LogFile);
+  data.back() = static_cast<char>(data.back() ^ 0xFF);
+  {
+    std::ofstream fout(LogFile, std::ios::binary | std::ios::trunc);
+    fout << data;
+  }
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.EnableLog(LogFile), 1);
+  ASSERT_TRUE(hashtable.exists("a"));
+  ASSERT_FALSE(hashtable.exists("b"));
+  ASSERT_LT(ReadFile(LogFile).size(), data.size());
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, rewrite_test) {
+  unlink(LogFile.c_str());
+  {
+    s21::HashTable hashtable;
+    hashtable.EnableLog(LogFile, s21::fsyncGroupCommit);
+    for (int i = 0; i < 100; ++i)
+      hashtable.set("key" + std::to_string(i), {"a", "b", i, "c", i});
+    for (int i = 0; i < 100; ++i)
+      hashtable.update("key" + std::to_string(i), {"a", "b", 0, "c", -i}, 0,
+                       s21::pCoins);
+    for (int i = 50; i < 100; ++i) hashtable.del("key" + std::to_string(i));
+    const size_t sizeBefore = ReadFile(LogFile).size();
+    ASSERT_EQ(hashtable.RewriteLog(), 50);
+    ASSERT_LT(ReadFile(LogFile).size(), sizeBefore / 4);
+    hashtable.set("after", {"a", "b", 1, "c", 2});
+  }
+  s21::SelfBalancingBinarySearchTree rbtree;
+  ASSERT_EQ(rbtree.EnableLog(LogFile), 51);
+  ASSERT_EQ(rbtree.GetSize(), 51);
+  ASSERT_EQ(rbtree.get("key7").value().coins, -7);
+  ASSERT_TRUE(rbtree.exists("after"));
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, rewrite_concurrent_test) {
+  unlink(LogFile.c_str());
+  {
+    s21::SelfBalancingBinarySearchTree rbtree;
+    rbtree.EnableLog(LogFile, s21::fsyncGroupCommit);
+    for (int i = 0; i < 1000; ++i)
+      rbtree.set("old" + std::to_string(i), {"a", "b", i, "c", i});
+    std::thread writer([&rbtree]() {
+      for (int i = 0; i < 1000; ++i) {
+        rbtree.set("new" + std::to_string(i), {"a", "b", i, "c", i});
+        rbtree.del("old" + std::to_string(i));
+      }
+    });
+    for (int i = 0; i < 5; ++i) ASSERT_GT(rbtree.RewriteLog(), 0);
+    writer.join();
+  }
+  s21::HashTable hashtable;
+  hashtable.EnableLog(LogFile);
+  ASSERT_EQ(hashtable.GetSize(), 1000);
+  ASSERT_TRUE(hashtable.exists("new999"));
+  ASSERT_FALSE(hashtable.exists("old0"));
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, group_commit_test) {
+  unlink(LogFile.c_str());
+  {
+    s21::HashTable hashtable;
+    hashtable.EnableLog(LogFile, s21::fsyncGroupCommit);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t)
+      writers.emplace_back([&hashtable, t]() {
+        for (int i = 0; i < 250; ++i)
+          hashtable.set(std::to_string(t) + "_" + std::to_string(i),
+                        {"a", "b", i, "c", t});
+      });
+    for (auto& writer : writers) writer.join();
+  }
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.EnableLog(LogFile), 1000);
+  ASSERT_EQ(hashtable.get("3_249").value().coins, 3);
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, commit_after_reopen_test) {
+  for (const auto policy : {s21::fsyncAlways, s21::fsyncGroupCommit}) {
+    unlink(LogFile.c_str());
+    // Номер получен до повторного открытия, а Commit вызван после него
+    s21::AppendOnlyLog log;
+    ASSERT_EQ(log.Open(LogFile, policy, std::chrono::seconds(1)),
+              s21::noErrors);
+    const uint64_t lsn = log.Append({s21::logDel, "a", "", {}, 0});
+    log.Close();
+    ASSERT_EQ(log.Open(LogFile, policy, std::chrono::seconds(1)),
+              s21::noErrors);
+    ASSERT_TRUE(log.Commit(lsn));
+    ASSERT_GT(log.Append({s21::logDel, "b", "", {}, 0}), lsn);
+    ASSERT_TRUE(log.Commit(log.LastLsn()));
+    log.Close();
+
+    // Журнал включают и выключают, пока другие потоки пишут
+    s21::HashTable hashtable;
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t)
+      writers.emplace_back([&hashtable, &stop, t]() {
+        for (int i = 0; !stop; ++i) {
+          const std::string key = std::to_string(t) + "_" + std::to_string(i);
+          hashtable.set(key, {"a", "b", i, "c", t});
+          hashtable.del(key);
+        }
+      });
+    for (int i = 0; i < 20; ++i) {
+      unlink(LogFile.c_str());
+      ASSERT_GE(hashtable.EnableLog(LogFile, policy), 0);
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      hashtable.DisableLog();
+    }
+    stop = true;
+    for (auto& writer : writers) writer.join();
+  }
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, close_waits_for_writer_test) {
+  constexpr int Generations = 30;
+  for (const auto policy : {s21::fsyncAlways, s21::fsyncGroupCommit}) {
+    // Каждый поток запоминает номера своих записей. Запись с номером не
+    // больше последнего номера до открытия файла принадлежит прежнему файлу
+    s21::AppendOnlyLog log;
+    std::atomic<bool> stop{false};
+    std::vector<std::vector<uint64_t>> lsns(4);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t)
+      writers.emplace_back([&log, &stop, &lsns, t]() {
+        while (!stop) {
+          const std::string key =
+              std::to_string(t) + "_" + std::to_string(lsns[t].size());
+          lsns[t].push_back(log.Append({s21::logDel, key, "", {}, 0}));
+          log.Commit(lsns[t].back());
+        }
+      });
+    std::vector<uint64_t> lastBeforeOpen;
+    for (int i = 0; i < Generations; ++i) {
+      const std::string fileName = LogFile + std::to_string(i);
+      unlink(fileName.c_str());
+      lastBeforeOpen.push_back(log.LastLsn());
+      ASSERT_EQ(log.Open(fileName, policy, std::chrono::seconds(1)),
+                s21::noErrors);
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      log.Close();
+    }
+    stop = true;
+    for (auto& writer : writers) writer.join();
+    for (int i = 0; i < Generations; ++i) {
+      const std::string fileName = LogFile + std::to_string(i);
+      ASSERT_GE(s21::AppendOnlyLog::Replay(
+                    fileName,
+                    [&](const s21::LogRecord& record) {
+                      const size_t split = record.key.find('_');
+                      const uint64_t lsn =
+                          lsns[std::stoi(record.key.substr(0, split))]
+                              [std::stoul(record.key.substr(split + 1))];
+                      EXPECT_GT(lsn, lastBeforeOpen[i])
+                          << "record of a closed log in " << fileName;
+                    }),
+                0);
+      unlink(fileName.c_str());
+    }
+  }
+}
+
+TEST(append_only_log, write_failure_test) {
+  // Запись в /dev/full всегда завершается ENOSPC
+  s21::AppendOnlyLog log;
+  ASSERT_EQ(log.Open("/dev/full", s21::fsyncGroupCommit,
+                     std::chrono::seconds(1)),
+            s21::noErrors);
+  ASSERT_FALSE(log.Failed());
+  const uint64_t lsn =
+      log.Append({s21::logSet, "a", "", {"Ivanov", "Ivan", 2000, "", 0}, 0});
+  ASSERT_GT(lsn, 0);
+  ASSERT_FALSE(log.Commit(lsn));
+  ASSERT_TRUE(log.Failed());
+  ASSERT_FALSE(log.Commit(log.Append({s21::logDel, "a", "", {}, 0})));
+}
+
+TEST(append_only_log, store_write_failure_test) {
+  for (const auto policy : {s21::fsyncAlways, s21::fsyncGroupCommit}) {
+    unlink(LogFile.c_str());
+    s21::HashTable hashtable;
+    ASSERT_EQ(hashtable.EnableLog(LogFile, policy), 0);
+    // Нулевой предельный размер файла не дает дописать журнал
+    rlimit oldLimit;
+    getrlimit(RLIMIT_FSIZE, &oldLimit);
+    auto oldHandler = std::signal(SIGXFSZ, SIG_IGN);
+    rlimit limit = oldLimit;
+    limit.rlim_cur = 0;
+    setrlimit(RLIMIT_FSIZE, &limit);
+    const s21::Errors res = hashtable.set("a", {"a", "b", 1, "c", 2});
+    setrlimit(RLIMIT_FSIZE, &oldLimit);
+    std::signal(SIGXFSZ, oldHandler);
+
+    ASSERT_EQ(res, s21::logWriteFailed);
+    // Изменение применено в памяти, но не сохранено
+    ASSERT_TRUE(hashtable.exists("a"));
+    ASSERT_TRUE(hashtable.LogFailed());
+    ASSERT_EQ(hashtable.del("a"), s21::logWriteFailed);
+    ASSERT_EQ(hashtable.mset({{"b", {"a", "b", 1, "c", 2}},
+                              {"b", {"a", "b", 1, "c", 2}}}),
+              (std::vector<s21::Errors>{s21::logWriteFailed,
+                                        s21::keyAlreadyExists}));
+    hashtable.DisableLog();
+    ASSERT_EQ(hashtable.del("b"), s21::noErrors);
+  }
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, reopen_after_failure_test) {
+  // Запись в канал не синхронизируется fdatasync и завершается ошибкой. Пока
+  // запись большого значения ждет читателя, в журнал добавляется еще одна
+  const std::string fifoName = "examples/test.fifo";
+  unlink(fifoName.c_str());
+  unlink(LogFile.c_str());
+  ASSERT_EQ(mkfifo(fifoName.c_str(), 0644), 0);
+  const int reader = open(fifoName.c_str(), O_RDONLY | O_NONBLOCK);
+  ASSERT_GE(reader, 0);
+  fcntl(reader, F_SETFL, 0);
+
+  s21::AppendOnlyLog log;
+  ASSERT_EQ(log.Open(fifoName, s21::fsyncGroupCommit, std::chrono::seconds(1)),
+            s21::noErrors);
+  const std::string big(1 << 20, 'x');
+  const uint64_t lsn =
+      log.Append({s21::logSet, "big", "", {big, "", 0, "", 0}, 0});
+  std::thread committer([&log, lsn]() { log.Commit(lsn); });
+  char chunk[4096];
+  ASSERT_GT(read(reader, chunk, sizeof(chunk)), 0);
+  log.Append({s21::logSet, "stale", "", {"a", "b", 1, "c", 2}, 0});
+  std::thread drainer([reader, &chunk]() {
+    while (read(reader, chunk, sizeof(chunk)) > 0) {
+    }
+  });
+  committer.join();
+  ASSERT_TRUE(log.Failed());
+
+  // Так же журнал выключают и включают заново DisableLog и EnableLog
+  log.Close();
+  drainer.join();
+  close(reader);
+  ASSERT_EQ(log.Open(LogFile, s21::fsyncAlways, std::chrono::seconds(1)),
+            s21::noErrors);
+  log.Append({s21::logSet, "new", "", {"a", "b", 1, "c", 2}, 0});
+  log.Close();
+
+  std::vector<s21::Key> keys;
+  ASSERT_EQ(s21::AppendOnlyLog::Replay(
+                LogFile,
+                [&keys](const s21::LogRecord& record) {
+                  keys.push_back(record.key);
+                }),
+            1);
+  ASSERT_EQ(keys, std::vector<s21::Key>{"new"});
+  unlink(fifoName.c_str());
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, rewrite_failure_test) {
+  unlink(LogFile.c_str());
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.EnableLog(LogFile, s21::fsyncAlways), 0);
+  for (int i = 0; i < 1000; ++i)
+    hashtable.set("key" + std::to_string(i), {"a", "b", i, "c", i});
+  const std::string original = ReadFile(LogFile);
+
+  // Ограничение размера файла обрывает запись нового журнала на середине
+  rlimit oldLimit;
+  getrlimit(RLIMIT_FSIZE, &oldLimit);
+  auto oldHandler = std::signal(SIGXFSZ, SIG_IGN);
+  rlimit limit = oldLimit;
+  limit.rlim_cur = original.size() / 2;
+  setrlimit(RLIMIT_FSIZE, &limit);
+  const int rewritten = hashtable.RewriteLog();
+  setrlimit(RLIMIT_FSIZE, &oldLimit);
+  std::signal(SIGXFSZ, oldHandler);
+
+  ASSERT_EQ(rewritten, s21::logWriteFailed);
+  ASSERT_EQ(ReadFile(LogFile), original);
+  ASSERT_NE(access((LogFile + ".rewrite").c_str(), F_OK), 0);
+  ASSERT_FALSE(hashtable.LogFailed());
+  ASSERT_EQ(hashtable.RewriteLog(), 1000);
+  unlink(LogFile.c_str());
+}
+
+TEST(append_only_log, zero_interval_test) {
+  unlink(LogFile.c_str());
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.EnableLog(LogFile, s21::fsyncInterval,
+                                std::chrono::milliseconds(0)),
+            s21::unknownError);
+  ASSERT_FALSE(hashtable.LogEnabled());
+  unlink(LogFile.c_str());
+}
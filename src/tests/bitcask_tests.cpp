@@ -0,0 +1,424 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../model/binary_io.h"
+#include "../model/bitcask/bitcask.h"
+#include "../types.h"
+
+namespace {
+// Каталог теста удаляется до и после него
+class TempDirectory {
+ public:
+  explicit TempDirectory(const std::string& name)
+      : path_((std::filesystem::temp_directory_path() /
+               (name + "_" + std::to_string(getpid())))
+                  .string()) {
+    std::filesystem::remove_all(path_);
+  }
+  ~TempDirectory() { std::filesystem::remove_all(path_); }
+
+  s21::Bitcask::Options Options(const uint64_t segmentBytes = 64 << 20) const {
+    s21::Bitcask::Options options;
+    options.directory = path_;
+    options.segmentBytes = segmentBytes;
+    return options;
+  }
+  const std::string& Path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+}  // namespace
+
+TEST(bitcask, operations_test) {
+  TempDirectory dir("s21_bitcask_operations");
+  s21::Bitcask bitcask(dir.Options());
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  ASSERT_EQ(bitcask.set("1", v), s21::noErrors);
+  ASSERT_EQ(bitcask.set("1", v), s21::keyAlreadyExists);
+  ASSERT_EQ(bitcask.set("2", v, 100), s21::noErrors);
+  ASSERT_EQ(bitcask.get("1").value().city, "Moscow");
+  ASSERT_EQ(bitcask.update("1", {"", "", 0, "Kazan", 0}, 0, s21::pCity),
+            s21::noErrors);
+  ASSERT_EQ(bitcask.get("1").value().city, "Kazan");
+  ASSERT_EQ(bitcask.get("1").value().coins, 10);
+  ASSERT_EQ(bitcask.rename("1", "2"), s21::keyAlreadyExists);
+  ASSERT_EQ(bitcask.rename("2", "3"), s21::noErrors);
+  ASSERT_FALSE(bitcask.exists("2"));
+  ASSERT_EQ(bitcask.Ttl("3"), 100);
+  ASSERT_EQ(bitcask.del("1"), s21::noErrors);
+  ASSERT_EQ(bitcask.del("1"), s21::keyNotFound);
+  ASSERT_EQ(bitcask.keys(), std::vector<std::string>({"3"}));
+  ASSERT_EQ(bitcask.find(v, 0, s21::pCity), std::vector<std::string>({"3"}));
+  s21::AggregateQuery query{s21::aggSum, s21::pCoins, s21::pCity, s21::Value(),
+                            0, 0};
+  auto rows = bitcask.aggregate(query);
+  ASSERT_EQ(rows.size(), 1u);
+  ASSERT_EQ(rows[0].group, "Moscow");
+  ASSERT_EQ(rows[0].result, 10);
+  ASSERT_EQ(bitcask.GetSize(), 1);
+}
+
+TEST(bitcask, versions_not_supported_test) {
+  TempDirectory dir("s21_bitcask_versions");
+  s21::Bitcask bitcask(dir.Options());
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  ASSERT_EQ(bitcask.set("1", v), s21::noErrors);
+  ASSERT_FALSE(bitcask.SupportsVersions());
+  ASSERT_EQ(bitcask.updateIfVersion("1", v, 0, s21::pCity, 0),
+            s21::versionsNotSupported);
+  ASSERT_EQ(bitcask.delIfVersion("1", 0), s21::versionsNotSupported);
+  ASSERT_TRUE(bitcask.exists("1"));
+}
+
+TEST(bitcask, batch_test) {
+  TempDirectory dir("s21_bitcask_batch");
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  {
+    s21::Bitcask bitcask(dir.Options(4 << 10));
+    std::vector<std::pair<s21::Key, s21::Value>> values;
+    for (int i = 0; i < 200; ++i)
+      values.push_back({"key" + std::to_string(i), {"a", "b", 2000, "c", i}});
+    values.push_back({"key0", v});
+    auto res = bitcask.mset(values);
+    ASSERT_EQ(res.back(), s21::keyAlreadyExists);
+    ASSERT_GT(bitcask.segmentsCount(), 1u);
+    auto found = bitcask.mget({"key150", "nokey", "key3", "key150"});
+    ASSERT_EQ(found[0].value().coins, 150);
+    ASSERT_FALSE(found[1].has_value());
+    ASSERT_EQ(found[2].value().coins, 3);
+    ASSERT_EQ(found[3].value().coins, 150);
+    ASSERT_EQ(bitcask.mdel({"key1", "nokey", "key2"}),
+              std::vector<s21::Errors>(
+                  {s21::noErrors, s21::keyNotFound, s21::noErrors}));
+  }
+  s21::Bitcask bitcask(dir.Options());
+  ASSERT_EQ(bitcask.GetSize(), 198);
+  ASSERT_FALSE(bitcask.exists("key1"));
+  ASSERT_EQ(bitcask.get("key0").value().coins, 0);
+}
+
+TEST(bitcask, incrby_test) {
+  TempDirectory dir("s21_bitcask_incrby");
+  {
+    s21::Bitcask bitcask(dir.Options());
+    bitcask.set("key", {"Ivanov", "Ivan", 2000, "Moscow", 10});
+    int result = 0;
+    ASSERT_EQ(bitcask.incrBy("key", s21::pCoins, 5, result), s21::noErrors);
+    ASSERT_EQ(result, 15);
+    ASSERT_EQ(bitcask.incrBy("key", s21::pYear, 1, result), s21::noErrors);
+    ASSERT_EQ(result, 2001);
+    ASSERT_EQ(bitcask.incrBy("nokey", s21::pCoins, 1, result),
+              s21::keyNotFound);
+  }
+  s21::Bitcask bitcask(dir.Options());
+  auto value = bitcask.get("key");
+  ASSERT_EQ(value.value().coins, 15);
+  ASSERT_EQ(value.value().year, 2001);
+}
+
+TEST(bitcask, restart_test) {
+  TempDirectory dir("s21_bitcask_restart");
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  {
+    s21::Bitcask bitcask(dir.Options(4 << 10));
+    for (int i = 0; i < 1000; ++i)
+      ASSERT_EQ(bitcask.set("key" + std::to_string(i), v), s21::noErrors);
+    for (int i = 0; i < 1000; i += 2)
+      ASSERT_EQ(bitcask.del("key" + std::to_string(i)), s21::noErrors);
+    ASSERT_EQ(bitcask.update("key1", {"", "", 0, "", 42}, 0, s21::pCoins),
+              s21::noErrors);
+    ASSERT_EQ(bitcask.set("ttl", v, 100), s21::noErrors);
+    ASSERT_EQ(bitcask.set("short", v, std::chrono::milliseconds(50)),
+              s21::noErrors);
+    ASSERT_GT(bitcask.segmentsCount(), 1u);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  s21::Bitcask bitcask(dir.Options(4 << 10));
+  ASSERT_EQ(bitcask.GetSize(), 501);
+  ASSERT_FALSE(bitcask.exists("key0"));
+  ASSERT_FALSE(bitcask.exists("short"));
+  ASSERT_EQ(bitcask.get("key1").value().coins, 42);
+  ASSERT_EQ(bitcask.get("key3").value().coins, 10);
+  ASSERT_GT(bitcask.Ttl("ttl"), 90);
+  ASSERT_EQ(bitcask.set("key0", v), s21::noErrors);
+}
+
+TEST(bitcask, upload_concurrent_writes_test) {
+  TempDirectory dir("s21_bitcask_upload");
+  const int rowsCount = 20000;
+  {
+    std::ofstream fout("examples/test.txt");
+    for (int i = 0; i < rowsCount; ++i)
+      fout << "key" << i << " \"Ivanov\" \"Ivan\" 1950 \"Moscow\" " << i
+           << "\n";
+  }
+  s21::Bitcask bitcask(dir.Options());
+  std::thread loader(
+      [&] { ASSERT_EQ(bitcask.upload("examples/test.txt"), rowsCount); });
+  // Загрузка отпускает блокировку между пакетами, и запись не ждет ее конца
+  for (int i = 0; i < 1000; ++i)
+    bitcask.set("other" + std::to_string(i), {"a", "b", 2000, "c", i});
+  loader.join();
+  ASSERT_EQ(bitcask.GetSize(), rowsCount + 1000);
+  ASSERT_EQ(bitcask.get("key19999").value().coins, 19999);
+  ASSERT_EQ(bitcask.get("other999").value().coins, 999);
+}
+
+TEST(bitcask, merge_test) {
+  TempDirectory dir("s21_bitcask_merge");
+  std::map<std::string, int> expected;
+  {
+    s21::Bitcask bitcask(dir.Options(16 << 10));
+    for (int round = 0; round < 5; ++round) {
+      for (int i = 0; i < 2000; ++i) {
+        const std::string key = "key" + std::to_string(i);
+        if (round == 0) {
+          ASSERT_EQ(bitcask.set(key, {"a", "b", 2000, "c", i}), s21::noErrors);
+        } else if (i % 5 == round) {
+          ASSERT_EQ(bitcask.del(key), s21::noErrors);
+        } else if (i % 5 > round) {
+          ASSERT_EQ(bitcask.update(key, {"", "", 0, "", round}, 0, s21::pCoins),
+                    s21::noErrors);
+        }
+      }
+    }
+    for (int i = 0; i < 2000; ++i)
+      if (i % 5 == 0) expected["key" + std::to_string(i)] = i;
+    const size_t before = bitcask.segmentsCount();
+    bitcask.merge();
+    ASSERT_LT(bitcask.segmentsCount(), before);
+    ASSERT_EQ(bitcask.GetSize(), 400);
+    for (const auto& [key, coins] : expected)
+      ASSERT_EQ(bitcask.get(key).value().coins, coins);
+    ASSERT_FALSE(bitcask.exists("key1"));
+  }
+  size_t hints = 0;
+  for (const auto& file : std::filesystem::directory_iterator(dir.Path()))
+    hints += file.path().extension() == ".hint";
+  ASSERT_GT(hints, 0u);
+
+  s21::Bitcask bitcask(dir.Options(16 << 10));
+  ASSERT_EQ(bitcask.GetSize(), 400);
+  std::map<std::string, int> actual;
+  for (const auto& value : bitcask.snapshotEntries())
+    actual[value.key] = value.value.coins;
+  ASSERT_EQ(actual, expected);
+}
+
+TEST(bitcask, merge_keeps_deleted_keys_test) {
+  TempDirectory dir("s21_bitcask_merge_deleted");
+  const std::string backup = dir.Path() + "_backup";
+  std::filesystem::remove_all(backup);
+  std::filesystem::create_directories(backup);
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  {
+    s21::Bitcask bitcask(dir.Options());
+    ASSERT_EQ(bitcask.set("deleted", v), s21::noErrors);
+    ASSERT_EQ(bitcask.set("kept", v), s21::noErrors);
+    // Обе записи переходят в сегмент 2 с подсказками, отметка об удалении
+    // пишется в активный сегмент 1
+    bitcask.merge();
+    ASSERT_EQ(bitcask.del("deleted"), s21::noErrors);
+    for (const uint32_t id : {1u, 2u})
+      std::filesystem::copy(s21::Segment::DataName(dir.Path(), id), backup);
+    std::filesystem::copy(s21::Segment::HintName(dir.Path(), 2), backup);
+    // Второе слияние отбрасывает отметку и удаляет сегменты 1 и 2
+    bitcask.merge();
+  }
+  // Сбой после удаления только сегмента 1: сегмент 2 остался в каталоге
+  for (const auto& name : {s21::Segment::DataName(dir.Path(), 2),
+                           s21::Segment::HintName(dir.Path(), 2)}) {
+    ASSERT_FALSE(std::filesystem::exists(name));
+    std::filesystem::copy(
+        backup + "/" + std::filesystem::path(name).filename().string(), name);
+  }
+  std::filesystem::remove_all(backup);
+
+  s21::Bitcask bitcask(dir.Options());
+  ASSERT_FALSE(bitcask.exists("deleted"));
+  ASSERT_EQ(bitcask.get("kept").value().city, "Moscow");
+  ASSERT_EQ(bitcask.GetSize(), 1);
+  ASSERT_FALSE(std::filesystem::exists(s21::Segment::DataName(dir.Path(), 2)));
+}
+
+TEST(bitcask, replaced_list_bounded_test) {
+  TempDirectory dir("s21_bitcask_replaced");
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  s21::Bitcask bitcask(dir.Options());
+  for (int round = 0; round < 10; ++round) {
+    ASSERT_EQ(bitcask.set("key" + std::to_string(round), v), s21::noErrors);
+    bitcask.merge();
+    // Список хранит только входы последнего слияния, файлы прежних уже
+    // удалены
+    std::vector<uint32_t> ids;
+    ASSERT_TRUE(s21::Segment::ReadReplaced(dir.Path(), ids));
+    ASSERT_LE(ids.size(), 2u);
+  }
+  ASSERT_EQ(bitcask.GetSize(), 10);
+}
+
+TEST(bitcask, torn_tail_test) {
+  TempDirectory dir("s21_bitcask_torn_tail");
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  {
+    s21::Bitcask bitcask(dir.Options());
+    ASSERT_EQ(bitcask.set("1", v), s21::noErrors);
+    ASSERT_EQ(bitcask.set("2", v), s21::noErrors);
+  }
+  // Обрезаем последнюю запись, как при сбое во время записи
+  const std::string fileName = s21::Segment::DataName(dir.Path(), 0);
+  std::filesystem::resize_file(fileName,
+                               std::filesystem::file_size(fileName) - 3);
+  s21::Bitcask bitcask(dir.Options());
+  ASSERT_TRUE(bitcask.exists("1"));
+  ASSERT_FALSE(bitcask.exists("2"));
+  ASSERT_EQ(bitcask.set("2", v), s21::noErrors);
+  ASSERT_EQ(bitcask.get("2").value().city, "Moscow");
+}
+
+TEST(bitcask, torn_tail_below_merge_outputs_test) {
+  TempDirectory dir("s21_bitcask_torn_below_merge");
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  {
+    s21::Bitcask bitcask(dir.Options(256));
+    for (int i = 0; i < 40; ++i)
+      ASSERT_EQ(bitcask.set(std::to_string(i), v), s21::noErrors);
+    for (int i = 0; i < 20; ++i)
+      ASSERT_EQ(bitcask.del(std::to_string(i)), s21::noErrors);
+    bitcask.merge();
+    ASSERT_EQ(bitcask.set("new", v), s21::noErrors);
+  }
+  // Текущий сегмент - последний без подсказок, выходы слияния лежат выше
+  uint32_t active = 0;
+  uint32_t highest = 0;
+  for (const auto& file : std::filesystem::directory_iterator(dir.Path())) {
+    if (file.path().extension() != ".data") continue;
+    const uint32_t id = std::stoul(file.path().stem().string());
+    highest = std::max(highest, id);
+    if (!std::filesystem::exists(s21::Segment::HintName(dir.Path(), id)))
+      active = std::max(active, id);
+  }
+  ASSERT_LT(active, highest);
+  // Начало записи, оборванной сбоем
+  std::ofstream(s21::Segment::DataName(dir.Path(), active),
+                std::ios::binary | std::ios::app)
+      << "abc";
+  s21::Bitcask bitcask(dir.Options(256));
+  ASSERT_EQ(bitcask.GetSize(), 21);
+  ASSERT_EQ(bitcask.get("new").value().city, "Moscow");
+  ASSERT_EQ(bitcask.get("39").value().city, "Moscow");
+}
+
+namespace {
+// Инвертирует байт offset файла
+void FlipByte(const std::string& fileName, const std::streamoff offset) {
+  std::fstream file(fileName, std::ios::binary | std::ios::in | std::ios::out);
+  file.seekg(offset);
+  const char byte = static_cast<char>(file.get() ^ 0xFF);
+  file.seekp(offset);
+  file.put(byte);
+}
+
+bool OpensCorrupted(const s21::Bitcask::Options& options) {
+  try {
+    s21::Bitcask bitcask(options);
+  } catch (const std::runtime_error& error) {
+    return std::string(error.what()).find("Corrupted") != std::string::npos;
+  }
+  return false;
+}
+}  // namespace
+
+TEST(bitcask, corrupted_closed_segment_test) {
+  TempDirectory dir("s21_bitcask_corrupted_closed");
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  {
+    s21::Bitcask bitcask(dir.Options());
+    for (int i = 0; i < 1000; ++i)
+      ASSERT_EQ(bitcask.set(std::to_string(i), v), s21::noErrors);
+  }
+  {
+    s21::Bitcask bitcask(dir.Options());
+    ASSERT_EQ(bitcask.set("new", v), s21::noErrors);
+  }
+  // Поврежденная запись в начале закрытого сегмента, за ней еще 999 целых
+  const std::string fileName = s21::Segment::DataName(dir.Path(), 0);
+  const auto size = std::filesystem::file_size(fileName);
+  FlipByte(fileName, 30);
+  ASSERT_TRUE(OpensCorrupted(dir.Options()));
+  ASSERT_EQ(std::filesystem::file_size(fileName), size);
+  ASSERT_TRUE(OpensCorrupted(dir.Options()));
+  ASSERT_EQ(std::filesystem::file_size(fileName), size);
+}
+
+TEST(bitcask, corrupted_last_segment_test) {
+  TempDirectory dir("s21_bitcask_corrupted_last");
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  {
+    s21::Bitcask bitcask(dir.Options());
+    ASSERT_EQ(bitcask.set("1", v), s21::noErrors);
+    ASSERT_EQ(bitcask.set("2", v), s21::noErrors);
+  }
+  // Запись с неверной контрольной суммой не в конце файла - не недописанный
+  // хвост даже в последнем сегменте
+  const std::string fileName = s21::Segment::DataName(dir.Path(), 0);
+  const auto size = std::filesystem::file_size(fileName);
+  FlipByte(fileName, 30);
+  ASSERT_TRUE(OpensCorrupted(dir.Options()));
+  ASSERT_EQ(std::filesystem::file_size(fileName), size);
+}
+
+TEST(bitcask, corrupted_merge_input_test) {
+  TempDirectory dir("s21_bitcask_corrupted_merge");
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  s21::Bitcask bitcask(dir.Options());
+  for (int i = 0; i < 100; ++i)
+    ASSERT_EQ(bitcask.set(std::to_string(i), v), s21::noErrors);
+  const std::string fileName = s21::Segment::DataName(dir.Path(), 0);
+  const auto size = std::filesystem::file_size(fileName);
+  FlipByte(fileName, 30);
+  // Слияние с поврежденным входом не удается, сегмент остается как был
+  bitcask.merge();
+  ASSERT_EQ(std::filesystem::file_size(fileName), size);
+  ASSERT_EQ(bitcask.get("99").value().city, "Moscow");
+}
+
+TEST(bitcask, undecodable_record_test) {
+  TempDirectory dir("s21_bitcask_undecodable");
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  {
+    s21::Bitcask bitcask(dir.Options());
+    ASSERT_EQ(bitcask.set("1", v), s21::noErrors);
+  }
+  // Запись с верной контрольной суммой, которую нельзя разобрать, и целая
+  // запись после нее
+  const std::string fileName = s21::Segment::DataName(dir.Path(), 0);
+  std::ifstream fin(fileName, std::ios::binary);
+  const std::string valid((std::istreambuf_iterator<char>(fin)),
+                          std::istreambuf_iterator<char>());
+  fin.close();
+  std::string damaged = valid;
+  s21::Put<uint32_t>(damaged, 3);
+  s21::Put<uint32_t>(damaged, s21::Crc32("abc"));
+  damaged += "abc" + valid;
+  std::ofstream(fileName, std::ios::binary | std::ios::trunc) << damaged;
+
+  try {
+    s21::Bitcask bitcask(dir.Options());
+    FAIL();
+  } catch (const std::runtime_error& error) {
+    ASSERT_NE(std::string(error.what()).find("Corrupted"), std::string::npos);
+  }
+  ASSERT_EQ(std::filesystem::file_size(fileName), damaged.size());
+}
@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../model/dispatchers/dispatcher_base.h"
+#include "../model/dispatchers/ttl_manager.h"
+#include "../model/hash_table/hash_table.h"
+
+namespace {
+const s21::Deadline Past = s21::Clock::now() - std::chrono::seconds(10);
+
+// Повторяет распределение ключей диспетчера по 16 сегментам
+size_t ShardOf(const std::string& key) {
+  return std::hash<std::string>()(key) % 16;
+}
+
+// Каждый пакет удаления занимает больше бюджета такта удаления
+class SlowExpiryTable : public s21::HashTable {
+ public:
+  ~SlowExpiryTable() override {
+    s21::TtlManager::getInstance().deleteContainer(*this);
+  }
+
+  size_t expireBatch(const std::vector<std::string>& keys) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      starts_.push_back(s21::Clock::now());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    return s21::HashTable::expireBatch(keys);
+  }
+
+  std::vector<s21::Deadline> Starts() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return starts_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<s21::Deadline> starts_;
+};
+}  // namespace
+
+TEST(dispatcher, reregister_earlier_test) {
+  s21::Dispatcher dispatcher;
+  const s21::Deadline now = s21::Clock::now();
+  dispatcher.AddOrUpdateObservableValue("key", now + std::chrono::hours(2));
+  dispatcher.AddOrUpdateObservableValue("key", now + std::chrono::hours(1));
+  ASSERT_EQ(dispatcher.NextDeadline(), now + std::chrono::hours(1));
+  ASSERT_EQ(dispatcher.ExpiringBetween(now, s21::NoDeadline).size(), 1);
+  ASSERT_TRUE(dispatcher
+                  .ExpiringBetween(now + std::chrono::minutes(90),
+                                   now + std::chrono::hours(3))
+                  .empty());
+}
+
+TEST(dispatcher, reregister_later_test) {
+  s21::Dispatcher dispatcher;
+  const s21::Deadline now = s21::Clock::now();
+  dispatcher.AddOrUpdateObservableValue("key", now + std::chrono::hours(1));
+  dispatcher.AddOrUpdateObservableValue("key", now + std::chrono::hours(2));
+  ASSERT_EQ(dispatcher.NextDeadline(), now + std::chrono::hours(2));
+  ASSERT_TRUE(
+      dispatcher.ExpiringBetween(now, now + std::chrono::minutes(90)).empty());
+  ASSERT_EQ(dispatcher.ExpiringBetween(now, s21::NoDeadline).size(), 1);
+}
+
+TEST(dispatcher, update_only_due_test) {
+  s21::Dispatcher dispatcher;
+  const s21::Deadline later = s21::Clock::now() + std::chrono::hours(1);
+  dispatcher.AddOrUpdateObservableValue("due1", Past);
+  dispatcher.AddOrUpdateObservableValue("due2", Past);
+  dispatcher.AddOrUpdateObservableValue("later", later);
+  ASSERT_EQ(dispatcher.Update(), 2);
+  ASSERT_EQ(dispatcher.Update(), 0);
+  std::vector<std::string> rest =
+      dispatcher.ExpiringBetween(Past, s21::NoDeadline);
+  ASSERT_EQ(rest.size(), 1);
+  ASSERT_EQ(rest[0], "later");
+  ASSERT_EQ(dispatcher.NextDeadline(), later);
+}
+
+TEST(dispatcher, delete_test) {
+  s21::Dispatcher dispatcher;
+  dispatcher.AddOrUpdateObservableValue("key", Past);
+  dispatcher.AddOrUpdateObservableValue("other", Past);
+  dispatcher.DeleteKeyFromObserv("key");
+  dispatcher.DeleteKeyFromObserv("missing");
+  std::vector<std::string> rest =
+      dispatcher.ExpiringBetween(Past, s21::NoDeadline);
+  ASSERT_EQ(rest.size(), 1);
+  ASSERT_EQ(rest[0], "other");
+  ASSERT_EQ(dispatcher.Update(), 1);
+  ASSERT_EQ(dispatcher.NextDeadline(), s21::NoDeadline);
+}
+
+TEST(dispatcher, update_max_count_round_robin_test) {
+  s21::Dispatcher dispatcher;
+  // По одному ключу в сегментах 1..15 и 20 ключей в сегменте 0
+  std::vector<bool> filled(16, false);
+  size_t crowded = 0, singles = 0;
+  for (int i = 0; crowded < 20 || singles < 15; ++i) {
+    const std::string key = "key" + std::to_string(i);
+    const size_t shard = ShardOf(key);
+    if (shard == 0 && crowded < 20) {
+      ++crowded;
+    } else if (shard != 0 && !filled[shard]) {
+      filled[shard] = true;
+      ++singles;
+    } else {
+      continue;
+    }
+    dispatcher.AddOrUpdateObservableValue(key, Past);
+  }
+  // Каждый такт начинается со следующего сегмента, поэтому 16 тактов по
+  // одному ключу забирают ключ из каждого сегмента
+  for (int i = 0; i < 16; ++i) ASSERT_EQ(dispatcher.Update(1), 1);
+  std::vector<std::string> rest =
+      dispatcher.ExpiringBetween(Past, s21::NoDeadline);
+  ASSERT_EQ(rest.size(), 19);
+  for (const auto& key : rest) ASSERT_EQ(ShardOf(key), 0);
+  ASSERT_EQ(dispatcher.Update(5), 5);
+  ASSERT_EQ(dispatcher.Update(), 14);
+  ASSERT_EQ(dispatcher.Update(), 0);
+}
+
+TEST(dispatcher, batch_test) {
+  s21::Dispatcher dispatcher;
+  const s21::Deadline later = s21::Clock::now() + std::chrono::hours(1);
+  std::vector<std::string> keys, due, missing{"missing"};
+  for (int i = 0; i < 100; ++i) {
+    keys.push_back("key" + std::to_string(i));
+    if (i % 2) due.push_back(keys.back());
+  }
+  dispatcher.AddOrUpdateObservableValues(keys, later);
+  ASSERT_EQ(dispatcher.ExpiringBetween(Past, s21::NoDeadline).size(), 100);
+  dispatcher.AddOrUpdateObservableValues(due, Past);
+  ASSERT_EQ(dispatcher.ExpiringBetween(Past, s21::NoDeadline).size(), 100);
+  ASSERT_EQ(dispatcher.Update(), 50);
+  ASSERT_EQ(dispatcher.NextDeadline(), later);
+
+  dispatcher.DeleteKeysFromObserv(keys);
+  dispatcher.DeleteKeysFromObserv(missing);
+  ASSERT_TRUE(dispatcher.ExpiringBetween(Past, s21::NoDeadline).empty());
+  ASSERT_EQ(dispatcher.NextDeadline(), s21::NoDeadline);
+}
+
+TEST(dispatcher, earlier_deadline_wakes_up_test) {
+  s21::HashTable hashtable;
+  s21::Value v;
+  // Поток удаления засыпает до срока late и должен проснуться раньше
+  ASSERT_EQ(hashtable.set("late", v, std::chrono::seconds(60)),
+            s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_EQ(hashtable.set("early", v, std::chrono::milliseconds(50)),
+            s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  // Счетчик уменьшает только удаление, а не чтение
+  ASSERT_EQ(hashtable.GetSize(), 1);
+  std::vector<std::string> rest =
+      hashtable.expiringWithin(std::chrono::hours(1));
+  ASSERT_EQ(rest.size(), 1);
+  ASSERT_EQ(rest[0], "late");
+}
+
+TEST(dispatcher, pause_after_budget_test) {
+  SlowExpiryTable hashtable;
+  s21::Value v;
+  std::vector<std::pair<s21::Key, s21::Value>> values;
+  for (int i = 0; i < 1000; ++i)
+    values.emplace_back("key" + std::to_string(i), v);
+  hashtable.mset(values, std::chrono::milliseconds(1));
+  while (hashtable.Starts().empty())
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  // Короткие сроки, добавленные во время такта и паузы после него, не
+  // начинают следующий такт раньше конца паузы
+  for (int i = 0; i < 50; ++i) {
+    hashtable.set("short" + std::to_string(i), v,
+                  std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  // Второй такт начинается только после пакета и паузы, поэтому ждем его
+  // с запасом, а не фиксированное время
+  const s21::Deadline deadline = s21::Clock::now() + std::chrono::seconds(1);
+  std::vector<s21::Deadline> starts = hashtable.Starts();
+  while (starts.size() < 2 && s21::Clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    starts = hashtable.Starts();
+  }
+  ASSERT_GE(starts.size(), 2u);
+  // Первый пакет занимает 30 мс, затем пауза 75 мс
+  ASSERT_GE(std::chrono::duration_cast<std::chrono::milliseconds>(
+                starts[1] - starts[0])
+                .count(),
+            100);
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../model/events/keyspace_notifier.h"
+#include "../model/events/ring_buffer.h"
+
+TEST(events, ring_buffer_test) {
+  s21::RingBuffer<int> buffer(3);
+  ASSERT_EQ(buffer.Capacity(), 4);
+  for (int i = 0; i < 4; ++i) ASSERT_TRUE(buffer.TryPush(i));
+  ASSERT_FALSE(buffer.TryPush(4));
+  int value = -1;
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(buffer.TryPop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_FALSE(buffer.TryPop(value));
+}
+
+TEST(events, ring_buffer_concurrent_test) {
+  const int count = 100000;
+  s21::RingBuffer<int> buffer(64);
+  std::thread producer([&]() {
+    for (int i = 0; i < count; ++i)
+      while (!buffer.TryPush(i)) std::this_thread::yield();
+  });
+  long long sum = 0;
+  int expected = 0;
+  while (expected < count) {
+    int value;
+    if (!buffer.TryPop(value)) continue;
+    ASSERT_EQ(value, expected++);
+    sum += value;
+  }
+  producer.join();
+  ASSERT_EQ(sum, static_cast<long long>(count) * (count - 1) / 2);
+}
+
+TEST(events, notifier_overflow_test) {
+  s21::KeyspaceNotifier notifier;
+  notifier.Publish(s21::evSet, "lost");
+  auto subscription = notifier.Subscribe(2);
+  notifier.Publish(s21::evSet, "1");
+  notifier.Publish(s21::evRename, "1", "2");
+  notifier.Publish(s21::evDel, "2");
+  ASSERT_EQ(subscription->Dropped(), 1);
+
+  s21::KeyspaceEvent event;
+  ASSERT_TRUE(subscription->Poll(event));
+  ASSERT_EQ(event.type, s21::evSet);
+  ASSERT_EQ(event.key, "1");
+  ASSERT_TRUE(subscription->Poll(event));
+  ASSERT_EQ(event.type, s21::evRename);
+  ASSERT_EQ(event.newKey, "2");
+  ASSERT_FALSE(subscription->Poll(event));
+
+  notifier.Unsubscribe(subscription);
+  notifier.Publish(s21::evSet, "3");
+  ASSERT_FALSE(subscription->Poll(event));
+}
+
+TEST(events, notifier_concurrent_publish_test) {
+  const int threadsCount = 4;
+  const int count = 20000;
+  s21::KeyspaceNotifier notifier;
+  auto subscription = notifier.Subscribe(1 << 10);
+  std::atomic<bool> done{false};
+  // Подписки меняются, пока несколько потоков публикуют события
+  std::thread churn([&]() {
+    while (!done.load()) notifier.Unsubscribe(notifier.Subscribe(4));
+  });
+  std::atomic<int> running{threadsCount};
+  // Как и в хранилище, публикации из разных потоков идут под одной
+  // блокировкой
+  std::mutex storeMutex;
+  std::vector<std::thread> publishers;
+  for (int t = 0; t < threadsCount; ++t)
+    publishers.emplace_back([&]() {
+      for (int i = 0; i < count; ++i) {
+        std::lock_guard<std::mutex> lock(storeMutex);
+        notifier.Publish(s21::evSet, "key");
+      }
+      --running;
+    });
+  size_t received = 0;
+  s21::KeyspaceEvent event;
+  while (running.load() > 0)
+    while (subscription->Poll(event)) ++received;
+  for (auto& publisher : publishers) publisher.join();
+  done = true;
+  churn.join();
+  while (subscription->Poll(event)) ++received;
+  ASSERT_EQ(received + subscription->Dropped(),
+            static_cast<size_t>(threadsCount) * count);
+}
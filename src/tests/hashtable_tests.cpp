@@ -1,7 +1,12 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <fstream>
+#include <atomic>
+#include <climits>
 #include <map>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "../model/hash_table/hash_table.h"
@@ -168,6 +173,119 @@ TEST(hashtable, ttl_test) {
   ASSERT_EQ(hashtable.Ttl("100"), s21::keyNotFound);
 }
 
+TEST(hashtable, batch_test) {
+  s21::HashTable hashtable;
+  fillhashtable(hashtable);
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  auto res = hashtable.mset({{"1", v}, {"10", v}, {"2", v}, {"1", v}}, 100);
+  ASSERT_EQ(res, std::vector<s21::Errors>({s21::noErrors, s21::keyAlreadyExists,
+                                           s21::noErrors,
+                                           s21::keyAlreadyExists}));
+  ASSERT_EQ(hashtable.Ttl("1"), 100);
+  ASSERT_EQ(hashtable.Ttl("10"), s21::hasNoTtl);
+  ASSERT_EQ(hashtable.expiringWithin(std::chrono::seconds(100)),
+            std::vector<std::string>({"1", "2"}));
+
+  auto values = hashtable.mget({"2", "nokey", "10"});
+  ASSERT_EQ(values.size(), 3u);
+  ASSERT_EQ(values[0].value().city, "Moscow");
+  ASSERT_FALSE(values[1].has_value());
+  ASSERT_EQ(values[2].value().city, "qwe");
+
+  ASSERT_EQ(hashtable.mdel({"1", "nokey", "10", "1"}),
+            std::vector<s21::Errors>({s21::noErrors, s21::keyNotFound,
+                                      s21::noErrors, s21::keyNotFound}));
+  ASSERT_EQ(hashtable.expiringWithin(std::chrono::seconds(100)),
+            std::vector<std::string>({"2"}));
+  ASSERT_EQ(hashtable.GetSize(), 15);
+}
+
+TEST(hashtable, visit_test) {
+  s21::HashTable hashtable;
+  fillhashtable(hashtable);
+  int visited = 0;
+  ASSERT_TRUE(hashtable.visit("10", [&visited](const s21::Value& value) {
+    ASSERT_EQ(value.city, "qwe");
+    ++visited;
+  }));
+  ASSERT_FALSE(hashtable.visit("nokey", [&visited](const s21::Value&) {
+    ++visited;
+  }));
+  ASSERT_EQ(visited, 1);
+}
+
+TEST(hashtable, incrby_test) {
+  s21::HashTable hashtable;
+  fillhashtable(hashtable);
+  int result = 0;
+  ASSERT_EQ(hashtable.incrBy("10", s21::pCoins, 7, result), s21::noErrors);
+  ASSERT_EQ(result, 130);
+  ASSERT_EQ(hashtable.incrBy("10", s21::pYear, -36, result), s21::noErrors);
+  ASSERT_EQ(result, 1200);
+  ASSERT_EQ(hashtable.get("10").value().coins, 130);
+  ASSERT_EQ(hashtable.incrBy("nokey", s21::pCoins, 1, result),
+            s21::keyNotFound);
+  ASSERT_EQ(hashtable.incrBy("10", s21::pCity, 1, result),
+            s21::valueOutOfRange);
+  ASSERT_EQ(hashtable.incrBy("10", s21::pCoins, INT_MAX, result),
+            s21::valueOutOfRange);
+  ASSERT_EQ(hashtable.get("10").value().coins, 130);
+
+  // Одновременные прибавления не теряются
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&hashtable]() {
+      int value = 0;
+      for (int i = 0; i < 1000; ++i)
+        hashtable.incrBy("20", s21::pCoins, 1, value);
+    });
+  for (auto& thread : threads) thread.join();
+  ASSERT_EQ(hashtable.get("20").value().coins, 4123);
+}
+
+TEST(hashtable, version_test) {
+  s21::HashTable hashtable;
+  fillhashtable(hashtable);
+  auto found = hashtable.getVersioned("10");
+  ASSERT_TRUE(found.has_value());
+  ASSERT_EQ(found->value.coins, 123);
+  const uint64_t version = found->version;
+  ASSERT_NE(hashtable.getVersioned("20")->version, version);
+  ASSERT_FALSE(hashtable.getVersioned("nokey").has_value());
+
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  ASSERT_EQ(hashtable.updateIfVersion("10", v, 0, s21::pCoins, version),
+            s21::noErrors);
+  const uint64_t updated = hashtable.getVersioned("10")->version;
+  ASSERT_GT(updated, version);
+  ASSERT_EQ(hashtable.updateIfVersion("10", v, 0, s21::pCity, version),
+            s21::versionMismatch);
+  ASSERT_EQ(hashtable.get("10").value().city, "qwe");
+  ASSERT_EQ(hashtable.delIfVersion("10", version), s21::versionMismatch);
+  ASSERT_EQ(hashtable.rename("10", "11"), s21::noErrors);
+  ASSERT_EQ(hashtable.delIfVersion("11", updated), s21::versionMismatch);
+  ASSERT_EQ(hashtable.delIfVersion("11", hashtable.getVersioned("11")->version),
+            s21::noErrors);
+  ASSERT_EQ(hashtable.delIfVersion("11", updated), s21::keyNotFound);
+
+  // Оптимистичные прибавления: чтение версии, затем условное обновление
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&hashtable]() {
+      for (int i = 0; i < 500; ++i) {
+        while (true) {
+          auto current = hashtable.getVersioned("20");
+          current->value.coins += 1;
+          if (hashtable.updateIfVersion("20", current->value, 0, s21::pCoins,
+                                        current->version) == s21::noErrors)
+            break;
+        }
+      }
+    });
+  for (auto& thread : threads) thread.join();
+  ASSERT_EQ(hashtable.get("20").value().coins, 2123);
+}
+
 TEST(hashtable, upload_good_test) {
   s21::HashTable hashtable;
   fillhashtable(hashtable);
@@ -176,6 +294,136 @@ TEST(hashtable, upload_good_test) {
   ASSERT_EQ(hashtable.upload("examples/ex1.txt"), numKeyInFile);
 }
 
+TEST(hashtable, upload_quoted_fields_test) {
+  {
+    std::ofstream fout("examples/test.txt");
+    fout << "k1 \"Ivanov  Petrov\" \" Ivan\" 2001 \"Nizhny  Novgorod\" 5\n"
+         << "k2 Sidorov Petr -12 Moscow 7 extra\n";
+  }
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.upload("examples/test.txt"), 2);
+  auto value = hashtable.get("k1").value();
+  ASSERT_EQ(value.lastname, "Ivanov Petrov");
+  ASSERT_EQ(value.name, " Ivan");
+  ASSERT_EQ(value.city, "Nizhny Novgorod");
+  ASSERT_EQ(value.coins, 5);
+  value = hashtable.get("k2").value();
+  ASSERT_EQ(value.lastname, "Sidorov");
+  ASSERT_EQ(value.year, -12);
+  ASSERT_EQ(value.coins, 7);
+}
+
+TEST(hashtable, upload_parallel_test) {
+  const int rowsCount = 120000;
+  {
+    std::ofstream fout("examples/test.txt");
+    for (int i = 0; i < rowsCount; ++i)
+      fout << "key" << i << " \"Ivanov\" \"Ivan\" " << 1950 + i % 70
+           << " \"Nizhny Novgorod\" " << i << "\n";
+    fout << "key0 \"Petrov\" \"Petr\" 2000 \"Moscow\" 1\n";
+  }
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.upload("examples/test.txt"), rowsCount);
+  ASSERT_EQ(hashtable.GetSize(), rowsCount);
+  ASSERT_EQ(hashtable.get("key0").value().lastname, "Ivanov");
+  ASSERT_EQ(hashtable.get("key119999").value().coins, 119999);
+
+  {
+    std::ofstream fout("examples/test.txt", std::ios::app);
+    fout << "\nbroken line\n";
+  }
+  s21::HashTable other;
+  ASSERT_EQ(other.upload("examples/test.txt"), s21::corruptedFile);
+  ASSERT_EQ(other.UploadErrorLine(), rowsCount + 3);
+  ASSERT_EQ(other.GetSize(), 0);
+}
+
+TEST(hashtable, upload_concurrent_writes_test) {
+  const int rowsCount = 120000;
+  {
+    std::ofstream fout("examples/test.txt");
+    for (int i = 0; i < rowsCount; ++i)
+      fout << "key" << i << " \"Ivanov\" \"Ivan\" 1950 \"Moscow\" " << i
+           << "\n";
+  }
+  s21::HashTable hashtable;
+  std::thread loader(
+      [&] { ASSERT_EQ(hashtable.upload("examples/test.txt"), rowsCount); });
+  // Загрузка отпускает блокировку между пакетами, и запись не ждет ее конца
+  for (int i = 0; i < 1000; ++i)
+    hashtable.set("other" + std::to_string(i), {"a", "b", 2000, "c", i});
+  loader.join();
+  ASSERT_EQ(hashtable.GetSize(), rowsCount + 1000);
+  ASSERT_EQ(hashtable.get("key119999").value().coins, 119999);
+  ASSERT_EQ(hashtable.get("other999").value().coins, 999);
+}
+
+TEST(hashtable, upload_multiple_workers_test) {
+  const int rowsCount = 3000;
+  {
+    std::ofstream fout("examples/test.txt");
+    for (int i = 0; i < rowsCount; ++i)
+      fout << "key" << i << " \"Ivanov\" \"Ivan\" 1950 \""
+           << (i % 3 ? "Moscow" : "City" + std::to_string(i % 30)) << "\" "
+           << i << "\n";
+    fout << "key0 \"Petrov\" \"Petr\" 2000 \"Moscow\" 1\n";
+  }
+  s21::HashTable hashtable;
+  hashtable.SetWorkersCount(4);
+  hashtable.set("key1", {"a", "b", 2000, "Kazan", -1});
+  hashtable.set("key2", {"a", "b", 2000, "Kazan", -1},
+                std::chrono::milliseconds(20));
+  // key2 удаляет диспетчер или сама загрузка, событие одно
+  auto subscription = hashtable.Subscribe(2 * rowsCount);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  // Существующий ключ и повтор в файле пропускаются, истекший заменяется
+  ASSERT_EQ(hashtable.upload("examples/test.txt"), rowsCount - 1);
+  ASSERT_EQ(hashtable.GetSize(), rowsCount);
+  ASSERT_EQ(hashtable.get("key0").value().lastname, "Ivanov");
+  ASSERT_EQ(hashtable.get("key1").value().coins, -1);
+  ASSERT_EQ(hashtable.get("key2").value().coins, 2);
+  ASSERT_EQ(hashtable.get("key2999").value().coins, 2999);
+
+  int sets = 0;
+  int expires = 0;
+  s21::KeyspaceEvent event;
+  while (subscription->Poll(event)) {
+    sets += event.type == s21::evSet;
+    expires += event.type == s21::evExpire;
+  }
+  ASSERT_EQ(sets, rowsCount - 1);
+  ASSERT_EQ(expires, 1);
+
+  // Статистика потоков загрузки объединена с общей
+  std::vector<s21::HeavyHitter> top = hashtable.TopK(s21::pCity, 1);
+  ASSERT_EQ(top.size(), 1);
+  ASSERT_EQ(top[0].value, "Moscow");
+  ASSERT_EQ(top[0].count, 1999);
+  long long distinct = hashtable.ApproxDistinct(s21::pCity);
+  ASSERT_GE(distinct, 11);
+  ASSERT_LE(distinct, 13);
+}
+
+TEST(hashtable, upload_skewed_keys_test) {
+  // Хеш - сумма символов, поэтому ключи с общим префиксом занимают меньше
+  // пятой части корзин. Строк больше, чем поток вставляет за один пакет
+  const int rowsCount = 40000;
+  {
+    std::ofstream fout("examples/test.txt");
+    for (int i = 0; i < rowsCount; ++i)
+      fout << "key" << i << " \"Ivanov\" \"Ivan\" 1950 \"Moscow\" " << i
+           << "\n";
+    fout << "key39999 \"Petrov\" \"Petr\" 2000 \"Moscow\" 1\n";
+  }
+  s21::HashTable hashtable;
+  hashtable.SetWorkersCount(4);
+  ASSERT_EQ(hashtable.upload("examples/test.txt"), rowsCount);
+  ASSERT_EQ(hashtable.GetSize(), rowsCount);
+  ASSERT_EQ(hashtable.get("key0").value().coins, 0);
+  ASSERT_EQ(hashtable.get("key39999").value().lastname, "Ivanov");
+}
+
 TEST(hashtable, upload_bad_filename_test) {
   s21::HashTable hashtable;
   fillhashtable(hashtable);
@@ -210,6 +458,7 @@ TEST(hashtable, upload_corrupted_file_test) {
   std::vector<s21::Value> oldValues = hashtable.showall();
 
   ASSERT_EQ(hashtable.upload("examples/corrupted.txt"), s21::corruptedFile);
+  ASSERT_EQ(hashtable.UploadErrorLine(), 2);
 
   std::vector<std::string> newKeys = hashtable.keys();
   ASSERT_EQ(oldKeys.size(), newKeys.size());
@@ -236,6 +485,7 @@ TEST(hashtable, upload_empty_file_test) {
   std::vector<s21::Value> oldValues = hashtable.showall();
 
   ASSERT_EQ(hashtable.upload("examples/empty.txt"), s21::corruptedFile);
+  ASSERT_EQ(hashtable.UploadErrorLine(), 2);
 
   std::vector<std::string> newKeys = hashtable.keys();
   ASSERT_EQ(oldKeys.size(), newKeys.size());
@@ -303,4 +553,375 @@ TEST(hashtable, find_test) {
   std::vector<std::string> foundKeys = hashtable.find(v, 0, bitmask);
   std::vector<std::string> expKeys{"11", "12", "13"};
   ASSERT_EQ(foundKeys.size(), expKeys.size());
-}
\ No newline at end of file
+}
+
+TEST(hashtable, aggregate_test) {
+  s21::HashTable hashtable;
+  s21::Value v;
+  v.lastname = "asd";
+  v.name = "zxc";
+  v.year = 2000;
+  v.city = "Moscow";
+  v.coins = 10;
+  hashtable.set("1", v);
+  v.coins = 30;
+  hashtable.set("2", v);
+  v.city = "Kazan";
+  v.coins = 5;
+  hashtable.set("3", v);
+  v.year = 1990;
+  hashtable.set("4", v);
+
+  s21::AggregateQuery query{s21::aggSum, s21::pCoins, s21::pCity, s21::Value(),
+                            0, 0};
+  std::vector<s21::AggregateRow> rows = hashtable.aggregate(query);
+  ASSERT_EQ(rows.size(), 2);
+  ASSERT_STREQ(rows[0].group.c_str(), "Kazan");
+  ASSERT_EQ(rows[0].result, 10);
+  ASSERT_EQ(rows[0].count, 2);
+  ASSERT_STREQ(rows[1].group.c_str(), "Moscow");
+  ASSERT_EQ(rows[1].result, 40);
+
+  query.function = s21::aggMax;
+  query.groupBy = 0;
+  query.filter.year = 2000;
+  query.paramsMask = s21::pYear;
+  rows = hashtable.aggregate(query);
+  ASSERT_EQ(rows.size(), 1);
+  ASSERT_EQ(rows[0].result, 30);
+  ASSERT_EQ(rows[0].count, 3);
+}
+
+TEST(hashtable, aggregate_during_renames_test) {
+  s21::HashTable hashtable;
+  s21::Value v{"asd", "zxc", 2000, "Moscow", 1};
+  for (int i = 0; i < 2000; ++i) hashtable.set("a" + std::to_string(i), v);
+
+  // Записи переезжают через позицию обхода и обратно, сумма не меняется
+  std::atomic<bool> stop{false};
+  std::thread renamer([&]() {
+    while (!stop.load()) {
+      for (int i = 0; i < 2000; i += 7) {
+        hashtable.rename("a" + std::to_string(i), "z" + std::to_string(i));
+        hashtable.rename("z" + std::to_string(i), "a" + std::to_string(i));
+      }
+    }
+  });
+  s21::AggregateQuery query{s21::aggSum, s21::pCoins, 0, s21::Value(), 0, 0};
+  for (int round = 0; round < 10; ++round) {
+    std::vector<s21::AggregateRow> rows = hashtable.aggregate(query);
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0].result, 2000);
+    EXPECT_EQ(rows[0].count, 2000);
+  }
+  stop = true;
+  renamer.join();
+}
+
+TEST(hashtable, aggregate_parallel_during_renames_test) {
+  s21::HashTable hashtable;
+  hashtable.SetWorkersCount(4);
+  s21::Value v{"asd", "zxc", 2000, "Moscow", 1};
+  for (int i = 0; i < 2000; ++i) {
+    v.city = i % 2 ? "Moscow" : "Kazan";
+    hashtable.set("a" + std::to_string(i), v);
+  }
+
+  // Записи переезжают между диапазонами разных потоков обхода
+  std::atomic<bool> stop{false};
+  std::thread renamer([&]() {
+    while (!stop.load()) {
+      for (int i = 0; i < 2000; i += 7) {
+        hashtable.rename("a" + std::to_string(i), "z" + std::to_string(i));
+        hashtable.rename("z" + std::to_string(i), "a" + std::to_string(i));
+      }
+    }
+  });
+  s21::AggregateQuery query{s21::aggSum, s21::pCoins, s21::pCity,
+                            s21::Value(), 0, 0};
+  for (int round = 0; round < 10; ++round) {
+    std::vector<s21::AggregateRow> rows = hashtable.aggregate(query);
+    ASSERT_EQ(rows.size(), 2);
+    EXPECT_EQ(rows[0].result, 1000);
+    EXPECT_EQ(rows[1].result, 1000);
+  }
+  stop = true;
+  renamer.join();
+}
+
+TEST(hashtable, aggregate_during_export_test) {
+  s21::HashTable hashtable;
+  hashtable.SetWorkersCount(4);
+  s21::Value v{"asd", "zxc", 2000, "Moscow", 3};
+  for (int i = 0; i < 1000; ++i) hashtable.set(std::to_string(i), v);
+
+  // Выгрузка держит snapshotView_, aggregate не ждет ее окончания
+  std::atomic<bool> writing{false};
+  std::atomic<bool> aggregated{false};
+  std::thread exporter([&]() {
+    hashtable.forEachEntry(
+        []() {},
+        [&](const s21::Key&, const s21::Value&, const s21::Deadline) {
+          writing = true;
+          while (!aggregated.load()) std::this_thread::yield();
+        });
+  });
+  while (!writing.load()) std::this_thread::yield();
+  s21::AggregateQuery query{s21::aggSum, s21::pCoins, 0, s21::Value(), 0, 0};
+  std::vector<s21::AggregateRow> rows = hashtable.aggregate(query);
+  aggregated = true;
+  exporter.join();
+  ASSERT_EQ(rows.size(), 1);
+  ASSERT_EQ(rows[0].result, 3000);
+  ASSERT_EQ(rows[0].count, 1000);
+}
+
+TEST(hashtable, ttl_ms_expiry_test) {
+  s21::HashTable hashtable;
+  s21::Value v;
+  ASSERT_EQ(hashtable.set("1", v, std::chrono::milliseconds(100)),
+            s21::noErrors);
+  ASSERT_EQ(hashtable.set("2", v, std::chrono::milliseconds(5000)),
+            s21::noErrors);
+  ASSERT_EQ(hashtable.set("3", v), s21::noErrors);
+  ASSERT_GT(hashtable.PTtl("1"), 0);
+  ASSERT_LE(hashtable.PTtl("1"), 100);
+  ASSERT_EQ(hashtable.Ttl("2"), 5);
+  ASSERT_EQ(hashtable.PTtl("3"), s21::hasNoTtl);
+
+  ASSERT_EQ(hashtable.update("2", v, std::chrono::milliseconds(150), s21::pTtl),
+            s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(400));
+  ASSERT_FALSE(hashtable.exists("1"));
+  ASSERT_FALSE(hashtable.exists("2"));
+  ASSERT_TRUE(hashtable.exists("3"));
+}
+
+TEST(hashtable, huge_ttl_test) {
+  s21::HashTable store;
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  // Срок дальше представимого steady_clock не переполняется в прошлое
+  ASSERT_EQ(store.set("ex", v, std::chrono::seconds(10000000000LL)),
+            s21::noErrors);
+  ASSERT_EQ(store.set("max", v, std::chrono::milliseconds(LLONG_MAX)),
+            s21::noErrors);
+  for (const auto& key : {"ex", "max"}) {
+    ASSERT_TRUE(store.exists(key));
+    ASSERT_GT(store.PTtl(key), 0);
+    ASSERT_EQ(store.Ttl(key), INT_MAX);
+  }
+}
+
+TEST(hashtable, expired_key_reuse_test) {
+  s21::HashTable hashtable;
+  s21::Value v;
+  ASSERT_EQ(hashtable.set("1", v, std::chrono::milliseconds(50)),
+            s21::noErrors);
+  ASSERT_EQ(hashtable.set("2", v, std::chrono::milliseconds(50)),
+            s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_FALSE(hashtable.get("1").has_value());
+  ASSERT_TRUE(hashtable.keys().empty());
+  ASSERT_EQ(hashtable.set("2", v), s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_TRUE(hashtable.exists("2"));
+  ASSERT_EQ(hashtable.Ttl("2"), s21::hasNoTtl);
+}
+
+TEST(hashtable, expire_batch_test) {
+  s21::HashTable hashtable;
+  s21::Value v;
+  for (int i = 0; i < 10; ++i)
+    ASSERT_EQ(
+        hashtable.set(std::to_string(i), v, std::chrono::milliseconds(50)),
+        s21::noErrors);
+  ASSERT_EQ(hashtable.set("alive", v, std::chrono::milliseconds(5000)),
+            s21::noErrors);
+  ASSERT_EQ(hashtable.set("forever", v), s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  std::vector<std::string> batch = {"alive", "forever", "missing"};
+  for (int i = 0; i < 10; ++i) batch.push_back(std::to_string(i));
+  ASSERT_LE(hashtable.expireBatch(batch), 10);
+  ASSERT_EQ(hashtable.GetSize(), 2);
+  ASSERT_TRUE(hashtable.exists("alive"));
+  ASSERT_TRUE(hashtable.exists("forever"));
+}
+
+TEST(hashtable, expiring_within_test) {
+  s21::HashTable hashtable;
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  ASSERT_EQ(hashtable.set("late", v, 55), s21::noErrors);
+  ASSERT_EQ(hashtable.set("soon", v, 5), s21::noErrors);
+  ASSERT_EQ(hashtable.set("middle", v, 25), s21::noErrors);
+  ASSERT_EQ(hashtable.set("forever", v), s21::noErrors);
+
+  auto keys = hashtable.expiringWithin(std::chrono::seconds(30));
+  ASSERT_EQ(keys, std::vector<std::string>({"soon", "middle"}));
+  ASSERT_EQ(hashtable.expiringWithin(std::chrono::seconds(60)).size(), 3);
+
+  auto counts = hashtable.expiryHistogram(std::chrono::seconds(10), 6);
+  ASSERT_EQ(counts, std::vector<size_t>({1, 0, 1, 0, 0, 1}));
+
+  ASSERT_EQ(hashtable.find(v, 25, s21::pTtl | s21::pCity),
+            std::vector<std::string>({"middle"}));
+  ASSERT_EQ(hashtable.del("middle"), s21::noErrors);
+  ASSERT_TRUE(hashtable.find(v, 25, s21::pTtl).empty());
+  // Окно поиска по крайним значениям ttl не переполняется
+  ASSERT_TRUE(hashtable.find(v, INT_MAX, s21::pTtl).empty());
+  ASSERT_TRUE(hashtable.find(v, INT_MIN, s21::pTtl).empty());
+  ASSERT_EQ(hashtable.expiryHistogram(std::chrono::seconds(10), 6)[2], 0);
+}
+
+TEST(hashtable, expiry_histogram_current_deadline_test) {
+  s21::HashTable hashtable;
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  ASSERT_EQ(hashtable.set("deleted", v, 5), s21::noErrors);
+  ASSERT_EQ(hashtable.del("deleted"), s21::noErrors);
+  ASSERT_EQ(hashtable.set("reset", v, 5), s21::noErrors);
+  ASSERT_EQ(hashtable.del("reset"), s21::noErrors);
+  ASSERT_EQ(hashtable.set("reset", v, 25), s21::noErrors);
+  ASSERT_EQ(hashtable.set("updated", v, 15), s21::noErrors);
+  ASSERT_EQ(hashtable.update("updated", v, 45, s21::pTtl), s21::noErrors);
+  ASSERT_EQ(hashtable.set("old", v, 35), s21::noErrors);
+  ASSERT_EQ(hashtable.rename("old", "new"), s21::noErrors);
+  // Каждый ключ учитывается один раз, по сроку текущей записи
+  ASSERT_EQ(hashtable.expiryHistogram(std::chrono::seconds(10), 6),
+            std::vector<size_t>({0, 0, 1, 1, 1, 0}));
+}
+
+TEST(hashtable, concurrent_set_del_ttl_test) {
+  s21::HashTable hashtable;
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  // Потоки перезаписывают одни и те же ключи, у каждого оставшегося ключа
+  // диспетчер должен знать срок именно той записи, что лежит в таблице
+  std::vector<std::thread> writers;
+  for (int t = 0; t < 4; ++t) {
+    writers.emplace_back([&]() {
+      for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < 8; ++i) {
+          const std::string key = std::to_string(i);
+          hashtable.set(key, v, 10);
+          hashtable.del(key);
+          hashtable.set(key, v, 100);
+        }
+      }
+    });
+  }
+  for (auto& writer : writers) writer.join();
+  std::vector<std::string> keys =
+      hashtable.expiringWithin(std::chrono::seconds(200));
+  std::vector<std::string> stored = hashtable.keys();
+  std::sort(keys.begin(), keys.end());
+  std::sort(stored.begin(), stored.end());
+  ASSERT_EQ(keys, stored);
+}
+
+TEST(hashtable, expiring_huge_window_test) {
+  s21::HashTable hashtable;
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  ASSERT_EQ(hashtable.set("soon", v, 5), s21::noErrors);
+  ASSERT_EQ(hashtable.set("far", v, std::chrono::seconds(10000000000LL)),
+            s21::noErrors);
+  // Конец окна не переполняется и не обрезает результат
+  ASSERT_EQ(hashtable.expiringWithin(std::chrono::milliseconds(LLONG_MAX)),
+            std::vector<std::string>({"soon", "far"}));
+  ASSERT_EQ(hashtable.expiryHistogram(std::chrono::milliseconds(LLONG_MAX), 3),
+            std::vector<size_t>({2, 0, 0}));
+  ASSERT_EQ(hashtable.expiryHistogram(std::chrono::hours(1000000), 10000)[0],
+            1u);
+}
+
+TEST(hashtable, keyspace_events_test) {
+  s21::HashTable hashtable;
+  s21::Value v;
+  auto subscription = hashtable.Subscribe();
+  ASSERT_EQ(hashtable.set("1", v), s21::noErrors);
+  ASSERT_EQ(hashtable.set("1", v), s21::keyAlreadyExists);
+  ASSERT_EQ(hashtable.update("1", v, 0, s21::pCoins), s21::noErrors);
+  ASSERT_EQ(hashtable.rename("1", "2"), s21::noErrors);
+  ASSERT_EQ(hashtable.set("3", v, std::chrono::milliseconds(50)),
+            s21::noErrors);
+  ASSERT_EQ(hashtable.del("2"), s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_FALSE(hashtable.exists("3"));
+
+  std::vector<s21::KeyspaceEventType> types;
+  s21::KeyspaceEvent event;
+  while (subscription->Poll(event)) types.push_back(event.type);
+  ASSERT_EQ(types, std::vector<s21::KeyspaceEventType>(
+                       {s21::evSet, s21::evUpdate, s21::evRename, s21::evSet,
+                        s21::evDel, s21::evExpire}));
+  ASSERT_EQ(event.key, "3");
+  ASSERT_EQ(hashtable.GetSize(), 0);
+}
+
+TEST(hashtable, snapshot_consistency_test) {
+  s21::HashTable hashtable;
+  std::map<std::string, int> expected;
+  for (int i = 0; i < 20000; ++i) {
+    hashtable.set("key" + std::to_string(i), {"a", "b", 2000, "c", i});
+    expected["key" + std::to_string(i)] = i;
+  }
+  // Изменения начинаются только после начала обхода и не должны попасть в
+  // снимок
+  std::atomic<bool> started{false};
+  std::thread writer([&]() {
+    while (!started.load()) std::this_thread::yield();
+    for (int i = 0; i < 20000; i += 2) {
+      hashtable.update("key" + std::to_string(i), {"", "", 0, "", -1}, 0,
+                       s21::pCoins);
+      hashtable.del("key" + std::to_string(i + 1));
+      hashtable.set("new" + std::to_string(i), {"a", "b", 2000, "c", 0});
+      hashtable.rename("key" + std::to_string(i), "moved" + std::to_string(i));
+    }
+  });
+  auto entries = hashtable.snapshotEntries([&]() { started = true; });
+  writer.join();
+
+  std::map<std::string, int> actual;
+  for (const auto& entry : entries) actual[entry.key] = entry.value.coins;
+  ASSERT_EQ(actual, expected);
+  ASSERT_EQ(entries.size(), expected.size());
+  ASSERT_EQ(hashtable.GetSize(), 20000);
+  ASSERT_EQ(hashtable.snapshotEntries().size(), 20000u);
+}
+
+TEST(hashtable, snapshot_long_chain_test) {
+  s21::HashTable hashtable;
+  // Все ключи попадают в одну корзину, ее обход занимает несколько захватов
+  // блокировки
+  auto key = [](const std::string& prefix, int i) {
+    std::string res = prefix + std::to_string(i);
+    unsigned char sum = 0;
+    for (char c : res) sum += c;
+    return res + static_cast<char>(static_cast<unsigned char>(7 - sum));
+  };
+  std::map<std::string, int> expected;
+  for (int i = 0; i < 10000; ++i) {
+    hashtable.set(key("key", i), {"a", "b", 2000, "c", i});
+    expected[key("key", i)] = i;
+  }
+  std::atomic<bool> started{false};
+  std::thread writer([&]() {
+    while (!started.load()) std::this_thread::yield();
+    for (int i = 0; i < 10000; i += 2) {
+      hashtable.update(key("key", i), {"", "", 0, "", -1}, 0, s21::pCoins);
+      hashtable.del(key("key", i + 1));
+      hashtable.set(key("new", i), {"a", "b", 2000, "c", 0});
+      hashtable.rename(key("key", i), key("moved", i));
+    }
+  });
+  std::map<std::string, int> actual;
+  size_t written = 0;
+  hashtable.forEachEntry(
+      [&]() { started = true; },
+      [&](const s21::Key& k, const s21::Value& value, const s21::Deadline) {
+        actual[k] = value.coins;
+        ++written;
+      });
+  writer.join();
+
+  ASSERT_EQ(actual, expected);
+  ASSERT_EQ(written, expected.size());
+  ASSERT_EQ(hashtable.GetSize(), 10000);
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "../interface/interface.h"
+
+namespace {
+// Выполняет команды в хеш-таблице через меню и возвращает вывод интерфейса.
+// После каждой команды интерфейс ждет Enter, поэтому команды разделены
+// пустыми строками
+std::string RunCommands(const std::string& commands) {
+  std::istringstream in("1\n" + commands + "\nRETURN\n0\n");
+  std::ostringstream out;
+  std::streambuf* cinBuf = std::cin.rdbuf(in.rdbuf());
+  std::streambuf* coutBuf = std::cout.rdbuf(out.rdbuf());
+  s21::Interface().ShowMainMenu();
+  std::cin.rdbuf(cinBuf);
+  std::cout.rdbuf(coutBuf);
+  return out.str();
+}
+
+size_t CountOf(const std::string& text, const std::string& pattern) {
+  size_t res = 0;
+  for (size_t pos = text.find(pattern); pos != std::string::npos;
+       pos = text.find(pattern, pos + pattern.size()))
+    ++res;
+  return res;
+}
+
+const std::string WrongCommand = "Введенна некорректная команда!";
+}  // namespace
+
+TEST(interface, updateif_rejects_non_numeric_fields_test) {
+  const std::string output = RunCommands(
+      "UPDATEIF k 1 - - abc - -\n\n"
+      "UPDATEIF k 1 - - - - 1x\n\n"
+      "UPDATEIF k 1 - - 12345678901 - -\n\n"
+      "UPDATEIF k 1 - - -5 - 7\n");
+  ASSERT_EQ(CountOf(output, WrongCommand), 3u);
+  ASSERT_NE(output.find("ERROR\n"), std::string::npos);
+  ASSERT_NE(output.find("bye-bye"), std::string::npos);
+}
+
+TEST(interface, set_update_find_reject_non_numeric_fields_test) {
+  const std::string output = RunCommands(
+      "SET k a b 99999999999 c 1\n\n"
+      "SET k a b 2000 c 1x\n\n"
+      "UPDATE k - - abc - -\n\n"
+      "UPDATE k - - - - 99999999999\n\n"
+      "FIND - - abc - -\n\n"
+      "FIND - - - - 12345678901\n\n"
+      "SET k a b 2000 c 1\n\n"
+      "UPDATE k - - 1990 - -\n\n"
+      "FIND - - 1990 - -\n");
+  ASSERT_EQ(CountOf(output, WrongCommand), 6u);
+  ASSERT_EQ(CountOf(output, "OK\n"), 2u);
+  ASSERT_NE(output.find("1) k\n"), std::string::npos);
+  ASSERT_NE(output.find("bye-bye"), std::string::npos);
+}
+
+TEST(interface, mset_rejects_out_of_range_fields_test) {
+  const std::string output = RunCommands(
+      "MSET k a b 2000 c 12345678901\n\n"
+      "MSET k a b 2000 c 1 m a b 12345678901 c 1\n\n"
+      "MSET k a b 2000 c 1 m a b 1990 c 2\n");
+  ASSERT_EQ(CountOf(output, WrongCommand), 2u);
+  ASSERT_EQ(CountOf(output, ") OK\n"), 2u);
+  ASSERT_NE(output.find("bye-bye"), std::string::npos);
+}
+
+TEST(interface, get_prints_value_test) {
+  const std::string output = RunCommands(
+      "SET k Ivanov Ivan 2000 Moscow 10\n\n"
+      "GET k\n\n"
+      "GET missing\n");
+  ASSERT_NE(output.find("Ivanov Ivan 2000 Moscow 10\n"), std::string::npos);
+  ASSERT_NE(output.find("(null)\n"), std::string::npos);
+}
+
+TEST(interface, aggregate_dash_field_only_with_count_test) {
+  const std::string output = RunCommands(
+      "SET k Ivanov Ivan 2000 Moscow 10\n\n"
+      "AGGREGATE SUM - BY city\n\n"
+      "AGGREGATE MAX - BY city\n\n"
+      "AGGREGATE COUNT - BY city\n");
+  ASSERT_EQ(CountOf(output, WrongCommand), 2u);
+  ASSERT_NE(output.find("Group               | Result      | Count   |\n"
+                        "Moscow                1             1       \n"),
+            std::string::npos);
+}
+
+TEST(interface, expiring_histogram_test) {
+  const std::string output = RunCommands(
+      "SET a Ivanov Ivan 2000 Moscow 10 EX 3\n\n"
+      "SET b Petrov Petr 1990 Kazan 20 EX 8\n\n"
+      "EXPIRING 10 BY 5\n");
+  ASSERT_NE(output.find("Seconds             | Count   |\n"
+                        "0-5                   1       \n"
+                        "5-10                  1       \n"),
+            std::string::npos);
+}
+
+TEST(interface, sorted_table_range_test) {
+  const std::string table =
+      (std::filesystem::temp_directory_path() /
+       ("s21_interface_table_" + std::to_string(getpid())))
+          .string();
+  const std::string output = RunCommands(
+      "SET b Petrov Petr 1990 Kazan 20\n\n"
+      "SET a Ivanov Ivan 2000 Moscow 10\n\n"
+      "SET d Sidorov Sidr 1980 Omsk 30\n\n"
+      "BUILDTABLE " + table + "\n\n"
+      "RANGE a c\n\n"
+      "RETURN\n"
+      "5\n" + table + "\n"
+      "RANGE a c\n\n"
+      "SET c Smirnov Ivan 1970 Perm 40\n");
+  std::filesystem::remove(table);
+  ASSERT_NE(output.find("OK 3\n"), std::string::npos);
+  ASSERT_NE(output.find("ERROR: RANGE is supported only by the sorted table"),
+            std::string::npos);
+  ASSERT_NE(output.find("1) a Ivanov Ivan 2000 Moscow 10\n"
+                        "2) b Petrov Petr 1990 Kazan 20\n"),
+            std::string::npos);
+  ASSERT_NE(output.find("ERROR: read-only storage\n"), std::string::npos);
+}
+
+TEST(interface, versions_not_supported_by_disk_storage_test) {
+  std::filesystem::remove_all("s21_lsm_tree");
+  const std::string output = RunCommands(
+      "RETURN\n"
+      "3\n"
+      "SET a Ivanov Ivan 2000 Moscow 10\n\n"
+      "GETVER a\n\n"
+      "UPDATEIF a 0 Petrov - - - -\n\n"
+      "DELIF a 0\n\n"
+      "GET a\n");
+  std::filesystem::remove_all("s21_lsm_tree");
+  ASSERT_EQ(CountOf(output, "ERROR: versions not supported by this storage\n"),
+            3u);
+  ASSERT_EQ(output.find("version 0"), std::string::npos);
+  ASSERT_NE(output.find("Ivanov Ivan 2000 Moscow 10\n"), std::string::npos);
+}
@@ -0,0 +1,503 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../model/hash_table/hash_table.h"
+#include "../model/lsm_tree/lsm_tree.h"
+#include "../types.h"
+
+namespace {
+// Маленькие таблицы и файлы, чтобы тест строил несколько уровней
+s21::LsmTree::Options SmallOptions() {
+  s21::LsmTree::Options options;
+  options.memtableBytes = 16 << 10;
+  options.runBytes = 16 << 10;
+  options.levelZeroRuns = 2;
+  options.levelRatio = 4;
+  return options;
+}
+
+// Сохранение, которое собрало бы все записи в память, проваливает тест
+class StreamingLsmTree : public s21::LsmTree {
+ public:
+  StreamingLsmTree() : s21::LsmTree(SmallOptions()) {}
+
+ protected:
+  std::vector<s21::Entry> copyEntries(
+      const std::function<void()>& underLock) override {
+    ADD_FAILURE() << "entries copied into memory";
+    return s21::LsmTree::copyEntries(underLock);
+  }
+};
+}  // namespace
+
+TEST(lsm_tree, operations_test) {
+  s21::LsmTree lsm;
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  ASSERT_EQ(lsm.set("1", v), s21::noErrors);
+  ASSERT_EQ(lsm.set("1", v), s21::keyAlreadyExists);
+  ASSERT_EQ(lsm.set("2", v, 100), s21::noErrors);
+  ASSERT_EQ(lsm.get("1").value().city, "Moscow");
+  ASSERT_EQ(lsm.update("1", {"", "", 0, "Kazan", 0}, 0, s21::pCity),
+            s21::noErrors);
+  ASSERT_EQ(lsm.get("1").value().city, "Kazan");
+  ASSERT_EQ(lsm.get("1").value().coins, 10);
+  ASSERT_EQ(lsm.rename("1", "2"), s21::keyAlreadyExists);
+  ASSERT_EQ(lsm.rename("2", "3"), s21::noErrors);
+  ASSERT_FALSE(lsm.exists("2"));
+  ASSERT_EQ(lsm.Ttl("3"), 100);
+  lsm.flush();
+  ASSERT_EQ(lsm.del("1"), s21::noErrors);
+  ASSERT_EQ(lsm.del("1"), s21::keyNotFound);
+  ASSERT_EQ(lsm.keys(), std::vector<std::string>({"3"}));
+  ASSERT_EQ(lsm.find(v, 0, s21::pCity), std::vector<std::string>({"3"}));
+  ASSERT_EQ(lsm.GetSize(), 1);
+}
+
+TEST(lsm_tree, compaction_test) {
+  s21::LsmTree lsm(SmallOptions());
+  std::map<std::string, int> expected;
+  std::mt19937 gen(42);
+  for (int i = 0; i < 20000; ++i) {
+    const std::string key = "key" + std::to_string(gen() % 5000);
+    const int coins = static_cast<int>(gen() % 1000);
+    if (coins < 200) {
+      ASSERT_EQ(lsm.del(key),
+                expected.erase(key) ? s21::noErrors : s21::keyNotFound);
+    } else if (expected.count(key)) {
+      ASSERT_EQ(lsm.update(key, {"", "", 0, "", coins}, 0, s21::pCoins),
+                s21::noErrors);
+      expected[key] = coins;
+    } else {
+      ASSERT_EQ(lsm.set(key, {"a", "b", 2000, "c", coins}), s21::noErrors);
+      expected[key] = coins;
+    }
+  }
+  ASSERT_TRUE(lsm.flush());
+  std::vector<size_t> runs = lsm.runsPerLevel();
+  ASSERT_GE(runs.size(), 3u);
+  ASSERT_LT(runs[0], SmallOptions().levelZeroRuns);
+
+  ASSERT_EQ(lsm.GetSize(), static_cast<int>(expected.size()));
+  for (int i = 0; i < 5000; ++i) {
+    const std::string key = "key" + std::to_string(i);
+    auto value = lsm.get(key);
+    ASSERT_EQ(value.has_value(), expected.count(key) > 0);
+    if (value) {
+      ASSERT_EQ(value->coins, expected[key]);
+    }
+  }
+  std::vector<std::string> keys;
+  for (const auto& row : expected) keys.push_back(row.first);
+  ASSERT_EQ(lsm.keys(), keys);
+}
+
+TEST(lsm_tree, bloom_filter_test) {
+  // Без фильтров и с ними ответы одинаковые
+  for (const double rate : {0.0, 0.01}) {
+    s21::LsmTree::Options options = SmallOptions();
+    options.bloomFalsePositiveRate = rate;
+    s21::LsmTree lsm(options);
+    for (int i = 0; i < 5000; ++i)
+      ASSERT_EQ(lsm.set("key" + std::to_string(i), {"a", "b", 2000, "c", i}),
+                s21::noErrors);
+    for (int i = 0; i < 5000; i += 3)
+      ASSERT_EQ(lsm.del("key" + std::to_string(i)), s21::noErrors);
+    lsm.flush();
+    for (int i = 0; i < 5000; ++i) {
+      ASSERT_EQ(lsm.exists("key" + std::to_string(i)), i % 3 != 0);
+      ASSERT_FALSE(lsm.exists("key" + std::to_string(i) + "_"));
+    }
+  }
+}
+
+TEST(lsm_tree, batch_test) {
+  s21::LsmTree lsm(SmallOptions());
+  std::vector<std::pair<s21::Key, s21::Value>> values;
+  for (int i = 0; i < 2000; ++i)
+    values.push_back({"key" + std::to_string(i), {"a", "b", 2000, "c", i}});
+  auto res = lsm.mset(values);
+  ASSERT_EQ(std::count(res.begin(), res.end(), s21::noErrors), 2000);
+  ASSERT_EQ(lsm.mset({{"key1", values[0].second}})[0], s21::keyAlreadyExists);
+  ASSERT_GT(lsm.runsPerLevel().size(), 1u);
+
+  auto found = lsm.mget({"key5", "nokey", "key1999"});
+  ASSERT_EQ(found[0].value().coins, 5);
+  ASSERT_FALSE(found[1].has_value());
+  ASSERT_EQ(found[2].value().coins, 1999);
+
+  std::vector<s21::Key> keys;
+  for (int i = 0; i < 2000; i += 2) keys.push_back("key" + std::to_string(i));
+  res = lsm.mdel(keys);
+  ASSERT_EQ(std::count(res.begin(), res.end(), s21::noErrors), 1000);
+  ASSERT_EQ(lsm.GetSize(), 1000);
+  ASSERT_FALSE(lsm.exists("key0"));
+  ASSERT_TRUE(lsm.exists("key1"));
+}
+
+TEST(lsm_tree, incrby_test) {
+  s21::LsmTree lsm(SmallOptions());
+  for (int i = 0; i < 2000; ++i)
+    lsm.set("key" + std::to_string(i), {"a", "b", 2000, "c", i});
+  ASSERT_GT(lsm.runsPerLevel().size(), 1u);
+  int result = 0;
+  ASSERT_EQ(lsm.incrBy("key3", s21::pCoins, 10, result), s21::noErrors);
+  ASSERT_EQ(result, 13);
+  ASSERT_EQ(lsm.incrBy("key3", s21::pCoins, 10, result), s21::noErrors);
+  ASSERT_EQ(result, 23);
+  ASSERT_EQ(lsm.get("key3").value().coins, 23);
+  ASSERT_EQ(lsm.incrBy("nokey", s21::pCoins, 1, result), s21::keyNotFound);
+}
+
+TEST(lsm_tree, version_test) {
+  s21::LsmTree lsm(SmallOptions());
+  s21::Value v{"a", "b", 2000, "c", 1};
+  lsm.set("key", v);
+  // LSM-дерево версий не ведет
+  ASSERT_FALSE(lsm.SupportsVersions());
+  ASSERT_EQ(lsm.getVersioned("key")->version, 0u);
+  ASSERT_EQ(lsm.updateIfVersion("key", v, 0, s21::pCoins, 0),
+            s21::versionsNotSupported);
+  ASSERT_EQ(lsm.delIfVersion("key", 0), s21::versionsNotSupported);
+  ASSERT_TRUE(lsm.exists("key"));
+}
+
+TEST(lsm_tree, visit_test) {
+  s21::LsmTree lsm(SmallOptions());
+  for (int i = 0; i < 1000; ++i)
+    lsm.set("key" + std::to_string(i), {"a", "b", 2000, "c", i});
+  ASSERT_EQ(lsm.del("key7"), s21::noErrors);
+  ASSERT_EQ(lsm.set("key8", {"a", "b", 2000, "c", 0}),
+            s21::keyAlreadyExists);
+  // Старые ключи уже в файлах, последние - в таблице в памяти
+  long long sum = 0;
+  for (int i = 0; i < 1000; ++i)
+    lsm.visit("key" + std::to_string(i),
+              [&sum](const s21::Value& value) { sum += value.coins; });
+  ASSERT_EQ(sum, 999 * 1000 / 2 - 7);
+  ASSERT_FALSE(lsm.visit("key7", [](const s21::Value&) {}));
+}
+
+TEST(lsm_tree, ttl_test) {
+  s21::LsmTree lsm(SmallOptions());
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  for (int i = 0; i < 1000; ++i)
+    ASSERT_EQ(lsm.set("key" + std::to_string(i), v,
+                      std::chrono::milliseconds(i % 2 ? 50 : 0)),
+              s21::noErrors);
+  lsm.flush();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_FALSE(lsm.exists("key1"));
+  ASSERT_TRUE(lsm.exists("key2"));
+  ASSERT_EQ(lsm.keys().size(), 500u);
+  ASSERT_EQ(lsm.set("key1", v), s21::noErrors);
+  ASSERT_EQ(lsm.Ttl("key1"), s21::hasNoTtl);
+}
+
+TEST(lsm_tree, read_expired_from_runs_test) {
+  s21::LsmTree lsm(SmallOptions());
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  for (int i = 0; i < 1000; ++i)
+    ASSERT_EQ(lsm.set("key" + std::to_string(i), v,
+                      std::chrono::milliseconds(i % 2 ? 50 : 0)),
+              s21::noErrors);
+  ASSERT_TRUE(lsm.flush());
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  // Записи читаются из файлов без блокировки, а истекшие удаляются под ней
+  // один раз, даже если ключ запрошен дважды
+  auto found = lsm.mget({"key1", "key2", "key1", "key3"});
+  ASSERT_FALSE(found[0].has_value());
+  ASSERT_EQ(found[1].value().coins, 10);
+  ASSERT_FALSE(found[2].has_value());
+  ASSERT_FALSE(found[3].has_value());
+  ASSERT_FALSE(lsm.get("key5").has_value());
+  ASSERT_EQ(lsm.PTtl("key7"), s21::keyNotFound);
+  ASSERT_TRUE(lsm.get("key4").has_value());
+  ASSERT_LE(lsm.GetSize(), 997);
+  ASSERT_EQ(lsm.keys().size(), 500u);
+}
+
+TEST(lsm_tree, upload_concurrent_writes_test) {
+  const int rowsCount = 20000;
+  {
+    std::ofstream fout("examples/test.txt");
+    for (int i = 0; i < rowsCount; ++i)
+      fout << "key" << i << " \"Ivanov\" \"Ivan\" 1950 \"Moscow\" " << i
+           << "\n";
+  }
+  s21::LsmTree lsm(SmallOptions());
+  std::thread loader(
+      [&] { ASSERT_EQ(lsm.upload("examples/test.txt"), rowsCount); });
+  // Загрузка отпускает блокировку между пакетами, и запись не ждет ее конца
+  for (int i = 0; i < 1000; ++i)
+    lsm.set("other" + std::to_string(i), {"a", "b", 2000, "c", i});
+  loader.join();
+  ASSERT_EQ(lsm.GetSize(), rowsCount + 1000);
+  ASSERT_EQ(lsm.get("key19999").value().coins, 19999);
+  ASSERT_EQ(lsm.get("other999").value().coins, 999);
+}
+
+TEST(lsm_tree, expiry_flushes_memtable_test) {
+  // Уровень 0 не сливается, поэтому каждый сброс добавляет в него файл
+  s21::LsmTree::Options options = SmallOptions();
+  options.levelZeroRuns = 100;
+  s21::LsmTree lsm(options);
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  for (int i = 0; i < 2000; ++i)
+    ASSERT_EQ(lsm.set("key" + std::to_string(i), v,
+                      std::chrono::milliseconds(100)),
+              s21::noErrors);
+  ASSERT_TRUE(lsm.flush());
+  const size_t runsBefore = lsm.runsPerLevel()[0];
+  // Отметки об удалении, которые пишет удаление по времени, сбрасываются на
+  // диск без записей от пользователя
+  const auto until = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while ((lsm.GetSize() > 0 || lsm.runsPerLevel()[0] == runsBefore) &&
+         std::chrono::steady_clock::now() < until)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_EQ(lsm.GetSize(), 0);
+  ASSERT_GT(lsm.runsPerLevel()[0], runsBefore);
+}
+
+TEST(lsm_tree, concurrent_set_del_ttl_test) {
+  s21::LsmTree lsm(SmallOptions());
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  // Пакетная запись отпускает блокировку между ключами, пока ждет сброса
+  // таблицы, и все равно не должна путать сроки с одиночными операциями
+  std::vector<std::thread> writers;
+  for (int t = 0; t < 4; ++t) {
+    writers.emplace_back([&, t]() {
+      for (int round = 0; round < 100; ++round) {
+        for (int i = 0; i < 8; ++i) {
+          const std::string key = std::to_string(i);
+          if (t % 2) {
+            lsm.mset({{key, v}}, std::chrono::seconds(10));
+            lsm.mdel({key});
+          } else {
+            lsm.set(key, v, 10);
+            lsm.del(key);
+          }
+          lsm.set(key, v, 100);
+        }
+      }
+    });
+  }
+  for (auto& writer : writers) writer.join();
+  std::vector<std::string> keys = lsm.expiringWithin(std::chrono::seconds(200));
+  std::vector<std::string> stored = lsm.keys();
+  std::sort(keys.begin(), keys.end());
+  std::sort(stored.begin(), stored.end());
+  ASSERT_EQ(keys, stored);
+}
+
+TEST(lsm_tree, snapshot_consistency_test) {
+  s21::LsmTree lsm(SmallOptions());
+  std::map<std::string, int> expected;
+  for (int i = 0; i < 20000; ++i) {
+    lsm.set("key" + std::to_string(i), {"a", "b", 2000, "c", i});
+    expected["key" + std::to_string(i)] = i;
+  }
+  std::atomic<bool> started{false};
+  std::thread writer([&]() {
+    while (!started.load()) std::this_thread::yield();
+    for (int i = 0; i < 20000; i += 2) {
+      lsm.update("key" + std::to_string(i), {"", "", 0, "", -1}, 0,
+                 s21::pCoins);
+      lsm.del("key" + std::to_string(i + 1));
+      lsm.set("new" + std::to_string(i), {"a", "b", 2000, "c", 0});
+    }
+  });
+  auto entries = lsm.snapshotEntries([&]() { started = true; });
+  writer.join();
+
+  std::map<std::string, int> actual;
+  for (const auto& entry : entries) actual[entry.key] = entry.value.coins;
+  ASSERT_EQ(actual, expected);
+  ASSERT_EQ(lsm.GetSize(), 20000);
+  ASSERT_EQ(lsm.snapshotEntries().size(), 20000u);
+}
+
+TEST(lsm_tree, streaming_persistence_test) {
+  const std::string exportName = "examples/test_lsm.txt";
+  const std::string checkpointName = "examples/test_lsm.snap";
+  const std::string logName = "examples/test_lsm.aof";
+  std::remove(checkpointName.c_str());
+  std::remove(logName.c_str());
+  StreamingLsmTree lsm;
+  for (int i = 0; i < 5000; ++i)
+    lsm.set("key" + std::to_string(i), {"a", "b", 2000, "c", i});
+  lsm.flush();
+  lsm.set("fresh", {"a", "b", 2000, "c", -1}, 100);
+  ASSERT_EQ(lsm.exportValues(exportName, s21::binaryFormat), 5001);
+  ASSERT_EQ(lsm.checkpoint(checkpointName), 5001);
+  ASSERT_EQ(lsm.EnableLog(logName, s21::fsyncGroupCommit), 0);
+  ASSERT_EQ(lsm.RewriteLog(), 5001);
+  lsm.DisableLog();
+
+  s21::HashTable uploaded;
+  ASSERT_EQ(uploaded.upload(exportName), 5001);
+  s21::HashTable restored;
+  ASSERT_EQ(restored.restoreCheckpoint(checkpointName), 5001);
+  ASSERT_EQ(restored.get("key4999").value().coins, 4999);
+  s21::HashTable replayed;
+  ASSERT_EQ(replayed.EnableLog(logName), 5001);
+  ASSERT_GT(replayed.Ttl("fresh"), 0);
+  replayed.DisableLog();
+  std::remove(exportName.c_str());
+  std::remove(checkpointName.c_str());
+  std::remove(logName.c_str());
+}
+
+TEST(lsm_tree, reopen_test) {
+  s21::LsmTree::Options options = SmallOptions();
+  options.directory = (std::filesystem::temp_directory_path() /
+                       ("s21_lsm_reopen_" + std::to_string(getpid())))
+                          .string();
+  std::filesystem::remove_all(options.directory);
+  {
+    s21::LsmTree lsm(options);
+    for (int i = 0; i < 5000; ++i)
+      lsm.set("key" + std::to_string(i), {"a", "b", 2000, "c", i});
+    for (int i = 0; i < 5000; i += 3) lsm.del("key" + std::to_string(i));
+    lsm.set("ttl", {"a", "b", 2000, "c", 0}, 100);
+    lsm.flush();
+    // Изменение в таблице в памяти сбрасывается при закрытии
+    lsm.update("key1", {"", "", 0, "", -1}, 0, s21::pCoins);
+  }
+  ASSERT_TRUE(std::filesystem::exists(options.directory + "/MANIFEST"));
+  {
+    s21::LsmTree lsm(options);
+    ASSERT_GT(lsm.runsPerLevel().size(), 1u);
+    ASSERT_EQ(lsm.GetSize(), 3334);
+    ASSERT_EQ(lsm.get("key1").value().coins, -1);
+    ASSERT_EQ(lsm.get("key4999").value().coins, 4999);
+    ASSERT_FALSE(lsm.exists("key0"));
+    ASSERT_GT(lsm.Ttl("ttl"), 0);
+    ASSERT_LE(lsm.Ttl("ttl"), 100);
+    ASSERT_EQ(lsm.set("key2", {"a", "b", 2000, "c", 0}),
+              s21::keyAlreadyExists);
+    ASSERT_EQ(lsm.set("new", {"a", "b", 2000, "c", 0}), s21::noErrors);
+  }
+  {
+    s21::LsmTree lsm(options);
+    ASSERT_EQ(lsm.GetSize(), 3335);
+    ASSERT_TRUE(lsm.exists("new"));
+  }
+  std::filesystem::remove_all(options.directory);
+}
+
+TEST(lsm_tree, run_checksum_test) {
+  const std::string fileName =
+      (std::filesystem::temp_directory_path() /
+       ("s21_run_" + std::to_string(getpid()) + ".run"))
+          .string();
+  {
+    s21::SortedRun::Builder builder(fileName, 0.01);
+    for (int i = 0; i < 1000; ++i)
+      builder.Add("key" + std::to_string(1000 + i),
+                  {false, {"a", "b", 2000, "c", i}, s21::NoDeadline});
+    ASSERT_EQ(builder.Finish()->Get("key1500").value().value.coins, 500);
+  }
+  // Байт в первом блоке: открытие читает только индекс, а чтение блока
+  // проверяет его сумму
+  {
+    std::fstream file(fileName, std::ios::binary | std::ios::in |
+                                    std::ios::out);
+    file.seekp(10);
+    file.put('#');
+  }
+  auto run = s21::SortedRun::Open(fileName, 0.01);
+  ASSERT_EQ(run->Get("key1999").value().value.coins, 999);
+  try {
+    run->Get("key1000");
+    FAIL() << "corrupted block read";
+  } catch (const std::runtime_error& error) {
+    ASSERT_NE(std::string(error.what()).find("Corrupted"), std::string::npos);
+  }
+  s21::LsmRecord record;
+  s21::SortedRun::Cursor cursor(run);
+  ASSERT_THROW(cursor.Next(record), std::runtime_error);
+  run->MarkObsolete();
+
+  // Хранилище не выпускает ошибку блока из операций и фоновых потоков
+  s21::LsmTree::Options options = SmallOptions();
+  options.directory = (std::filesystem::temp_directory_path() /
+                       ("s21_lsm_checksum_" + std::to_string(getpid())))
+                          .string();
+  std::filesystem::remove_all(options.directory);
+  {
+    s21::LsmTree lsm(options);
+    for (int i = 0; i < 1000; ++i)
+      lsm.set("key" + std::to_string(1000 + i), {"a", "b", 2000, "c", i});
+    ASSERT_TRUE(lsm.flush());
+  }
+  // Первый блок каждого файла, key1000 лежит в одном из них
+  for (const auto& file :
+       std::filesystem::directory_iterator(options.directory)) {
+    if (file.path().extension() != ".run") continue;
+    std::fstream data(file.path(),
+                      std::ios::binary | std::ios::in | std::ios::out);
+    data.seekp(10);
+    data.put('#');
+  }
+  {
+    s21::LsmTree lsm(options);
+    ASSERT_FALSE(lsm.get("key1000").has_value());
+    ASSERT_FALSE(lsm.exists("key1000"));
+    ASSERT_EQ(lsm.del("key1000"), s21::keyNotFound);
+    ASSERT_EQ(lsm.expireBatch({"key1000"}), 0u);
+    ASSERT_LT(lsm.keys().size(), 1000u);
+    ASSERT_LT(lsm.showall().size(), 1000u);
+    ASSERT_EQ(lsm.set("key1000", {"a", "b", 2000, "c", -1}), s21::noErrors);
+    ASSERT_EQ(lsm.get("key1000").value().coins, -1);
+  }
+  std::filesystem::remove_all(options.directory);
+}
+
+TEST(lsm_tree, reopen_statistics_test) {
+  s21::LsmTree::Options options = SmallOptions();
+  options.directory = (std::filesystem::temp_directory_path() /
+                       ("s21_lsm_statistics_" + std::to_string(getpid())))
+                          .string();
+  std::filesystem::remove_all(options.directory);
+  {
+    s21::LsmTree lsm(options);
+    for (int i = 0; i < 3000; ++i)
+      lsm.set("key" + std::to_string(i), {"a", "b", 2000, "Moscow", i});
+  }
+  {
+    s21::LsmTree lsm(options);
+    // Число записей берется из MANIFEST, а статистика считается в фоне,
+    // пока операции меняют записи
+    ASSERT_EQ(lsm.GetSize(), 3000);
+    ASSERT_EQ(lsm.update("key2999", {"", "", 0, "Kazan", 0}, 0, s21::pCity),
+              s21::noErrors);
+    ASSERT_EQ(lsm.rename("key2998", "moved"), s21::noErrors);
+    ASSERT_EQ(lsm.del("key2997"), s21::noErrors);
+    ASSERT_EQ(lsm.set("new", {"a", "b", 2000, "Moscow", 0}), s21::noErrors);
+    ASSERT_EQ(lsm.GetSize(), 3000);
+    std::vector<s21::HeavyHitter> top;
+    for (int i = 0; i < 500; ++i) {
+      top = lsm.TopK(s21::pCity, 2);
+      if (top.size() == 2 && top[0].count == 2999) break;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(top.size(), 2u);
+    ASSERT_EQ(top[0].value, "Moscow");
+    ASSERT_EQ(top[0].count, 2999);
+    ASSERT_EQ(top[1].value, "Kazan");
+    ASSERT_EQ(top[1].count, 1);
+  }
+  std::filesystem::remove_all(options.directory);
+}
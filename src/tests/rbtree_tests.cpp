@@ -1,7 +1,10 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <climits>
 #include <map>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "../model/self_balancing_binary_search_tree/self_balancing_binary_search_tree.h"
@@ -176,6 +179,113 @@ TEST(rbtree, ttl_test) {
   ASSERT_EQ(tree.Ttl("100"), s21::keyNotFound);
 }
 
+TEST(rbtree, batch_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  fillTree(tree);
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  auto res = tree.mset({{"1", v}, {"10", v}, {"2", v}, {"1", v}}, 100);
+  ASSERT_EQ(res, std::vector<s21::Errors>({s21::noErrors, s21::keyAlreadyExists,
+                                           s21::noErrors,
+                                           s21::keyAlreadyExists}));
+  ASSERT_EQ(tree.Ttl("1"), 100);
+  ASSERT_EQ(tree.Ttl("10"), s21::hasNoTtl);
+  ASSERT_EQ(tree.expiringWithin(std::chrono::seconds(100)),
+            std::vector<std::string>({"1", "2"}));
+
+  auto values = tree.mget({"2", "nokey", "10"});
+  ASSERT_EQ(values.size(), 3u);
+  ASSERT_EQ(values[0].value().city, "Moscow");
+  ASSERT_FALSE(values[1].has_value());
+  ASSERT_EQ(values[2].value().city, "qwe");
+
+  ASSERT_EQ(tree.mdel({"1", "nokey", "10", "1"}),
+            std::vector<s21::Errors>({s21::noErrors, s21::keyNotFound,
+                                      s21::noErrors, s21::keyNotFound}));
+  ASSERT_EQ(tree.expiringWithin(std::chrono::seconds(100)),
+            std::vector<std::string>({"2"}));
+  ASSERT_EQ(tree.GetSize(), 15);
+}
+
+TEST(rbtree, visit_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  fillTree(tree);
+  int visited = 0;
+  // Посетитель получает ссылку на значение в узле, а не копию
+  const s21::Value* first = nullptr;
+  const s21::Value* second = nullptr;
+  ASSERT_TRUE(tree.visit("10", [&](const s21::Value& value) {
+    ASSERT_EQ(value.city, "qwe");
+    first = &value;
+    ++visited;
+  }));
+  ASSERT_TRUE(tree.visit("10", [&](const s21::Value& value) {
+    second = &value;
+    ++visited;
+  }));
+  ASSERT_NE(first, nullptr);
+  ASSERT_EQ(first, second);
+
+  ASSERT_FALSE(tree.visit("nokey", [&visited](const s21::Value&) {
+    ++visited;
+  }));
+  ASSERT_EQ(tree.set("ttl", s21::Value(), std::chrono::milliseconds(50)),
+            s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_FALSE(tree.visit("ttl", [&visited](const s21::Value&) {
+    ++visited;
+  }));
+  ASSERT_EQ(visited, 2);
+}
+
+TEST(rbtree, incrby_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  ASSERT_EQ(tree.set("1", v, 100), s21::noErrors);
+  int result = 0;
+  ASSERT_EQ(tree.incrBy("1", s21::pCoins, -25, result), s21::noErrors);
+  ASSERT_EQ(result, -15);
+  ASSERT_EQ(tree.incrBy("1", s21::pYear, 5, result), s21::noErrors);
+  ASSERT_EQ(result, 2005);
+  auto value = tree.get("1");
+  ASSERT_EQ(value.value().coins, -15);
+  ASSERT_EQ(value.value().year, 2005);
+  ASSERT_EQ(tree.Ttl("1"), 100);
+  ASSERT_EQ(tree.incrBy("2", s21::pCoins, 1, result), s21::keyNotFound);
+  ASSERT_EQ(tree.incrBy("1", s21::pCoins, INT_MIN, result),
+            s21::valueOutOfRange);
+  ASSERT_EQ(tree.get("1").value().coins, -15);
+}
+
+TEST(rbtree, version_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  fillTree(tree);
+  std::map<std::string, uint64_t> versions;
+  for (const auto& key : tree.keys())
+    versions[key] = tree.getVersioned(key)->version;
+  // Удаление узла с двумя потомками переносит в него соседнюю запись
+  // вместе с ее версией
+  ASSERT_EQ(tree.delIfVersion(tree.keys()[0], 0), s21::versionMismatch);
+  const std::string root = tree.keys()[tree.keys().size() / 2];
+  ASSERT_EQ(tree.delIfVersion(root, versions[root]), s21::noErrors);
+  for (const auto& key : tree.keys())
+    ASSERT_EQ(tree.getVersioned(key)->version, versions[key]);
+
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  const std::string key = tree.keys()[0];
+  ASSERT_EQ(tree.updateIfVersion(key, v, 100, s21::pName | s21::pTtl,
+                                 versions[key]),
+            s21::noErrors);
+  ASSERT_EQ(tree.Ttl(key), 100);
+  ASSERT_EQ(tree.updateIfVersion(key, v, 0, s21::pCity, versions[key]),
+            s21::versionMismatch);
+  int result = 0;
+  const uint64_t updated = tree.getVersioned(key)->version;
+  ASSERT_EQ(tree.incrBy(key, s21::pCoins, 1, result), s21::noErrors);
+  ASSERT_GT(tree.getVersioned(key)->version, updated);
+  ASSERT_EQ(tree.updateIfVersion("nokey", v, 0, s21::pCity, updated),
+            s21::keyNotFound);
+}
+
 TEST(rbtree, upload_good_test) {
   s21::SelfBalancingBinarySearchTree tree;
   fillTree(tree);
@@ -227,6 +337,7 @@ TEST(rbtree, upload_corrupted_file_test) {
   std::vector<s21::Value> oldValues = tree.showall();
 
   ASSERT_EQ(tree.upload("examples/corrupted.txt"), s21::corruptedFile);
+  ASSERT_EQ(tree.UploadErrorLine(), 2);
 
   std::vector<std::string> newKeys = tree.keys();
   ASSERT_EQ(oldKeys.size(), newKeys.size());
@@ -245,6 +356,19 @@ TEST(rbtree, upload_corrupted_file_test) {
   }
 }
 
+TEST(rbtree, bulk_insert_over_expired_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  s21::Value v{"asd", "zxc", 2000, "Moscow", 1};
+  ASSERT_EQ(tree.set("0", v, std::chrono::milliseconds(1)), s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  // Истекший ключ заменяется новой записью, которая тоже считается
+  std::vector<std::pair<s21::Key, s21::Value>> values;
+  for (int i = 0; i < 40000; ++i) values.push_back({std::to_string(i), v});
+  values.push_back({"1", v});
+  ASSERT_EQ(tree.bulkInsert(values), 40000u);
+  ASSERT_EQ(tree.GetSize(), 40000);
+}
+
 TEST(rbtree, upload_empty_file_test) {
   s21::SelfBalancingBinarySearchTree tree;
   fillTree(tree);
@@ -253,6 +377,7 @@ TEST(rbtree, upload_empty_file_test) {
   std::vector<s21::Value> oldValues = tree.showall();
 
   ASSERT_EQ(tree.upload("examples/empty.txt"), s21::corruptedFile);
+  ASSERT_EQ(tree.UploadErrorLine(), 2);
 
   std::vector<std::string> newKeys = tree.keys();
   ASSERT_EQ(oldKeys.size(), newKeys.size());
@@ -323,4 +448,307 @@ TEST(rbtree, find_test) {
   for (size_t i = 0; i < foundKeys.size(); ++i) {
     ASSERT_STREQ(expKeys[i].c_str(), foundKeys[i].c_str());
   }
-}
\ No newline at end of file
+}
+
+TEST(rbtree, aggregate_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  s21::Value v;
+  v.lastname = "asd";
+  v.name = "zxc";
+  v.year = 2000;
+  v.city = "Moscow";
+  v.coins = 10;
+  tree.set("1", v);
+  v.coins = 30;
+  tree.set("2", v);
+  v.city = "Kazan";
+  v.coins = 5;
+  tree.set("3", v);
+  v.year = 1990;
+  tree.set("4", v);
+
+  s21::AggregateQuery query{s21::aggSum, s21::pCoins, s21::pCity, s21::Value(),
+                            0, 0};
+  std::vector<s21::AggregateRow> rows = tree.aggregate(query);
+  ASSERT_EQ(rows.size(), 2);
+  ASSERT_STREQ(rows[0].group.c_str(), "Kazan");
+  ASSERT_EQ(rows[0].result, 10);
+  ASSERT_EQ(rows[0].count, 2);
+  ASSERT_STREQ(rows[1].group.c_str(), "Moscow");
+  ASSERT_EQ(rows[1].result, 40);
+
+  query.function = s21::aggMax;
+  query.groupBy = 0;
+  query.filter.year = 2000;
+  query.paramsMask = s21::pYear;
+  rows = tree.aggregate(query);
+  ASSERT_EQ(rows.size(), 1);
+  ASSERT_EQ(rows[0].result, 30);
+  ASSERT_EQ(rows[0].count, 3);
+}
+
+TEST(rbtree, aggregate_batches_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  s21::Value v{"asd", "zxc", 2000, "Moscow", 1};
+  for (int i = 0; i < 10000; ++i) tree.set(std::to_string(i), v);
+
+  s21::AggregateQuery query{s21::aggSum, s21::pCoins, 0, s21::Value(), 0, 0};
+  std::vector<s21::AggregateRow> rows = tree.aggregate(query);
+  ASSERT_EQ(rows.size(), 1);
+  ASSERT_EQ(rows[0].result, 10000);
+  ASSERT_EQ(rows[0].count, 10000);
+}
+
+TEST(rbtree, aggregate_during_renames_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  s21::Value v{"asd", "zxc", 2000, "Moscow", 1};
+  for (int i = 0; i < 10000; ++i) tree.set("a" + std::to_string(i), v);
+
+  // Обход идет пакетами, записи переезжают через его позицию и обратно,
+  // сумма не меняется
+  std::atomic<bool> stop{false};
+  std::thread renamer([&]() {
+    while (!stop.load()) {
+      for (int i = 0; i < 10000; i += 7) {
+        tree.rename("a" + std::to_string(i), "z" + std::to_string(i));
+        tree.rename("z" + std::to_string(i), "a" + std::to_string(i));
+      }
+    }
+  });
+  s21::AggregateQuery query{s21::aggSum, s21::pCoins, 0, s21::Value(), 0, 0};
+  for (int round = 0; round < 10; ++round) {
+    std::vector<s21::AggregateRow> rows = tree.aggregate(query);
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0].result, 10000);
+    EXPECT_EQ(rows[0].count, 10000);
+  }
+  stop = true;
+  renamer.join();
+}
+
+TEST(rbtree, aggregate_parallel_during_renames_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  tree.SetWorkersCount(4);
+  s21::Value v{"asd", "zxc", 2000, "Moscow", 1};
+  for (int i = 0; i < 2000; ++i) {
+    v.city = i % 2 ? "Moscow" : "Kazan";
+    tree.set("a" + std::to_string(i), v);
+  }
+
+  // Записи переезжают между диапазонами разных потоков обхода
+  std::atomic<bool> stop{false};
+  std::thread renamer([&]() {
+    while (!stop.load()) {
+      for (int i = 0; i < 2000; i += 7) {
+        tree.rename("a" + std::to_string(i), "z" + std::to_string(i));
+        tree.rename("z" + std::to_string(i), "a" + std::to_string(i));
+      }
+    }
+  });
+  s21::AggregateQuery query{s21::aggSum, s21::pCoins, s21::pCity,
+                            s21::Value(), 0, 0};
+  for (int round = 0; round < 10; ++round) {
+    std::vector<s21::AggregateRow> rows = tree.aggregate(query);
+    ASSERT_EQ(rows.size(), 2);
+    EXPECT_EQ(rows[0].result, 1000);
+    EXPECT_EQ(rows[1].result, 1000);
+  }
+  stop = true;
+  renamer.join();
+}
+
+TEST(rbtree, aggregate_during_export_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  tree.SetWorkersCount(4);
+  s21::Value v{"asd", "zxc", 2000, "Moscow", 3};
+  for (int i = 0; i < 1000; ++i) tree.set(std::to_string(i), v);
+
+  // Выгрузка держит snapshotView_, aggregate не ждет ее окончания
+  std::atomic<bool> writing{false};
+  std::atomic<bool> aggregated{false};
+  std::thread exporter([&]() {
+    tree.forEachEntry(
+        []() {},
+        [&](const s21::Key&, const s21::Value&, const s21::Deadline) {
+          writing = true;
+          while (!aggregated.load()) std::this_thread::yield();
+        });
+  });
+  while (!writing.load()) std::this_thread::yield();
+  s21::AggregateQuery query{s21::aggSum, s21::pCoins, 0, s21::Value(), 0, 0};
+  std::vector<s21::AggregateRow> rows = tree.aggregate(query);
+  aggregated = true;
+  exporter.join();
+  ASSERT_EQ(rows.size(), 1);
+  ASSERT_EQ(rows[0].result, 3000);
+  ASSERT_EQ(rows[0].count, 1000);
+}
+
+TEST(rbtree, ttl_ms_expiry_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  s21::Value v;
+  ASSERT_EQ(tree.set("1", v, std::chrono::milliseconds(100)), s21::noErrors);
+  ASSERT_EQ(tree.set("2", v, std::chrono::milliseconds(5000)), s21::noErrors);
+  ASSERT_EQ(tree.set("3", v), s21::noErrors);
+  ASSERT_GT(tree.PTtl("1"), 0);
+  ASSERT_LE(tree.PTtl("1"), 100);
+  ASSERT_EQ(tree.Ttl("2"), 5);
+  ASSERT_EQ(tree.PTtl("3"), s21::hasNoTtl);
+
+  ASSERT_EQ(tree.update("2", v, std::chrono::milliseconds(150), s21::pTtl),
+            s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(400));
+  ASSERT_FALSE(tree.exists("1"));
+  ASSERT_FALSE(tree.exists("2"));
+  ASSERT_TRUE(tree.exists("3"));
+}
+
+TEST(rbtree, huge_ttl_test) {
+  s21::SelfBalancingBinarySearchTree store;
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  // Срок дальше представимого steady_clock не переполняется в прошлое
+  ASSERT_EQ(store.set("ex", v, std::chrono::seconds(10000000000LL)),
+            s21::noErrors);
+  ASSERT_EQ(store.set("max", v, std::chrono::milliseconds(LLONG_MAX)),
+            s21::noErrors);
+  for (const auto& key : {"ex", "max"}) {
+    ASSERT_TRUE(store.exists(key));
+    ASSERT_GT(store.PTtl(key), 0);
+    ASSERT_EQ(store.Ttl(key), INT_MAX);
+  }
+}
+
+TEST(rbtree, expired_key_reuse_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  s21::Value v;
+  ASSERT_EQ(tree.set("1", v, std::chrono::milliseconds(50)), s21::noErrors);
+  ASSERT_EQ(tree.set("2", v, std::chrono::milliseconds(50)), s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_FALSE(tree.get("1").has_value());
+  ASSERT_TRUE(tree.keys().empty());
+  ASSERT_EQ(tree.set("2", v), s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_TRUE(tree.exists("2"));
+  ASSERT_EQ(tree.Ttl("2"), s21::hasNoTtl);
+}
+
+TEST(rbtree, expire_batch_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  s21::Value v;
+  for (int i = 0; i < 10; ++i)
+    ASSERT_EQ(tree.set(std::to_string(i), v, std::chrono::milliseconds(50)),
+              s21::noErrors);
+  ASSERT_EQ(tree.set("alive", v, std::chrono::milliseconds(5000)),
+            s21::noErrors);
+  ASSERT_EQ(tree.set("forever", v), s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  std::vector<std::string> batch = {"alive", "forever", "missing"};
+  for (int i = 0; i < 10; ++i) batch.push_back(std::to_string(i));
+  ASSERT_LE(tree.expireBatch(batch), 10);
+  ASSERT_EQ(tree.GetSize(), 2);
+  ASSERT_TRUE(tree.exists("alive"));
+  ASSERT_TRUE(tree.exists("forever"));
+}
+
+TEST(rbtree, expiring_within_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  ASSERT_EQ(tree.set("late", v, 55), s21::noErrors);
+  ASSERT_EQ(tree.set("soon", v, 5), s21::noErrors);
+  ASSERT_EQ(tree.set("middle", v, 25), s21::noErrors);
+  ASSERT_EQ(tree.set("forever", v), s21::noErrors);
+
+  auto keys = tree.expiringWithin(std::chrono::seconds(30));
+  ASSERT_EQ(keys, std::vector<std::string>({"soon", "middle"}));
+  ASSERT_EQ(tree.expiringWithin(std::chrono::seconds(60)).size(), 3);
+
+  auto counts = tree.expiryHistogram(std::chrono::seconds(10), 6);
+  ASSERT_EQ(counts, std::vector<size_t>({1, 0, 1, 0, 0, 1}));
+
+  ASSERT_EQ(tree.find(v, 25, s21::pTtl | s21::pCity),
+            std::vector<std::string>({"middle"}));
+  ASSERT_EQ(tree.del("middle"), s21::noErrors);
+  ASSERT_TRUE(tree.find(v, 25, s21::pTtl).empty());
+  ASSERT_EQ(tree.expiryHistogram(std::chrono::seconds(10), 6)[2], 0);
+}
+
+TEST(rbtree, expiry_histogram_current_deadline_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  ASSERT_EQ(tree.set("gone", v, 15), s21::noErrors);
+  ASSERT_EQ(tree.del("gone"), s21::noErrors);
+  ASSERT_EQ(tree.set("again", v, 5), s21::noErrors);
+  ASSERT_EQ(tree.del("again"), s21::noErrors);
+  ASSERT_EQ(tree.set("again", v, 55), s21::noErrors);
+  ASSERT_EQ(tree.set("persisted", v, 25), s21::noErrors);
+  ASSERT_EQ(tree.update("persisted", v, 0, s21::pTtl), s21::noErrors);
+  ASSERT_EQ(tree.expiryHistogram(std::chrono::seconds(10), 6),
+            std::vector<size_t>({0, 0, 0, 0, 0, 1}));
+}
+
+TEST(rbtree, keyspace_events_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  s21::Value v;
+  auto subscription = tree.Subscribe();
+  ASSERT_EQ(tree.set("1", v), s21::noErrors);
+  ASSERT_EQ(tree.set("1", v), s21::keyAlreadyExists);
+  ASSERT_EQ(tree.update("1", v, 0, s21::pCoins), s21::noErrors);
+  ASSERT_EQ(tree.rename("1", "2"), s21::noErrors);
+  ASSERT_EQ(tree.set("3", v, std::chrono::milliseconds(50)), s21::noErrors);
+  ASSERT_EQ(tree.del("2"), s21::noErrors);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_FALSE(tree.exists("3"));
+
+  std::vector<s21::KeyspaceEventType> types;
+  s21::KeyspaceEvent event;
+  while (subscription->Poll(event)) types.push_back(event.type);
+  ASSERT_EQ(types, std::vector<s21::KeyspaceEventType>(
+                       {s21::evSet, s21::evUpdate, s21::evRename, s21::evSet,
+                        s21::evDel, s21::evExpire}));
+  ASSERT_EQ(event.key, "3");
+  ASSERT_EQ(tree.GetSize(), 0);
+}
+
+TEST(rbtree, destroy_publishes_no_events_test) {
+  std::shared_ptr<s21::KeyspaceSubscription> subscription;
+  {
+    s21::SelfBalancingBinarySearchTree tree;
+    for (int i = 0; i < 100; ++i)
+      ASSERT_EQ(tree.set(std::to_string(i), s21::Value()), s21::noErrors);
+    subscription = tree.Subscribe();
+  }
+  // Уничтожение дерева не удаляет записи, как и у хеш-таблицы
+  s21::KeyspaceEvent event;
+  ASSERT_FALSE(subscription->Poll(event));
+}
+
+TEST(rbtree, snapshot_consistency_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  std::map<std::string, int> expected;
+  for (int i = 0; i < 20000; ++i) {
+    tree.set("key" + std::to_string(i), {"a", "b", 2000, "c", i});
+    expected["key" + std::to_string(i)] = i;
+  }
+  // Изменения начинаются только после начала обхода и не должны попасть в
+  // снимок
+  std::atomic<bool> started{false};
+  std::thread writer([&]() {
+    while (!started.load()) std::this_thread::yield();
+    for (int i = 0; i < 20000; i += 2) {
+      tree.update("key" + std::to_string(i), {"", "", 0, "", -1}, 0,
+                  s21::pCoins);
+      tree.del("key" + std::to_string(i + 1));
+      tree.set("new" + std::to_string(i), {"a", "b", 2000, "c", 0});
+      tree.rename("key" + std::to_string(i), "moved" + std::to_string(i));
+    }
+  });
+  auto entries = tree.snapshotEntries([&]() { started = true; });
+  writer.join();
+
+  std::map<std::string, int> actual;
+  for (const auto& entry : entries) actual[entry.key] = entry.value.coins;
+  ASSERT_EQ(actual, expected);
+  ASSERT_EQ(entries.size(), expected.size());
+  ASSERT_EQ(tree.GetSize(), 20000);
+  ASSERT_EQ(tree.snapshotEntries().size(), 20000u);
+}
@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../model/hash_table/hash_table.h"
+#include "../model/self_balancing_binary_search_tree/self_balancing_binary_search_tree.h"
+#include "../model/sketches/bloom_filter.h"
+#include "../model/sketches/count_min_sketch.h"
+#include "../model/sketches/hyper_log_log.h"
+#include "../types.h"
+
+TEST(sketches, hyper_log_log_test) {
+  s21::HyperLogLog hll;
+  ASSERT_EQ(hll.Estimate(), 0);
+  const int count = 100000;
+  for (int i = 0; i < count; ++i)
+    hll.Add(std::hash<std::string>()(std::to_string(i)) *
+            0x9e3779b97f4a7c15ULL);
+  long long estimate = hll.Estimate();
+  ASSERT_GT(estimate, count * 0.95);
+  ASSERT_LT(estimate, count * 1.05);
+}
+
+TEST(sketches, count_min_sketch_test) {
+  s21::CountMinSketch cms;
+  cms.Add(42, 10);
+  cms.Add(7, 3);
+  ASSERT_GE(cms.Estimate(42), 10);
+  cms.Add(42, -4);
+  ASSERT_GE(cms.Estimate(42), 6);
+  ASSERT_GE(cms.Estimate(7), 3);
+}
+
+TEST(sketches, merge_test) {
+  s21::HyperLogLog first;
+  s21::HyperLogLog second;
+  s21::CountMinSketch firstCounts;
+  s21::CountMinSketch secondCounts;
+  const int count = 100000;
+  for (int i = 0; i < count; ++i) {
+    const uint64_t hash =
+        std::hash<std::string>()(std::to_string(i)) * 0x9e3779b97f4a7c15ULL;
+    (i % 2 ? first : second).Add(hash);
+    (i % 2 ? firstCounts : secondCounts).Add(i % 10, 1);
+  }
+  first.Merge(second);
+  long long estimate = first.Estimate();
+  ASSERT_GT(estimate, count * 0.95);
+  ASSERT_LT(estimate, count * 1.05);
+  firstCounts.Merge(secondCounts);
+  ASSERT_GE(firstCounts.Estimate(3), count / 10);
+  ASSERT_GE(firstCounts.Estimate(4), count / 10);
+}
+
+TEST(sketches, bloom_filter_test) {
+  const int count = 10000;
+  for (const double rate : {0.1, 0.01, 0.001}) {
+    s21::BloomFilter filter(count, rate);
+    for (int i = 0; i < count; ++i)
+      filter.Add(s21::BloomFilter::HashOf("key" + std::to_string(i)));
+    for (int i = 0; i < count; ++i) {
+      const uint64_t hash = s21::BloomFilter::HashOf("key" + std::to_string(i));
+      ASSERT_TRUE(filter.MayContain(hash));
+    }
+    int falsePositives = 0;
+    for (int i = 0; i < 100 * count; ++i)
+      falsePositives += filter.MayContain(
+          s21::BloomFilter::HashOf("other" + std::to_string(i)));
+    ASSERT_LT(falsePositives, 100 * count * rate * 1.5);
+  }
+  s21::BloomFilter disabled(count, 0);
+  ASSERT_FALSE(disabled.Enabled());
+  ASSERT_TRUE(disabled.MayContain(s21::BloomFilter::HashOf("key")));
+}
+
+TEST(sketches, hashtable_bloom_filter_test) {
+  // Удаления копят устаревшие биты, пока фильтр корзины не перестроят
+  s21::HashTable hashtable;
+  s21::Value v{"Ivanov", "Ivan", 2000, "Moscow", 10};
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 5000; ++i)
+      ASSERT_EQ(hashtable.set("key" + std::to_string(i), v), s21::noErrors);
+    for (int i = 0; i < 5000; i += 2)
+      ASSERT_EQ(hashtable.del("key" + std::to_string(i)), s21::noErrors);
+    for (int i = 0; i < 5000; ++i)
+      ASSERT_EQ(hashtable.exists("key" + std::to_string(i)), i % 2 == 1);
+    ASSERT_EQ(hashtable.rename("key1", "moved"), s21::noErrors);
+    ASSERT_TRUE(hashtable.exists("moved"));
+    ASSERT_EQ(hashtable.rename("moved", "key1"), s21::noErrors);
+    for (int i = 1; i < 5000; i += 2)
+      ASSERT_EQ(hashtable.del("key" + std::to_string(i)), s21::noErrors);
+    ASSERT_EQ(hashtable.GetSize(), 0);
+  }
+}
+
+TEST(sketches, hashtable_statistics_test) {
+  s21::HashTable hashtable;
+  s21::Value v;
+  v.lastname = "asd";
+  v.name = "zxc";
+  v.year = 2000;
+  v.coins = 1;
+  for (int i = 0; i < 300; ++i) {
+    v.city = i % 3 ? "Moscow" : "City" + std::to_string(i);
+    hashtable.set(std::to_string(i), v);
+  }
+  long long distinct = hashtable.ApproxDistinct(s21::pCity);
+  ASSERT_GT(distinct, 95);
+  ASSERT_LT(distinct, 107);
+
+  std::vector<s21::HeavyHitter> top = hashtable.TopK(s21::pCity, 1);
+  ASSERT_EQ(top.size(), 1);
+  ASSERT_STREQ(top[0].value.c_str(), "Moscow");
+  ASSERT_EQ(top[0].count, 200);
+
+  hashtable.del("1");
+  v.city = "Kazan";
+  hashtable.update("2", v, 0, s21::pCity);
+  top = hashtable.TopK(s21::pCity, 1);
+  ASSERT_EQ(top[0].count, 198);
+}
+
+TEST(sketches, statistics_recount_test) {
+  const std::string fileName = "examples/test.snap";
+  s21::HashTable hashtable;
+  s21::Value v{"asd", "zxc", 2000, "", 1};
+  for (int i = 0; i < 100; ++i) {
+    v.city = "City" + std::to_string(i);
+    hashtable.set(std::to_string(i), v);
+  }
+  for (int i = 10; i < 100; ++i) hashtable.del(std::to_string(i));
+  ASSERT_GT(hashtable.ApproxDistinct(s21::pCity), 95);
+
+  // Полный снимок строит оценку заново по живым записям
+  ASSERT_EQ(hashtable.checkpoint(fileName), 10);
+  ASSERT_EQ(hashtable.ApproxDistinct(s21::pCity), 10);
+  v.city = "Moscow";
+  hashtable.set("new", v);
+  ASSERT_EQ(hashtable.ApproxDistinct(s21::pCity), 11);
+  std::remove(fileName.c_str());
+}
+
+TEST(sketches, rbtree_statistics_test) {
+  s21::SelfBalancingBinarySearchTree tree;
+  s21::Value v;
+  v.name = "zxc";
+  v.city = "Moscow";
+  v.year = 2000;
+  v.coins = 1;
+  for (int i = 0; i < 50; ++i) {
+    v.lastname = i < 40 ? "Ivanov" : "Petrov";
+    tree.set(std::to_string(i), v);
+  }
+  ASSERT_EQ(tree.ApproxDistinct(s21::pLastname), 2);
+  std::vector<s21::HeavyHitter> top = tree.TopK(s21::pLastname, 5);
+  ASSERT_EQ(top.size(), 2);
+  ASSERT_STREQ(top[0].value.c_str(), "Ivanov");
+  ASSERT_EQ(top[0].count, 40);
+  ASSERT_EQ(top[1].count, 10);
+
+  tree.del("45");
+  ASSERT_EQ(tree.TopK(s21::pLastname, 2)[1].count, 9);
+  ASSERT_TRUE(tree.TopK(s21::pYear, 2).empty());
+}
@@ -0,0 +1,352 @@
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "../model/binary_io.h"
+#include "../model/data.h"
+#include "../model/delta_snapshot.h"
+#include "../model/hash_table/hash_table.h"
+#include "../model/lz_block.h"
+#include "../model/self_balancing_binary_search_tree/self_balancing_binary_search_tree.h"
+#include "../model/snapshot.h"
+#include "../types.h"
+
+namespace {
+std::string ReadFile(const std::string& fileName) {
+  std::ifstream fin(fileName, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(fin),
+                     std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::string& fileName, const std::string& data) {
+  std::ofstream fout(fileName, std::ios::binary | std::ios::trunc);
+  fout << data;
+}
+}  // namespace
+
+TEST(snapshot, crc32_test) {
+  ASSERT_EQ(s21::Crc32("123456789"), 0xCBF43926u);
+  ASSERT_EQ(s21::Crc32(""), 0u);
+}
+
+TEST(snapshot, little_endian_test) {
+  std::string data;
+  s21::Put<uint32_t>(data, 0x01020304u);
+  s21::Put<int32_t>(data, -2);
+  s21::Put<int64_t>(data, -1234567890123LL);
+  s21::Put<uint8_t>(data, 0xAB);
+  ASSERT_EQ(data.substr(0, 8),
+            std::string("\x04\x03\x02\x01\xFE\xFF\xFF\xFF"));
+  s21::BinaryReader reader(data);
+  ASSERT_EQ(reader.Get<uint32_t>(), 0x01020304u);
+  ASSERT_EQ(reader.Get<int32_t>(), -2);
+  ASSERT_EQ(reader.Get<int64_t>(), -1234567890123LL);
+  ASSERT_EQ(reader.Get<uint8_t>(), 0xAB);
+  ASSERT_TRUE(reader.AtEnd());
+}
+
+TEST(snapshot, round_trip_test) {
+  std::vector<std::pair<s21::Key, s21::Value>> values;
+  for (int i = 0; i < 20000; ++i)
+    values.push_back({"key" + std::to_string(i),
+                      {"Ivanov Petrov", "", 1900 + i % 100, "Moscow", -i}});
+  ASSERT_EQ(s21::Data::saveData("examples/test.txt", values,
+                                s21::binaryFormat),
+            20000);
+  auto loaded = s21::Data::loadData("examples/test.txt");
+  ASSERT_EQ(loaded.size(), values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    ASSERT_EQ(loaded[i].first, values[i].first);
+    ASSERT_EQ(loaded[i].second.lastname, values[i].second.lastname);
+    ASSERT_EQ(loaded[i].second.name, values[i].second.name);
+    ASSERT_EQ(loaded[i].second.year, values[i].second.year);
+    ASSERT_EQ(loaded[i].second.city, values[i].second.city);
+    ASSERT_EQ(loaded[i].second.coins, values[i].second.coins);
+  }
+}
+
+TEST(snapshot, export_upload_test) {
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.upload("examples/ex1.txt"), 3);
+  ASSERT_EQ(hashtable.exportValues("examples/test.txt", s21::binaryFormat), 3);
+  s21::HashTable restored;
+  ASSERT_EQ(restored.upload("examples/test.txt"), 3);
+  ASSERT_EQ(restored.get("key300500").value().city, "Novgorod");
+
+  s21::HashTable empty;
+  ASSERT_EQ(empty.exportValues("examples/test.txt", s21::binaryFormat), 0);
+  ASSERT_EQ(restored.upload("examples/test.txt"), 0);
+}
+
+TEST(snapshot, export_upload_ttl_test) {
+  s21::HashTable hashtable;
+  hashtable.set("timed", {"a", "b", 2000, "c", 1}, 100);
+  hashtable.set("plain", {"a", "b", 2000, "c", 2});
+  hashtable.set("short", {"a", "b", 2000, "c", 3},
+                std::chrono::milliseconds(50));
+  ASSERT_EQ(hashtable.exportValues("examples/test.txt", s21::binaryFormat), 3);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  s21::HashTable restored;
+  ASSERT_EQ(restored.upload("examples/test.txt"), 2);
+  ASSERT_GT(restored.PTtl("timed"), 90000);
+  ASSERT_LE(restored.PTtl("timed"), 100000);
+  ASSERT_EQ(restored.PTtl("plain"), hashtable.PTtl("plain"));
+  ASSERT_FALSE(restored.exists("short"));
+}
+
+TEST(snapshot, corrupted_test) {
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.upload("examples/ex1.txt"), 3);
+  ASSERT_EQ(hashtable.exportValues("examples/test.txt", s21::binaryFormat), 3);
+  const std::string data = ReadFile("examples/test.txt");
+
+  std::string damaged = data;
+  damaged[30] ^= 0x01;
+  WriteFile("examples/test.txt", damaged);
+  s21::HashTable restored;
+  ASSERT_EQ(restored.upload("examples/test.txt"), s21::corruptedFile);
+
+  WriteFile("examples/test.txt", data.substr(0, data.size() - 5));
+  ASSERT_EQ(restored.upload("examples/test.txt"), s21::corruptedFile);
+
+  damaged = data;
+  damaged[8] = 2;
+  WriteFile("examples/test.txt", damaged);
+  ASSERT_EQ(restored.upload("examples/test.txt"), s21::corruptedFile);
+
+  // Старший байт размера первого блока до сжатия
+  damaged = data;
+  damaged[31] ^= 0x80;
+  WriteFile("examples/test.txt", damaged);
+  ASSERT_EQ(restored.upload("examples/test.txt"), s21::corruptedFile);
+  ASSERT_EQ(restored.GetSize(), 0);
+}
+
+TEST(snapshot, corrupted_resets_error_line_test) {
+  s21::HashTable hashtable;
+  ASSERT_EQ(hashtable.upload("examples/ex1.txt"), 3);
+  ASSERT_EQ(hashtable.exportValues("examples/test.txt", s21::binaryFormat), 3);
+  const std::string data = ReadFile("examples/test.txt");
+  WriteFile("examples/test.txt", data.substr(0, data.size() - 5));
+
+  s21::HashTable restored;
+  ASSERT_EQ(restored.upload("examples/corrupted.txt"), s21::corruptedFile);
+  ASSERT_EQ(restored.UploadErrorLine(), 2);
+  ASSERT_EQ(restored.upload("examples/test.txt"), s21::corruptedFile);
+  ASSERT_EQ(restored.UploadErrorLine(), 0);
+}
+
+TEST(snapshot, lz_block_test) {
+  std::mt19937 gen(21);
+  std::string random(100000, '\0');
+  for (auto& c : random) c = static_cast<char>(gen());
+  std::string repeated;
+  for (int i = 0; i < 10000; ++i)
+    repeated += "key" + std::to_string(i % 300) + "Moscow";
+  for (const std::string& data :
+       {std::string(), std::string("abc"), std::string(70000, 'x'), random,
+        repeated}) {
+    const std::string compressed = s21::LzBlock::Compress(data);
+    ASSERT_EQ(s21::LzBlock::Decompress(compressed, data.size()), data);
+  }
+  ASSERT_LT(s21::LzBlock::Compress(repeated).size(), repeated.size() / 4);
+
+  const std::string compressed = s21::LzBlock::Compress(repeated);
+  ASSERT_THROW(s21::LzBlock::Decompress(compressed, repeated.size() + 1),
+               std::runtime_error);
+  ASSERT_THROW(s21::LzBlock::Decompress(compressed.substr(0, 10),
+                                        repeated.size()),
+               std::runtime_error);
+}
+
+TEST(snapshot, compressed_round_trip_test) {
+  std::vector<std::pair<s21::Key, s21::Value>> values;
+  for (int i = 0; i < 20000; ++i)
+    values.push_back({"key" + std::to_string(i),
+                      {"Ivanov", "Petr", 1900 + i % 100, "Moscow", i % 50}});
+  ASSERT_EQ(s21::Snapshot::save("examples/test.txt", values, false), 20000);
+  const std::string raw = ReadFile("examples/test.txt");
+  ASSERT_EQ(s21::Snapshot::save("examples/test.txt", values), 20000);
+  const std::string compressed = ReadFile("examples/test.txt");
+  ASSERT_LT(compressed.size(), raw.size() / 2);
+  for (const std::string& data : {raw, compressed}) {
+    auto loaded = s21::Snapshot::load(data);
+    ASSERT_EQ(loaded.size(), values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      ASSERT_EQ(loaded[i].key, values[i].first);
+      ASSERT_EQ(loaded[i].value.city, values[i].second.city);
+      ASSERT_EQ(loaded[i].value.coins, values[i].second.coins);
+      ASSERT_EQ(loaded[i].timeToDel, s21::NoDeadline);
+    }
+  }
+}
+
+TEST(snapshot, checkpoint_chain_test) {
+  const std::string fileName = "examples/test.snap";
+  s21::SelfBalancingBinarySearchTree rbtree;
+  for (int i = 0; i < 1000; ++i)
+    rbtree.set("key" + std::to_string(i), {"a", "b", 2000, "c", i});
+  ASSERT_EQ(rbtree.checkpoint(fileName), 1000);
+  const size_t baseSize = ReadFile(fileName).size();
+
+  rbtree.update("key1", {"", "", 0, "", -1}, 0, s21::pCoins);
+  rbtree.del("key2");
+  rbtree.rename("key3", "renamed");
+  ASSERT_EQ(rbtree.checkpoint(fileName), 4);
+  ASSERT_LT(ReadFile(s21::DeltaSnapshot::DeltaName(fileName, 1)).size(),
+            baseSize / 10);
+  rbtree.set("key2", {"a", "b", 2000, "c", 2});
+  ASSERT_EQ(rbtree.checkpoint(fileName), 1);
+  ASSERT_EQ(s21::DeltaSnapshot::ChainLength(fileName), 2u);
+
+  s21::HashTable restored;
+  ASSERT_EQ(restored.restoreCheckpoint(fileName), 1000);
+  ASSERT_EQ(restored.get("key1").value().coins, -1);
+  ASSERT_EQ(restored.get("key2").value().coins, 2);
+  ASSERT_FALSE(restored.exists("key3"));
+  ASSERT_EQ(restored.get("renamed").value().coins, 3);
+
+  // Восстановленное хранилище продолжает ту же цепочку
+  restored.del("key4");
+  ASSERT_EQ(restored.checkpoint(fileName), 1);
+  ASSERT_EQ(s21::DeltaSnapshot::ChainLength(fileName), 3u);
+  ASSERT_EQ(restored.compactCheckpoint(fileName), 999);
+  ASSERT_EQ(s21::DeltaSnapshot::ChainLength(fileName), 0u);
+  s21::HashTable compacted;
+  ASSERT_EQ(compacted.restoreCheckpoint(fileName), 999);
+  ASSERT_FALSE(compacted.exists("key4"));
+  ASSERT_EQ(compacted.get("key1").value().coins, -1);
+  std::remove(fileName.c_str());
+}
+
+TEST(snapshot, checkpoint_after_concurrent_restore_test) {
+  const std::string fileName = "examples/test.snap";
+  {
+    s21::HashTable hashtable;
+    for (int i = 0; i < 20000; ++i)
+      hashtable.set("key" + std::to_string(i), {"a", "b", 2000, "c", i});
+    ASSERT_EQ(hashtable.checkpoint(fileName), 20000);
+  }
+  // Записи другого потока во время восстановления попадают в следующий
+  // checkpoint
+  s21::HashTable restored;
+  std::atomic<bool> stop{false};
+  std::thread writer([&]() {
+    for (int i = 0; !stop; ++i)
+      restored.set("new" + std::to_string(i), {"a", "b", 2000, "c", i});
+  });
+  ASSERT_EQ(restored.restoreCheckpoint(fileName), 20000);
+  stop = true;
+  writer.join();
+  ASSERT_GE(restored.checkpoint(fileName), 0);
+
+  s21::HashTable reloaded;
+  ASSERT_EQ(reloaded.restoreCheckpoint(fileName), restored.GetSize());
+  s21::DeltaSnapshot::removeDeltas(fileName);
+  std::remove(fileName.c_str());
+}
+
+TEST(snapshot, checkpoint_ttl_test) {
+  const std::string fileName = "examples/test.snap";
+  s21::SelfBalancingBinarySearchTree rbtree;
+  rbtree.set("base", {"a", "b", 2000, "c", 1}, 100);
+  rbtree.set("plain", {"a", "b", 2000, "c", 2});
+  ASSERT_EQ(rbtree.checkpoint(fileName), 2);
+  rbtree.set("delta", {"a", "b", 2000, "c", 3}, 100);
+  rbtree.set("short", {"a", "b", 2000, "c", 4}, std::chrono::milliseconds(50));
+  ASSERT_EQ(rbtree.checkpoint(fileName), 2);
+  ASSERT_EQ(s21::DeltaSnapshot::ChainLength(fileName), 1u);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  s21::HashTable restored;
+  ASSERT_EQ(restored.restoreCheckpoint(fileName), 3);
+  for (const std::string key : {"base", "delta"}) {
+    ASSERT_GT(restored.PTtl(key), 90000);
+    ASSERT_LE(restored.PTtl(key), 100000);
+  }
+  ASSERT_EQ(restored.PTtl("plain"), rbtree.PTtl("plain"));
+  ASSERT_FALSE(restored.exists("short"));
+
+  ASSERT_EQ(restored.compactCheckpoint(fileName), 3);
+  s21::HashTable compacted;
+  ASSERT_EQ(compacted.restoreCheckpoint(fileName), 3);
+  ASSERT_GT(compacted.PTtl("delta"), 90000);
+  std::remove(fileName.c_str());
+}
+
+TEST(snapshot, checkpoint_corrupted_delta_test) {
+  const std::string fileName = "examples/test.snap";
+  s21::HashTable hashtable;
+  hashtable.set("a", {"a", "b", 2000, "c", 1});
+  ASSERT_EQ(hashtable.checkpoint(fileName), 1);
+  hashtable.set("b", {"a", "b", 2000, "c", 1});
+  ASSERT_EQ(hashtable.checkpoint(fileName), 1);
+  const std::string deltaName = s21::DeltaSnapshot::DeltaName(fileName, 1);
+  const std::string delta = ReadFile(deltaName);
+  WriteFile(deltaName, delta.substr(0, delta.size() - 1));
+  s21::HashTable restored;
+  ASSERT_EQ(restored.restoreCheckpoint(fileName), s21::corruptedFile);
+
+  std::string otherVersion = delta;
+  otherVersion[8] = 2;
+  WriteFile(deltaName, otherVersion);
+  ASSERT_EQ(restored.restoreCheckpoint(fileName), s21::corruptedFile);
+
+  // Новый полный снимок удаляет дельты старой цепочки
+  s21::HashTable other;
+  other.set("c", {"a", "b", 2000, "c", 1});
+  ASSERT_EQ(other.checkpoint(fileName), 1);
+  ASSERT_EQ(s21::DeltaSnapshot::ChainLength(fileName), 0u);
+  ASSERT_EQ(restored.restoreCheckpoint(fileName), 1);
+  std::remove(fileName.c_str());
+}
+
+TEST(snapshot, checkpoint_failed_base_test) {
+  const std::string fileName = "examples/test.snap";
+  s21::HashTable hashtable;
+  hashtable.set("a", {"a", "b", 2000, "c", 1});
+  ASSERT_EQ(hashtable.checkpoint(fileName), 1);
+  hashtable.set("b", {"a", "b", 2000, "c", 2});
+  ASSERT_EQ(hashtable.checkpoint(fileName), 1);
+
+  // Каталог на месте временного файла не дает записать новый снимок
+  const std::string tmpName = fileName + ".tmp";
+  ASSERT_EQ(mkdir(tmpName.c_str(), 0755), 0);
+  WriteFile(tmpName + "/file", "");
+  s21::HashTable other;
+  other.set("c", {"a", "b", 2000, "c", 3});
+  ASSERT_EQ(other.checkpoint(fileName), s21::canNotOpenFile);
+  ASSERT_EQ(std::remove((tmpName + "/file").c_str()), 0);
+  ASSERT_EQ(rmdir(tmpName.c_str()), 0);
+  ASSERT_EQ(s21::DeltaSnapshot::ChainLength(fileName), 1u);
+  s21::HashTable restored;
+  ASSERT_EQ(restored.restoreCheckpoint(fileName), 2);
+  ASSERT_EQ(restored.get("b").value().coins, 2);
+
+  // Сбой между записью снимка и удалением дельт: дельты прошлой цепочки не
+  // применяются к новому снимку
+  ASSERT_EQ(s21::DeltaSnapshot::saveBase(fileName, {{"c", {"a", "b", 2000,
+                                                           "c", 3}}}),
+            1);
+  ASSERT_EQ(s21::DeltaSnapshot::ChainLength(fileName), 0u);
+  s21::HashTable fresh;
+  ASSERT_EQ(fresh.restoreCheckpoint(fileName), 1);
+  ASSERT_FALSE(fresh.exists("b"));
+  fresh.set("d", {"a", "b", 2000, "c", 4});
+  ASSERT_EQ(fresh.checkpoint(fileName), 1);
+  s21::HashTable chained;
+  ASSERT_EQ(chained.restoreCheckpoint(fileName), 2);
+  ASSERT_TRUE(chained.exists("d"));
+  ASSERT_FALSE(chained.exists("b"));
+  s21::DeltaSnapshot::removeDeltas(fileName);
+  std::remove(fileName.c_str());
+}
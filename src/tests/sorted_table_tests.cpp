@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../model/bitcask/bitcask.h"
+#include "../model/hash_table/hash_table.h"
+#include "../model/lsm_tree/lsm_tree.h"
+#include "../model/sorted_table/sorted_table.h"
+#include "../types.h"
+
+namespace {
+std::string TableName(const std::string& name) {
+  return (std::filesystem::temp_directory_path() /
+          (name + "_" + std::to_string(getpid()) + ".table"))
+      .string();
+}
+}  // namespace
+
+TEST(sorted_table, operations_test) {
+  const std::string fileName = TableName("s21_table_operations");
+  std::vector<std::pair<s21::Key, s21::Value>> values;
+  std::map<std::string, int> expected;
+  for (int i = 999; i >= 0; --i) {
+    const std::string key = "key" + std::to_string(i);
+    values.push_back({key, {"Ivanov", "Ivan", 2000, i % 2 ? "Moscow" : "", i}});
+    expected[key] = i;
+  }
+  values.push_back({"key1", {"Petrov", "Petr", 1990, "Kazan", -1}});
+  ASSERT_EQ(s21::SortedTable::Build(fileName, values), 1000);
+
+  s21::SortedTable table(fileName);
+  ASSERT_EQ(table.GetSize(), 1000);
+  for (const auto& [key, coins] : expected) {
+    auto value = table.get(key);
+    ASSERT_TRUE(value.has_value());
+    ASSERT_EQ(value->coins, coins);
+    ASSERT_TRUE(table.exists(key));
+    ASSERT_FALSE(table.exists(key + "_"));
+  }
+  ASSERT_FALSE(table.exists(""));
+  ASSERT_FALSE(table.exists("zzz"));
+  ASSERT_EQ(table.Ttl("key1"), s21::hasNoTtl);
+  ASSERT_EQ(table.Ttl("nokey"), s21::keyNotFound);
+
+  std::vector<std::string> keys;
+  for (const auto& row : expected) keys.push_back(row.first);
+  ASSERT_EQ(table.keys(), keys);
+  ASSERT_EQ(table.find({"", "", 0, "Moscow", 0}, 0, s21::pCity).size(), 500u);
+
+  auto range = table.range("key10", "key11");
+  std::vector<std::string> rangeKeys;
+  for (const auto& row : range) rangeKeys.push_back(row.first);
+  std::vector<std::string> expectedRange;
+  for (auto it = expected.lower_bound("key10");
+       it != expected.end() && it->first <= "key11"; ++it)
+    expectedRange.push_back(it->first);
+  ASSERT_EQ(rangeKeys, expectedRange);
+  ASSERT_EQ(table.range("a", "b").size(), 0u);
+  ASSERT_EQ(table.range("a", "z").size(), 1000u);
+
+  ASSERT_EQ(table.set("new", values[0].second), s21::readOnlyStorage);
+  ASSERT_EQ(table.del("key1"), s21::readOnlyStorage);
+  ASSERT_EQ(table.rename("key1", "key2"), s21::readOnlyStorage);
+  ASSERT_EQ(table.update("key1", values[0].second, 0, s21::pCity),
+            s21::readOnlyStorage);
+  ASSERT_EQ(table.GetSize(), 1000);
+  std::remove(fileName.c_str());
+}
+
+TEST(sorted_table, empty_test) {
+  const std::string fileName = TableName("s21_table_empty");
+  ASSERT_EQ(s21::SortedTable::Build(
+                fileName, std::vector<std::pair<s21::Key, s21::Value>>()),
+            0);
+  s21::SortedTable table(fileName);
+  ASSERT_EQ(table.GetSize(), 0);
+  ASSERT_FALSE(table.exists("key"));
+  ASSERT_TRUE(table.keys().empty());
+  ASSERT_TRUE(table.range("a", "z").empty());
+  std::remove(fileName.c_str());
+}
+
+TEST(sorted_table, corrupted_test) {
+  const std::string fileName = TableName("s21_table_corrupted");
+  std::vector<std::pair<s21::Key, s21::Value>> values;
+  for (int i = 0; i < 100; ++i)
+    values.push_back({"key" + std::to_string(i), {"a", "b", 2000, "c", i}});
+  ASSERT_EQ(s21::SortedTable::Build(fileName, values), 100);
+  // Портим ключ в индексе в конце файла
+  const auto size = std::filesystem::file_size(fileName);
+  {
+    std::fstream file(fileName,
+                      std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(size - 40);
+    file.put('#');
+  }
+  ASSERT_THROW(s21::SortedTable table(fileName), std::runtime_error);
+  std::filesystem::resize_file(fileName, 10);
+  ASSERT_THROW(s21::SortedTable table(fileName), std::runtime_error);
+  std::remove(fileName.c_str());
+  ASSERT_THROW(s21::SortedTable table(fileName), std::runtime_error);
+}
+
+TEST(sorted_table, build_from_stores_test) {
+  const std::string fileName = TableName("s21_table_stores");
+  s21::LsmTree::Options lsmOptions;
+  lsmOptions.memtableBytes = 4 << 10;
+  lsmOptions.runBytes = 4 << 10;
+  s21::HashTable hashtable;
+  s21::LsmTree lsm(lsmOptions);
+  s21::Bitcask::Options bitcaskOptions;
+  bitcaskOptions.directory = TableName("s21_table_stores_bitcask");
+  std::filesystem::remove_all(bitcaskOptions.directory);
+  s21::Bitcask bitcask(bitcaskOptions);
+  for (s21::AbstractKeyValueStore* store :
+       std::vector<s21::AbstractKeyValueStore*>{&hashtable, &lsm, &bitcask}) {
+    std::vector<std::string> expected;
+    for (int i = 999; i >= 0; --i)
+      ASSERT_EQ(store->set("key" + std::to_string(i), {"a", "b", 2000, "c", i}),
+                s21::noErrors);
+    for (int i = 0; i < 1000; ++i) {
+      if (i % 3 == 0)
+        ASSERT_EQ(store->del("key" + std::to_string(i)), s21::noErrors);
+      else
+        expected.push_back("key" + std::to_string(i));
+    }
+    std::sort(expected.begin(), expected.end());
+    ASSERT_EQ(s21::SortedTable::Build(fileName,
+                                      [store](const s21::EntryWriter& write) {
+                                        store->forEachEntryByKey(write);
+                                      }),
+              static_cast<int>(expected.size()));
+    s21::SortedTable table(fileName);
+    ASSERT_EQ(table.keys(), expected);
+    ASSERT_EQ(table.get("key5").value().coins, 5);
+  }
+  std::remove(fileName.c_str());
+  std::filesystem::remove_all(bitcaskOptions.directory);
+}
+
+TEST(sorted_table, unordered_source_test) {
+  const std::string fileName = TableName("s21_table_unordered");
+  std::vector<std::pair<s21::Key, s21::Value>> values = {
+      {"b", {"a", "b", 2000, "c", 1}}, {"a", {"a", "b", 2000, "c", 2}}};
+  ASSERT_EQ(s21::SortedTable::Build(fileName, s21::SourceOf(values)),
+            s21::unknownError);
+  ASSERT_FALSE(std::filesystem::exists(fileName));
+  ASSERT_FALSE(std::filesystem::exists(fileName + ".tmp"));
+}
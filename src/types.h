@@ -1,12 +1,59 @@
 #ifndef SRC_MODEL_TYPES_H_
 #define SRC_MODEL_TYPES_H_
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace s21 {
 typedef std::string Key;
 
+// Время удаления записей отсчитывается по монотонным часам
+typedef std::chrono::steady_clock Clock;
+typedef Clock::time_point Deadline;
+constexpr Deadline NoDeadline = Deadline::max();
+
+// from + duration без переполнения: срок дальше представимого становится
+// последним моментом перед NoDeadline
+inline Deadline SaturatingAdd(const Deadline from,
+                              const std::chrono::milliseconds duration) {
+  const auto room =
+      std::chrono::duration_cast<std::chrono::milliseconds>(NoDeadline - from);
+  if (duration >= room) return NoDeadline - Clock::duration(1);
+  return from + duration;
+}
+
+// Текущее время системных часов в миллисекундах
+inline int64_t NowWallClockMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// Время удаления в миллисекундах системных часов для файлов, которые
+// переживают перезапуск, 0 - без него. FromWallClock - обратно
+inline int64_t ToWallClock(const Deadline timeToDel) {
+  if (timeToDel == NoDeadline) return 0;
+  auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+      timeToDel - Clock::now());
+  return std::max<int64_t>(NowWallClockMs() + remaining.count(), 1);
+}
+
+// Оставшееся время жизни. Отрицательное, если время уже истекло
+inline std::chrono::milliseconds RemainingTtl(const int64_t expireAt) {
+  return std::chrono::milliseconds(expireAt - NowWallClockMs());
+}
+
+inline Deadline FromWallClock(const int64_t expireAt) {
+  if (expireAt == 0) return NoDeadline;
+  return SaturatingAdd(Clock::now(), RemainingTtl(expireAt));
+}
+
 struct Value {
   std::string lastname;
   std::string name;
@@ -14,13 +61,55 @@ struct Value {
   std::string city;
   int coins;
 
-  void Print() {
-    std::cout << lastname << " " << name << " " << year << " " << city << " "
-              << coins << std::endl;
+  void Print(std::ostream& out = std::cout) const {
+    out << lastname << " " << name << " " << year << " " << city << " "
+        << coins << std::endl;
   }
 };
 
-enum ContainerType { hashTable, rbtree };
+// Запись хранилища вместе с временем удаления
+struct Entry {
+  Key key;
+  Value value;
+  Deadline timeToDel;
+};
+
+// Потоковая запись файла: источник вызывает write для каждой записи по
+// очереди, не собирая их в память
+typedef std::function<void(const Key&, const Value&, const Deadline)>
+    EntryWriter;
+typedef std::function<void(const EntryWriter& write)> EntrySource;
+
+// Источник записей values без времени удаления. values должен жить, пока
+// источник используется
+inline EntrySource SourceOf(const std::vector<std::pair<Key, Value>>& values) {
+  return [&values](const EntryWriter& write) {
+    for (const auto& [key, value] : values) write(key, value, NoDeadline);
+  };
+}
+
+// Источник записей entries вместе с временем удаления
+inline EntrySource SourceOf(const std::vector<Entry>& entries) {
+  return [&entries](const EntryWriter& write) {
+    for (const auto& entry : entries)
+      write(entry.key, entry.value, entry.timeToDel);
+  };
+}
+
+// Значение вместе с версией записи
+struct VersionedValue {
+  Value value;
+  uint64_t version;
+};
+
+enum ContainerType { hashTable, rbtree, lsmTree, bitcask, sortedTable };
+
+enum FileFormat { textFormat, binaryFormat };
+
+// Когда журнал операций сбрасывается на диск: после каждой операции, раз в
+// заданный интервал или общим fsync для одновременно пишущих потоков. При
+// fsyncAlways и fsyncGroupCommit операция завершается после записи на диск
+enum FsyncPolicy { fsyncAlways, fsyncInterval, fsyncGroupCommit };
 
 enum Errors {
   noErrors = 0,
@@ -29,7 +118,14 @@ enum Errors {
   hasNoTtl = -3,
   canNotOpenFile = -4,
   corruptedFile = -5,
-  unknownError = -10
+  readOnlyStorage = -6,
+  valueOutOfRange = -7,
+  versionMismatch = -8,
+  // Изменение применено, но не записано в журнал операций
+  logWriteFailed = -9,
+  unknownError = -10,
+  // Хранилище не ведет версий записей
+  versionsNotSupported = -11
 };
 
 enum ValueParam {
@@ -41,6 +137,37 @@ enum ValueParam {
   pTtl = 1 << 5
 };
 
+enum AggregateFunction { aggSum, aggCount, aggMin, aggMax };
+
+struct AggregateQuery {
+  AggregateFunction function;
+  int field;
+  int groupBy;
+  Value filter;
+  int ttl;
+  int paramsMask;
+};
+
+struct AggregateRow {
+  std::string group;
+  long long result;
+  int count;
+};
+
+struct HeavyHitter {
+  std::string value;
+  long long count;
+};
+
+enum KeyspaceEventType { evSet, evUpdate, evDel, evRename, evExpire };
+
+// Для evRename key - прежний ключ, newKey - новый
+struct KeyspaceEvent {
+  KeyspaceEventType type;
+  Key key;
+  Key newKey;
+};
+
 }  // namespace s21
 
 #endif  //  SRC_MODEL_TYPES_H_
\ No newline at end of file